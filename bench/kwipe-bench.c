@@ -0,0 +1,890 @@
+/*
+ *  kwipe-bench.c: The end-to-end benchmark, run with make bench.
+ *
+ *  Runs kwipe over every combination of the methods, PRNGs, write sizes, sync settings and
+ *  I/O backends asked for, against a sparse file, a file, a loop device or a disk, and records
+ *  for each the throughput of the passes, the CPU time, the peak RSS and the number of read
+ *  and write system calls to JSON. The throughput is taken from the log, kwipe logs the bytes
+ *  its passes moved and the time they took, so start-up and device probing don't count. The
+ *  system calls are read from /proc/PID/io once kwipe has exited and before it is reaped.
+ *
+ *  With --compare the results are compared with a baseline saved from an earlier run, and
+ *  a fall in throughput or a rise in CPU time beyond --threshold is flagged as a regression.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define KWIPE_BENCH_MAX_LIST 32
+#define KWIPE_BENCH_MAX_ARGS 64
+#define KWIPE_BENCH_MAX_REPEAT 100
+#define KWIPE_BENCH_NAME_LENGTH 256
+#define KWIPE_BENCH_LINE_LENGTH 4096
+
+/* The defaults of the matrix, each a comma separated list */
+#define KWIPE_BENCH_METHODS "zero,random,dodshort"
+#define KWIPE_BENCH_PRNGS "aes_ctr_prng,xoroshiro256_prng,isaac64"
+#define KWIPE_BENCH_BLOCKS "default,autotune"
+#define KWIPE_BENCH_SYNCS "100000,window=64"
+#define KWIPE_BENCH_IOS "null,mem"
+
+/* Baselines under this much CPU time are too short to compare */
+#define KWIPE_BENCH_MIN_CPU_SECONDS 0.05
+
+typedef struct
+{
+    char* item[KWIPE_BENCH_MAX_LIST];
+    int count;
+} kwipe_bench_list_t;
+
+typedef struct
+{
+    char name[KWIPE_BENCH_NAME_LENGTH];  // method/prng/block/sync/io, the key results are compared by.
+    const char* method;
+    const char* prng;  // "-" when the method doesn't use the PRNG.
+    const char* block;
+    const char* sync;
+    const char* io;
+    int status;  // The exit status of kwipe, -1 if it didn't exit normally.
+    unsigned long long bytes;  // The bytes read and written by the passes.
+    double wipe_seconds;  // The time the passes took.
+    double throughput;  // bytes / wipe_seconds, in MB/s.
+    double wall_seconds;  // The time kwipe ran for, start-up included.
+    double user_seconds;
+    double system_seconds;
+    double peak_rss_kb;
+    double read_syscalls;
+    double write_syscalls;
+} kwipe_bench_result_t;
+
+typedef struct
+{
+    const char* kwipe;  // The kwipe binary.
+    const char* target;  // The device or file wiped.
+    const char* log;  // The log file kwipe writes, parsed for the bytes and time of the passes.
+    char** extra;  // Arguments passed on to kwipe.
+    int extra_count;
+    int repeat;  // The number of runs of each combination, the medians are recorded.
+} kwipe_bench_config_t;
+
+static void kwipe_bench_help( void )
+{
+    puts( "Usage: kwipe-bench [options] [-- kwipe options]\n" );
+    puts( "Runs kwipe over every combination of the lists below and writes the throughput of the" );
+    puts( "passes, CPU time, peak RSS and system calls of each to JSON. kwipe must run as root.\n" );
+    puts( "  --kwipe=PATH        The kwipe binary (default: ./kwipe)" );
+    puts( "  --target=PATH       The device or file to wipe, it is overwritten if --ios has device" );
+    puts( "                      (default: a sparse file of --size in $TMPDIR, removed afterwards)" );
+    puts( "  --size=MIB          The size of the default target (default: 1024)" );
+    puts( "  --methods=LIST      kwipe --method values (default: " KWIPE_BENCH_METHODS ")" );
+    puts( "  --prngs=LIST        kwipe --prng values, for the methods that use the PRNG" );
+    puts( "                      (default: " KWIPE_BENCH_PRNGS ")" );
+    puts( "  --blocks=LIST       default for st_blksize writes, autotune for --autotune" );
+    puts( "                      (default: " KWIPE_BENCH_BLOCKS ")" );
+    puts( "  --syncs=LIST        N for --sync=N, window=MIB for --sync-window=MIB" );
+    puts( "                      (default: " KWIPE_BENCH_SYNCS ")" );
+    puts( "  --ios=LIST          kwipe --io values, device, null and mem (default: " KWIPE_BENCH_IOS ")" );
+    puts( "  --repeat=NUM        Runs of each combination, medians are recorded (default: 3)" );
+    puts( "  --output=FILE       Write the results to FILE (default: stdout)" );
+    puts( "  --input=FILE        Don't run kwipe, read the results from FILE, for --compare" );
+    puts( "  --compare=BASELINE  Compare the results with BASELINE, a saved --output, and exit" );
+    puts( "                      with 1 if any have regressed" );
+    puts( "  --threshold=PCT     A fall in throughput or rise in CPU time of more than PCT" );
+    puts( "                      percent is a regression (default: 5)" );
+    puts( "  --help              Show this help" );
+}
+
+static int kwipe_bench_split( char* text, kwipe_bench_list_t* list )
+{
+    char* save;
+    char* item;
+
+    list->count = 0;
+    for( item = strtok_r( text, ",", &save ); item != NULL; item = strtok_r( NULL, ",", &save ) )
+    {
+        if( list->count == KWIPE_BENCH_MAX_LIST )
+        {
+            fprintf( stderr, "Error: At most %i values can be listed.\n", KWIPE_BENCH_MAX_LIST );
+            return -1;
+        }
+        list->item[list->count++] = item;
+    }
+
+    return 0;
+}
+
+/* Whether the method writes or verifies a PRNG stream, the others are run once whatever --prngs says */
+static int kwipe_bench_uses_prng( const char* method )
+{
+    static const char* fixed[] = { "zero", "quick", "one", "verify_zero", "verify_one", NULL };
+    int i;
+
+    if( strncmp( method, "sanitize_", 9 ) == 0 )
+    {
+        return 0;
+    }
+
+    for( i = 0; fixed[i] != NULL; i++ )
+    {
+        if( strcmp( method, fixed[i] ) == 0 )
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static double kwipe_bench_seconds( const struct timeval* tv )
+{
+    return (double) tv->tv_sec + (double) tv->tv_usec / 1e6;
+}
+
+static double kwipe_bench_now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Reads the read and write system call counts of an exited, not yet reaped, process */
+static void kwipe_bench_syscalls( pid_t pid, double* reads, double* writes )
+{
+    char path[64];
+    char line[128];
+    unsigned long long value;
+    FILE* fp;
+
+    *reads = 0;
+    *writes = 0;
+
+    snprintf( path, sizeof( path ), "/proc/%i/io", (int) pid );
+    fp = fopen( path, "r" );
+    if( fp == NULL )
+    {
+        return;
+    }
+
+    while( fgets( line, sizeof( line ), fp ) != NULL )
+    {
+        if( sscanf( line, "syscr: %llu", &value ) == 1 )
+        {
+            *reads = (double) value;
+        }
+        else if( sscanf( line, "syscw: %llu", &value ) == 1 )
+        {
+            *writes = (double) value;
+        }
+    }
+
+    fclose( fp );
+}
+
+/* Adds up the "N bytes in S seconds on DEVICE" lines kwipe logs at the end of each wipe */
+static int kwipe_bench_parse_log( const char* log, kwipe_bench_result_t* result )
+{
+    char line[KWIPE_BENCH_LINE_LENGTH];
+    unsigned long long bytes;
+    double seconds;
+    char* p;
+    FILE* fp;
+    int found = 0;
+
+    fp = fopen( log, "r" );
+    if( fp == NULL )
+    {
+        return -1;
+    }
+
+    while( fgets( line, sizeof( line ), fp ) != NULL )
+    {
+        p = strstr( line, "notice: " );
+        if( p != NULL && sscanf( p + 8, "%llu bytes in %lf seconds on", &bytes, &seconds ) == 2 )
+        {
+            result->bytes += bytes;
+            result->wipe_seconds += seconds;
+            found++;
+        }
+    }
+
+    fclose( fp );
+    return found > 0 ? 0 : -1;
+}
+
+static int kwipe_bench_run_once( const kwipe_bench_config_t* config, char** argv, kwipe_bench_result_t* result )
+{
+    struct rusage usage;
+    siginfo_t info;
+    double start;
+    pid_t pid;
+    int status;
+    int fd;
+
+    /* kwipe appends to its log */
+    fd = open( config->log, O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+    if( fd < 0 )
+    {
+        fprintf( stderr, "Error: Unable to create %s: %s\n", config->log, strerror( errno ) );
+        return -1;
+    }
+    close( fd );
+
+    memset( result, 0, sizeof( kwipe_bench_result_t ) );
+    start = kwipe_bench_now();
+
+    pid = fork();
+    if( pid < 0 )
+    {
+        fprintf( stderr, "Error: fork: %s\n", strerror( errno ) );
+        return -1;
+    }
+
+    if( pid == 0 )
+    {
+        fd = open( "/dev/null", O_RDWR );
+        if( fd >= 0 )
+        {
+            dup2( fd, STDIN_FILENO );
+            dup2( fd, STDOUT_FILENO );
+            dup2( fd, STDERR_FILENO );
+        }
+        execv( config->kwipe, argv );
+        _exit( 127 );
+    }
+
+    /* Wait for it to exit but leave it unreaped, its /proc/PID/io goes with it */
+    while( waitid( P_PID, pid, &info, WEXITED | WNOWAIT ) != 0 && errno == EINTR )
+    {
+    }
+    kwipe_bench_syscalls( pid, &result->read_syscalls, &result->write_syscalls );
+
+    while( wait4( pid, &status, 0, &usage ) < 0 && errno == EINTR )
+    {
+    }
+
+    result->wall_seconds = kwipe_bench_now() - start;
+    result->user_seconds = kwipe_bench_seconds( &usage.ru_utime );
+    result->system_seconds = kwipe_bench_seconds( &usage.ru_stime );
+    result->peak_rss_kb = (double) usage.ru_maxrss;
+    result->status = WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+
+    if( kwipe_bench_parse_log( config->log, result ) == 0 && result->wipe_seconds > 0 )
+    {
+        result->throughput = (double) result->bytes / result->wipe_seconds / 1e6;
+    }
+
+    return 0;
+}
+
+static int kwipe_bench_compare_doubles( const void* a, const void* b )
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+static double kwipe_bench_median( double* values, int count )
+{
+    qsort( values, count, sizeof( double ), kwipe_bench_compare_doubles );
+    return count % 2 ? values[count / 2] : ( values[count / 2 - 1] + values[count / 2] ) / 2;
+}
+
+/* Runs a combination config->repeat times, each metric of the result is the median of the runs */
+static int kwipe_bench_run( const kwipe_bench_config_t* config, kwipe_bench_result_t* result )
+{
+    kwipe_bench_result_t runs[KWIPE_BENCH_MAX_REPEAT];
+    double values[KWIPE_BENCH_MAX_REPEAT];
+    char method[KWIPE_BENCH_NAME_LENGTH];
+    char prng[KWIPE_BENCH_NAME_LENGTH];
+    char sync[KWIPE_BENCH_NAME_LENGTH];
+    char io[KWIPE_BENCH_NAME_LENGTH];
+    char* argv[KWIPE_BENCH_MAX_ARGS];
+    int argc = 0;
+    int i;
+
+    argv[argc++] = (char*) config->kwipe;
+    argv[argc++] = "--nogui";
+    argv[argc++] = "--autonuke";
+    argv[argc++] = "--nowait";
+    argv[argc++] = "--PDFreportpath=noPDF";
+    argv[argc++] = "--logfile";
+    argv[argc++] = (char*) config->log;
+
+    snprintf( method, sizeof( method ), "--method=%s", result->method );
+    argv[argc++] = method;
+
+    if( strcmp( result->prng, "-" ) != 0 )
+    {
+        snprintf( prng, sizeof( prng ), "--prng=%s", result->prng );
+        argv[argc++] = prng;
+    }
+
+    if( strcmp( result->block, "autotune" ) == 0 )
+    {
+        argv[argc++] = "--autotune";
+    }
+
+    if( strncmp( result->sync, "window=", 7 ) == 0 )
+    {
+        snprintf( sync, sizeof( sync ), "--sync-window=%s", result->sync + 7 );
+    }
+    else
+    {
+        snprintf( sync, sizeof( sync ), "--sync=%s", result->sync );
+    }
+    argv[argc++] = sync;
+
+    snprintf( io, sizeof( io ), "--io=%s", result->io );
+    argv[argc++] = io;
+
+    for( i = 0; i < config->extra_count && argc < KWIPE_BENCH_MAX_ARGS - 2; i++ )
+    {
+        argv[argc++] = config->extra[i];
+    }
+
+    argv[argc++] = (char*) config->target;
+    argv[argc] = NULL;
+
+    for( i = 0; i < config->repeat; i++ )
+    {
+        if( kwipe_bench_run_once( config, argv, &runs[i] ) != 0 )
+        {
+            return -1;
+        }
+
+        /* A failed run is recorded as it is, the comparison flags it */
+        if( runs[i].status != 0 )
+        {
+            result->status = runs[i].status;
+        }
+    }
+
+#define KWIPE_BENCH_MEDIAN( field )                        \
+    for( i = 0; i < config->repeat; i++ )                  \
+    {                                                      \
+        values[i] = (double) runs[i].field;                \
+    }                                                      \
+    result->field = kwipe_bench_median( values, config->repeat );
+
+    KWIPE_BENCH_MEDIAN( wipe_seconds );
+    KWIPE_BENCH_MEDIAN( throughput );
+    KWIPE_BENCH_MEDIAN( wall_seconds );
+    KWIPE_BENCH_MEDIAN( user_seconds );
+    KWIPE_BENCH_MEDIAN( system_seconds );
+    KWIPE_BENCH_MEDIAN( peak_rss_kb );
+    KWIPE_BENCH_MEDIAN( read_syscalls );
+    KWIPE_BENCH_MEDIAN( write_syscalls );
+
+#undef KWIPE_BENCH_MEDIAN
+
+    result->bytes = runs[0].bytes;
+
+    return 0;
+}
+
+static void kwipe_bench_json_string( FILE* fp, const char* text )
+{
+    fputc( '"', fp );
+    for( ; *text != 0; text++ )
+    {
+        if( *text == '"' || *text == '\\' )
+        {
+            fputc( '\\', fp );
+            fputc( *text, fp );
+        }
+        else if( (unsigned char) *text >= 0x20 )
+        {
+            fputc( *text, fp );
+        }
+    }
+    fputc( '"', fp );
+}
+
+/* Each result is written on a line of its own, that is what kwipe_bench_load() reads */
+static void kwipe_bench_write_result( FILE* fp, const kwipe_bench_result_t* r, int last )
+{
+    fprintf( fp, "    { \"name\": " );
+    kwipe_bench_json_string( fp, r->name );
+    fprintf( fp, ", \"method\": " );
+    kwipe_bench_json_string( fp, r->method );
+    fprintf( fp, ", \"prng\": " );
+    kwipe_bench_json_string( fp, r->prng );
+    fprintf( fp, ", \"block\": " );
+    kwipe_bench_json_string( fp, r->block );
+    fprintf( fp, ", \"sync\": " );
+    kwipe_bench_json_string( fp, r->sync );
+    fprintf( fp, ", \"io\": " );
+    kwipe_bench_json_string( fp, r->io );
+    fprintf( fp,
+             ", \"status\": %i, \"bytes\": %llu, \"wipe_seconds\": %.3f, \"throughput_mbs\": %.1f"
+             ", \"wall_seconds\": %.3f, \"user_seconds\": %.3f, \"system_seconds\": %.3f"
+             ", \"peak_rss_kb\": %.0f, \"read_syscalls\": %.0f, \"write_syscalls\": %.0f }%s\n",
+             r->status,
+             r->bytes,
+             r->wipe_seconds,
+             r->throughput,
+             r->wall_seconds,
+             r->user_seconds,
+             r->system_seconds,
+             r->peak_rss_kb,
+             r->read_syscalls,
+             r->write_syscalls,
+             last ? "" : "," );
+}
+
+static double kwipe_bench_field( const char* line, const char* field )
+{
+    char key[64];
+    const char* p;
+
+    snprintf( key, sizeof( key ), "\"%s\": ", field );
+    p = strstr( line, key );
+    return p == NULL ? 0 : strtod( p + strlen( key ), NULL );
+}
+
+/* Reads the results written by kwipe_bench_write_result(), only the fields compared are kept */
+static int kwipe_bench_load( const char* path, kwipe_bench_result_t** results, int* count )
+{
+    char line[KWIPE_BENCH_LINE_LENGTH];
+    kwipe_bench_result_t* r;
+    const char* p;
+    size_t length;
+    FILE* fp;
+
+    fp = fopen( path, "r" );
+    if( fp == NULL )
+    {
+        fprintf( stderr, "Error: Unable to open %s: %s\n", path, strerror( errno ) );
+        return -1;
+    }
+
+    *results = NULL;
+    *count = 0;
+
+    while( fgets( line, sizeof( line ), fp ) != NULL )
+    {
+        p = strstr( line, "{ \"name\": \"" );
+        if( p == NULL )
+        {
+            continue;
+        }
+        p += 11;
+
+        r = realloc( *results, ( *count + 1 ) * sizeof( kwipe_bench_result_t ) );
+        if( r == NULL )
+        {
+            fclose( fp );
+            return -1;
+        }
+        *results = r;
+        r = &r[( *count )++];
+        memset( r, 0, sizeof( kwipe_bench_result_t ) );
+
+        length = strcspn( p, "\"" );
+        if( length >= sizeof( r->name ) )
+        {
+            length = sizeof( r->name ) - 1;
+        }
+        memcpy( r->name, p, length );
+
+        r->status = (int) kwipe_bench_field( line, "status" );
+        r->throughput = kwipe_bench_field( line, "throughput_mbs" );
+        r->user_seconds = kwipe_bench_field( line, "user_seconds" );
+        r->system_seconds = kwipe_bench_field( line, "system_seconds" );
+        r->peak_rss_kb = kwipe_bench_field( line, "peak_rss_kb" );
+    }
+
+    fclose( fp );
+    return 0;
+}
+
+static double kwipe_bench_change( double before, double after )
+{
+    return before > 0 ? ( after - before ) * 100 / before : 0;
+}
+
+/* Prints a line per result and returns the number that have regressed */
+static int kwipe_bench_compare( const kwipe_bench_result_t* base,
+                                int base_count,
+                                const kwipe_bench_result_t* now,
+                                int now_count,
+                                double threshold )
+{
+    const kwipe_bench_result_t* b;
+    double cpu_before;
+    double cpu_after;
+    double throughput_change;
+    double cpu_change;
+    int regressions = 0;
+    int regressed;
+    int i;
+    int j;
+
+    printf( "%-56s %10s %10s %8s %8s %8s %8s\n", "", "MB/s", "was", "change", "CPU s", "was", "change" );
+
+    for( i = 0; i < now_count; i++ )
+    {
+        b = NULL;
+        for( j = 0; j < base_count; j++ )
+        {
+            if( strcmp( base[j].name, now[i].name ) == 0 )
+            {
+                b = &base[j];
+                break;
+            }
+        }
+
+        if( b == NULL )
+        {
+            printf( "%-56s %10.1f %10s   (not in the baseline)\n", now[i].name, now[i].throughput, "-" );
+            continue;
+        }
+
+        cpu_before = b->user_seconds + b->system_seconds;
+        cpu_after = now[i].user_seconds + now[i].system_seconds;
+        throughput_change = kwipe_bench_change( b->throughput, now[i].throughput );
+        cpu_change = kwipe_bench_change( cpu_before, cpu_after );
+
+        regressed = ( now[i].status != 0 && b->status == 0 ) || throughput_change < -threshold
+                    || ( cpu_before >= KWIPE_BENCH_MIN_CPU_SECONDS && cpu_change > threshold );
+        regressions += regressed;
+
+        printf( "%-56s %10.1f %10.1f %+7.1f%% %8.2f %8.2f %+7.1f%%%s\n",
+                now[i].name,
+                now[i].throughput,
+                b->throughput,
+                throughput_change,
+                cpu_after,
+                cpu_before,
+                cpu_change,
+                regressed ? now[i].status != 0 && b->status == 0 ? "  FAILED" : "  REGRESSION" : "" );
+    }
+
+    for( j = 0; j < base_count; j++ )
+    {
+        for( i = 0; i < now_count && strcmp( base[j].name, now[i].name ) != 0; i++ )
+        {
+        }
+        if( i == now_count )
+        {
+            printf( "%-56s %10s %10.1f   (not run)\n", base[j].name, "-", base[j].throughput );
+        }
+    }
+
+    printf( "%i of %i results regressed by more than %.1f%%\n", regressions, now_count, threshold );
+    return regressions;
+}
+
+static void kwipe_bench_version( const char* kwipe, char* version, size_t length )
+{
+    char command[KWIPE_BENCH_LINE_LENGTH];
+    FILE* fp;
+
+    snprintf( version, length, "unknown" );
+    snprintf( command, sizeof( command ), "'%s' --version 2>/dev/null", kwipe );
+
+    fp = popen( command, "r" );
+    if( fp == NULL )
+    {
+        return;
+    }
+    if( fgets( version, (int) length, fp ) != NULL )
+    {
+        version[strcspn( version, "\n" )] = 0;
+    }
+    pclose( fp );
+}
+
+int main( int argc, char** argv )
+{
+    static struct option long_options[] = { { "kwipe", required_argument, 0, 'k' },
+                                            { "target", required_argument, 0, 't' },
+                                            { "size", required_argument, 0, 's' },
+                                            { "methods", required_argument, 0, 'm' },
+                                            { "prngs", required_argument, 0, 'p' },
+                                            { "blocks", required_argument, 0, 'b' },
+                                            { "syncs", required_argument, 0, 'y' },
+                                            { "ios", required_argument, 0, 'i' },
+                                            { "repeat", required_argument, 0, 'r' },
+                                            { "output", required_argument, 0, 'o' },
+                                            { "input", required_argument, 0, 'I' },
+                                            { "compare", required_argument, 0, 'c' },
+                                            { "threshold", required_argument, 0, 'T' },
+                                            { "help", no_argument, 0, 'h' },
+                                            { 0, 0, 0, 0 } };
+
+    char methods_text[KWIPE_BENCH_LINE_LENGTH] = KWIPE_BENCH_METHODS;
+    char prngs_text[KWIPE_BENCH_LINE_LENGTH] = KWIPE_BENCH_PRNGS;
+    char blocks_text[KWIPE_BENCH_LINE_LENGTH] = KWIPE_BENCH_BLOCKS;
+    char syncs_text[KWIPE_BENCH_LINE_LENGTH] = KWIPE_BENCH_SYNCS;
+    char ios_text[KWIPE_BENCH_LINE_LENGTH] = KWIPE_BENCH_IOS;
+    kwipe_bench_list_t methods;
+    kwipe_bench_list_t prngs;
+    kwipe_bench_list_t blocks;
+    kwipe_bench_list_t syncs;
+    kwipe_bench_list_t ios;
+    kwipe_bench_list_t one_prng = { { "-" }, 1 };
+    kwipe_bench_list_t* method_prngs;
+    kwipe_bench_config_t config = { "./kwipe", NULL, NULL, NULL, 0, 3 };
+    kwipe_bench_result_t* results = NULL;
+    kwipe_bench_result_t* baseline = NULL;
+    kwipe_bench_result_t* r;
+    const char* output = NULL;
+    const char* input = NULL;
+    const char* compare = NULL;
+    const char* tmpdir;
+    char version[KWIPE_BENCH_NAME_LENGTH];
+    char target[PATH_MAX] = "";
+    char log[PATH_MAX];
+    double threshold = 5;
+    long size_mib = 1024;
+    int baseline_count = 0;
+    int count = 0;
+    int total;
+    int m, p, b, s, i;
+    int opt;
+    int fd;
+    FILE* fp;
+
+    while( ( opt = getopt_long( argc, argv, "h", long_options, NULL ) ) != -1 )
+    {
+        switch( opt )
+        {
+            case 'k':
+                config.kwipe = optarg;
+                break;
+            case 't':
+                config.target = optarg;
+                break;
+            case 's':
+                size_mib = strtol( optarg, NULL, 10 );
+                break;
+            case 'm':
+                snprintf( methods_text, sizeof( methods_text ), "%s", optarg );
+                break;
+            case 'p':
+                snprintf( prngs_text, sizeof( prngs_text ), "%s", optarg );
+                break;
+            case 'b':
+                snprintf( blocks_text, sizeof( blocks_text ), "%s", optarg );
+                break;
+            case 'y':
+                snprintf( syncs_text, sizeof( syncs_text ), "%s", optarg );
+                break;
+            case 'i':
+                snprintf( ios_text, sizeof( ios_text ), "%s", optarg );
+                break;
+            case 'r':
+                config.repeat = (int) strtol( optarg, NULL, 10 );
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'I':
+                input = optarg;
+                break;
+            case 'c':
+                compare = optarg;
+                break;
+            case 'T':
+                threshold = strtod( optarg, NULL );
+                break;
+            case 'h':
+                kwipe_bench_help();
+                return 0;
+            default:
+                kwipe_bench_help();
+                return 2;
+        }
+    }
+
+    if( config.repeat < 1 || config.repeat > KWIPE_BENCH_MAX_REPEAT || size_mib < 1 || threshold < 0 )
+    {
+        fprintf(
+            stderr, "Error: --repeat must be 1 to %i, --size and --threshold positive.\n", KWIPE_BENCH_MAX_REPEAT );
+        return 2;
+    }
+
+    config.extra = argv + optind;
+    config.extra_count = argc - optind;
+
+    if( input != NULL )
+    {
+        if( compare == NULL )
+        {
+            fprintf( stderr, "Error: --input is only used with --compare.\n" );
+            return 2;
+        }
+        if( kwipe_bench_load( input, &results, &count ) != 0 )
+        {
+            return 2;
+        }
+    }
+    else
+    {
+        if( kwipe_bench_split( methods_text, &methods ) != 0 || kwipe_bench_split( prngs_text, &prngs ) != 0
+            || kwipe_bench_split( blocks_text, &blocks ) != 0 || kwipe_bench_split( syncs_text, &syncs ) != 0
+            || kwipe_bench_split( ios_text, &ios ) != 0 )
+        {
+            return 2;
+        }
+
+        if( geteuid() != 0 )
+        {
+            fprintf( stderr, "Warning: kwipe must run as root, the runs will fail.\n" );
+        }
+
+        tmpdir = getenv( "TMPDIR" ) ? getenv( "TMPDIR" ) : "/tmp";
+
+        /* A sparse file, the null and mem backends only need its size */
+        if( config.target == NULL )
+        {
+            snprintf( target, sizeof( target ), "%s/kwipe-bench-XXXXXX", tmpdir );
+            fd = mkstemp( target );
+            if( fd < 0 || ftruncate( fd, (off_t) size_mib * 1024 * 1024 ) != 0 )
+            {
+                fprintf( stderr, "Error: Unable to create the target %s: %s\n", target, strerror( errno ) );
+                return 2;
+            }
+            close( fd );
+            config.target = target;
+        }
+
+        snprintf( log, sizeof( log ), "%s/kwipe-bench-log-XXXXXX", tmpdir );
+        fd = mkstemp( log );
+        if( fd < 0 )
+        {
+            fprintf( stderr, "Error: Unable to create the log %s: %s\n", log, strerror( errno ) );
+            return 2;
+        }
+        close( fd );
+        config.log = log;
+
+        total = 0;
+        for( m = 0; m < methods.count; m++ )
+        {
+            total += ( kwipe_bench_uses_prng( methods.item[m] ) ? prngs.count : 1 ) * blocks.count * syncs.count
+                     * ios.count;
+        }
+
+        results = calloc( total, sizeof( kwipe_bench_result_t ) );
+        if( results == NULL )
+        {
+            fprintf( stderr, "Error: Unable to allocate memory for the results.\n" );
+            return 2;
+        }
+
+        for( m = 0; m < methods.count; m++ )
+        {
+            method_prngs = kwipe_bench_uses_prng( methods.item[m] ) ? &prngs : &one_prng;
+
+            for( p = 0; p < method_prngs->count; p++ )
+                for( b = 0; b < blocks.count; b++ )
+                    for( s = 0; s < syncs.count; s++ )
+                        for( i = 0; i < ios.count; i++ )
+                        {
+                            r = &results[count++];
+                            r->method = methods.item[m];
+                            r->prng = method_prngs->item[p];
+                            r->block = blocks.item[b];
+                            r->sync = syncs.item[s];
+                            r->io = ios.item[i];
+                            snprintf( r->name,
+                                      sizeof( r->name ),
+                                      "%s/%s/%s/%s/%s",
+                                      r->method,
+                                      r->prng,
+                                      r->block,
+                                      r->sync,
+                                      r->io );
+
+                            fprintf( stderr, "[%i/%i] %s ", count, total, r->name );
+                            if( kwipe_bench_run( &config, r ) != 0 )
+                            {
+                                return 2;
+                            }
+                            fprintf( stderr,
+                                     "%.1f MB/s, %.2f s CPU%s\n",
+                                     r->throughput,
+                                     r->user_seconds + r->system_seconds,
+                                     r->status ? ", FAILED" : "" );
+                        }
+        }
+
+        unlink( log );
+        if( target[0] != 0 )
+        {
+            unlink( target );
+        }
+    }
+
+    /* With --compare and no --output only the comparison is printed */
+    if( input == NULL && ( output != NULL || compare == NULL ) )
+    {
+        fp = output != NULL ? fopen( output, "w" ) : stdout;
+        if( fp == NULL )
+        {
+            fprintf( stderr, "Error: Unable to create %s: %s\n", output, strerror( errno ) );
+            return 2;
+        }
+
+        kwipe_bench_version( config.kwipe, version, sizeof( version ) );
+        fprintf( fp, "{\n  \"kwipe\": " );
+        kwipe_bench_json_string( fp, version );
+        fprintf( fp, ",\n  \"target\": " );
+        kwipe_bench_json_string( fp, config.target );
+        fprintf( fp, ",\n  \"date\": %lld,\n  \"repeat\": %i,\n", (long long) time( NULL ), config.repeat );
+        fprintf( fp, "  \"results\": [\n" );
+        for( i = 0; i < count; i++ )
+        {
+            kwipe_bench_write_result( fp, &results[i], i == count - 1 );
+        }
+        fprintf( fp, "  ]\n}\n" );
+
+        if( fp != stdout )
+        {
+            fclose( fp );
+        }
+    }
+
+    if( compare != NULL )
+    {
+        if( kwipe_bench_load( compare, &baseline, &baseline_count ) != 0 )
+        {
+            return 2;
+        }
+        return kwipe_bench_compare( baseline, baseline_count, results, count, threshold ) > 0 ? 1 : 0;
+    }
+
+    return 0;
+}
@@ -31,7 +31,9 @@
 #define STATE_SIZE 64  // Size of the state array, sufficient for a high period
 #define LAG_BIG 55  // Large lag, e.g., 55
 #define LAG_SMALL 24  // Small lag, e.g., 24
-#define MODULUS ( 1ULL << 48 )  // Modulus for the operations, here 2^48 for simple handling
+
+/* The arithmetic is modulo 2^64, the natural overflow of uint64_t, so every bit of each word written is random.
+ * The period is 2^63 * (2^55 - 1) as long as one of the LAG_BIG previous values is odd. */
 
 void add_lagg_fibonacci_init( add_lagg_fibonacci_state_t* state, uint64_t init_key[], unsigned long key_length )
 {
@@ -45,35 +47,34 @@ void add_lagg_fibonacci_init( add_lagg_fibonacci_state_t* state, uint64_t init_k
         else
         {
             // Simple method to generate further state values. Should be improved for serious applications.
-            state->s[i] = ( 6364136223846793005ULL * state->s[i - 1] + 1 ) % MODULUS;
+            state->s[i] = 6364136223846793005ULL * ( i > 0 ? state->s[i - 1] : 0 ) + 1;
         }
     }
+
+    // Ensure the full period, the first value generated adds s[STATE_SIZE - LAG_BIG]
+    state->s[STATE_SIZE - LAG_BIG] |= 1;
+
     state->index = 0;  // Initialize the index for the first generation
 }
 
 void add_lagg_fibonacci_genrand_uint256_to_buf( add_lagg_fibonacci_state_t* state, unsigned char* bufpos )
 {
-    uint64_t* buf_as_uint64 = (uint64_t*) bufpos;  // Interprets bufpos as a uint64_t array for direct assignment
-    int64_t result;  // Use signed integer to handle potential negative results from subtraction
+    for( int i = 0; i < 4; i++ )
+    {
+        // s[n] = s[n - LAG_BIG] + s[n - LAG_SMALL], the state array is a ring of the last STATE_SIZE values
+        uint64_t result = state->s[( state->index + STATE_SIZE - LAG_BIG ) % STATE_SIZE]
+            + state->s[( state->index + STATE_SIZE - LAG_SMALL ) % STATE_SIZE];
 
-    for (int i = 0; i < 4; i++) {
-        // Subtract the two previous numbers in the sequence
-        result = (int64_t)state->s[(state->index + LAG_BIG) % STATE_SIZE] - (int64_t)state->s[(state->index + LAG_SMALL) % STATE_SIZE];
+        state->s[state->index] = result;
 
-        // Handle borrow if result is negative
-        if (result < 0) {
-            result += MODULUS;
-            // Optionally set a borrow flag or adjust the next operation based on borrow logic
+        // Write the result low byte first
+        for( int j = 0; j < 8; j++ )
+        {
+            bufpos[i * 8 + j] = (unsigned char) ( result & 0xFF );
+            result >>= 8;
         }
 
-        // Store the result (after adjustment) back into the state, ensuring it's positive and within range
-        state->s[state->index] = (uint64_t)result;
-
-        // Write the result into buf_as_uint64
-        buf_as_uint64[i] = state->s[state->index];
-
         // Update the index for the next round
-        state->index = (state->index + 1) % STATE_SIZE;
+        state->index = ( state->index + 1 ) % STATE_SIZE;
     }
 }
-
@@ -0,0 +1,302 @@
+/*
+ *  autotune.c: Choosing the write size for each drive by measuring it.
+ *
+ *  The write passes normally write st_blksize bytes at a time, usually 4KiB, whatever the
+ *  drive. USB sticks, SAS disks and NVMe drives reach their best speed at very different
+ *  sizes, so when --autotune is set the first write pass on each drive is started with a
+ *  calibration. Each size on a ladder from st_blksize up to NWIPE_AUTOTUNE_MAX_SIZE is
+ *  used for NWIPE_AUTOTUNE_TRIAL_BYTES of the pass, ending with an fdatasync so that the
+ *  page cache doesn't flatter the result, and the fastest is locked in for the rest of the
+ *  wipe. The trials write the pass's own data, so nothing is written twice.
+ *
+ *  After calibration the throughput is measured over every NWIPE_AUTOTUNE_WINDOW_BYTES. If
+ *  it collapses, as it can when an SSD's cache fills or a USB bridge changes mode, the
+ *  drive is calibrated again. Time spent in the thermal throttle is not counted.
+ *
+ *  The passes use blocking write(), so there is no queue depth to tune, only the size.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "miscellaneous.h"
+#include "stats.h"
+#include "autotune.h"
+#include "io.h"
+
+static size_t kwipe_autotune_ladder( kwipe_context_t* c, int trial )
+{
+    /* The size tried in a trial, trials are numbered from 1 */
+    size_t size = c->device_stat.st_blksize;
+
+    while( --trial > 0 )
+    {
+        size *= NWIPE_AUTOTUNE_STEP;
+    }
+
+    return size;
+}
+
+static int kwipe_autotune_ladder_length( kwipe_context_t* c )
+{
+    int trials = 1;
+
+    while( kwipe_autotune_ladder( c, trials + 1 ) <= NWIPE_AUTOTUNE_MAX_SIZE )
+    {
+        trials++;
+    }
+
+    return trials;
+}
+
+static void kwipe_autotune_size_text( size_t size, char* text, size_t text_size )
+{
+    if( size >= 1024 * 1024 && size % ( 1024 * 1024 ) == 0 )
+    {
+        snprintf( text, text_size, "%zuMiB", size / ( 1024 * 1024 ) );
+    }
+    else if( size >= 1024 && size % 1024 == 0 )
+    {
+        snprintf( text, text_size, "%zuKiB", size / 1024 );
+    }
+    else
+    {
+        snprintf( text, text_size, "%zuB", size );
+    }
+}
+
+static void kwipe_autotune_rate_text( u64 rate, char* text, size_t text_size )
+{
+    /* Determine_C_B_nomenclature() pads to a fixed width for the tables, drop the padding */
+    char padded[13];
+
+    Determine_C_B_nomenclature( rate, padded, sizeof( padded ) );
+    snprintf( text, text_size, "%s", padded + strspn( padded, " " ) );
+}
+
+static void kwipe_autotune_begin( kwipe_context_t* c )
+{
+    /* Starts a trial or window */
+    c->autotune_bytes = 0;
+    c->autotune_start_ns = kwipe_time_ns();
+    c->autotune_throttle_ns = c->throttle_ns;
+}
+
+static u64 kwipe_autotune_throughput( kwipe_context_t* c )
+{
+    /* Bytes per second over the current trial or window, leaving out time spent throttled */
+    u64 elapsed = kwipe_time_ns() - c->autotune_start_ns - ( c->throttle_ns - c->autotune_throttle_ns );
+
+    if( elapsed == 0 )
+    {
+        return 0;
+    }
+
+    return c->autotune_bytes * 1000000000ULL / elapsed;
+}
+
+static void kwipe_autotune_calibrate( kwipe_context_t* c )
+{
+    char smallest[NWIPE_AUTOTUNE_TXT_LENGTH];
+    char largest[NWIPE_AUTOTUNE_TXT_LENGTH];
+    int trials = kwipe_autotune_ladder_length( c );
+
+    kwipe_autotune_size_text( kwipe_autotune_ladder( c, 1 ), smallest, sizeof( smallest ) );
+    kwipe_autotune_size_text( kwipe_autotune_ladder( c, trials ), largest, sizeof( largest ) );
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "Autotune: calibrating %s, %i sizes from %s to %s",
+               c->device_name,
+               trials,
+               smallest,
+               largest );
+
+    c->autotune_calibrations++;
+    c->autotune_trial = 1;
+    c->autotune_best_size = 0;
+    c->autotune_best_throughput = 0;
+    c->io_size = kwipe_autotune_ladder( c, 1 );
+
+    kwipe_autotune_begin( c );
+}
+
+static void kwipe_autotune_lock( kwipe_context_t* c )
+{
+    char size[NWIPE_AUTOTUNE_TXT_LENGTH];
+    char throughput[13];
+
+    c->autotune_trial = 0;
+
+    if( c->autotune_best_size == 0 )
+    {
+        /* Abandoned before the first trial finished */
+        c->io_size = 0;
+        c->io_size_throughput = 0;
+        return;
+    }
+
+    c->io_size = c->autotune_best_size;
+    c->io_size_throughput = c->autotune_best_throughput;
+
+    kwipe_autotune_size_text( c->io_size, size, sizeof( size ) );
+    kwipe_autotune_rate_text( c->io_size_throughput, throughput, sizeof( throughput ) );
+    kwipe_log( NWIPE_LOG_NOTICE, "Autotune: %s locked in %s writes at %s/s", c->device_name, size, throughput );
+
+    kwipe_autotune_begin( c );
+}
+
+size_t kwipe_autotune_buffer_size( kwipe_context_t* c )
+{
+    size_t size = c->device_stat.st_blksize;
+
+    if( kwipe_options.autotune && size < NWIPE_AUTOTUNE_MAX_SIZE )
+    {
+        size = NWIPE_AUTOTUNE_MAX_SIZE;
+    }
+
+    return size;
+}
+
+void kwipe_autotune_start_pass( kwipe_context_t* c )
+{
+    char size[NWIPE_AUTOTUNE_TXT_LENGTH];
+
+    if( !kwipe_options.autotune )
+    {
+        return;
+    }
+
+    if( c->autotune_calibrations == 0 )
+    {
+        if( c->device_size
+            < kwipe_autotune_ladder_length( c ) * NWIPE_AUTOTUNE_TRIAL_BYTES * NWIPE_AUTOTUNE_MIN_LADDERS )
+        {
+            kwipe_autotune_size_text( c->device_stat.st_blksize, size, sizeof( size ) );
+            kwipe_log( NWIPE_LOG_INFO, "Autotune: %s is too small to calibrate, writing %s", c->device_name, size );
+
+            /* Don't try again on the next pass */
+            c->autotune_calibrations = NWIPE_AUTOTUNE_MAX_CALIBRATIONS;
+            return;
+        }
+
+        kwipe_autotune_calibrate( c );
+        return;
+    }
+
+    /* Restart the current trial or window, the sync at the end of the last pass would skew it */
+    kwipe_autotune_begin( c );
+}
+
+void kwipe_autotune_update( kwipe_context_t* c, size_t bytes )
+{
+    char size[NWIPE_AUTOTUNE_TXT_LENGTH];
+    char throughput[13];
+    char calibrated[13];
+    u64 rate;
+
+    if( !kwipe_options.autotune )
+    {
+        return;
+    }
+
+    c->autotune_bytes += bytes;
+
+    if( c->autotune_trial )
+    {
+        if( c->autotune_bytes < NWIPE_AUTOTUNE_TRIAL_BYTES )
+        {
+            return;
+        }
+
+        /* Count the time to get the trial onto the drive, not just into the page cache */
+        if( kwipe_io_fdatasync( c ) != 0 )
+        {
+            kwipe_perror( errno, __FUNCTION__, "fdatasync" );
+            kwipe_log( NWIPE_LOG_WARNING, "Autotune: buffer flush failure on %s, calibration stopped", c->device_name );
+            kwipe_autotune_lock( c );
+            return;
+        }
+
+        rate = kwipe_autotune_throughput( c );
+
+        kwipe_autotune_size_text( c->io_size, size, sizeof( size ) );
+        kwipe_autotune_rate_text( rate, throughput, sizeof( throughput ) );
+        kwipe_log( NWIPE_LOG_INFO, "Autotune: %s %s writes, %s/s", c->device_name, size, throughput );
+
+        /* Only move to a larger size if it is clearly faster */
+        if( rate * 100 > c->autotune_best_throughput * ( 100 + NWIPE_AUTOTUNE_MARGIN ) )
+        {
+            c->autotune_best_size = c->io_size;
+            c->autotune_best_throughput = rate;
+        }
+
+        if( c->autotune_trial < kwipe_autotune_ladder_length( c ) )
+        {
+            c->autotune_trial++;
+            c->io_size = kwipe_autotune_ladder( c, c->autotune_trial );
+            kwipe_autotune_begin( c );
+        }
+        else
+        {
+            kwipe_autotune_lock( c );
+        }
+        return;
+    }
+
+    if( c->io_size_throughput == 0 || c->autotune_bytes < NWIPE_AUTOTUNE_WINDOW_BYTES )
+    {
+        return;
+    }
+
+    rate = kwipe_autotune_throughput( c );
+
+    if( rate * 100 < c->io_size_throughput * NWIPE_AUTOTUNE_COLLAPSE
+        && c->autotune_calibrations < NWIPE_AUTOTUNE_MAX_CALIBRATIONS )
+    {
+        kwipe_autotune_rate_text( rate, throughput, sizeof( throughput ) );
+        kwipe_autotune_rate_text( c->io_size_throughput, calibrated, sizeof( calibrated ) );
+        kwipe_log( NWIPE_LOG_WARNING,
+                   "Autotune: %s fell to %s/s from %s/s, recalibrating",
+                   c->device_name,
+                   throughput,
+                   calibrated );
+        kwipe_autotune_calibrate( c );
+        return;
+    }
+
+    kwipe_autotune_begin( c );
+}
+
+void kwipe_autotune_summary_text( const kwipe_context_t* c, char* text, size_t text_size )
+{
+    char size[NWIPE_AUTOTUNE_TXT_LENGTH];
+    char throughput[13];
+
+    kwipe_autotune_size_text(
+        c->io_size ? c->io_size : (size_t) c->device_stat.st_blksize, size, sizeof( size ) );
+
+    if( c->io_size_throughput == 0 )
+    {
+        snprintf( text, text_size, "%s", size );
+        return;
+    }
+
+    kwipe_autotune_rate_text( c->io_size_throughput, throughput, sizeof( throughput ) );
+    snprintf( text, text_size, "%s (autotuned, %s/s)", size, throughput );
+}
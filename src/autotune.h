@@ -0,0 +1,80 @@
+/*
+ *  autotune.h: Choosing the write size for each drive by measuring it.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef AUTOTUNE_H_
+#define AUTOTUNE_H_
+
+#include "context.h"
+
+/* Each size on the ladder is NWIPE_AUTOTUNE_STEP times the last, from st_blksize up to
+ * NWIPE_AUTOTUNE_MAX_SIZE, and each is tried for NWIPE_AUTOTUNE_TRIAL_BYTES. From a 4KiB
+ * st_blksize that is six sizes, 384MiB in all. */
+#define NWIPE_AUTOTUNE_STEP 4
+#define NWIPE_AUTOTUNE_MAX_SIZE ( 4 * 1024 * 1024 )
+#define NWIPE_AUTOTUNE_TRIAL_BYTES ( 64ULL * 1024 * 1024 )
+
+/* A larger size has to be this many percent faster than a smaller one to be chosen. */
+#define NWIPE_AUTOTUNE_MARGIN 5
+
+/* Drives smaller than this many times the whole ladder are not calibrated. */
+#define NWIPE_AUTOTUNE_MIN_LADDERS 4
+
+/* Once calibrated, throughput is checked every NWIPE_AUTOTUNE_WINDOW_BYTES, and if it falls
+ * below NWIPE_AUTOTUNE_COLLAPSE percent of the calibrated throughput the drive is calibrated
+ * again, up to NWIPE_AUTOTUNE_MAX_CALIBRATIONS times in all. */
+#define NWIPE_AUTOTUNE_WINDOW_BYTES ( 1024ULL * 1024 * 1024 )
+#define NWIPE_AUTOTUNE_COLLAPSE 25
+#define NWIPE_AUTOTUNE_MAX_CALIBRATIONS 3
+
+/* Enough for "4MiB (autotuned, 1234.5 MB/s)" */
+#define NWIPE_AUTOTUNE_TXT_LENGTH 48
+
+/**
+ * Returns the size of the buffer a write pass needs, large enough for any size the
+ * autotuner may choose.
+ */
+size_t kwipe_autotune_buffer_size( kwipe_context_t* c );
+
+/**
+ * Returns the size of the next write, st_blksize unless --autotune is set.
+ */
+static inline size_t kwipe_autotune_size( kwipe_context_t* c )
+{
+    return c->io_size ? c->io_size : (size_t) c->device_stat.st_blksize;
+}
+
+/**
+ * Called by the write passes before their first write. Starts calibrating the drive on
+ * the first write pass when --autotune is set, and starts watching the throughput on
+ * later passes.
+ */
+void kwipe_autotune_start_pass( kwipe_context_t* c );
+
+/**
+ * Called by the write passes after every write with the number of bytes written. Moves
+ * on to the next size at the end of each trial, locks in the best size at the end of the
+ * ladder, and starts calibrating again if the throughput collapses.
+ */
+void kwipe_autotune_update( kwipe_context_t* c, size_t bytes );
+
+/**
+ * Formats the write size for the log and PDF, e.g. "1MiB (autotuned, 180.2 MB/s)".
+ */
+void kwipe_autotune_summary_text( const kwipe_context_t* c, char* text, size_t text_size );
+
+#endif /* AUTOTUNE_H_ */
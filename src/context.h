@@ -39,7 +39,8 @@ typedef enum kwipe_device_t_ {
     NWIPE_DEVICE_NVME,
     NWIPE_DEVICE_VIRT,
     NWIPE_DEVICE_SAS,
-    NWIPE_DEVICE_MMC
+    NWIPE_DEVICE_MMC,
+    NWIPE_DEVICE_FILE  // A regular file, such as a disk image, named on the command line.
 } kwipe_device_t;
 
 typedef enum kwipe_pass_t_ {
@@ -47,7 +48,8 @@ typedef enum kwipe_pass_t_ {
     NWIPE_PASS_WRITE,  // Writing patterns to the device.
     NWIPE_PASS_VERIFY,  // Verifying a pass.
     NWIPE_PASS_FINAL_BLANK,  // Filling the device with zeros.
-    NWIPE_PASS_FINAL_OPS2  // Special case for kwipe_ops2.
+    NWIPE_PASS_FINAL_OPS2,  // Special case for kwipe_ops2.
+    NWIPE_PASS_DISCARD  // Discarding the device's blocks after the wipe.
 } kwipe_pass_t;
 
 typedef enum kwipe_select_t_ {
@@ -59,19 +61,63 @@ typedef enum kwipe_select_t_ {
     NWIPE_SELECT_DISABLED  // Do not wipe this device and do not allow it to be selected.
 } kwipe_select_t;
 
-#define NWIPE_KNOB_SPEEDRING_SIZE 30
-#define NWIPE_KNOB_SPEEDRING_GRANULARITY 10
+#define NWIPE_KNOB_STATS_WINDOW 40  // Samples in the windowed throughput, 10 seconds at the sample rate.
+#define NWIPE_KNOB_STATS_SAMPLE_NS 250000000ULL  // Minimum interval between throughput samples, 4Hz.
+#define NWIPE_KNOB_STATS_EWMA_TAU 5.0  // Time constant of the smoothed throughput in seconds.
 
-typedef struct kwipe_speedring_t_
+typedef struct kwipe_stats_t_
 {
-    u64 bytes[NWIPE_KNOB_SPEEDRING_SIZE];
-    u64 bytestotal;
-    u64 byteslast;
-    time_t times[NWIPE_KNOB_SPEEDRING_SIZE];
-    time_t timestotal;
-    time_t timeslast;
-    u32 position;
-} kwipe_speedring_t;
+    u64 sample_ns[NWIPE_KNOB_STATS_WINDOW];  // Monotonic time of each sample in the window.
+    u64 sample_bytes[NWIPE_KNOB_STATS_WINDOW];  // round_done at each sample in the window.
+    u32 position;  // The next slot of the window to be written.
+    u32 samples;  // The number of valid samples in the window.
+    u64 last_ns;  // Monotonic time of the most recent sample, 0 = not yet sampled.
+    u64 last_bytes;  // round_done at the most recent sample.
+    double write_ewma;  // Smoothed write throughput in bytes per second, 0 = not yet measured.
+    double verify_ewma;  // Smoothed verification throughput in bytes per second, 0 = not yet measured.
+    u64 verify_done;  // The number of bytes read back by verification passes so far.
+    int pass_key;  // Identifies the pass being sampled, so we notice when the next one starts.
+    u64 pass_start_ns;  // Monotonic time at which the current pass was first sampled.
+    u64 pass_start_bytes;  // pass_done at which the current pass was first sampled.
+    int finished;  // 1 once the final sample has been taken after the wipe finished.
+} kwipe_stats_t;
+
+/* Latency histograms are log-linear: each power of two of nanoseconds is split into
+ * 2^NWIPE_KNOB_LATENCY_SUB_BITS linear buckets, up to 2^NWIPE_KNOB_LATENCY_MAX_BITS ns. */
+#define NWIPE_KNOB_LATENCY_SUB_BITS 3
+#define NWIPE_KNOB_LATENCY_MAX_BITS 40
+#define NWIPE_LATENCY_GROUPS ( NWIPE_KNOB_LATENCY_MAX_BITS - NWIPE_KNOB_LATENCY_SUB_BITS + 2 )
+#define NWIPE_LATENCY_BUCKETS ( NWIPE_LATENCY_GROUPS << NWIPE_KNOB_LATENCY_SUB_BITS )
+
+typedef enum kwipe_latency_op_t_ {
+    NWIPE_LATENCY_WRITE = 0,
+    NWIPE_LATENCY_READ,
+    NWIPE_LATENCY_SYNC,
+    NWIPE_LATENCY_OPS  // The number of operation types, not an operation.
+} kwipe_latency_op_t;
+
+typedef struct kwipe_latency_t_
+{
+    u64 count;  // The number of calls recorded.
+    u64 total_ns;  // The sum of their latencies.
+    u64 max_ns;  // The slowest call.
+    u64 bucket[NWIPE_LATENCY_BUCKETS];  // The number of calls per latency bucket, see latency.c
+} kwipe_latency_t;
+
+#define NWIPE_CACHE_LINE_SIZE 64
+
+/* The progress counters the wipe thread updates after every block, see progress.h */
+typedef struct kwipe_progress_t_
+{
+    unsigned int seq;  // Sequence lock, odd while the wipe thread is updating the counters.
+    short sync_status;  // A flag to indicate when the method is syncing.
+    u64 pass_done;  // The number of bytes that have already been i/o'd in this pass.
+    u64 round_done;  // The number of bytes that have already been i/o'd.
+    u64 bytes_written;  // The number of bytes written by the passes, across all rounds.
+    u64 bytes_read;  // The number of bytes read back by the verification passes, across all rounds.
+    unsigned long long bytes_erased;  // Irrespective of pass, this how much of the drive has been erased, CANNOT be
+                                      // greater than device_size.
+} __attribute__( ( aligned( NWIPE_CACHE_LINE_SIZE ) ) ) kwipe_progress_t;
 
 #define NWIPE_DEVICE_LABEL_LENGTH 200
 #define NWIPE_DEVICE_SIZE_TXT_LENGTH 8
@@ -84,6 +130,12 @@ typedef struct kwipe_speedring_t_
 
 typedef struct kwipe_context_t_
 {
+    /*
+     * Progress counters, updated by the wipe thread after every block. They are kept in
+     * their own cache line and must be read with kwipe_progress_snapshot() by other threads.
+     */
+    kwipe_progress_t progress;
+
     /*
      * Device fields
      */
@@ -105,8 +157,6 @@ typedef struct kwipe_context_t_
     u64 device_size_in_sectors;  // The device size in number of logical sectors, this may be 512 or 4096 sectors
     u64 device_size_in_512byte_sectors;  // The device size in number of 512byte sectors, irrespective of logical sector
                                          // size reported by libata
-    unsigned long long bytes_erased;  // Irrespective of pass, this how much of the drive has been erased, CANNOT be
-                                      // greater than device_size.
     char* device_size_text;  // The device size in a more (human)readable format.
     char device_size_txt[NWIPE_DEVICE_SIZE_TXT_LENGTH];  // The device size in a more (human)readable format.
     char* device_model;  // The model of the device.
@@ -122,7 +172,6 @@ typedef struct kwipe_context_t_
     u64 eta;  // The estimated number of seconds until method completion.
     int entropy_fd;  // The entropy source. Usually /dev/urandom.
     int pass_count;  // The number of passes performed by the working wipe method.
-    u64 pass_done;  // The number of bytes that have already been i/o'd in this pass.
     u64 pass_errors;  // The number of errors across all passes.
     u64 pass_size;  // The total number of i/o bytes across all passes.
     kwipe_pass_t pass_type;  // The type of the current working pass.
@@ -132,17 +181,19 @@ typedef struct kwipe_context_t_
     void* prng_state;  // The private internal state of the PRNG.
     int result;  // The process return value.
     int round_count;  // The number of rounds requested by the user for the working wipe method.
-    u64 round_done;  // The number of bytes that have already been i/o'd.
     u64 round_errors;  // The number of errors across all rounds.
     u64 round_size;  // The total number of i/o bytes across all rounds.
+    u64 round_verify_size;  // The number of bytes in round_size that are read back by verification passes.
     double round_percent;  // The percentage complete across all rounds.
     int round_working;  // The current working round.
     kwipe_select_t select;  // Indicates whether this device should be wiped.
     int signal;  // Set when the child is killed by a signal.
-    kwipe_speedring_t speedring;  // Ring buffer for computing the rolling throughput average.
-    short sync_status;  // A flag to indicate when the method is syncing.
+    kwipe_stats_t stats;  // Samples for computing the throughput and ETA, see stats.c
+    kwipe_latency_t latency[NWIPE_LATENCY_OPS];  // Latency of write(), read() and fdatasync() calls.
     pthread_t thread;  // The ID of the thread.
-    u64 throughput;  // Average throughput in bytes per second.
+    u64 throughput;  // Current throughput in bytes per second, averaged over the last NWIPE_KNOB_STATS_WINDOW samples.
+    u64 throughput_pass;  // Average throughput of the current pass in bytes per second.
+    u64 throughput_overall;  // Average throughput since the start of the wipe in bytes per second.
     char throughput_txt[13];  // Human readable throughput.
     u64 verify_errors;  // The number of verification errors across all passes.
     int templ_has_hwmon_data;  // 0 = no hwmon data available, 1 = hwmon data available
@@ -163,14 +214,48 @@ typedef struct kwipe_context_t_
     int temp1_flash_rate_status;  // 0=blank 1=visible
     time_t temp1_time;  // The time when temperature was last checked, seconds since epoch
     struct disk* templ_disk;  // Pointer to disk structure for hddtemp SCSI routines
+    int temp1_input_fd;  // hwmon temp1_input, kept open and read with pread(), -1 if not available
+    int temp1_highest_fd;  // hwmon temp1_highest, as above
+    int temp1_lowest_fd;  // hwmon temp1_lowest, as above
+    pthread_t temp1_thread;  // The thread polling a SCSI/SAS drive's temperature, 0 if there isn't one
+    int temp1_interval;  // Seconds between polls of a SCSI/SAS drive's temperature, see temperature.c
+    int throttle_state;  // 0 = full speed, 1 = writes slowed, 2 = writes paused, see throttle.c
+    u64 throttle_ns;  // Time the writes were slowed or paused for by the thermal throttle
+    u64 throttle_debt_ns;  // Throttle delay owed but not yet slept
     int wipe_status;  // Wipe finished = 0, wipe in progress = 1, wipe yet to start = -1.
-    char wipe_status_txt[10];  // ERASED, FAILED, ABORTED, INSANITY
+    int cancel_requested;  // Set by main() to stop the wipe thread at its next block, see event.h
+    int thread_finished;  // Set when the wipe thread has returned, see kwipe_wipe_thread()
+    int controller;  // Index of the HBA, SAS expander or USB hub the drive is on, see scheduler.c
+    int queued;  // The wipe is waiting for room on its controller, see --controller-limit
+    int numa_node;  // The NUMA node of the drive's controller, -1 if unknown, see numa.c
+    size_t io_size;  // The write size chosen by --autotune, 0 = st_blksize, see autotune.c
+    u64 io_size_throughput;  // The throughput measured for io_size, bytes per second
+    int autotune_trial;  // The size on the ladder being tried, from 1, 0 when not calibrating
+    int autotune_calibrations;  // The number of times the drive has been calibrated
+    size_t autotune_best_size;  // The fastest size tried so far in this calibration
+    u64 autotune_best_throughput;  // Its throughput, bytes per second
+    u64 autotune_bytes;  // Bytes written in the current trial or window
+    u64 autotune_start_ns;  // When the current trial or window started
+    u64 autotune_throttle_ns;  // throttle_ns at that time, time spent throttled isn't counted
+    u64 writeback_done;  // The end of the last window handed to write-back, see writeback.c
+    const struct kwipe_io_backend_t_* io;  // The I/O backend of the passes, see io.c
+    u64 io_offset;  // The file offset of the null and mem backends
+    char* io_mem;  // The mem backend's copy of the device
+    const struct kwipe_io_backend_t_* io_lower;  // The backend the faults of --io-faults are injected into
+    u64 io_fault_state;  // The state of the random numbers that choose the faults
+    u64 io_fault_eio;  // The number of reads and writes failed with EIO, including the bad LBAs
+    u64 io_fault_partial;  // The number of reads and writes cut short, including those up to a bad LBA
+    u64 io_fault_spikes;  // The number of calls delayed
+    u64 io_fault_sync;  // The number of syncs failed
+    int shared_stream_epoch;  // The number of random passes seeded by --shared-stream, see shared_stream.c
+    char wipe_status_txt[10];  // ERASED, FAILED, ABORTED, UNWRITTEN, INSANITY
     int spinner_idx;  // Index into the spinner character array
     char spinner_character[1];  // The current spinner character
     double duration;  // Duration of the wipe in seconds
     char duration_str[20];  // The duration string in hh:mm:ss
     time_t start_time;  // Start time of wipe
     time_t end_time;  // End time of wipe
+    u64 start_ns;  // Monotonic start time of wipe in nanoseconds, see kwipe_time_ns()
     u64 fsyncdata_errors;  // The number of fsyncdata errors across all passes.
     char PDF_filename[FILENAME_MAX];  // The filename of the PDF certificate/report.
     int HPA_status;  // 0 = No HPA found/disabled, 1 = HPA detected, 2 = Unknown, unable to checked,
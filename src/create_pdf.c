@@ -33,6 +33,7 @@
 #include "PDFGen/pdfgen.h"
 #include "version.h"
 #include "method.h"
+#include "sanitize.h"
 #include "embedded_images/shred_db.jpg.h"
 #include "embedded_images/tick_erased.jpg.h"
 #include "embedded_images/redcross.h"
@@ -42,6 +43,9 @@
 #include "prng.h"
 #include "hpa_dco.h"
 #include "miscellaneous.h"
+#include "latency.h"
+#include "throttle.h"
+#include "autotune.h"
 #include <libconfig.h>
 #include "conf.h"
 
@@ -52,6 +56,7 @@
 #include <openssl/err.h>
 
 #define text_size_data 10
+#define text_size_footnote 8
 
 struct pdf_doc* pdf;
 struct pdf_object* page;
@@ -64,6 +69,11 @@ float height;
 float page_width;
 int status_icon;
 
+/* The key the reports are signed with. OpenSSL isn't initialised, and the key isn't generated,
+ * until the first report is created, then the key is used for every report of the run. */
+static EVP_PKEY* signing_pkey = NULL;
+static X509* signing_x509 = NULL;
+
 /* Prototypes for new functions */
 int generate_key_and_certificate( EVP_PKEY** pkey, X509** x509 );
 int sign_pdf( const char* pdf_filename, EVP_PKEY* pkey, unsigned char** signature, size_t* signature_len );
@@ -96,6 +106,12 @@ int create_pdf( kwipe_context_t* ptr )
     char HPA_size_text[50] = "";
     char errors[50] = "";
     char throughput_txt[50] = "";
+    char latency_write[NWIPE_LATENCY_TXT_LENGTH * 3] = "";
+    char latency_read[NWIPE_LATENCY_TXT_LENGTH * 3] = "";
+    char latency_sync[NWIPE_LATENCY_TXT_LENGTH * 3] = "";
+    char latency_txt[NWIPE_LATENCY_TXT_LENGTH * 10] = "";
+    char throttle_txt[NWIPE_THROTTLE_TXT_LENGTH] = "";
+    char io_size_txt[NWIPE_AUTOTUNE_TXT_LENGTH] = "";
     char bytes_percent_str[7] = "";
 
     struct pdf_info info = { .creator = "https://github.com/PartialVolume/shredos.x86_64",
@@ -444,7 +460,8 @@ int create_pdf( kwipe_context_t* ptr )
      */
     pdf_add_text( pdf, NULL, "PRNG algorithm:", 12, 300, 270, PDF_GRAY );
     if( kwipe_options.method == &kwipe_verify_one || kwipe_options.method == &kwipe_verify_zero
-        || kwipe_options.method == &kwipe_zero || kwipe_options.method == &kwipe_one )
+        || kwipe_options.method == &kwipe_zero || kwipe_options.method == &kwipe_one
+        || kwipe_method_is_sanitize( kwipe_options.method ) )
     {
         snprintf( prng_type, sizeof( prng_type ), "Not applicable to method" );
     }
@@ -535,11 +552,12 @@ int create_pdf( kwipe_context_t* ptr )
             || c->HPA_status == HPA_NOT_APPLICABLE )
         {
             convert_double_to_string( bytes_percent_str,
-                                      (double) ( (double) c->bytes_erased / (double) c->device_size ) * 100 );
+                                      (double) ( (double) c->progress.bytes_erased / (double) c->device_size ) * 100 );
 
-            snprintf( bytes_erased, sizeof( bytes_erased ), "%lli, (%s%%)", c->bytes_erased, bytes_percent_str );
+            snprintf(
+                bytes_erased, sizeof( bytes_erased ), "%lli, (%s%%)", c->progress.bytes_erased, bytes_percent_str );
 
-            if( c->bytes_erased == c->device_size )
+            if( c->progress.bytes_erased == c->device_size )
             {
                 pdf_add_text( pdf, NULL, bytes_erased, text_size_data, 145, 230, PDF_DARK_GREEN );
             }
@@ -553,11 +571,12 @@ int create_pdf( kwipe_context_t* ptr )
 
             convert_double_to_string(
                 bytes_percent_str,
-                (double) ( (double) c->bytes_erased / (double) c->Calculated_real_max_size_in_bytes ) * 100 );
+                (double) ( (double) c->progress.bytes_erased / (double) c->Calculated_real_max_size_in_bytes ) * 100 );
 
-            snprintf( bytes_erased, sizeof( bytes_erased ), "%lli, (%s%%)", c->bytes_erased, bytes_percent_str );
+            snprintf(
+                bytes_erased, sizeof( bytes_erased ), "%lli, (%s%%)", c->progress.bytes_erased, bytes_percent_str );
 
-            if( c->bytes_erased == c->Calculated_real_max_size_in_bytes )
+            if( c->progress.bytes_erased == c->Calculated_real_max_size_in_bytes )
             {
                 pdf_add_text( pdf, NULL, bytes_erased, text_size_data, 145, 230, PDF_DARK_GREEN );
             }
@@ -688,6 +707,48 @@ int create_pdf( kwipe_context_t* ptr )
     }
     pdf_set_font( pdf, "Helvetica" );
 
+    /*************************************************
+     * I/O latency p50/p99/max of write, read and sync
+     */
+    pdf_add_text( pdf, NULL, "Latency(p50/p99/max):", 12, 60, 153, PDF_GRAY );
+    kwipe_latency_summary_text( &c->latency[NWIPE_LATENCY_WRITE], latency_write, sizeof( latency_write ) );
+    kwipe_latency_summary_text( &c->latency[NWIPE_LATENCY_READ], latency_read, sizeof( latency_read ) );
+    kwipe_latency_summary_text( &c->latency[NWIPE_LATENCY_SYNC], latency_sync, sizeof( latency_sync ) );
+    snprintf( latency_txt,
+              sizeof( latency_txt ),
+              "write %s, read %s, sync %s",
+              latency_write,
+              latency_read,
+              latency_sync );
+    pdf_set_font( pdf, "Helvetica-Bold" );
+    pdf_add_text( pdf, NULL, latency_txt, text_size_data, 190, 153, PDF_BLACK );
+    pdf_set_font( pdf, "Helvetica" );
+
+    /**********************************************************
+     * Time the writes were slowed or paused by thermal throttle
+     */
+    pdf_add_text( pdf, NULL, "Thermal throttle:", 12, 60, 137, PDF_GRAY );
+    if( kwipe_options.thermal_throttle )
+    {
+        kwipe_throttle_summary_text( c, throttle_txt, sizeof( throttle_txt ) );
+    }
+    else
+    {
+        snprintf( throttle_txt, sizeof( throttle_txt ), "Disabled" );
+    }
+    pdf_set_font( pdf, "Helvetica-Bold" );
+    pdf_add_text( pdf, NULL, throttle_txt, text_size_data, 190, 137, PDF_BLACK );
+    pdf_set_font( pdf, "Helvetica" );
+
+    /***************************************
+     * Write size, st_blksize or autotuned
+     */
+    pdf_add_text( pdf, NULL, "I/O size:", 12, 300, 137, PDF_GRAY );
+    kwipe_autotune_summary_text( c, io_size_txt, sizeof( io_size_txt ) );
+    pdf_set_font( pdf, "Helvetica-Bold" );
+    pdf_add_text( pdf, NULL, io_size_txt, text_size_data, 360, 137, PDF_BLACK );
+    pdf_set_font( pdf, "Helvetica" );
+
     /*************
      * Information
      */
@@ -721,20 +782,26 @@ int create_pdf( kwipe_context_t* ptr )
                       PDF_RED );
     }
 
-    /* Info describing what bytes erased actually means */
+    /* Info describing what bytes erased actually means, the footnotes share a line in a smaller
+     * font below the latency, thermal throttle and I/O size rows */
     pdf_add_text( pdf,
                   NULL,
                   "* bytes erased: The amount of drive that's been erased at least once",
-                  text_size_data,
+                  text_size_footnote,
                   60,
-                  137,
+                  125,
                   PDF_BLACK );
 
     /* Meaning of abbreviation DDNSHPA */
     if( c->HPA_status == HPA_NOT_SUPPORTED_BY_DRIVE )
     {
-        pdf_add_text(
-            pdf, NULL, "** DDNSHPA = Drive does not support HPA/DCO", text_size_data, 60, 125, PDF_DARK_GREEN );
+        pdf_add_text( pdf,
+                      NULL,
+                      "** DDNSHPA = Drive does not support HPA/DCO",
+                      text_size_footnote,
+                      340,
+                      125,
+                      PDF_DARK_GREEN );
     }
     pdf_set_font( pdf, "Helvetica" );
 
@@ -781,30 +848,30 @@ int create_pdf( kwipe_context_t* ptr )
     /* Save the PDF */
     pdf_save( pdf, c->PDF_filename );
 
-    /* OpenSSL initialization */
-    OpenSSL_add_all_algorithms();
-    ERR_load_crypto_strings();
-
-    /* Generate key and certificate */
-    EVP_PKEY* pkey = NULL;
-    X509* x509 = NULL;
-    if( generate_key_and_certificate( &pkey, &x509 ) != 1 )
+    /* Initialise OpenSSL and generate the key and certificate for the first report */
+    if( signing_pkey == NULL )
     {
-        kwipe_log( NWIPE_LOG_ERROR, "Error generating key and certificate" );
-        /* Clean up and exit */
-        pdf_destroy( pdf );
-        return -1;
+        OpenSSL_add_all_algorithms();
+        ERR_load_crypto_strings();
+
+        if( generate_key_and_certificate( &signing_pkey, &signing_x509 ) != 1 )
+        {
+            kwipe_log( NWIPE_LOG_ERROR, "Error generating key and certificate" );
+            signing_pkey = NULL;
+            signing_x509 = NULL;
+            /* Clean up and exit */
+            pdf_destroy( pdf );
+            return -1;
+        }
     }
 
     /* Sign the PDF */
     unsigned char* signature = NULL;
     size_t signature_len = 0;
-    if( sign_pdf( c->PDF_filename, pkey, &signature, &signature_len ) != 1 )
+    if( sign_pdf( c->PDF_filename, signing_pkey, &signature, &signature_len ) != 1 )
     {
         kwipe_log( NWIPE_LOG_ERROR, "Error signing the PDF" );
         /* Clean up and exit */
-        EVP_PKEY_free( pkey );
-        X509_free( x509 );
         pdf_destroy( pdf );
         return -1;
     }
@@ -817,16 +884,27 @@ int create_pdf( kwipe_context_t* ptr )
 
     /* Free resources */
     free( signature );
-    EVP_PKEY_free( pkey );
-    X509_free( x509 );
     pdf_destroy( pdf );
 
+    return 0;
+}
+
+void create_pdf_release_key( void )
+{
+    if( signing_pkey == NULL )
+    {
+        return;
+    }
+
+    EVP_PKEY_free( signing_pkey );
+    X509_free( signing_x509 );
+    signing_pkey = NULL;
+    signing_x509 = NULL;
+
     /* OpenSSL cleanup */
     EVP_cleanup();
     CRYPTO_cleanup_all_ex_data();
     ERR_free_strings();
-
-    return 0;
 }
 
 int kwipe_get_smart_data( kwipe_context_t* c )
@@ -836,10 +914,8 @@ int kwipe_get_smart_data( kwipe_context_t* c )
     char* pdata;
     char page_title[50];
 
-    char smartctl_command[] = "smartctl -a %s";
-    char smartctl_command2[] = "/sbin/smartctl -a %s";
-    char smartctl_command3[] = "/usr/bin/smartctl -a %s";
-    char final_cmd_smartctl[sizeof( smartctl_command3 ) + 256];
+    const char* command;
+    char final_cmd_smartctl[NWIPE_COMMAND_PATH_LENGTH + 256];
     char result[512];
     char smartctl_labels_to_anonymize[][18] = {
         "serial number:", "lu wwn device id:", "logical unit id:", "" /* Don't remove this empty string! Important */
@@ -852,28 +928,20 @@ int kwipe_get_smart_data( kwipe_context_t* c )
 
     final_cmd_smartctl[0] = 0;
 
+    /* A regular file has no SMART data */
+    if( c->device_type == NWIPE_DEVICE_FILE )
+    {
+        return 1;
+    }
+
     /* Determine whether we can access smartctl */
-    if( system( "which smartctl > /dev/null 2>&1" ) )
+    if( ( command = kwipe_find_command( "smartctl" ) ) == NULL )
     {
-        if( system( "which /sbin/smartctl > /dev/null 2>&1" ) )
-        {
-            if( system( "which /usr/bin/smartctl > /dev/null 2>&1" ) )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install smartmontools!" );
-            }
-            else
-            {
-                sprintf( final_cmd_smartctl, smartctl_command3, c->device_name );
-            }
-        }
-        else
-        {
-            sprintf( final_cmd_smartctl, smartctl_command2, c->device_name );
-        }
+        kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install smartmontools!" );
     }
     else
     {
-        sprintf( final_cmd_smartctl, smartctl_command, c->device_name );
+        snprintf( final_cmd_smartctl, sizeof( final_cmd_smartctl ), "%s -a %s", command, c->device_name );
     }
 
     if( final_cmd_smartctl[0] != 0 )
@@ -882,7 +950,7 @@ int kwipe_get_smart_data( kwipe_context_t* c )
 
         if( fp == NULL )
         {
-            kwipe_log( NWIPE_LOG_WARNING, "kwipe_get_smart_data(): Failed to create stream to %s", smartctl_command );
+            kwipe_log( NWIPE_LOG_WARNING, "kwipe_get_smart_data(): Failed to create stream to %s", final_cmd_smartctl );
 
             set_return_value = 3;
         }
@@ -46,6 +46,12 @@
  */
 int create_pdf( kwipe_context_t* ptr );
 
+/**
+ * Releases the key the reports were signed with and cleans up OpenSSL, which create_pdf()
+ * initialises for the first report. Called once every report has been created.
+ */
+void create_pdf_release_key( void );
+
 /**
  * Get SMART data and add it to the PDF
  * @param c Pointer to kwipe context
@@ -20,6 +20,10 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // fallocate()
+#endif
+
 #ifndef _DEFAULT_SOURCE
 #define _DEFAULT_SOURCE
 #endif
@@ -42,12 +46,17 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include "hpa_dco.h"
+#include "stats.h"
+#include "profile.h"
 #include "miscellaneous.h"
+#include "event.h"
+#include "io.h"
 
 #include <parted/parted.h>
 #include <parted/debug.h>
 
 int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount );
+static int check_file( kwipe_context_t*** c, const char* path, const struct stat* st, int dcount );
 char* trim( char* str );
 
 extern int terminate_signal;
@@ -93,6 +102,7 @@ int kwipe_device_get( kwipe_context_t*** c, char** devnamelist, int ndevnames )
 {
     PedDevice* dev = NULL;
 
+    struct stat st;
     int i;
     int dcount = 0;
 
@@ -101,6 +111,14 @@ int kwipe_device_get( kwipe_context_t*** c, char** devnamelist, int ndevnames )
         /* to have some progress indication. can help if there are many/slow disks */
         fprintf( stderr, "." );
 
+        /* Regular files, such as VM disk images, are wiped as they are, libparted isn't needed */
+        if( stat( devnamelist[i], &st ) == 0 && S_ISREG( st.st_mode ) )
+        {
+            if( check_file( c, devnamelist[i], &st, dcount ) )
+                dcount++;
+            continue;
+        }
+
         dev = ped_device_get( devnamelist[i] );
         if( !dev )
         {
@@ -135,6 +153,7 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
     kwipe_device_t bus;
     int is_ssd;
     int check_HPA;  // a flag that indicates whether we check for a HPA on this device
+    u64 probe_ns;  // The start of the current step of the probe, see --profile-startup
 
     bus = 0;
 
@@ -149,6 +168,8 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
         }
     }
 
+    probe_ns = kwipe_time_ns();
+
     /* Check whether the user has specified using the --nousb option
      * that all USB devices should not be displayed or wiped whether
      * in GUI, --nogui or --autonuke modes */
@@ -173,7 +194,7 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
             {
                 kwipe_log(
                     NWIPE_LOG_NOTICE, "--nousb requires the 'readlink' program, please install readlink", dev->path );
-                terminate_signal = 1;
+                kwipe_request_terminate();
                 return 0;
             }
         }
@@ -190,7 +211,11 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
     /* New device, reallocate memory for additional struct pointer */
     *c = realloc( *c, ( dcount + 1 ) * sizeof( kwipe_context_t* ) );
 
-    next_device = malloc( sizeof( kwipe_context_t ) );
+    /* Aligned so the progress counters of each drive get a cache line to themselves. */
+    if( posix_memalign( (void**) &next_device, NWIPE_CACHE_LINE_SIZE, sizeof( kwipe_context_t ) ) != 0 )
+    {
+        next_device = NULL;
+    }
 
     /* Check the allocation. */
     if( !next_device )
@@ -273,10 +298,14 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
     // Remove leading/trailing whitespace from serial number and left justify.
     trim( (char*) next_device->device_serial_no );
 
+    probe_ns = kwipe_profile_phase( probe_ns, "%s open and identify", dev->path );
+
     /* if we couldn't obtain serial number by using the above method .. try this */
     r = kwipe_get_device_bus_type_and_serialno(
         next_device->device_name, &next_device->device_type, &next_device->device_is_ssd, tmp_serial );
 
+    probe_ns = kwipe_profile_phase( probe_ns, "%s bus type and serial number", dev->path );
+
     /* If serial number & bus retrieved (0) OR unsupported USB bus identified (5) */
     if( r == 0 || r == 5 )
     {
@@ -375,6 +404,10 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
         case NWIPE_DEVICE_MMC:
             strcpy( next_device->device_type_str, " MMC" );
             break;
+
+        default:
+            /* Regular files never get here, check_file() sets them up */
+            break;
     }
     if( next_device->device_is_ssd )
     {
@@ -422,11 +455,13 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
                dev->phys_sector_size );
 
     /******************************
-     * Check for hidden sector_size
+     * Check for hidden sector_size, only of use to the certificate of a drive the passes write, see --io
      */
-    if( check_HPA == 1 )
+    if( check_HPA == 1 && kwipe_options.io == &kwipe_io_device )
     {
         hpa_dco_status( next_device );
+
+        kwipe_profile_phase( probe_ns, "%s HPA/DCO", dev->path );
     }
 
     /* print an empty line to separate the drives in the log */
@@ -436,6 +471,123 @@ int check_device( kwipe_context_t*** c, PedDevice* dev, int dcount )
     return 1;
 }
 
+static int check_file( kwipe_context_t*** c, const char* path, const struct stat* st, int dcount )
+{
+    /* The file counterpart of check_device(), a regular file has no bus, serial number or HPA,
+     * its size is the file's and the wipe goes through the same passes and reports. */
+    kwipe_context_t* next_device;
+    int idx;
+
+    for( idx = 0; idx < MAX_NUMBER_EXCLUDED_DRIVES; idx++ )
+    {
+        if( !strcmp( path, kwipe_options.exclude[idx] ) )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE, "File %s excluded as per command line option -e", path );
+            return 0;
+        }
+    }
+
+    if( st->st_size == 0 )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "File %s is empty, there is nothing to wipe", path );
+        return 0;
+    }
+
+    *c = realloc( *c, ( dcount + 1 ) * sizeof( kwipe_context_t* ) );
+
+    /* Aligned so the progress counters of each drive get a cache line to themselves. */
+    if( posix_memalign( (void**) &next_device, NWIPE_CACHE_LINE_SIZE, sizeof( kwipe_context_t ) ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "malloc" );
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to create the array of enumeration contexts." );
+        return 0;
+    }
+
+    memset( next_device, 0, sizeof( kwipe_context_t ) );
+
+    /* The report replaces the model's non alphanumeric characters, so it must be writable */
+    next_device->device_name = strdup( path );
+    next_device->device_model = strdup( "Regular file" );
+    if( next_device->device_name == NULL || next_device->device_model == NULL )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to create the array of enumeration contexts." );
+        free( next_device->device_name );
+        free( next_device->device_model );
+        free( next_device );
+        return 0;
+    }
+
+    kwipe_strip_path( next_device->device_name_without_path, next_device->device_name );
+
+    if( strlen( next_device->device_name ) > MAX_LENGTH_OF_DEVICE_STRING )
+    {
+        strcpy( next_device->gui_device_name, next_device->device_name_without_path );
+    }
+    else
+    {
+        strcpy( next_device->gui_device_name, next_device->device_name );
+    }
+
+    next_device->device_size = st->st_size;
+    next_device->device_sector_size = 512;
+    next_device->device_block_size = st->st_blksize;
+    next_device->device_phys_sector_size = st->st_blksize;
+    next_device->device_size_in_sectors = next_device->device_size / next_device->device_sector_size;
+    next_device->device_size_in_512byte_sectors = next_device->device_size / 512;
+    Determine_C_B_nomenclature( next_device->device_size, next_device->device_size_txt, NWIPE_DEVICE_SIZE_TXT_LENGTH );
+    next_device->device_size_text = next_device->device_size_txt;
+    next_device->result = -2;
+
+    next_device->device_type = NWIPE_DEVICE_FILE;
+    strcpy( next_device->device_type_str, "FILE    " );
+
+    next_device->HPA_toggle_time = time( NULL );
+    next_device->HPA_status = HPA_NOT_APPLICABLE;
+
+    snprintf( next_device->device_label,
+              NWIPE_DEVICE_LABEL_LENGTH,
+              "%s %s [%s] %s",
+              next_device->device_name,
+              next_device->device_type_str,
+              next_device->device_size_text,
+              next_device->device_model );
+
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "Found %s, %s, %s, %s",
+               next_device->device_name,
+               next_device->device_type_str,
+               next_device->device_model,
+               next_device->device_size_text );
+
+    kwipe_log( NWIPE_LOG_INFO, " " );
+
+    ( *c )[dcount] = next_device;
+    return 1;
+}
+
+int kwipe_file_preallocate( kwipe_context_t* c )
+{
+    /* Allocates the holes of a sparse file before the wipe, so a file system that fills up fails the
+     * wipe now rather than part way through it. The file's size is unchanged. */
+    if( fallocate( c->device_fd, 0, 0, c->device_stat.st_size ) == 0 )
+    {
+        kwipe_log(
+            NWIPE_LOG_NOTICE, "Preallocated %lli bytes of %s", (long long) c->device_stat.st_size, c->device_name );
+        return 0;
+    }
+
+    if( errno == ENOSPC || errno == EDQUOT )
+    {
+        kwipe_perror( errno, __FUNCTION__, "fallocate" );
+        kwipe_log( NWIPE_LOG_ERROR, "There isn't room to allocate all of %s, it can't be wiped", c->device_name );
+        return -1;
+    }
+
+    /* tmpfs, ext4 and xfs support it, for others the holes are allocated as the wipe writes them */
+    kwipe_log( NWIPE_LOG_WARNING, "Unable to preallocate %s, %s", c->device_name, strerror( errno ) );
+    return 0;
+}
+
 /* Remove leading/trailing whitespace from a string and left justify result */
 char* trim( char* str )
 {
@@ -520,16 +672,11 @@ int kwipe_get_device_bus_type_and_serialno( char* device, kwipe_device_t* bus, i
     int idx;
     int idx2;
 
-    char readlink_command[] = "readlink /sys/block/%s";
-    char readlink_command2[] = "/usr/bin/readlink /sys/block/%s";
-    char readlink_command3[] = "/sbin/readlink /sys/block/%s";
-    char smartctl_command[] = "smartctl -i %s";
-    char smartctl_command2[] = "/sbin/smartctl -i %s";
-    char smartctl_command3[] = "/usr/bin/smartctl -i %s";
+    const char* command;
     char device_shortform[50];
     char result[512];
-    char final_cmd_readlink[sizeof( readlink_command ) + sizeof( device_shortform )];
-    char final_cmd_smartctl[sizeof( smartctl_command ) + 256];
+    char final_cmd_readlink[NWIPE_COMMAND_PATH_LENGTH + sizeof( device_shortform ) + 16];
+    char final_cmd_smartctl[NWIPE_COMMAND_PATH_LENGTH + 256];
     char* pResult;
     char smartctl_labels_to_anonymize[][18] = {
         "serial number:", "lu wwn device id:", "logical unit id:", "" /* Don't remove this empty string !, important */
@@ -572,34 +719,20 @@ int kwipe_get_device_bus_type_and_serialno( char* device, kwipe_device_t* bus, i
 
     /* Determine whether we can access readlink, required if the PATH environment is not setup ! (Debian sid 'su' as
      * opposed to 'su -' */
-    if( system( "which readlink > /dev/null 2>&1" ) )
+    if( ( command = kwipe_find_command( "readlink" ) ) == NULL )
     {
-        if( system( "which /sbin/readlink > /dev/null 2>&1" ) )
-        {
-            if( system( "which /usr/bin/readlink > /dev/null 2>&1" ) )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install readlink !" );
-                set_return_value = 2;
+        kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install readlink !" );
+        set_return_value = 2;
 
-                /* Return immediately if --nousb specified. Readlink is a requirement for this option. */
-                if( kwipe_options.nousb )
-                {
-                    return set_return_value;
-                }
-            }
-            else
-            {
-                sprintf( final_cmd_readlink, readlink_command3, device_shortform );
-            }
-        }
-        else
+        /* Return immediately if --nousb specified. Readlink is a requirement for this option. */
+        if( kwipe_options.nousb )
         {
-            sprintf( final_cmd_readlink, readlink_command2, device_shortform );
+            return set_return_value;
         }
     }
     else
     {
-        sprintf( final_cmd_readlink, readlink_command, device_shortform );
+        snprintf( final_cmd_readlink, sizeof( final_cmd_readlink ), "%s /sys/block/%s", command, device_shortform );
     }
 
     if( final_cmd_readlink[0] != 0 )
@@ -611,7 +744,7 @@ int kwipe_get_device_bus_type_and_serialno( char* device, kwipe_device_t* bus, i
         {
             kwipe_log( NWIPE_LOG_WARNING,
                        "kwipe_get_device_bus_type_and_serialno: Failed to create stream to %s",
-                       readlink_command );
+                       final_cmd_readlink );
 
             set_return_value = 1;
         }
@@ -700,27 +833,13 @@ int kwipe_get_device_bus_type_and_serialno( char* device, kwipe_device_t* bus, i
 
     /* Determine whether we can access smartctl, required if the PATH environment is not setup ! (Debian sid 'su' as
      * opposed to 'su -' */
-    if( system( "which smartctl > /dev/null 2>&1" ) )
+    if( ( command = kwipe_find_command( "smartctl" ) ) == NULL )
     {
-        if( system( "which /sbin/smartctl > /dev/null 2>&1" ) )
-        {
-            if( system( "which /usr/bin/smartctl > /dev/null 2>&1" ) )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install smartmontools !" );
-            }
-            else
-            {
-                sprintf( final_cmd_smartctl, smartctl_command3, device );
-            }
-        }
-        else
-        {
-            sprintf( final_cmd_smartctl, smartctl_command2, device );
-        }
+        kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install smartmontools !" );
     }
     else
     {
-        sprintf( final_cmd_smartctl, smartctl_command, device );
+        snprintf( final_cmd_smartctl, sizeof( final_cmd_smartctl ), "%s -i %s", command, device );
     }
 
     if( final_cmd_smartctl[0] != 0 )
@@ -731,7 +850,7 @@ int kwipe_get_device_bus_type_and_serialno( char* device, kwipe_device_t* bus, i
         {
             kwipe_log( NWIPE_LOG_WARNING,
                        "kwipe_get_device_bus_type_and_serialno(): Failed to create stream to %s",
-                       smartctl_command );
+                       final_cmd_smartctl );
 
             set_return_value = 3;
         }
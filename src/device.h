@@ -40,6 +40,13 @@ int kwipe_device_scan( kwipe_context_t*** c );  // Find devices that we can wipe
  */
 int kwipe_device_get( kwipe_context_t*** c, char** devnamelist, int ndevnames );  // Get info about devices to wipe.
 
+/**
+ * Allocates every block of a regular file target, --preallocate.
+ * @param c the context of an open file target
+ * @return 0 if it was allocated, or the file system can't preallocate, -1 if there isn't room
+ */
+int kwipe_file_preallocate( kwipe_context_t* c );
+
 int kwipe_get_device_bus_type_and_serialno( char*, kwipe_device_t*, int*, char* );
 void strip_CR_LF( char* );
 void determine_disk_capacity_nomenclature( u64, char* );
@@ -0,0 +1,713 @@
+/*
+ *  dmi.c: Reading the SMBIOS/DMI data for the log without running dmidecode.
+ *
+ *  The system, board, chassis and processor details at the top of the log used to come from
+ *  running dmidecode -s once for every keyword, twenty one processes each reading and parsing
+ *  the whole SMBIOS table, which took seconds on some BMCs. The kernel already exports most
+ *  of it in /sys/class/dmi/id and the raw table in /sys/firmware/dmi/tables, so both are read
+ *  once here and formatted as dmidecode -s would. dmidecode is only run, once for all of
+ *  them, on kernels without the raw table.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "logging.h"
+#include "miscellaneous.h"
+#include "dmi.h"
+
+/* How a value is stored in its SMBIOS structure */
+#define NWIPE_DMI_STRING 0  // A string number
+#define NWIPE_DMI_UUID 1  // 16 bytes
+#define NWIPE_DMI_CHASSIS_TYPE 2  // A byte, see kwipe_dmi_chassis_types
+#define NWIPE_DMI_PROCESSOR_FAMILY 3  // A byte, or a word at 0x28 if it is 0xFE
+#define NWIPE_DMI_SPEED 4  // A word in MHz
+
+/* The largest table the kernel exports is well under this */
+#define NWIPE_DMI_TABLE_MAX ( 1024 * 1024 )
+
+typedef struct
+{
+    const char* keyword;  // The dmidecode -s keyword
+    const char* sysfs;  // The file in /sys/class/dmi/id, NULL if the kernel doesn't export it
+    int type;  // The SMBIOS structure type
+    int offset;  // The offset of the value in the structure
+    int format;  // How the value is stored
+    const char* label;  // The label dmidecode prints the value under
+} kwipe_dmi_source_t;
+
+static const kwipe_dmi_source_t kwipe_dmi_sources[] = {
+    { "bios-vendor", "bios_vendor", 0, 0x04, NWIPE_DMI_STRING, "Vendor" },
+    { "bios-version", "bios_version", 0, 0x05, NWIPE_DMI_STRING, "Version" },
+    { "bios-release-date", "bios_date", 0, 0x08, NWIPE_DMI_STRING, "Release Date" },
+    { "system-manufacturer", "sys_vendor", 1, 0x04, NWIPE_DMI_STRING, "Manufacturer" },
+    { "system-product-name", "product_name", 1, 0x05, NWIPE_DMI_STRING, "Product Name" },
+    { "system-version", "product_version", 1, 0x06, NWIPE_DMI_STRING, "Version" },
+    { "system-serial-number", "product_serial", 1, 0x07, NWIPE_DMI_STRING, "Serial Number" },
+    { "system-uuid", "product_uuid", 1, 0x08, NWIPE_DMI_UUID, "UUID" },
+    { "baseboard-manufacturer", "board_vendor", 2, 0x04, NWIPE_DMI_STRING, "Manufacturer" },
+    { "baseboard-product-name", "board_name", 2, 0x05, NWIPE_DMI_STRING, "Product Name" },
+    { "baseboard-version", "board_version", 2, 0x06, NWIPE_DMI_STRING, "Version" },
+    { "baseboard-serial-number", "board_serial", 2, 0x07, NWIPE_DMI_STRING, "Serial Number" },
+    { "baseboard-asset-tag", "board_asset_tag", 2, 0x08, NWIPE_DMI_STRING, "Asset Tag" },
+    { "chassis-manufacturer", "chassis_vendor", 3, 0x04, NWIPE_DMI_STRING, "Manufacturer" },
+    { "chassis-type", "chassis_type", 3, 0x05, NWIPE_DMI_CHASSIS_TYPE, "Type" },
+    { "chassis-version", "chassis_version", 3, 0x06, NWIPE_DMI_STRING, "Version" },
+    { "chassis-serial-number", "chassis_serial", 3, 0x07, NWIPE_DMI_STRING, "Serial Number" },
+    { "chassis-asset-tag", "chassis_asset_tag", 3, 0x08, NWIPE_DMI_STRING, "Asset Tag" },
+    { "processor-family", NULL, 4, 0x06, NWIPE_DMI_PROCESSOR_FAMILY, "Family" },
+    { "processor-manufacturer", NULL, 4, 0x07, NWIPE_DMI_STRING, "Manufacturer" },
+    { "processor-version", NULL, 4, 0x10, NWIPE_DMI_STRING, "Version" },
+    { "processor-frequency", NULL, 4, 0x16, NWIPE_DMI_SPEED, "Current Speed" },
+    { NULL, NULL, 0, 0, 0, NULL } };
+
+/* SMBIOS 3.x, 7.4.1, indexed by type */
+static const char* kwipe_dmi_chassis_types[] = {
+    NULL,
+    "Other",
+    "Unknown",
+    "Desktop",
+    "Low Profile Desktop",
+    "Pizza Box",
+    "Mini Tower",
+    "Tower",
+    "Portable",
+    "Laptop",
+    "Notebook",
+    "Hand Held",
+    "Docking Station",
+    "All In One",
+    "Sub Notebook",
+    "Space-saving",
+    "Lunch Box",
+    "Main Server Chassis",
+    "Expansion Chassis",
+    "Sub Chassis",
+    "Bus Expansion Chassis",
+    "Peripheral Chassis",
+    "RAID Chassis",
+    "Rack Mount Chassis",
+    "Sealed-case PC",
+    "Multi-system",
+    "CompactPCI",
+    "AdvancedTCA",
+    "Blade",
+    "Blade Enclosure",
+    "Tablet",
+    "Convertible",
+    "Detachable",
+    "IoT Gateway",
+    "Embedded PC",
+    "Mini PC",
+    "Stick PC" };
+
+typedef struct
+{
+    int family;
+    const char* name;
+} kwipe_dmi_family_t;
+
+/* SMBIOS 3.x, 7.5.2, the families likely to be found in a machine being wiped */
+static const kwipe_dmi_family_t kwipe_dmi_processor_families[] = {
+    { 0x01, "Other" },
+    { 0x02, "Unknown" },
+    { 0x0B, "Pentium" },
+    { 0x0C, "Pentium Pro" },
+    { 0x0D, "Pentium II" },
+    { 0x0E, "Pentium MMX" },
+    { 0x0F, "Celeron" },
+    { 0x10, "Pentium II Xeon" },
+    { 0x11, "Pentium III" },
+    { 0x14, "Celeron M" },
+    { 0x15, "Pentium 4 HT" },
+    { 0x18, "Duron" },
+    { 0x19, "K5" },
+    { 0x1A, "K6" },
+    { 0x1B, "K6-2" },
+    { 0x1C, "K6-3" },
+    { 0x1D, "Athlon" },
+    { 0x28, "Core Duo" },
+    { 0x29, "Core Duo Mobile" },
+    { 0x2A, "Core Solo Mobile" },
+    { 0x2B, "Atom" },
+    { 0x2C, "Core M" },
+    { 0x2D, "Core m3" },
+    { 0x2E, "Core m5" },
+    { 0x2F, "Core m7" },
+    { 0x6B, "Zen" },
+    { 0x83, "Athlon 64" },
+    { 0x84, "Opteron" },
+    { 0x85, "Sempron" },
+    { 0x86, "Turion 64" },
+    { 0x87, "Dual-Core Opteron" },
+    { 0x88, "Athlon 64 X2" },
+    { 0x89, "Turion 64 X2" },
+    { 0x8A, "Quad-Core Opteron" },
+    { 0x8B, "Third-Generation Opteron" },
+    { 0x8C, "Phenom FX" },
+    { 0x8D, "Phenom X4" },
+    { 0x8E, "Phenom X2" },
+    { 0x8F, "Athlon X2" },
+    { 0xB3, "Xeon" },
+    { 0xB5, "Xeon MP" },
+    { 0xB6, "Athlon XP" },
+    { 0xB7, "Athlon MP" },
+    { 0xB8, "Itanium 2" },
+    { 0xB9, "Pentium M" },
+    { 0xBA, "Celeron D" },
+    { 0xBB, "Pentium D" },
+    { 0xBC, "Pentium EE" },
+    { 0xBD, "Core Solo" },
+    { 0xBF, "Core 2 Duo" },
+    { 0xC0, "Core 2 Solo" },
+    { 0xC1, "Core 2 Extreme" },
+    { 0xC2, "Core 2 Quad" },
+    { 0xC3, "Core 2 Extreme Mobile" },
+    { 0xC4, "Core 2 Duo Mobile" },
+    { 0xC5, "Core 2 Solo Mobile" },
+    { 0xC6, "Core i7" },
+    { 0xC7, "Dual-Core Celeron" },
+    { 0xCD, "Core i5" },
+    { 0xCE, "Core i3" },
+    { 0xCF, "Core i9" },
+    { 0x100, "ARMv7" },
+    { 0x101, "ARMv8" },
+    { 0x102, "ARMv9" },
+    { 0x118, "ARM" },
+    { 0x119, "StrongARM" },
+    { 0x200, "RV32" },
+    { 0x201, "RV64" },
+    { 0x202, "RV128" },
+    { 0, NULL } };
+
+static const kwipe_dmi_source_t* kwipe_dmi_source( const char* keyword )
+{
+    const kwipe_dmi_source_t* source;
+
+    for( source = kwipe_dmi_sources; source->keyword != NULL; source++ )
+    {
+        if( strcmp( source->keyword, keyword ) == 0 )
+        {
+            return source;
+        }
+    }
+
+    return NULL;
+}
+
+static void kwipe_dmi_trim( char* value )
+{
+    /* Drops the trailing newline and any padding after it, dmidecode -s does the same */
+    size_t length = strlen( value );
+
+    while( length > 0 && isspace( (unsigned char) value[length - 1] ) )
+    {
+        value[--length] = 0;
+    }
+}
+
+static void kwipe_dmi_add( kwipe_dmi_field_t* field, const char* value )
+{
+    if( field->count < NWIPE_DMI_MAX_VALUES )
+    {
+        snprintf( field->value[field->count], NWIPE_DMI_VALUE_LENGTH, "%s", value );
+        kwipe_dmi_trim( field->value[field->count] );
+        field->count++;
+    }
+}
+
+static const char* kwipe_dmi_chassis_type( int type )
+{
+    /* The top bit says whether the chassis has a lock */
+    type &= 0x7F;
+
+    if( type > 0 && type < (int) ( sizeof( kwipe_dmi_chassis_types ) / sizeof( kwipe_dmi_chassis_types[0] ) ) )
+    {
+        return kwipe_dmi_chassis_types[type];
+    }
+
+    return "<OUT OF SPEC>";
+}
+
+static void kwipe_dmi_read_sysfs( kwipe_dmi_field_t* field, const kwipe_dmi_source_t* source )
+{
+    char path[sizeof( NWIPE_DMI_SYSFS ) + 32];
+    char value[NWIPE_DMI_VALUE_LENGTH];
+    FILE* fp;
+    char* p;
+
+    snprintf( path, sizeof( path ), "%s/%s", NWIPE_DMI_SYSFS, source->sysfs );
+
+    /* The serial numbers and UUID are only readable by root */
+    fp = fopen( path, "r" );
+    if( fp == NULL )
+    {
+        return;
+    }
+
+    if( fgets( value, sizeof( value ), fp ) == NULL )
+    {
+        fclose( fp );
+        return;
+    }
+    fclose( fp );
+
+    kwipe_dmi_trim( value );
+    if( value[0] == 0 )
+    {
+        /* Left for the table, which says Not Specified as dmidecode does */
+        return;
+    }
+
+    switch( source->format )
+    {
+        case NWIPE_DMI_CHASSIS_TYPE:
+            kwipe_dmi_add( field, kwipe_dmi_chassis_type( atoi( value ) ) );
+            break;
+
+        case NWIPE_DMI_UUID:
+            /* The kernel prints it in lower case, dmidecode in upper */
+            for( p = value; *p; p++ )
+            {
+                *p = toupper( (unsigned char) *p );
+            }
+            kwipe_dmi_add( field, value );
+            break;
+
+        default:
+            kwipe_dmi_add( field, value );
+            break;
+    }
+}
+
+static int kwipe_dmi_read_version( void )
+{
+    /* Returns the SMBIOS version from the entry point as 0xMMmm, the UUID's byte order
+     * depends on it. Assumes a current version if the entry point can't be read. */
+    unsigned char entry[32];
+    FILE* fp;
+    size_t r;
+
+    fp = fopen( NWIPE_DMI_ENTRY_POINT, "r" );
+    if( fp == NULL )
+    {
+        return 0x0300;
+    }
+
+    r = fread( entry, 1, sizeof( entry ), fp );
+    fclose( fp );
+
+    if( r >= 9 && memcmp( entry, "_SM3_", 5 ) == 0 )
+    {
+        return ( entry[7] << 8 ) | entry[8];
+    }
+
+    if( r >= 8 && memcmp( entry, "_SM_", 4 ) == 0 )
+    {
+        return ( entry[6] << 8 ) | entry[7];
+    }
+
+    return 0x0300;
+}
+
+static unsigned char* kwipe_dmi_read_table( size_t* size )
+{
+    unsigned char* table;
+    FILE* fp;
+
+    fp = fopen( NWIPE_DMI_TABLE, "r" );
+    if( fp == NULL )
+    {
+        return NULL;
+    }
+
+    table = malloc( NWIPE_DMI_TABLE_MAX );
+    if( table == NULL )
+    {
+        kwipe_perror( errno, __FUNCTION__, "malloc" );
+        fclose( fp );
+        return NULL;
+    }
+
+    *size = fread( table, 1, NWIPE_DMI_TABLE_MAX, fp );
+    fclose( fp );
+
+    if( *size == 0 )
+    {
+        free( table );
+        return NULL;
+    }
+
+    return table;
+}
+
+static void kwipe_dmi_string( const unsigned char* structure, const unsigned char* end, int number, char* value )
+{
+    /* Finds string 'number' in the set after the formatted area of the structure */
+    const char* s = (const char*) structure + structure[1];
+
+    if( number == 0 )
+    {
+        snprintf( value, NWIPE_DMI_VALUE_LENGTH, "Not Specified" );
+        return;
+    }
+
+    while( --number > 0 && (const unsigned char*) s < end && *s )
+    {
+        s += strnlen( s, (const char*) end - s ) + 1;
+    }
+
+    if( (const unsigned char*) s >= end || *s == 0 )
+    {
+        snprintf( value, NWIPE_DMI_VALUE_LENGTH, "<BAD INDEX>" );
+        return;
+    }
+
+    snprintf( value, NWIPE_DMI_VALUE_LENGTH, "%.*s", (int) strnlen( s, (const char*) end - s ), s );
+}
+
+static void kwipe_dmi_uuid( const unsigned char* p, int version, char* value )
+{
+    int only_zero = 1;
+    int only_ff = 1;
+    int i;
+
+    for( i = 0; i < 16; i++ )
+    {
+        only_zero &= p[i] == 0x00;
+        only_ff &= p[i] == 0xFF;
+    }
+
+    if( only_zero )
+    {
+        snprintf( value, NWIPE_DMI_VALUE_LENGTH, "Not Present" );
+        return;
+    }
+    if( only_ff )
+    {
+        snprintf( value, NWIPE_DMI_VALUE_LENGTH, "Not Settable" );
+        return;
+    }
+
+    /* From SMBIOS 2.6 the first three fields are little-endian */
+    if( version >= 0x0206 )
+    {
+        snprintf( value,
+                  NWIPE_DMI_VALUE_LENGTH,
+                  "%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+                  p[3],
+                  p[2],
+                  p[1],
+                  p[0],
+                  p[5],
+                  p[4],
+                  p[7],
+                  p[6],
+                  p[8],
+                  p[9],
+                  p[10],
+                  p[11],
+                  p[12],
+                  p[13],
+                  p[14],
+                  p[15] );
+    }
+    else
+    {
+        snprintf( value,
+                  NWIPE_DMI_VALUE_LENGTH,
+                  "%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+                  p[0],
+                  p[1],
+                  p[2],
+                  p[3],
+                  p[4],
+                  p[5],
+                  p[6],
+                  p[7],
+                  p[8],
+                  p[9],
+                  p[10],
+                  p[11],
+                  p[12],
+                  p[13],
+                  p[14],
+                  p[15] );
+    }
+}
+
+static void kwipe_dmi_processor_family( int family, char* value )
+{
+    const kwipe_dmi_family_t* f;
+
+    for( f = kwipe_dmi_processor_families; f->name != NULL; f++ )
+    {
+        if( f->family == family )
+        {
+            snprintf( value, NWIPE_DMI_VALUE_LENGTH, "%s", f->name );
+            return;
+        }
+    }
+
+    snprintf( value, NWIPE_DMI_VALUE_LENGTH, "Family 0x%02X", family );
+}
+
+static void kwipe_dmi_decode( const unsigned char* structure,
+                              const unsigned char* end,
+                              const kwipe_dmi_source_t* source,
+                              int version,
+                              char* value )
+{
+    /* Formats a value from a structure of the source's type as dmidecode -s does */
+    const unsigned char* p = structure + source->offset;
+    int length = structure[1];
+    int word;
+
+    value[0] = 0;
+
+    switch( source->format )
+    {
+        case NWIPE_DMI_STRING:
+            if( length > source->offset )
+            {
+                kwipe_dmi_string( structure, end, p[0], value );
+            }
+            break;
+
+        case NWIPE_DMI_UUID:
+            if( length >= source->offset + 16 )
+            {
+                kwipe_dmi_uuid( p, version, value );
+            }
+            break;
+
+        case NWIPE_DMI_CHASSIS_TYPE:
+            if( length > source->offset )
+            {
+                snprintf( value, NWIPE_DMI_VALUE_LENGTH, "%s", kwipe_dmi_chassis_type( p[0] ) );
+            }
+            break;
+
+        case NWIPE_DMI_PROCESSOR_FAMILY:
+            if( length > source->offset )
+            {
+                /* 0xFE means see Processor Family 2 */
+                if( p[0] == 0xFE && length >= 0x2A )
+                {
+                    kwipe_dmi_processor_family( structure[0x28] | ( structure[0x29] << 8 ), value );
+                }
+                else
+                {
+                    kwipe_dmi_processor_family( p[0], value );
+                }
+            }
+            break;
+
+        case NWIPE_DMI_SPEED:
+            if( length > source->offset + 1 )
+            {
+                word = p[0] | ( p[1] << 8 );
+                if( word == 0 )
+                {
+                    snprintf( value, NWIPE_DMI_VALUE_LENGTH, "Unknown" );
+                }
+                else
+                {
+                    snprintf( value, NWIPE_DMI_VALUE_LENGTH, "%i MHz", word );
+                }
+            }
+            break;
+    }
+}
+
+static void kwipe_dmi_parse_table( const unsigned char* table,
+                                   size_t size,
+                                   kwipe_dmi_field_t* fields,
+                                   const kwipe_dmi_source_t** sources,
+                                   int* from_table,
+                                   int count )
+{
+    /* One walk of the table fills in every field that wasn't found in sysfs */
+    const unsigned char* structure = table;
+    const unsigned char* end = table + size;
+    const unsigned char* next;
+    char value[NWIPE_DMI_VALUE_LENGTH];
+    int version = kwipe_dmi_read_version();
+    int i;
+
+    /* Each structure is a four byte header, the formatted area and a set of strings ending
+     * in a double null */
+    while( structure + 4 <= end && structure[1] >= 4 && structure + structure[1] <= end )
+    {
+        next = structure + structure[1];
+        while( next + 1 < end && ( next[0] != 0 || next[1] != 0 ) )
+        {
+            next++;
+        }
+        next += 2;
+
+        /* End of table */
+        if( structure[0] == 127 )
+        {
+            break;
+        }
+
+        for( i = 0; i < count; i++ )
+        {
+            if( from_table[i] && sources[i]->type == structure[0] )
+            {
+                kwipe_dmi_decode( structure, next < end ? next : end, sources[i], version, value );
+                if( value[0] != 0 )
+                {
+                    kwipe_dmi_add( &fields[i], value );
+                }
+            }
+        }
+
+        structure = next;
+    }
+}
+
+static void kwipe_dmi_run_dmidecode( kwipe_dmi_field_t* fields, const kwipe_dmi_source_t** sources, int count )
+{
+    /* Runs dmidecode once for every type and picks each missing value out of its output */
+    const char* path;
+    char command[NWIPE_COMMAND_PATH_LENGTH + 32];
+    char line[256];
+    char* value;
+    int missing[count];
+    int type = -1;
+    FILE* fp;
+    int i;
+    int r;
+
+    for( i = 0; i < count; i++ )
+    {
+        missing[i] = sources[i] != NULL && fields[i].count == 0;
+    }
+
+    if( ( path = kwipe_find_command( "dmidecode" ) ) == NULL )
+    {
+        return;
+    }
+
+    snprintf( command, sizeof( command ), "%s -t 0,1,2,3,4 2>/dev/null", path );
+
+    fp = popen( command, "r" );
+    if( fp == NULL )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "kwipe_dmi_read: Failed to create stream to %s", command );
+        return;
+    }
+
+    while( fgets( line, sizeof( line ), fp ) != NULL )
+    {
+        /* "Handle 0x0001, DMI type 1, 27 bytes" starts each structure */
+        if( strncmp( line, "Handle ", 7 ) == 0 )
+        {
+            value = strstr( line, "DMI type " );
+            type = value ? atoi( value + 9 ) : -1;
+            continue;
+        }
+
+        /* Values are "\tLabel: value", deeper indents are lists */
+        if( line[0] != '\t' || line[1] == '\t' || ( value = strstr( line, ": " ) ) == NULL )
+        {
+            continue;
+        }
+        *value = 0;
+        value += 2;
+
+        for( i = 0; i < count; i++ )
+        {
+            if( missing[i] && sources[i]->type == type && strcmp( sources[i]->label, line + 1 ) == 0 )
+            {
+                kwipe_dmi_add( &fields[i], value );
+            }
+        }
+    }
+
+    r = pclose( fp );
+    if( r != 0 )
+    {
+        kwipe_log(
+            NWIPE_LOG_WARNING, "kwipe_dmi_read: dmidecode failed, \"%s\" exit status = %u", command, WEXITSTATUS( r ) );
+    }
+}
+
+int kwipe_dmi_read( kwipe_dmi_field_t* fields, int count )
+{
+    const kwipe_dmi_source_t* sources[count];
+    int from_table[count];
+    unsigned char* table;
+    size_t size = 0;
+    int missing = 0;
+    int i;
+
+    for( i = 0; i < count; i++ )
+    {
+        fields[i].count = 0;
+        sources[i] = kwipe_dmi_source( fields[i].keyword );
+        from_table[i] = 0;
+
+        if( sources[i] == NULL )
+        {
+            kwipe_log( NWIPE_LOG_WARNING, "kwipe_dmi_read: Unknown keyword %s", fields[i].keyword );
+            continue;
+        }
+
+        if( sources[i]->sysfs != NULL )
+        {
+            kwipe_dmi_read_sysfs( &fields[i], sources[i] );
+        }
+
+        /* The table has a value for every structure, sysfs only the first */
+        from_table[i] = fields[i].count == 0;
+    }
+
+    table = kwipe_dmi_read_table( &size );
+    if( table != NULL )
+    {
+        kwipe_dmi_parse_table( table, size, fields, sources, from_table, count );
+        free( table );
+    }
+    else
+    {
+        /* Kernels before 4.2 don't export the table */
+        for( i = 0; i < count; i++ )
+        {
+            if( sources[i] != NULL && fields[i].count == 0 )
+            {
+                kwipe_dmi_run_dmidecode( fields, sources, count );
+                break;
+            }
+        }
+    }
+
+    for( i = 0; i < count; i++ )
+    {
+        if( fields[i].count == 0 )
+        {
+            missing++;
+        }
+    }
+
+    return missing;
+}
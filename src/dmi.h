@@ -0,0 +1,48 @@
+/*
+ *  dmi.h: Reading the SMBIOS/DMI data for the log without running dmidecode.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef DMI_H_
+#define DMI_H_
+
+#define NWIPE_DMI_VALUE_LENGTH 128
+
+/* A keyword can have a value for each structure of its type, e.g. one per processor socket */
+#define NWIPE_DMI_MAX_VALUES 8
+
+#define NWIPE_DMI_SYSFS "/sys/class/dmi/id"
+#define NWIPE_DMI_TABLE "/sys/firmware/dmi/tables/DMI"
+#define NWIPE_DMI_ENTRY_POINT "/sys/firmware/dmi/tables/smbios_entry_point"
+
+typedef struct
+{
+    const char* keyword;  // A dmidecode -s keyword, e.g. "system-serial-number"
+    int count;  // The number of values found
+    char value[NWIPE_DMI_MAX_VALUES][NWIPE_DMI_VALUE_LENGTH];  // Formatted as dmidecode -s would
+} kwipe_dmi_field_t;
+
+/**
+ * Fills in the values of each field. The kernel's /sys/class/dmi/id is read first and the
+ * SMBIOS table in /sys/firmware/dmi/tables is parsed for the fields it doesn't have, such as
+ * the processor's. dmidecode is run, once, only for the fields neither of those has.
+ * @param fields the fields, each with its keyword set
+ * @param count the number of fields
+ * @return 0 if every field was found, otherwise the number of fields that weren't
+ */
+int kwipe_dmi_read( kwipe_dmi_field_t* fields, int count );
+
+#endif /* DMI_H_ */
@@ -0,0 +1,126 @@
+/*
+ *  event.c: Waking the main and temperature threads when a wipe finishes or kwipe is terminating.
+ *
+ *  Instead of polling the wipe status and terminate_signal once a second, the main and
+ *  temperature threads sleep on a condition variable. Every wipe thread signals it when
+ *  it returns and so does everything that sets terminate_signal. The condition variable
+ *  uses the monotonic clock so that timeouts are not affected by the wall clock changing.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <time.h>
+#include <pthread.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "event.h"
+#include "numa.h"
+#include "shared_stream.h"
+
+extern int terminate_signal;
+
+static pthread_mutex_t event_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t event_cond = PTHREAD_COND_INITIALIZER;
+static u64 event_generation;
+
+void kwipe_event_init( void )
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &event_cond, &attr );
+    pthread_condattr_destroy( &attr );
+}
+
+void kwipe_event_signal( void )
+{
+    pthread_mutex_lock( &event_mutex );
+    event_generation++;
+    pthread_cond_broadcast( &event_cond );
+    pthread_mutex_unlock( &event_mutex );
+}
+
+u64 kwipe_event_generation( void )
+{
+    u64 generation;
+
+    pthread_mutex_lock( &event_mutex );
+    generation = event_generation;
+    pthread_mutex_unlock( &event_mutex );
+
+    return generation;
+}
+
+u64 kwipe_event_wait( u64 seen, u64 timeout_ns )
+{
+    struct timespec deadline;
+    u64 generation;
+    int r = 0;
+
+    if( timeout_ns )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &deadline );
+        timeout_ns += deadline.tv_nsec;
+        deadline.tv_sec += timeout_ns / 1000000000ULL;
+        deadline.tv_nsec = timeout_ns % 1000000000ULL;
+    }
+
+    pthread_mutex_lock( &event_mutex );
+    while( event_generation == seen && r == 0 )
+    {
+        if( timeout_ns )
+        {
+            r = pthread_cond_timedwait( &event_cond, &event_mutex, &deadline );
+        }
+        else
+        {
+            r = pthread_cond_wait( &event_cond, &event_mutex );
+        }
+    }
+    generation = event_generation;
+    pthread_mutex_unlock( &event_mutex );
+
+    return generation;
+}
+
+void kwipe_request_terminate( void )
+{
+    terminate_signal = 1;
+    kwipe_event_signal();
+}
+
+void* kwipe_wipe_thread( void* ptr )
+{
+    kwipe_context_t* c = (kwipe_context_t*) ptr;
+    void* ( *method )( void* ) = kwipe_options.method;
+
+    /* Run on the drive's NUMA node, before the method allocates its buffers */
+    kwipe_numa_bind( c );
+
+    method( ptr );
+
+    /* Stop holding back the other drives' shared streams, see shared_stream.c */
+    kwipe_shared_stream_leave( c );
+
+    __atomic_store_n( &c->thread_finished, 1, __ATOMIC_RELEASE );
+    kwipe_event_signal();
+
+    return NULL;
+}
@@ -0,0 +1,82 @@
+/*
+ *  event.h: Waking the main and temperature threads when a wipe finishes or kwipe is terminating.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include "context.h"
+
+/* Returned by the passes, and so by kwipe_runmethod(), when the wipe was cancelled. */
+#define NWIPE_CANCELLED -2
+
+/**
+ * Initialises the event, must be called before any thread is created.
+ */
+void kwipe_event_init( void );
+
+/**
+ * Wakes every thread waiting in kwipe_event_wait().
+ */
+void kwipe_event_signal( void );
+
+/**
+ * Returns the number of times the event has been signalled. Read it before checking
+ * the condition you are waiting for, then pass it to kwipe_event_wait() so that a
+ * signal arriving in between is not lost.
+ */
+u64 kwipe_event_generation( void );
+
+/**
+ * Waits until the event is signalled after generation 'seen' or the timeout expires.
+ * @param seen the generation returned by kwipe_event_generation() or a previous wait
+ * @param timeout_ns the longest time to wait in nanoseconds, 0 waits indefinitely
+ * @return the current generation
+ */
+u64 kwipe_event_wait( u64 seen, u64 timeout_ns );
+
+/**
+ * Sets terminate_signal and wakes the threads waiting on it.
+ */
+void kwipe_request_terminate( void );
+
+/**
+ * Runs the wipe method for a drive, kwipe_options.method, then marks the thread as
+ * finished and signals the event. This is the start routine of every wipe thread.
+ */
+void* kwipe_wipe_thread( void* ptr );
+
+/**
+ * Asks the wipe thread of a drive to stop. The passes check at the end of every block,
+ * flush what has been written and return NWIPE_CANCELLED.
+ */
+static inline void kwipe_cancel( kwipe_context_t* c )
+{
+    __atomic_store_n( &c->cancel_requested, 1, __ATOMIC_RELEASE );
+}
+
+static inline int kwipe_cancel_requested( kwipe_context_t* c )
+{
+    return __atomic_load_n( &c->cancel_requested, __ATOMIC_ACQUIRE );
+}
+
+static inline int kwipe_thread_finished( kwipe_context_t* c )
+{
+    return __atomic_load_n( &c->thread_finished, __ATOMIC_ACQUIRE );
+}
+
+#endif /* EVENT_H_ */
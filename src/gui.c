@@ -52,6 +52,7 @@
 #include "kwipe.h"
 #include "context.h"
 #include "method.h"
+#include "sanitize.h"
 #include "prng.h"
 #include "options.h"
 #include "gui.h"
@@ -60,6 +61,11 @@
 #include "version.h"
 #include "temperature.h"
 #include "miscellaneous.h"
+#include "stats.h"
+#include "latency.h"
+#include "progress.h"
+#include "event.h"
+#include "scheduler.h"
 #include "hpa_dco.h"
 #include "customers.h"
 #include "conf.h"
@@ -81,7 +87,7 @@
 
 /* Options window: width, height, x coorindate, y coordinate. */
 #define NWIPE_GUI_OPTIONS_W 44
-#define NWIPE_GUI_OPTIONS_H 7
+#define NWIPE_GUI_OPTIONS_H 8
 #define NWIPE_GUI_OPTIONS_Y 1
 #define NWIPE_GUI_OPTIONS_X 0
 
@@ -100,7 +106,7 @@
 
 /* Stats window: width, height, x coordinate, y coordinate. */
 #define NWIPE_GUI_STATS_W ( COLS - 44 )
-#define NWIPE_GUI_STATS_H 7
+#define NWIPE_GUI_STATS_H 8
 #define NWIPE_GUI_STATS_Y 1
 #define NWIPE_GUI_STATS_X 44
 
@@ -115,12 +121,14 @@
 #define NWIPE_GUI_STATS_THROUGHPUT_X 1
 #define NWIPE_GUI_STATS_ERRORS_Y 5
 #define NWIPE_GUI_STATS_ERRORS_X 1
+#define NWIPE_GUI_STATS_LATENCY_Y 6
+#define NWIPE_GUI_STATS_LATENCY_X 1
 #define NWIPE_GUI_STATS_TAB 16
 
 /* Select window: width, height, x coordinate, y coordinate. */
 #define NWIPE_GUI_MAIN_W COLS
 #define NWIPE_GUI_MAIN_H ( LINES - NWIPE_GUI_MAIN_Y - 1 )
-#define NWIPE_GUI_MAIN_Y 8
+#define NWIPE_GUI_MAIN_Y 9
 #define NWIPE_GUI_MAIN_X 0
 
 #define SKIP_DEV_PREFIX 5
@@ -166,7 +174,7 @@ const char* selection_footer_preview_prior_to_drive_selection =
     "A=Accept & display drives J=Down K=Up Space=Select Backspace=Cancel Ctrl+C=Quit";
 const char* selection_footer_add_customer = "S=Save J=Down K=Up Space=Select Backspace=Cancel Ctrl+C=Quit";
 const char* selection_footer_add_customer_yes_no = "Save Customer Details Y/N";
-const char* end_wipe_footer = "B=[Toggle between dark\\blank\\blue screen] Ctrl+C=Quit";
+const char* end_wipe_footer = "B=[Toggle between dark\\blank\\blue screen] L=[Toggle log] Ctrl+C=Quit";
 const char* rounds_footer = "Left=Erase Esc=Cancel Ctrl+C=Quit";
 const char* selection_footer_text_entry = "Esc=Cancel Return=Submit Ctrl+C=Quit";
 
@@ -553,6 +561,7 @@ void kwipe_gui_create_stats_window()
     mvwprintw( stats_window, NWIPE_GUI_STATS_LOAD_Y, NWIPE_GUI_STATS_LOAD_X, "Load Averages: " );
     mvwprintw( stats_window, NWIPE_GUI_STATS_THROUGHPUT_Y, NWIPE_GUI_STATS_THROUGHPUT_X, "Throughput:    " );
     mvwprintw( stats_window, NWIPE_GUI_STATS_ERRORS_Y, NWIPE_GUI_STATS_ERRORS_X, "Errors:        " );
+    mvwprintw( stats_window, NWIPE_GUI_STATS_LATENCY_Y, NWIPE_GUI_STATS_LATENCY_X, "Latency p99:   " );
 
 } /* kwipe_gui_create_stats_window */
 
@@ -947,7 +956,7 @@ void kwipe_gui_select( int count, kwipe_context_t** c )
                                "GUI.c,kwipe_gui_select(), loop runaway, did you close the terminal without exiting "
                                "kwipe? Exiting kwipe now." );
                     /* Issue signal to kwipe to exit immediately but gracefully */
-                    terminate_signal = 1;
+                    kwipe_request_terminate();
                 }
             }
             else
@@ -1426,9 +1435,9 @@ void kwipe_gui_options( void )
 
     mvwprintw( options_window, NWIPE_GUI_OPTIONS_ROUNDS_Y, NWIPE_GUI_OPTIONS_ROUNDS_X, "Rounds:  " );
 
-    /* Disable blanking for ops2 and verify methods */
+    /* Disable blanking for ops2, verify and sanitize methods */
     if( kwipe_options.method == &kwipe_ops2 || kwipe_options.method == &kwipe_verify_zero
-        || kwipe_options.method == &kwipe_verify_one )
+        || kwipe_options.method == &kwipe_verify_one || kwipe_method_is_sanitize( kwipe_options.method ) )
     {
         kwipe_options.noblank = 1;
     }
@@ -2315,7 +2324,7 @@ void kwipe_gui_method( void )
     extern int terminate_signal;
 
     /* The number of implemented methods. */
-    const int count = 10;
+    const int count = 13;
 
     /* The first tabstop. */
     const int tab1 = 2;
@@ -2377,6 +2386,18 @@ void kwipe_gui_method( void )
     {
         focus = 9;
     }
+    if( kwipe_options.method == &kwipe_sanitize_crypto )
+    {
+        focus = 10;
+    }
+    if( kwipe_options.method == &kwipe_sanitize_block )
+    {
+        focus = 11;
+    }
+    if( kwipe_options.method == &kwipe_sanitize_overwrite )
+    {
+        focus = 12;
+    }
 
     do
     {
@@ -2399,6 +2420,9 @@ void kwipe_gui_method( void )
         mvwprintw( main_window, yy++, tab1, "  %s", kwipe_method_label( &kwipe_verify_zero ) );
         mvwprintw( main_window, yy++, tab1, "  %s", kwipe_method_label( &kwipe_verify_one ) );
         mvwprintw( main_window, yy++, tab1, "  %s", kwipe_method_label( &kwipe_is5enh ) );
+        mvwprintw( main_window, yy++, tab1, "  %s", kwipe_method_label( &kwipe_sanitize_crypto ) );
+        mvwprintw( main_window, yy++, tab1, "  %s", kwipe_method_label( &kwipe_sanitize_block ) );
+        mvwprintw( main_window, yy++, tab1, "  %s", kwipe_method_label( &kwipe_sanitize_overwrite ) );
         mvwprintw( main_window, yy++, tab1, "                                             " );
 
         /* Print the cursor. */
@@ -2535,6 +2559,48 @@ void kwipe_gui_method( void )
                 mvwprintw( main_window, 11, tab2, "successfully written.                            " );
                 break;
 
+            case 10:
+
+                mvwprintw( main_window, 2, tab2, "Security Level: Depends on the drive" );
+
+                mvwprintw( main_window, 4, tab2, "The drive changes its media encryption key, so   " );
+                mvwprintw( main_window, 5, tab2, "everything it holds, spare blocks included, can  " );
+                mvwprintw( main_window, 6, tab2, "no longer be decrypted. Takes seconds.           " );
+                mvwprintw( main_window, 7, tab2, "                                                 " );
+                mvwprintw( main_window, 8, tab2, "Sent as ATA SANITIZE, NVMe Sanitize or SCSI      " );
+                mvwprintw( main_window, 9, tab2, "SANITIZE, the drive must support it. Rounds and  " );
+                mvwprintw( main_window, 10, tab2, "blanking do not apply, verification reads back  " );
+                mvwprintw( main_window, 11, tab2, "a sample of blocks.                              " );
+                break;
+
+            case 11:
+
+                mvwprintw( main_window, 2, tab2, "Security Level: high (drive erase)" );
+
+                mvwprintw( main_window, 4, tab2, "The drive erases every block of its media, spare " );
+                mvwprintw( main_window, 5, tab2, "and remapped blocks included. The best choice for" );
+                mvwprintw( main_window, 6, tab2, "most solid state drives (SSD).                   " );
+                mvwprintw( main_window, 7, tab2, "                                                 " );
+                mvwprintw( main_window, 8, tab2, "Sent as ATA SANITIZE, NVMe Sanitize or SCSI      " );
+                mvwprintw( main_window, 9, tab2, "SANITIZE, the drive must support it. Rounds and  " );
+                mvwprintw( main_window, 10, tab2, "blanking do not apply, verification reads back  " );
+                mvwprintw( main_window, 11, tab2, "a sample of blocks.                              " );
+                break;
+
+            case 12:
+
+                mvwprintw( main_window, 2, tab2, "Security Level: high (1 pass)" );
+
+                mvwprintw( main_window, 4, tab2, "The drive overwrites its media with zeros, spare " );
+                mvwprintw( main_window, 5, tab2, "and remapped blocks included, which a wipe from  " );
+                mvwprintw( main_window, 6, tab2, "the host can't reach.                            " );
+                mvwprintw( main_window, 7, tab2, "                                                 " );
+                mvwprintw( main_window, 8, tab2, "Sent as ATA SANITIZE, NVMe Sanitize or SCSI      " );
+                mvwprintw( main_window, 9, tab2, "SANITIZE, the drive must support it. Rounds and  " );
+                mvwprintw( main_window, 10, tab2, "blanking do not apply, verification reads back  " );
+                mvwprintw( main_window, 11, tab2, "a sample of blocks.                              " );
+                break;
+
         } /* switch */
 
         /* Add a border. */
@@ -2629,6 +2695,18 @@ void kwipe_gui_method( void )
         case 9:
             kwipe_options.method = &kwipe_is5enh;
             break;
+
+        case 10:
+            kwipe_options.method = &kwipe_sanitize_crypto;
+            break;
+
+        case 11:
+            kwipe_options.method = &kwipe_sanitize_block;
+            break;
+
+        case 12:
+            kwipe_options.method = &kwipe_sanitize_overwrite;
+            break;
     }
 
 } /* kwipe_gui_method */
@@ -4097,7 +4175,7 @@ void kwipe_gui_list( int count, char* window_title, char** list, int* selected_e
                                "GUI.c,kwipe_gui_select(), loop runaway, did you close the terminal without exiting "
                                "kwipe? Exiting kwipe now." );
                     /* Issue signal to kwipe to exit immediately but gracefully */
-                    terminate_signal = 1;
+                    kwipe_request_terminate();
                 }
             }
             else
@@ -6230,6 +6308,9 @@ void* kwipe_gui_status( void* ptr )
     /* Spinner character */
     char spinner_string[2];
 
+    /* A copy of the progress counters of the drive being printed */
+    kwipe_progress_t progress;
+
     /* Create the finish message, this changes based on whether PDF creation is enabled
      * and whether a logfile has been specified
      */
@@ -6292,6 +6373,13 @@ void* kwipe_gui_status( void* ptr )
     /* The index of the element that is visible in the first slot. */
     static int offset;
 
+    /* Whether the main window shows the log instead of the drives, see kwipe_gui_log(). */
+    static int log_view;
+
+    /* The first line of the log shown, and whether the window follows the latest lines. */
+    static u64 log_top;
+    static int log_follow = 1;
+
     /* The number of elements that we can show in the window. */
     int slots;
 
@@ -6393,7 +6481,7 @@ void* kwipe_gui_status( void* ptr )
                            "GUI.c,kwipe_gui_status(), loop runaway, did you close the terminal without exiting "
                            "kwipe? Initiating shutdown now." );
                 /* Issue signal to kwipe to shutdown immediately but gracefully */
-                terminate_signal = 1;
+                kwipe_request_terminate();
             }
         }
         else
@@ -6530,10 +6618,47 @@ void* kwipe_gui_status( void* ptr )
 
                     break;
 
+                case 'l':
+                case 'L':
+
+                    /* Toggle between the drives and the log, which starts at its latest lines. */
+                    log_view = !log_view;
+                    log_follow = 1;
+
+                    break;
+
+                case KEY_PPAGE:
+                case KEY_NPAGE:
+                case KEY_END:
+
+                    /* Page through the log, End returns to its latest lines. */
+                    if( log_view )
+                    {
+                        log_follow = keystroke == KEY_END;
+                        if( keystroke == KEY_PPAGE )
+                        {
+                            log_top = log_top > (u64) ( wlines - 2 ) ? log_top - ( wlines - 2 ) : 0;
+                        }
+                        else if( keystroke == KEY_NPAGE )
+                        {
+                            log_top += wlines - 2;
+                        }
+                    }
+
+                    break;
+
                 case KEY_DOWN:
                 case 'j':
                 case 'J':
 
+                    if( log_view )
+                    {
+                        /* Scroll the log down, kwipe_gui_log() stops it at the latest line. */
+                        log_follow = 0;
+                        log_top++;
+                        break;
+                    }
+
                     /* Scroll down. */
                     offset += 1;
 
@@ -6553,6 +6678,16 @@ void* kwipe_gui_status( void* ptr )
                 case 'k':
                 case 'K':
 
+                    if( log_view )
+                    {
+                        log_follow = 0;
+                        if( log_top > 0 )
+                        {
+                            log_top--;
+                        }
+                        break;
+                    }
+
                     /* Scroll up. */
                     offset -= 1;
 
@@ -6606,9 +6741,17 @@ void* kwipe_gui_status( void* ptr )
             if( kwipe_gui_blank == 0 )
             {
 
+                if( log_view )
+                {
+                    kwipe_gui_log( &log_top, log_follow );
+                }
+
                 /* Print information for the user. */
-                for( i = offset; i < offset + slots && i < count; i++ )
+                for( i = offset; !log_view && i < offset + slots && i < count; i++ )
                 {
+                    /* Take a consistent copy of the progress counters the wipe thread is updating. */
+                    kwipe_progress_snapshot( c[i], &progress );
+
                     /* Print the device details. */
                     mvwprintw( main_window,
                                yy++,
@@ -6635,6 +6778,11 @@ void* kwipe_gui_status( void* ptr )
                                    c[i]->pass_count );
 
                     } /* child running */
+                    else if( c[i]->queued )
+                    {
+                        /* Waiting for room on its controller, see --controller-limit */
+                        mvwprintw( main_window, yy++, 4, "[queued on controller %i] ", c[i]->controller );
+                    }
                     else
                     {
                         if( c[i]->result == 0 )
@@ -6671,28 +6819,35 @@ void* kwipe_gui_status( void* ptr )
                             /* Each text field in square brackets should be the same number of characters
                              * to retain output in columns */
                             case NWIPE_PASS_FINAL_BLANK:
-                                if( !c[i]->sync_status )
+                                if( !progress.sync_status )
                                 {
                                     wprintw( main_window, "[ blanking] " );
                                 }
                                 break;
 
                             case NWIPE_PASS_FINAL_OPS2:
-                                if( !c[i]->sync_status )
+                                if( !progress.sync_status )
                                 {
                                     wprintw( main_window, "[OPS2final] " );
                                 }
                                 break;
 
+                            case NWIPE_PASS_DISCARD:
+                                if( !progress.sync_status )
+                                {
+                                    wprintw( main_window, "[ discard ] " );
+                                }
+                                break;
+
                             case NWIPE_PASS_WRITE:
-                                if( !c[i]->sync_status )
+                                if( !progress.sync_status )
                                 {
                                     wprintw( main_window, "[ writing ] " );
                                 }
                                 break;
 
                             case NWIPE_PASS_VERIFY:
-                                if( !c[i]->sync_status )
+                                if( !progress.sync_status )
                                 {
                                     wprintw( main_window, "[verifying] " );
                                 }
@@ -6702,7 +6857,7 @@ void* kwipe_gui_status( void* ptr )
                                 break;
                         }
 
-                        if( c[i]->sync_status )
+                        if( progress.sync_status )
                         {
                             wprintw( main_window, "[ syncing ] " );
                         }
@@ -6732,13 +6887,13 @@ void* kwipe_gui_status( void* ptr )
                     wprintw( main_window, " %s ", spinner_string );
                 }
 
-                if( offset > 0 )
+                if( !log_view && offset > 0 )
                 {
                     mvwprintw( main_window, 1, wcols - 8, " More " );
                     waddch( main_window, ACS_UARROW );
                 }
 
-                if( count - offset > slots )
+                if( !log_view && count - offset > slots )
                 {
                     mvwprintw( main_window, wlines - 2, wcols - 8, " More " );
                     waddch( main_window, ACS_DARROW );
@@ -6817,6 +6972,10 @@ void* kwipe_gui_status( void* ptr )
                            "  %llu",
                            kwipe_misc_thread_data->errors );
 
+                /* Print the latency of the slowest drive, that is the one with the highest p99 for the
+                 * operation it is currently doing, as p50/p99/max. */
+                kwipe_gui_latency( c, count );
+
                 /* Add a border. */
                 box( stats_window, 0, 0 );
 
@@ -6836,11 +6995,103 @@ void* kwipe_gui_status( void* ptr )
     } /* End of while loop */
 
     kwipe_gui_title( footer_window, finish_message );
-    terminate_signal = 1;
+    kwipe_request_terminate();
 
     return NULL;
 } /* kwipe_gui_status */
 
+void kwipe_gui_latency( kwipe_context_t** c, int count )
+{
+    kwipe_latency_t* h;
+    kwipe_latency_t* slowest = NULL;
+    char* slowest_name = NULL;
+    char latency_txt[NWIPE_LATENCY_TXT_LENGTH * 3];
+    u64 slowest_p99 = 0;
+    u64 p99;
+    int i;
+
+    for( i = 0; i < count; i++ )
+    {
+        if( c[i]->wipe_status != 1 )
+        {
+            continue;
+        }
+
+        if( c[i]->pass_type == NWIPE_PASS_VERIFY )
+        {
+            h = &c[i]->latency[NWIPE_LATENCY_READ];
+        }
+        else
+        {
+            h = &c[i]->latency[NWIPE_LATENCY_WRITE];
+        }
+
+        p99 = kwipe_latency_percentile( h, 99 );
+        if( slowest == NULL || p99 > slowest_p99 )
+        {
+            slowest = h;
+            slowest_p99 = p99;
+            slowest_name = c[i]->device_name_without_path;
+        }
+    }
+
+    mvwprintw( stats_window, NWIPE_GUI_STATS_LATENCY_Y, NWIPE_GUI_STATS_LATENCY_X, "Latency p99:" );
+    wmove( stats_window, NWIPE_GUI_STATS_LATENCY_Y, NWIPE_GUI_STATS_TAB );
+    wclrtoeol( stats_window );
+
+    if( slowest != NULL && slowest->count )
+    {
+        kwipe_latency_summary_text( slowest, latency_txt, sizeof( latency_txt ) );
+        mvwprintw( stats_window, NWIPE_GUI_STATS_LATENCY_Y, NWIPE_GUI_STATS_TAB, "%s %s", latency_txt, slowest_name );
+    }
+}
+
+void kwipe_gui_log( u64* top, int follow )
+{
+    char line[MAX_LOG_LINE_CHARS];
+    u64 count;
+    int wlines;
+    int wcols;
+    int rows;
+    int y;
+
+    getmaxyx( main_window, wlines, wcols );
+
+    /* Less two lines for the box, and two columns either side for the box and padding */
+    rows = wlines - 2;
+    if( rows < 1 || wcols < 12 )
+    {
+        return;
+    }
+
+    count = kwipe_log_line_count();
+    if( follow || *top + rows > count )
+    {
+        *top = count > (u64) rows ? count - rows : 0;
+    }
+
+    for( y = 0; y < rows && *top + y < count; y++ )
+    {
+        if( kwipe_log_get_line( *top + y, line, sizeof( line ) ) != 0 )
+        {
+            snprintf( line, sizeof( line ), "[log line %llu is no longer available]", *top + y );
+        }
+        mvwprintw( main_window, y + 1, 2, "%.*s", wcols - 4, line );
+    }
+
+    if( *top > 0 )
+    {
+        mvwprintw( main_window, 1, wcols - 8, " More " );
+        waddch( main_window, ACS_UARROW );
+    }
+
+    if( *top + rows < count )
+    {
+        mvwprintw( main_window, wlines - 2, wcols - 8, " More " );
+        waddch( main_window, ACS_DARROW );
+    }
+}
+
 int compute_stats( void* ptr )
 {
     kwipe_thread_data_ptr_t* kwipe_thread_data_ptr;
@@ -6856,7 +7107,9 @@ int compute_stats( void* ptr )
     int kwipe_active = 0;
     int i;
 
-    time_t kwipe_time_now = time( NULL );
+    kwipe_progress_t progress;
+
+    u64 kwipe_time_now = kwipe_time_ns();
 
     kwipe_misc_thread_data->throughput = 0;
     kwipe_misc_thread_data->maxeta = 0;
@@ -6865,101 +7118,44 @@ int compute_stats( void* ptr )
     /* Enumerate all contexts to compute statistics. */
     for( i = 0; i < count; i++ )
     {
+        /* Even if the wipe has finished ALWAYS sample it one last time so the final throughput is correct. */
+        kwipe_stats_update( c[i], kwipe_time_now );
+
         /* Check whether the child process is still running the wipe. */
         if( c[i]->wipe_status == 1 )
         {
             /* Increment the child counter. */
             kwipe_active += 1;
 
-            /* Even if the wipe has finished ALWAYS run the stats one last time so the final SUCCESS percentage value is
-             * correct. Maintain a rolling average of throughput. */
-            kwipe_update_speedring( &c[i]->speedring, c[i]->round_done, kwipe_time_now );
-
-            if( c[i]->speedring.timestotal > 0 && c[i]->wipe_status == 1 )
+            if( (time_t) c[i]->eta > kwipe_misc_thread_data->maxeta )
             {
-                /* Update the current average throughput in bytes-per-second. */
-                c[i]->throughput = c[i]->speedring.bytestotal / c[i]->speedring.timestotal;
-
-                /* Only update the estimated remaining runtime if the
-                 * throughput for a given drive is greater than 100,000 bytes per second
-                 * This prevents enormous ETA's being calculated on an unresponsive
-                 * drive */
-                if( c[i]->throughput > 100000 )
-                {
-                    c[i]->eta = ( c[i]->round_size - c[i]->round_done ) / c[i]->throughput;
-
-                    if( c[i]->eta > kwipe_misc_thread_data->maxeta )
-                    {
-                        kwipe_misc_thread_data->maxeta = c[i]->eta;
-                    }
-                }
+                kwipe_misc_thread_data->maxeta = c[i]->eta;
             }
 
-            /* Calculate the average throughput */
-            c[i]->throughput = (double) c[i]->round_done / (double) difftime( kwipe_time_now, c[i]->start_time );
-        }
-
-        /* Update the percentage value. */
-        c[i]->round_percent = (double) c[i]->round_done / (double) c[i]->round_size * 100;
-
-        if( c[i]->wipe_status == 1 )
-        {
             /* Accumulate combined throughput. */
             kwipe_misc_thread_data->throughput += c[i]->throughput;
         }
+        else if( c[i]->queued )
+        {
+            /* A queued wipe hasn't finished, it just hasn't started yet. */
+            kwipe_active += 1;
+        }
+
+        /* Update the percentage value. */
+        kwipe_progress_snapshot( c[i], &progress );
+        c[i]->round_percent = (double) progress.round_done / (double) c[i]->round_size * 100;
 
         /* Accumulate the error count. */
         kwipe_misc_thread_data->errors += c[i]->pass_errors;
         kwipe_misc_thread_data->errors += c[i]->verify_errors;
         kwipe_misc_thread_data->errors += c[i]->fsyncdata_errors;
 
-        /* Read the drive temperature values */
-        //        if( kwipe_time_now > ( c[i]->temp1_time + 60 ) )
-        //        {
-        //            kwipe_update_temperature( c[i] );
-        //        }
-
     } /* for statistics */
 
-    return kwipe_active;
-}
-
-void kwipe_update_speedring( kwipe_speedring_t* speedring, u64 speedring_bytes, time_t speedring_now )
-{
-
-    if( speedring->timeslast == 0 )
-    {
-        /* Ignore the first sample and initialize. */
-        speedring->timeslast = speedring_now;
-        return;
-    }
+    /* Add up the throughput of each controller */
+    kwipe_sched_sample();
 
-    if( speedring_now - speedring->timeslast < NWIPE_KNOB_SPEEDRING_GRANULARITY )
-    {
-        /* Avoid jitter caused by frequent updates. */
-        return;
-    }
-
-    /* Subtract the oldest speed sample from the accumulator. */
-    speedring->bytestotal -= speedring->bytes[speedring->position];
-    speedring->timestotal -= speedring->times[speedring->position];
-
-    /* Put the latest bytes-per-second sample into the ring buffer. */
-    speedring->bytes[speedring->position] = speedring_bytes - speedring->byteslast;
-    speedring->times[speedring->position] = speedring_now - speedring->timeslast;
-
-    /* Add the newest speed sample to the accumulator. */
-    speedring->bytestotal += speedring->bytes[speedring->position];
-    speedring->timestotal += speedring->times[speedring->position];
-
-    /* Remember the last sample. */
-    speedring->byteslast = speedring_bytes;
-    speedring->timeslast = speedring_now;
-
-    if( ++speedring->position >= NWIPE_KNOB_SPEEDRING_SIZE )
-    {
-        speedring->position = 0;
-    }
+    return kwipe_active;
 }
 
 int spinner( kwipe_context_t** ptr, int device_idx )
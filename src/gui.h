@@ -118,8 +118,22 @@ void temp1_flash( kwipe_context_t* );  // toggles term1_flash_status, which flas
  */
 void wprintw_temperature( kwipe_context_t* );
 
+/**
+ * Prints the p50/p99/max latency of the slowest drive in the stats window.
+ * @param pointer to the array of drive contexts being wiped
+ * @param the number of contexts
+ */
+void kwipe_gui_latency( kwipe_context_t**, int );
+
+/**
+ * Shows the log in the main window instead of the drives, L in the status screen. Lines that are
+ * no longer held in memory are paged back from disk with kwipe_log_get_line().
+ * @param top the first line shown, updated to keep the window within the log
+ * @param follow if set, shows the latest lines and moves top with them
+ */
+void kwipe_gui_log( u64* top, int follow );
+
 int compute_stats( void* ptr );
-void kwipe_update_speedring( kwipe_speedring_t* speedring, u64 speedring_done, time_t speedring_now );
 
 #define NOMENCLATURE_RESULT_STR_SIZE 8
 
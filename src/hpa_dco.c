@@ -59,13 +59,9 @@ int hpa_dco_status( kwipe_context_t* ptr )
     int dco_line_found;
 
     FILE* fp;
-    char path_hdparm_cmd1_get_hpa[] = "hdparm --verbose -N";
-    char path_hdparm_cmd2_get_hpa[] = "/sbin/hdparm --verbose -N";
-    char path_hdparm_cmd3_get_hpa[] = "/usr/bin/hdparm --verbose -N";
-
-    char path_hdparm_cmd4_get_dco[] = "hdparm --verbose --dco-identify";
-    char path_hdparm_cmd5_get_dco[] = "/sbin/hdparm --verbose --dco-identify";
-    char path_hdparm_cmd6_get_dco[] = "/usr/bin/hdparm --verbose --dco-identify";
+    const char* path_hdparm;
+    char hdparm_get_hpa[] = "--verbose -N";
+    char hdparm_get_dco[] = "--verbose --dco-identify";
 
     char pipe_std_err[] = "2>&1";
 
@@ -75,11 +71,9 @@ int hpa_dco_status( kwipe_context_t* ptr )
 
     char* p;
 
-    /* Use the longest of the 'path_hdparm_cmd.....' strings above to
-     *determine size in the strings below
-     */
-    char hdparm_cmd_get_hpa[sizeof( path_hdparm_cmd3_get_hpa ) + sizeof( c->device_name ) + sizeof( pipe_std_err )];
-    char hdparm_cmd_get_dco[sizeof( path_hdparm_cmd6_get_dco ) + sizeof( c->device_name ) + sizeof( pipe_std_err )];
+    /* The path to hdparm, its arguments, the device name and the redirection */
+    char hdparm_cmd_get_hpa[NWIPE_COMMAND_PATH_LENGTH + sizeof( hdparm_get_hpa ) + sizeof( pipe_std_err ) + 256];
+    char hdparm_cmd_get_dco[NWIPE_COMMAND_PATH_LENGTH + sizeof( hdparm_get_dco ) + sizeof( pipe_std_err ) + 256];
 
     /* Initialise return value */
     set_return_value = 0;
@@ -90,67 +84,30 @@ int hpa_dco_status( kwipe_context_t* ptr )
      * get on some distros. -> debian SID
      */
 
-    if( system( "which hdparm > /dev/null 2>&1" ) )
+    if( ( path_hdparm = kwipe_find_command( "hdparm" ) ) == NULL )
     {
-        if( system( "which /sbin/hdparm > /dev/null 2>&1" ) )
-        {
-            if( system( "which /usr/bin/hdparm > /dev/null 2>&1" ) )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "hdparm command not found." );
-                kwipe_log( NWIPE_LOG_WARNING,
-                           "Required by kwipe for HPA/DCO detection & correction and ATA secure erase." );
-                kwipe_log( NWIPE_LOG_WARNING, "** Please install hdparm **\n" );
-                cleanup();
-                exit( 1 );
-            }
-            else
-            {
-                snprintf( hdparm_cmd_get_hpa,
-                          sizeof( hdparm_cmd_get_hpa ),
-                          "%s %s %s\n",
-                          path_hdparm_cmd3_get_hpa,
-                          c->device_name,
-                          pipe_std_err );
-                snprintf( hdparm_cmd_get_dco,
-                          sizeof( hdparm_cmd_get_dco ),
-                          "%s %s %s\n",
-                          path_hdparm_cmd6_get_dco,
-                          c->device_name,
-                          pipe_std_err );
-            }
-        }
-        else
-        {
-            snprintf( hdparm_cmd_get_hpa,
-                      sizeof( hdparm_cmd_get_hpa ),
-                      "%s %s %s\n",
-                      path_hdparm_cmd2_get_hpa,
-                      c->device_name,
-                      pipe_std_err );
-            snprintf( hdparm_cmd_get_dco,
-                      sizeof( hdparm_cmd_get_dco ),
-                      "%s %s %s\n",
-                      path_hdparm_cmd5_get_dco,
-                      c->device_name,
-                      pipe_std_err );
-        }
-    }
-    else
-    {
-        snprintf( hdparm_cmd_get_hpa,
-                  sizeof( hdparm_cmd_get_hpa ),
-                  "%s %s %s\n",
-                  path_hdparm_cmd1_get_hpa,
-                  c->device_name,
-                  pipe_std_err );
-        snprintf( hdparm_cmd_get_dco,
-                  sizeof( hdparm_cmd_get_dco ),
-                  "%s %s %s\n",
-                  path_hdparm_cmd4_get_dco,
-                  c->device_name,
-                  pipe_std_err );
+        kwipe_log( NWIPE_LOG_WARNING, "hdparm command not found." );
+        kwipe_log( NWIPE_LOG_WARNING, "Required by kwipe for HPA/DCO detection & correction and ATA secure erase." );
+        kwipe_log( NWIPE_LOG_WARNING, "** Please install hdparm **\n" );
+        cleanup();
+        exit( 1 );
     }
 
+    snprintf( hdparm_cmd_get_hpa,
+              sizeof( hdparm_cmd_get_hpa ),
+              "%s %s %s %s\n",
+              path_hdparm,
+              hdparm_get_hpa,
+              c->device_name,
+              pipe_std_err );
+    snprintf( hdparm_cmd_get_dco,
+              sizeof( hdparm_cmd_get_dco ),
+              "%s %s %s %s\n",
+              path_hdparm,
+              hdparm_get_dco,
+              c->device_name,
+              pipe_std_err );
+
     /* Initialise the results buffer, so we don't some how inadvertently process a past result */
     memset( result, 0, sizeof( result ) );
 
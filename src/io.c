@@ -0,0 +1,635 @@
+/*
+ *  io.c: The I/O backends of the wipe passes.
+ *
+ *  The passes read, write, seek and sync a drive through the backend in its context, c->io,
+ *  chosen with --io. The device backend makes the system calls on the device. The null and
+ *  mem backends leave the device alone so the cost of the engine itself, the PRNGs, pattern
+ *  generation, verification and progress accounting, can be measured without a drive's
+ *  throughput hiding it. The drives are still opened, they give each wipe its size and block
+ *  size, so a sparse file created with truncate serves as well as a disk.
+ *
+ *  With --io-faults the calls go through the fault backend first. It fails reads and writes
+ *  with EIO or cuts them short at random or where they meet a bad LBA range, delays calls and
+ *  fails syncs, so the error handling of the passes can be tested and timed without failing
+ *  media. The faults are logged when the drive is closed, to compare with the errors counted.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "io.h"
+
+kwipe_io_faults_t kwipe_io_faults;
+
+static const kwipe_io_backend_t* kwipe_io_backends[] = { &kwipe_io_device, &kwipe_io_null, &kwipe_io_mem };
+
+const kwipe_io_backend_t* kwipe_io_find( const char* label )
+{
+    size_t i;
+
+    for( i = 0; i < sizeof( kwipe_io_backends ) / sizeof( kwipe_io_backends[0] ); i++ )
+    {
+        if( strcmp( kwipe_io_backends[i]->label, label ) == 0 )
+        {
+            return kwipe_io_backends[i];
+        }
+    }
+
+    return NULL;
+}
+
+int kwipe_io_open( kwipe_context_t* c )
+{
+    c->io = kwipe_options.io;
+    c->io_offset = 0;
+    c->io_mem = NULL;
+
+    if( kwipe_options.io_faults != NULL )
+    {
+        c->io_lower = c->io;
+        c->io = &kwipe_io_fault;
+    }
+
+    if( c->io->open( c ) != 0 )
+    {
+        return -1;
+    }
+
+    if( kwipe_options.io != &kwipe_io_device )
+    {
+        kwipe_log( NWIPE_LOG_WARNING,
+                   "%s is wiped with the %s I/O backend, the drive isn't written",
+                   c->device_name,
+                   kwipe_options.io->label );
+    }
+
+    return 0;
+}
+
+void kwipe_io_close( kwipe_context_t* c )
+{
+    if( c->io != NULL )
+    {
+        c->io->close( c );
+    }
+}
+
+/*
+ * The device backend.
+ */
+
+static int kwipe_io_device_open( kwipe_context_t* c )
+{
+    (void) c;
+    return 0;
+}
+
+static void kwipe_io_device_close( kwipe_context_t* c )
+{
+    (void) c;
+}
+
+static ssize_t kwipe_io_device_read( kwipe_context_t* c, void* buffer, size_t count )
+{
+    return read( c->device_fd, buffer, count );
+}
+
+static ssize_t kwipe_io_device_write( kwipe_context_t* c, const void* buffer, size_t count )
+{
+    return write( c->device_fd, buffer, count );
+}
+
+static off64_t kwipe_io_device_lseek( kwipe_context_t* c, off64_t offset, int whence )
+{
+    return lseek( c->device_fd, offset, whence );
+}
+
+static int kwipe_io_device_fdatasync( kwipe_context_t* c )
+{
+    return fdatasync( c->device_fd );
+}
+
+static int kwipe_io_device_sync_file_range( kwipe_context_t* c, u64 offset, u64 length, unsigned int flags )
+{
+    return sync_file_range( c->device_fd, (off64_t) offset, (off64_t) length, flags );
+}
+
+const kwipe_io_backend_t kwipe_io_device = { "device",
+                                             kwipe_io_device_open,
+                                             kwipe_io_device_close,
+                                             kwipe_io_device_read,
+                                             kwipe_io_device_write,
+                                             kwipe_io_device_lseek,
+                                             kwipe_io_device_fdatasync,
+                                             kwipe_io_device_sync_file_range };
+
+/*
+ * The null and mem backends keep their own file offset, in c->io_offset, and end where the device ends.
+ */
+
+static off64_t kwipe_io_virtual_lseek( kwipe_context_t* c, off64_t offset, int whence )
+{
+    off64_t base;
+
+    switch( whence )
+    {
+        case SEEK_SET:
+            base = 0;
+            break;
+
+        case SEEK_CUR:
+            base = (off64_t) c->io_offset;
+            break;
+
+        case SEEK_END:
+            base = (off64_t) c->device_size;
+            break;
+
+        default:
+            errno = EINVAL;
+            return (off64_t) -1;
+    }
+
+    if( base + offset < 0 )
+    {
+        errno = EINVAL;
+        return (off64_t) -1;
+    }
+
+    c->io_offset = (u64) ( base + offset );
+    return (off64_t) c->io_offset;
+}
+
+/* The number of bytes a read or write of count bytes at the current offset transfers, as a device would */
+static size_t kwipe_io_virtual_extent( kwipe_context_t* c, size_t count )
+{
+    if( c->io_offset >= c->device_size )
+    {
+        return 0;
+    }
+
+    if( count > c->device_size - c->io_offset )
+    {
+        return c->device_size - c->io_offset;
+    }
+
+    return count;
+}
+
+static int kwipe_io_virtual_fdatasync( kwipe_context_t* c )
+{
+    (void) c;
+    return 0;
+}
+
+static int kwipe_io_virtual_sync_file_range( kwipe_context_t* c, u64 offset, u64 length, unsigned int flags )
+{
+    (void) c;
+    (void) offset;
+    (void) length;
+    (void) flags;
+    return 0;
+}
+
+/*
+ * The null backend.
+ */
+
+static ssize_t kwipe_io_null_read( kwipe_context_t* c, void* buffer, size_t count )
+{
+    count = kwipe_io_virtual_extent( c, count );
+
+    /* Like a freshly discarded drive, so a zero pass verifies and any other pattern doesn't */
+    memset( buffer, 0, count );
+    c->io_offset += count;
+
+    return (ssize_t) count;
+}
+
+static ssize_t kwipe_io_null_write( kwipe_context_t* c, const void* buffer, size_t count )
+{
+    (void) buffer;
+
+    if( c->io_offset >= c->device_size && count > 0 )
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    count = kwipe_io_virtual_extent( c, count );
+    c->io_offset += count;
+
+    return (ssize_t) count;
+}
+
+const kwipe_io_backend_t kwipe_io_null = { "null",
+                                           kwipe_io_device_open,
+                                           kwipe_io_device_close,
+                                           kwipe_io_null_read,
+                                           kwipe_io_null_write,
+                                           kwipe_io_virtual_lseek,
+                                           kwipe_io_virtual_fdatasync,
+                                           kwipe_io_virtual_sync_file_range };
+
+/*
+ * The mem backend. The copy of the device is an anonymous mapping without swap reserved for it,
+ * so only the pages written take memory and the rest read as zeros.
+ */
+
+static int kwipe_io_mem_open( kwipe_context_t* c )
+{
+    void* mem;
+
+    mem = mmap( NULL, c->device_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+    if( mem == MAP_FAILED )
+    {
+        kwipe_perror( errno, __FUNCTION__, "mmap" );
+        kwipe_log( NWIPE_LOG_ERROR, "Unable to map %llu bytes of memory for '%s'.", c->device_size, c->device_name );
+        return -1;
+    }
+
+    c->io_mem = mem;
+    return 0;
+}
+
+static void kwipe_io_mem_close( kwipe_context_t* c )
+{
+    if( c->io_mem != NULL )
+    {
+        munmap( c->io_mem, c->device_size );
+        c->io_mem = NULL;
+    }
+}
+
+static ssize_t kwipe_io_mem_read( kwipe_context_t* c, void* buffer, size_t count )
+{
+    count = kwipe_io_virtual_extent( c, count );
+
+    memcpy( buffer, c->io_mem + c->io_offset, count );
+    c->io_offset += count;
+
+    return (ssize_t) count;
+}
+
+static ssize_t kwipe_io_mem_write( kwipe_context_t* c, const void* buffer, size_t count )
+{
+    if( c->io_offset >= c->device_size && count > 0 )
+    {
+        errno = ENOSPC;
+        return -1;
+    }
+
+    count = kwipe_io_virtual_extent( c, count );
+
+    memcpy( c->io_mem + c->io_offset, buffer, count );
+    c->io_offset += count;
+
+    return (ssize_t) count;
+}
+
+const kwipe_io_backend_t kwipe_io_mem = { "mem",
+                                          kwipe_io_mem_open,
+                                          kwipe_io_mem_close,
+                                          kwipe_io_mem_read,
+                                          kwipe_io_mem_write,
+                                          kwipe_io_virtual_lseek,
+                                          kwipe_io_virtual_fdatasync,
+                                          kwipe_io_virtual_sync_file_range };
+
+/*
+ * The fault backend. Each drive has its own random numbers, seeded from --io-faults seed= and
+ * its name, so a run with the same seed fails the same calls in the same way.
+ */
+
+static u64 kwipe_io_fault_random( kwipe_context_t* c )
+{
+    /* splitmix64 */
+    u64 z = ( c->io_fault_state += 0x9E3779B97F4A7C15ULL );
+
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+static int kwipe_io_fault_chance( kwipe_context_t* c, double probability )
+{
+    if( probability <= 0 )
+    {
+        return 0;
+    }
+
+    /* The top 53 bits as a double in [0, 1) */
+    return (double) ( kwipe_io_fault_random( c ) >> 11 ) / 9007199254740992.0 < probability;
+}
+
+static void kwipe_io_fault_delay( kwipe_context_t* c )
+{
+    struct timespec ts;
+
+    if( kwipe_io_faults.delay_ms == 0 || !kwipe_io_fault_chance( c, kwipe_io_faults.spike ) )
+    {
+        return;
+    }
+
+    ts.tv_sec = kwipe_io_faults.delay_ms / 1000;
+    ts.tv_nsec = ( kwipe_io_faults.delay_ms % 1000 ) * 1000000L;
+    nanosleep( &ts, NULL );
+
+    c->io_fault_spikes++;
+}
+
+/* Decides the fate of a read or write of count bytes at the current offset. Returns -1 with errno
+ * set if it fails, otherwise 0 with count reduced to the number of bytes to transfer. */
+static int kwipe_io_fault_transfer( kwipe_context_t* c, size_t* count )
+{
+    off64_t offset;
+    u64 first;
+    u64 end;
+    int i;
+
+    kwipe_io_fault_delay( c );
+
+    if( kwipe_io_fault_chance( c, kwipe_io_faults.eio ) )
+    {
+        c->io_fault_eio++;
+        errno = EIO;
+        return -1;
+    }
+
+    if( kwipe_io_faults.bad_count > 0 && *count > 0 )
+    {
+        offset = c->io_lower->lseek( c, 0, SEEK_CUR );
+        if( offset == (off64_t) -1 )
+        {
+            return -1;
+        }
+
+        for( i = 0; i < kwipe_io_faults.bad_count; i++ )
+        {
+            first = kwipe_io_faults.bad_first[i] * 512;
+            end = ( kwipe_io_faults.bad_last[i] + 1 ) * 512;
+
+            if( (u64) offset >= end || (u64) offset + *count <= first )
+            {
+                continue;
+            }
+
+            if( (u64) offset >= first )
+            {
+                c->io_fault_eio++;
+                errno = EIO;
+                return -1;
+            }
+
+            /* Like a drive, transfer the blocks before the bad one */
+            *count = first - (u64) offset;
+            c->io_fault_partial++;
+            return 0;
+        }
+    }
+
+    if( *count > 1 && kwipe_io_fault_chance( c, kwipe_io_faults.partial ) )
+    {
+        *count /= 2;
+        c->io_fault_partial++;
+    }
+
+    return 0;
+}
+
+static int kwipe_io_fault_open( kwipe_context_t* c )
+{
+    const char* p;
+
+    /* FNV-1a of the device name, so each drive fails differently */
+    c->io_fault_state = 0xCBF29CE484222325ULL;
+    for( p = c->device_name; *p != 0; p++ )
+    {
+        c->io_fault_state = ( c->io_fault_state ^ (unsigned char) *p ) * 0x100000001B3ULL;
+    }
+    c->io_fault_state ^= kwipe_io_faults.seed;
+
+    c->io_fault_eio = 0;
+    c->io_fault_partial = 0;
+    c->io_fault_spikes = 0;
+    c->io_fault_sync = 0;
+
+    kwipe_log( NWIPE_LOG_WARNING, "Injecting faults into the I/O of %s: %s", c->device_name, kwipe_options.io_faults );
+
+    return c->io_lower->open( c );
+}
+
+static void kwipe_io_fault_close( kwipe_context_t* c )
+{
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "Faults injected on %s: %llu EIO, %llu partial transfers, %llu delays, %llu failed syncs",
+               c->device_name,
+               c->io_fault_eio,
+               c->io_fault_partial,
+               c->io_fault_spikes,
+               c->io_fault_sync );
+
+    c->io_lower->close( c );
+}
+
+static ssize_t kwipe_io_fault_read( kwipe_context_t* c, void* buffer, size_t count )
+{
+    if( kwipe_io_fault_transfer( c, &count ) != 0 )
+    {
+        return -1;
+    }
+
+    return c->io_lower->read( c, buffer, count );
+}
+
+static ssize_t kwipe_io_fault_write( kwipe_context_t* c, const void* buffer, size_t count )
+{
+    if( kwipe_io_fault_transfer( c, &count ) != 0 )
+    {
+        return -1;
+    }
+
+    return c->io_lower->write( c, buffer, count );
+}
+
+static off64_t kwipe_io_fault_lseek( kwipe_context_t* c, off64_t offset, int whence )
+{
+    return c->io_lower->lseek( c, offset, whence );
+}
+
+static int kwipe_io_fault_fdatasync( kwipe_context_t* c )
+{
+    kwipe_io_fault_delay( c );
+
+    if( kwipe_io_fault_chance( c, kwipe_io_faults.sync ) )
+    {
+        c->io_fault_sync++;
+        errno = EIO;
+        return -1;
+    }
+
+    return c->io_lower->fdatasync( c );
+}
+
+static int kwipe_io_fault_sync_file_range( kwipe_context_t* c, u64 offset, u64 length, unsigned int flags )
+{
+    kwipe_io_fault_delay( c );
+
+    if( kwipe_io_fault_chance( c, kwipe_io_faults.sync ) )
+    {
+        c->io_fault_sync++;
+        errno = EIO;
+        return -1;
+    }
+
+    return c->io_lower->sync_file_range( c, offset, length, flags );
+}
+
+const kwipe_io_backend_t kwipe_io_fault = { "fault",
+                                            kwipe_io_fault_open,
+                                            kwipe_io_fault_close,
+                                            kwipe_io_fault_read,
+                                            kwipe_io_fault_write,
+                                            kwipe_io_fault_lseek,
+                                            kwipe_io_fault_fdatasync,
+                                            kwipe_io_fault_sync_file_range };
+
+static int kwipe_io_faults_probability( const char* name, const char* value, double* probability )
+{
+    char* end;
+
+    *probability = strtod( value, &end );
+    if( end == value || *end != 0 || !( *probability >= 0 && *probability <= 1 ) )
+    {
+        fprintf( stderr, "Error: The io-faults %s probability must be between 0 and 1.\n", name );
+        return -1;
+    }
+
+    return 0;
+}
+
+int kwipe_io_faults_parse( const char* spec, kwipe_io_faults_t* faults )
+{
+    char* copy;
+    char* item;
+    char* save;
+    char* value;
+    char* end;
+    int r = 0;
+
+    memset( faults, 0, sizeof( kwipe_io_faults_t ) );
+    faults->delay_ms = 100;
+
+    copy = strdup( spec );
+    if( copy == NULL )
+    {
+        fprintf( stderr, "Error: Unable to allocate memory for the io-faults argument.\n" );
+        return -1;
+    }
+
+    for( item = strtok_r( copy, ",", &save ); item != NULL && r == 0; item = strtok_r( NULL, ",", &save ) )
+    {
+        value = strchr( item, '=' );
+        if( value == NULL )
+        {
+            fprintf( stderr, "Error: '%s' in the io-faults argument has no value.\n", item );
+            r = -1;
+            break;
+        }
+        *value++ = 0;
+
+        if( strcmp( item, "eio" ) == 0 )
+        {
+            r = kwipe_io_faults_probability( item, value, &faults->eio );
+        }
+        else if( strcmp( item, "partial" ) == 0 )
+        {
+            r = kwipe_io_faults_probability( item, value, &faults->partial );
+        }
+        else if( strcmp( item, "spike" ) == 0 )
+        {
+            r = kwipe_io_faults_probability( item, value, &faults->spike );
+        }
+        else if( strcmp( item, "sync" ) == 0 )
+        {
+            r = kwipe_io_faults_probability( item, value, &faults->sync );
+        }
+        else if( strcmp( item, "delay" ) == 0 )
+        {
+            faults->delay_ms = (unsigned int) strtoul( value, &end, 10 );
+            if( end == value || *end != 0 )
+            {
+                fprintf( stderr, "Error: The io-faults delay must be a number of milliseconds.\n" );
+                r = -1;
+            }
+        }
+        else if( strcmp( item, "seed" ) == 0 )
+        {
+            faults->seed = strtoull( value, &end, 0 );
+            if( end == value || *end != 0 )
+            {
+                fprintf( stderr, "Error: The io-faults seed must be a number.\n" );
+                r = -1;
+            }
+        }
+        else if( strcmp( item, "bad" ) == 0 )
+        {
+            if( faults->bad_count == NWIPE_IO_FAULT_MAX_BAD )
+            {
+                fprintf( stderr, "Error: At most %i bad ranges can be given to io-faults.\n", NWIPE_IO_FAULT_MAX_BAD );
+                r = -1;
+                break;
+            }
+
+            faults->bad_first[faults->bad_count] = strtoull( value, &end, 0 );
+            faults->bad_last[faults->bad_count] = faults->bad_first[faults->bad_count];
+            if( end != value && *end == '-' )
+            {
+                value = end + 1;
+                faults->bad_last[faults->bad_count] = strtoull( value, &end, 0 );
+            }
+
+            if( end == value || *end != 0
+                || faults->bad_last[faults->bad_count] < faults->bad_first[faults->bad_count] )
+            {
+                fprintf( stderr, "Error: The io-faults bad range must be LBA or FIRST-LAST.\n" );
+                r = -1;
+            }
+            faults->bad_count++;
+        }
+        else
+        {
+            fprintf( stderr, "Error: Unknown io-faults fault '%s'.\n", item );
+            r = -1;
+        }
+    }
+
+    free( copy );
+    return r;
+}
@@ -0,0 +1,124 @@
+/*
+ *  io.h: The I/O backends of the wipe passes, the device itself or, to benchmark the engine
+ *  without a drive, a null or in-memory device.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef IO_H_
+#define IO_H_
+
+#include "context.h"
+
+/* The calls the passes make on a drive. Each returns what the system call of the same name would, and sets errno. */
+typedef struct kwipe_io_backend_t_
+{
+    const char* label;  // The name given to --io.
+    int ( *open )( kwipe_context_t* c );  // Called once the device is open and its size is known, 0 or -1.
+    void ( *close )( kwipe_context_t* c );  // Called before the device is closed.
+    ssize_t ( *read )( kwipe_context_t* c, void* buffer, size_t count );
+    ssize_t ( *write )( kwipe_context_t* c, const void* buffer, size_t count );
+    off64_t ( *lseek )( kwipe_context_t* c, off64_t offset, int whence );
+    int ( *fdatasync )( kwipe_context_t* c );
+    int ( *sync_file_range )( kwipe_context_t* c, u64 offset, u64 length, unsigned int flags );
+} kwipe_io_backend_t;
+
+/* Reads and writes the device */
+extern const kwipe_io_backend_t kwipe_io_device;
+
+/* Discards the writes and reads zeros, the cost of the engine alone */
+extern const kwipe_io_backend_t kwipe_io_null;
+
+/* Keeps the writes in memory so the verification passes read them back */
+extern const kwipe_io_backend_t kwipe_io_mem;
+
+/* Injects the faults given to --io-faults into the calls to the backend chosen with --io */
+extern const kwipe_io_backend_t kwipe_io_fault;
+
+/* The most bad LBA ranges --io-faults accepts */
+#define NWIPE_IO_FAULT_MAX_BAD 16
+
+/* The faults to inject, parsed from --io-faults */
+typedef struct
+{
+    double eio;  // The probability that a read or write fails with EIO.
+    double partial;  // The probability that a read or write transfers only half its bytes.
+    double spike;  // The probability that a read, write or sync is delayed.
+    double sync;  // The probability that an fdatasync or sync_file_range fails with EIO.
+    unsigned int delay_ms;  // The length of a delay.
+    u64 seed;  // The seed of the random numbers, the faults on a drive repeat with the same seed.
+    int bad_count;  // The number of bad LBA ranges.
+    u64 bad_first[NWIPE_IO_FAULT_MAX_BAD];  // The first 512 byte LBA of each range.
+    u64 bad_last[NWIPE_IO_FAULT_MAX_BAD];  // The last 512 byte LBA of each range.
+} kwipe_io_faults_t;
+
+/**
+ * Parses the argument of --io-faults, a comma separated list of
+ * eio=P, partial=P, spike=P, delay=MS, sync=P, seed=N and bad=LBA[-LBA]
+ * where P is a probability per call between 0 and 1.
+ * @param spec the argument
+ * @param faults the faults, set to those in spec
+ * @return 0 on success, -1 if spec isn't valid, the reason has been printed to stderr
+ */
+int kwipe_io_faults_parse( const char* spec, kwipe_io_faults_t* faults );
+
+/* The faults parsed from --io-faults, injected when kwipe_options.io_faults is set */
+extern kwipe_io_faults_t kwipe_io_faults;
+
+/**
+ * Finds a backend by its label.
+ * @param label the argument of --io
+ * @return the backend, NULL if there is none by that name
+ */
+const kwipe_io_backend_t* kwipe_io_find( const char* label );
+
+/**
+ * Sets up the backend chosen with --io for a drive, called once its device is open and its size known.
+ * With --io-faults the drive's backend is kwipe_io_fault, over the one chosen with --io.
+ * @return 0 on success, -1 if the backend couldn't be set up, the reason has been logged
+ */
+int kwipe_io_open( kwipe_context_t* c );
+
+/**
+ * Releases what the backend of a drive holds, called before its device is closed.
+ */
+void kwipe_io_close( kwipe_context_t* c );
+
+static inline ssize_t kwipe_io_read( kwipe_context_t* c, void* buffer, size_t count )
+{
+    return c->io->read( c, buffer, count );
+}
+
+static inline ssize_t kwipe_io_write( kwipe_context_t* c, const void* buffer, size_t count )
+{
+    return c->io->write( c, buffer, count );
+}
+
+static inline off64_t kwipe_io_lseek( kwipe_context_t* c, off64_t offset, int whence )
+{
+    return c->io->lseek( c, offset, whence );
+}
+
+static inline int kwipe_io_fdatasync( kwipe_context_t* c )
+{
+    return c->io->fdatasync( c );
+}
+
+static inline int kwipe_io_sync_file_range( kwipe_context_t* c, u64 offset, u64 length, unsigned int flags )
+{
+    return c->io->sync_file_range( c, offset, length, flags );
+}
+
+#endif /* IO_H_ */
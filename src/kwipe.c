@@ -47,6 +47,13 @@
 #include "gui.h"
 #include "temperature.h"
 #include "miscellaneous.h"
+#include "stats.h"
+#include "progress.h"
+#include "event.h"
+#include "scheduler.h"
+#include "numa.h"
+#include "pattern_cache.h"
+#include "shared_stream.h"
 
 #include <sys/ioctl.h> /* FIXME: Twice Included */
 #include <sys/shm.h>
@@ -57,6 +64,10 @@
 #include "conf.h"
 #include "version.h"
 #include "hpa_dco.h"
+#include "profile.h"
+#include "io.h"
+#include "metrics.h"
+#include "progress_json.h"
 #include "conf.h"
 #include <libconfig.h>
 
@@ -86,16 +97,19 @@ int main( int argc, char** argv )
     int kwipe_error = 0;  // An error counter.
     int kwipe_selected = 0;  // The number of contexts that have been selected.
     int any_threads_still_running;  // used in wipe thread cancellation wait loop
-    int thread_timeout_counter;  // timeout thread cancellation after THREAD_CANCELLATION_TIMEOUT seconds
+    u64 thread_timeout_ns;  // timeout thread cancellation after THREAD_CANCELLATION_TIMEOUT seconds
+    u64 event_seen;  // The generation of the completion event last seen, see event.h
+    u64 now_ns;  // The monotonic time, see kwipe_time_ns()
     pthread_t kwipe_gui_thread = 0;  // The thread ID of the GUI thread.
     pthread_t kwipe_temperature_thread = 0;  // The thread ID of the temperature update thread
     pthread_t kwipe_sigint_thread;  // The thread ID of the sigint handler.
 
-    char modprobe_command[] = "modprobe %s";
-    char modprobe_command2[] = "/sbin/modprobe %s";
-    char modprobe_command3[] = "/usr/sbin/modprobe %s";
+    const char* path_modprobe;
     char module_shortform[50];
-    char final_cmd_modprobe[sizeof( modprobe_command ) + sizeof( module_shortform )];
+    char final_cmd_modprobe[NWIPE_COMMAND_PATH_LENGTH + sizeof( module_shortform ) + 1];
+
+    u64 startup_ns;  // The time start-up began, see --profile-startup
+    u64 profile_ns;  // The start of the current phase of start-up
 
     /* The entropy source file handle. */
     int kwipe_entropy;
@@ -107,9 +121,16 @@ int main( int argc, char** argv )
     /* The generic result buffer. */
     int r;
 
+    startup_ns = kwipe_profile_init();
+    profile_ns = startup_ns;
+
     /* Initialise the termintaion signal, 1=terminate kwipe */
     terminate_signal = 0;
 
+    /* Initialise the event the wipe threads signal on completion, before any thread is created */
+    kwipe_event_init();
+    kwipe_shared_stream_init();
+
     /* Initialise the user abort signal, 1=User aborted with CNTRL-C,SIGTERM, SIGQUIT, SIGINT etc.. */
     user_abort = 0;
 
@@ -158,27 +179,29 @@ int main( int argc, char** argv )
     /* Log kwipes version */
     kwipe_log( NWIPE_LOG_INFO, "%s", banner );
 
+    /* Logged once the options say whether to */
+    profile_ns = kwipe_profile_phase( profile_ns, "reading kwipe.conf and parsing options" );
+
     /* Log OS info */
     kwipe_log_OSinfo();
 
+    /* Pin main(), and so every thread it creates, to the housekeeping CPU on a NUMA system */
+    kwipe_numa_init();
+
+    profile_ns = kwipe_profile_phase( profile_ns, "OS info and NUMA" );
+
     /* Check that hdparm exists, we use hdparm for some HPA/DCO detection etc, if not
      * exit kwipe. These checks are required if the PATH environment is not setup !
      * Example: Debian sid 'su' as opposed to 'su -'
+     * Not needed when the passes don't touch the drives, see --io.
      */
-    if( system( "which hdparm > /dev/null 2>&1" ) )
+    if( kwipe_options.io == &kwipe_io_device && kwipe_find_command( "hdparm" ) == NULL )
     {
-        if( system( "which /sbin/hdparm > /dev/null 2>&1" ) )
-        {
-            if( system( "which /usr/bin/hdparm > /dev/null 2>&1" ) )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "hdparm command not found." );
-                kwipe_log( NWIPE_LOG_WARNING,
-                           "Required by kwipe for HPA/DCO detection & correction and ATA secure erase." );
-                kwipe_log( NWIPE_LOG_WARNING, "** Please install hdparm **\n" );
-                cleanup();
-                exit( 1 );
-            }
-        }
+        kwipe_log( NWIPE_LOG_WARNING, "hdparm command not found." );
+        kwipe_log( NWIPE_LOG_WARNING, "Required by kwipe for HPA/DCO detection & correction and ATA secure erase." );
+        kwipe_log( NWIPE_LOG_WARNING, "** Please install hdparm **\n" );
+        cleanup();
+        exit( 1 );
     }
 
     /* Check if the given path for PDF reports is a writeable directory */
@@ -232,6 +255,8 @@ int main( int argc, char** argv )
         }
     }
 
+    profile_ns = kwipe_profile_phase( profile_ns, "device scan, %i devices", kwipe_enumerated );
+
     /* sort list of devices here */
     qsort( (void*) c1, (size_t) kwipe_enumerated, sizeof( kwipe_context_t* ), devnamecmp );
 
@@ -244,6 +269,8 @@ int main( int argc, char** argv )
     /* Log the System information */
     kwipe_log_sysinfo();
 
+    profile_ns = kwipe_profile_phase( profile_ns, "system information" );
+
     /* The array of pointers to contexts that will actually be wiped. */
     kwipe_context_t** c2 = (kwipe_context_t**) malloc( kwipe_enumerated * sizeof( kwipe_context_t* ) );
     if( c2 == NULL )
@@ -313,29 +340,15 @@ int main( int argc, char** argv )
     /* Determine whether we can access modprobe, required if the PATH environment is not setup ! (Debian sid 'su' as
      * opposed to 'su -' */
 
-    if( system( "which modprobe > /dev/null 2>&1" ) )
+    if( ( path_modprobe = kwipe_find_command( "modprobe" ) ) == NULL )
     {
-        if( system( "which /sbin/modprobe > /dev/null 2>&1" ) )
-        {
-            if( system( "which /usr/sbin/modprobe > /dev/null 2>&1" ) )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "modprobe command not found. Install kmod package (modprobe)) !" );
-                kwipe_log( NWIPE_LOG_WARNING, "Most temperature monitoring may be unavailable as module drivetemp" );
-                kwipe_log( NWIPE_LOG_WARNING, "could not be loaded. drivetemp is not available on kernels < v5.5" );
-            }
-            else
-            {
-                sprintf( final_cmd_modprobe, modprobe_command3, module_shortform );
-            }
-        }
-        else
-        {
-            sprintf( final_cmd_modprobe, modprobe_command2, module_shortform );
-        }
+        kwipe_log( NWIPE_LOG_WARNING, "modprobe command not found. Install kmod package (modprobe)) !" );
+        kwipe_log( NWIPE_LOG_WARNING, "Most temperature monitoring may be unavailable as module drivetemp" );
+        kwipe_log( NWIPE_LOG_WARNING, "could not be loaded. drivetemp is not available on kernels < v5.5" );
     }
     else
     {
-        sprintf( final_cmd_modprobe, modprobe_command, module_shortform );
+        snprintf( final_cmd_modprobe, sizeof( final_cmd_modprobe ), "%s %s", path_modprobe, module_shortform );
     }
 
     /* load the drivetemp module */
@@ -351,6 +364,8 @@ int main( int argc, char** argv )
         kwipe_log( NWIPE_LOG_NOTICE, "hwmon: Module drivetemp loaded, drive temperatures available" );
     }
 
+    profile_ns = kwipe_profile_phase( profile_ns, "entropy, signals and drivetemp" );
+
     /* A context struct for each device has already been created. */
     /* Now set specific kwipe options */
     for( i = 0; i < kwipe_enumerated; i++ )
@@ -387,6 +402,8 @@ int main( int argc, char** argv )
          */
 
         kwipe_log_drives_temperature_limits( c1[i] );
+
+        profile_ns = kwipe_profile_phase( profile_ns, "%s temperature", c1[i]->device_name );
     }
 
     /* Check for initialization errors. */
@@ -410,6 +427,9 @@ int main( int argc, char** argv )
     if( !kwipe_options.nogui )
         kwipe_gui_init();
 
+    kwipe_profile_phase( profile_ns, "temperature thread and GUI" );
+    kwipe_profile_phase( startup_ns, "total, to the drive selection screen" );
+
     if( kwipe_options.autonuke == 1 )
     {
         /* Print the options window. */
@@ -456,7 +476,7 @@ int main( int argc, char** argv )
         c1[i]->result = 0;
 
         /* Initialise the variable that tracks how much of the drive has been erased */
-        c1[i]->bytes_erased = 0;
+        c1[i]->progress.bytes_erased = 0;
     }
 
     /* Pass the number selected to the struct for other threads */
@@ -496,6 +516,9 @@ int main( int argc, char** argv )
             /* Initialise the wipe_status flag, -1 = wipe not yet started */
             c2[i]->wipe_status = -1;
 
+            /* The passes use the device until kwipe_io_open() has set up the backend */
+            c2[i]->io = &kwipe_io_device;
+
             /* Open the file for reads and writes. */
             c2[i]->device_fd = open( c2[i]->device_name, O_RDWR );
 
@@ -517,8 +540,9 @@ int main( int argc, char** argv )
                 continue;
             }
 
-            /* Check that the file is a block device. */
-            if( !S_ISBLK( c2[i]->device_stat.st_mode ) )
+            /* Check that the file is a block device, or a regular file named on the command line. */
+            if( !S_ISBLK( c2[i]->device_stat.st_mode )
+                && !( c2[i]->device_type == NWIPE_DEVICE_FILE && S_ISREG( c2[i]->device_stat.st_mode ) ) )
             {
                 kwipe_log( NWIPE_LOG_ERROR, "'%s' is not a block device.", c2[i]->device_name );
                 kwipe_error++;
@@ -544,7 +568,16 @@ int main( int argc, char** argv )
 
             /* Do sector size and block size checking. I don't think this does anything useful as logical/Physical
              * sector sizes are obtained by libparted in check.c */
-            if( ioctl( c2[i]->device_fd, BLKSSZGET, &c2[i]->device_sector_size ) == 0 )
+            if( c2[i]->device_type == NWIPE_DEVICE_FILE )
+            {
+                /* A file has no sectors, the sizes were set from its stat in check_file() */
+                if( kwipe_options.preallocate && kwipe_file_preallocate( c2[i] ) != 0 )
+                {
+                    kwipe_error++;
+                    continue;
+                }
+            }
+            else if( ioctl( c2[i]->device_fd, BLKSSZGET, &c2[i]->device_sector_size ) == 0 )
             {
 
                 if( ioctl( c2[i]->device_fd, BLKBSZGET, &c2[i]->device_block_size ) != 0 )
@@ -566,24 +599,27 @@ int main( int argc, char** argv )
             /* Seek to the end of the device to determine its size. */
             c2[i]->device_size = lseek( c2[i]->device_fd, 0, SEEK_END );
 
-            /* Also ask the driver for the device size. */
+            /* Also ask the driver for the device size, a file only has the size lseek() found. */
             /* if( ioctl( c2[i]->device_fd, BLKGETSIZE64, &size64 ) ) */
-            if( ioctl( c2[i]->device_fd, _IOR( 0x12, 114, size_t ), &size64 ) )
+            if( c2[i]->device_type != NWIPE_DEVICE_FILE )
             {
-                /* The ioctl failed. */
-                fprintf( stderr, "Error: BLKGETSIZE64 failed  on '%s'.\n", c2[i]->device_name );
-                kwipe_log( NWIPE_LOG_ERROR, "BLKGETSIZE64 failed  on '%s'.\n", c2[i]->device_name );
-                kwipe_error++;
-            }
-            c2[i]->device_size = size64;
+                if( ioctl( c2[i]->device_fd, _IOR( 0x12, 114, size_t ), &size64 ) )
+                {
+                    /* The ioctl failed. */
+                    fprintf( stderr, "Error: BLKGETSIZE64 failed  on '%s'.\n", c2[i]->device_name );
+                    kwipe_log( NWIPE_LOG_ERROR, "BLKGETSIZE64 failed  on '%s'.\n", c2[i]->device_name );
+                    kwipe_error++;
+                }
+                c2[i]->device_size = size64;
 
-            /* Check whether the two size values agree. */
-            if( c2[i]->device_size != size64 )
-            {
-                /* This could be caused by the linux last-odd-block problem. */
-                fprintf( stderr, "Error: Last-odd-block detected on '%s'.\n", c2[i]->device_name );
-                kwipe_log( NWIPE_LOG_ERROR, "Last-odd-block detected on '%s'.", c2[i]->device_name );
-                kwipe_error++;
+                /* Check whether the two size values agree. */
+                if( c2[i]->device_size != size64 )
+                {
+                    /* This could be caused by the linux last-odd-block problem. */
+                    fprintf( stderr, "Error: Last-odd-block detected on '%s'.\n", c2[i]->device_name );
+                    kwipe_log( NWIPE_LOG_ERROR, "Last-odd-block detected on '%s'.", c2[i]->device_name );
+                    kwipe_error++;
+                }
             }
 
             if( c2[i]->device_size == (long long) -1 )
@@ -627,22 +663,50 @@ int main( int argc, char** argv )
                            c2[i]->device_size );
             }
 
-            /* Fork a child process. */
-            errno = pthread_create( &c2[i]->thread, NULL, kwipe_options.method, (void*) c2[i] );
-            if( errno )
+            /* Set up the I/O backend of the passes, see --io. */
+            if( kwipe_io_open( c2[i] ) != 0 )
             {
-                kwipe_perror( errno, __FUNCTION__, "pthread_create" );
-                if( !kwipe_options.nogui )
-                    kwipe_gui_free();
-                return errno;
+                kwipe_error++;
+                continue;
             }
-            else
+
+            /* Choose the CPUs and memory node for the wipe thread. */
+            kwipe_numa_place( c2[i] );
+
+            /* Queue the wipe, it is started below once its controller has room for it. */
+            if( kwipe_sched_add( c2[i] ) != 0 )
             {
-                wipe_threads_started = 1;
+                kwipe_error++;
             }
         }
     }
 
+    /* Publish the progress of the wipes with --metrics-socket and --metrics-file. */
+    if( kwipe_metrics_start( c2, kwipe_selected ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "metrics: Unable to publish the metrics, continuing without them." );
+    }
+
+    /* Stream the progress of the wipes as JSON lines with --progress-json. */
+    if( kwipe_progress_json_start( c2, kwipe_selected ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "progress-json: Unable to write the progress, continuing without it." );
+    }
+
+    /* Start the wipes, largest drives first, up to --controller-limit per controller. */
+    r = kwipe_sched_start();
+    if( r < 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "pthread_create" );
+        if( !kwipe_options.nogui )
+            kwipe_gui_free();
+        return errno;
+    }
+    else if( r > 0 )
+    {
+        wipe_threads_started = 1;
+    }
+
     /* Change the terminal mode to non-blocking input. */
     nodelay( stdscr, 0 );
 
@@ -651,10 +715,10 @@ int main( int argc, char** argv )
 
     /* Set up data structs to pass the GUI thread the data it needs. */
     kwipe_thread_data_ptr_t kwipe_gui_data;
+    kwipe_gui_data.c = c2;
+    kwipe_gui_data.kwipe_misc_thread_data = &kwipe_misc_thread_data;
     if( !kwipe_options.nogui )
     {
-        kwipe_gui_data.c = c2;
-        kwipe_gui_data.kwipe_misc_thread_data = &kwipe_misc_thread_data;
         /* Fork the GUI thread. */
         errno = pthread_create( &kwipe_gui_thread, NULL, kwipe_gui_status, &kwipe_gui_data );
     }
@@ -664,52 +728,73 @@ int main( int argc, char** argv )
     /* set getch delay to 2/10th second. */
     halfdelay( 10 );
 
-    i = 0;
-    while( i < kwipe_selected && terminate_signal == 0 )
+    /* Each wipe thread signals the event as it returns, as does anything that sets terminate_signal,
+     * so we sleep until something happens rather than polling. Read the generation before checking
+     * so that a wipe finishing in between is not missed. */
+    event_seen = kwipe_event_generation();
+    while( terminate_signal == 0 )
     {
-        if( i == kwipe_selected )
+        /* A wipe may have finished and made room on its controller for a queued one. */
+        if( kwipe_sched_start() < 0 )
         {
+            kwipe_perror( errno, __FUNCTION__, "pthread_create" );
+            kwipe_log( NWIPE_LOG_ERROR, "Unable to start the queued wipes." );
+            kwipe_request_terminate();
             break;
         }
 
-        if( c2[i]->wipe_status != 0 )
+        for( i = 0; i < kwipe_selected; i++ )
+        {
+            if( c2[i]->thread && !kwipe_thread_finished( c2[i] ) )
+            {
+                break;
+            }
+        }
+
+        if( i == kwipe_selected && kwipe_sched_queued() == 0 )
         {
-            i = 0;
+            break;
+        }
+
+        if( kwipe_options.nogui )
+        {
+            /* There is no GUI thread to sample the throughput, so sample it here at the same rate. */
+            compute_stats( &kwipe_gui_data );
+            event_seen = kwipe_event_wait( event_seen, NWIPE_KNOB_STATS_SAMPLE_NS );
         }
         else
         {
-            i++;
-            continue;
+            event_seen = kwipe_event_wait( event_seen, 0 );
         }
-        sleep( 1 ); /* DO NOT REMOVE ! Stops the routine hogging CPU cycles */
     }
 
     if( terminate_signal != 1 )
     {
         if( !kwipe_options.nowait && !kwipe_options.autopoweroff )
         {
-            do
+            /* Wait for the user to acknowledge the completed wipes in the GUI */
+            while( terminate_signal != 1 )
             {
-                sleep( 1 );
-
-            } while( terminate_signal != 1 );
+                event_seen = kwipe_event_wait( event_seen, 0 );
+            }
         }
     }
     if( kwipe_options.verbose )
     {
         kwipe_log( NWIPE_LOG_INFO, "Exit in progress" );
     }
-    /* Send a REQUEST for the wipe threads to be cancelled */
+    /* Send a REQUEST for the wipe threads to be cancelled, they stop at the end of the current block
+     * and flush what has already been written */
     for( i = 0; i < kwipe_selected; i++ )
     {
 
-        if( c2[i]->thread )
+        if( c2[i]->thread && !kwipe_thread_finished( c2[i] ) )
         {
             if( kwipe_options.verbose )
             {
                 kwipe_log( NWIPE_LOG_INFO, "Requesting wipe thread cancellation for %s", c2[i]->device_name );
             }
-            pthread_cancel( c2[i]->thread );
+            kwipe_cancel( c2[i] );
         }
     }
 
@@ -744,75 +829,105 @@ int main( int argc, char** argv )
         kwipe_gui_free();
     }
 
-    /* Now join the wipe threads and wait until they have terminated */
+    /* Wait for the wipe threads to reach the end of their current block and return, but don't wait
+     * longer than THREAD_CANCELLATION_TIMEOUT seconds for a drive that has stopped responding */
+    thread_timeout_ns = kwipe_time_ns() + THREAD_CANCELLATION_TIMEOUT * 1000000000ULL;
+    event_seen = kwipe_event_generation();
     any_threads_still_running = 1;
-    thread_timeout_counter = THREAD_CANCELLATION_TIMEOUT;
     while( any_threads_still_running )
     {
-        /* quit waiting if we've tried 'thread_timeout_counter' times */
-        if( thread_timeout_counter == 0 )
+        any_threads_still_running = 0;
+        for( i = 0; i < kwipe_selected; i++ )
+        {
+            if( c2[i]->thread && !kwipe_thread_finished( c2[i] ) )
+            {
+                any_threads_still_running = 1;
+            }
+        }
+
+        now_ns = kwipe_time_ns();
+        if( any_threads_still_running == 0 || now_ns >= thread_timeout_ns )
         {
             break;
         }
+        event_seen = kwipe_event_wait( event_seen, thread_timeout_ns - now_ns );
+    }
 
-        any_threads_still_running = 0;
-        for( i = 0; i < kwipe_selected; i++ )
+    /* Now join the wipe threads that have terminated */
+    for( i = 0; i < kwipe_selected; i++ )
+    {
+        if( c2[i]->thread && !kwipe_thread_finished( c2[i] ) )
         {
-            if( c2[i]->thread )
+            kwipe_log( NWIPE_LOG_ERROR,
+                       "Wipe thread for %s did not respond to cancellation within %i seconds.",
+                       c2[i]->device_name,
+                       THREAD_CANCELLATION_TIMEOUT );
+            continue;
+        }
+
+        if( c2[i]->thread )
+        {
+            printf( "\nWaiting for wipe thread to cancel for %s\n", c2[i]->device_name );
+
+            /* Joins the thread and waits for completion before continuing */
+            r = pthread_join( c2[i]->thread, NULL );
+            if( r != 0 )
             {
-                printf( "\nWaiting for wipe thread to cancel for %s\n", c2[i]->device_name );
+                kwipe_log( NWIPE_LOG_ERROR,
+                           "Error joining the wipe thread when waiting for thread to cancel.",
+                           c2[i]->device_name );
 
-                /* Joins the thread and waits for completion before continuing */
-                r = pthread_join( c2[i]->thread, NULL );
-                if( r != 0 )
+                if( r == EDEADLK )
                 {
                     kwipe_log( NWIPE_LOG_ERROR,
-                               "Error joining the wipe thread when waiting for thread to cancel.",
+                               "Error joining the wipe thread: EDEADLK: Deadlock detected.",
                                c2[i]->device_name );
-
-                    if( r == EDEADLK )
+                }
+                else
+                {
+                    if( r == EINVAL )
                     {
                         kwipe_log( NWIPE_LOG_ERROR,
-                                   "Error joining the wipe thread: EDEADLK: Deadlock detected.",
+                                   "Error joining the wipe thread: %s EINVAL: thread is not joinable.",
                                    c2[i]->device_name );
                     }
                     else
                     {
-                        if( r == EINVAL )
+                        if( r == ESRCH )
                         {
                             kwipe_log( NWIPE_LOG_ERROR,
-                                       "Error joining the wipe thread: %s EINVAL: thread is not joinable.",
+                                       "Error joining the wipe thread: %s ESRCH: no matching thread found",
                                        c2[i]->device_name );
                         }
-                        else
-                        {
-                            if( r == ESRCH )
-                            {
-                                kwipe_log( NWIPE_LOG_ERROR,
-                                           "Error joining the wipe thread: %s ESRCH: no matching thread found",
-                                           c2[i]->device_name );
-                            }
-                        }
                     }
-
-                    any_threads_still_running = 1;
                 }
-                else
-                {
-                    c2[i]->thread = 0; /* Zero the thread so we know it's been cancelled */
-
-                    if( kwipe_options.verbose )
-                    {
-                        kwipe_log( NWIPE_LOG_INFO, "Wipe thread for device %s has terminated", c2[i]->device_name );
-                    }
+            }
+            else
+            {
+                c2[i]->thread = 0; /* Zero the thread so we know it's been cancelled */
 
-                    /* Close the device file descriptor. */
-                    close( c2[i]->device_fd );
+                if( kwipe_options.verbose )
+                {
+                    kwipe_log( NWIPE_LOG_INFO, "Wipe thread for device %s has terminated", c2[i]->device_name );
                 }
+
+                /* Close the device file descriptor. */
+                kwipe_io_close( c2[i] );
+                close( c2[i]->device_fd );
             }
         }
-        thread_timeout_counter--;
-        sleep( 1 );
+    }
+
+    /* Write the final metrics and results and stop publishing them. */
+    kwipe_metrics_stop();
+    kwipe_progress_json_stop();
+
+    /* Release the shared pattern buffers and PRNG streams, unless a wipe thread that didn't respond
+     * may still be using them */
+    if( !any_threads_still_running )
+    {
+        kwipe_pattern_cache_free();
+        kwipe_shared_stream_free();
     }
 
     /* Now all the wipe threads have finished, we can issue a terminate_signal = 1
@@ -822,7 +937,7 @@ int main( int argc, char** argv )
      * active (being in the gui section) so here we need to set the terminate signal
      * specifically for a completed wipes/s just for non gui mode.
      */
-    terminate_signal = 1;
+    kwipe_request_terminate();
 
     /* Kill the temperature update thread */
     if( kwipe_temperature_thread )
@@ -850,6 +965,12 @@ int main( int argc, char** argv )
         }
     }
 
+    /* Close the hwmon files the temperature thread was reading */
+    for( i = 0; i < kwipe_enumerated; i++ )
+    {
+        kwipe_shut_temperature( c1[i] );
+    }
+
     if( kwipe_options.verbose )
     {
         for( i = 0; i < kwipe_selected; i++ )
@@ -908,7 +1029,8 @@ int main( int argc, char** argv )
         }
     }
 
-    /* Generate and send the drive status summary to the log */
+    /* Log the peak throughput of each controller, then the drive status summary */
+    kwipe_sched_log_summary();
     kwipe_log_summary( c2, kwipe_selected );
 
     /* Print a one line status message for the user */
@@ -970,6 +1092,10 @@ void* signal_hand( void* ptr )
 
     int i;
     char eta[9];
+    char throughput[NOMENCLATURE_RESULT_STR_SIZE];
+    char throughput_pass[NOMENCLATURE_RESULT_STR_SIZE];
+    char throughput_overall[NOMENCLATURE_RESULT_STR_SIZE];
+    kwipe_progress_t progress;
 
     /* Set up the structs we will use for the data required. */
     kwipe_thread_data_ptr_t* kwipe_thread_data_ptr;
@@ -1009,6 +1135,10 @@ void* signal_hand( void* ptr )
                                 status = "[OPS-II final]";
                                 break;
 
+                            case NWIPE_PASS_DISCARD:
+                                status = "[discarding]";
+                                break;
+
                             case NWIPE_PASS_WRITE:
                                 status = "[writing]";
                                 break;
@@ -1020,15 +1150,22 @@ void* signal_hand( void* ptr )
                             case NWIPE_PASS_NONE:
                                 break;
                         }
-                        if( c[i]->sync_status )
+                        kwipe_progress_snapshot( c[i], &progress );
+                        if( progress.sync_status )
                         {
                             status = "[syncing]";
                         }
 
                         convert_seconds_to_hours_minutes_seconds( c[i]->eta, &hours, &minutes, &seconds );
 
+                        Determine_C_B_nomenclature( c[i]->throughput, throughput, sizeof( throughput ) );
+                        Determine_C_B_nomenclature( c[i]->throughput_pass, throughput_pass, sizeof( throughput_pass ) );
+                        Determine_C_B_nomenclature(
+                            c[i]->throughput_overall, throughput_overall, sizeof( throughput_overall ) );
+
                         kwipe_log( NWIPE_LOG_INFO,
-                                   "%s: %05.2f%%, round %i of %i, pass %i of %i, eta %02i:%02i:%02i, %s",
+                                   "%s: %05.2f%%, round %i of %i, pass %i of %i, eta %02i:%02i:%02i, %s/s (pass %s/s, "
+                                   "overall %s/s), %s",
                                    c[i]->device_name,
                                    c[i]->round_percent,
                                    c[i]->round_working,
@@ -1038,6 +1175,9 @@ void* signal_hand( void* ptr )
                                    hours,
                                    minutes,
                                    seconds,
+                                   throughput,
+                                   throughput_pass,
+                                   throughput_overall,
                                    status );
                     }
                     else
@@ -1065,12 +1205,12 @@ void* signal_hand( void* ptr )
             case SIGINT:
             case SIGQUIT:
             case SIGTERM:
-                /* Set termination flag for main() which will do housekeeping prior to exit */
-                terminate_signal = 1;
-
-                /* Set the user abort flag */
+                /* Set the user abort flag, before main() is woken so that it sees it */
                 user_abort = 1;
 
+                /* Set termination flag for main() which will do housekeeping prior to exit */
+                kwipe_request_terminate();
+
                 /* Return control to the main thread, returning the signal received */
                 return ( (void*) 0 );
 
@@ -1083,33 +1223,20 @@ void* signal_hand( void* ptr )
 
 int cleanup()
 {
-    int i;
-    extern int log_elements_displayed;  // initialised and found in logging.c
-    extern int log_elements_allocated;  // initialised and found in logging.c
-    extern char** log_lines;
     extern config_t kwipe_cfg;
 
-    /* Print the logs held in memory to the console */
-    for( i = log_elements_displayed; i < log_elements_allocated; i++ )
-    {
-        printf( "%s\n", log_lines[i] );
-    }
-    fflush( stdout );
+    /* Print the logs held in memory, or paged back from disk, to the console */
+    kwipe_log_print_history( stdout );
 
     /* Deallocate memory used by logging */
-    if( log_elements_allocated != 0 )
-    {
-        for( i = 0; i < log_elements_allocated; i++ )
-        {
-            free( log_lines[i] );
-        }
-        log_elements_allocated = 0;  // zeroed just in case cleanup is called twice.
-        free( log_lines );
-    }
+    kwipe_log_free_history();
 
     /* Deallocate libconfig resources */
     config_destroy( &kwipe_cfg );
 
+    /* Deallocate the wipe queue */
+    kwipe_sched_free();
+
     /* TODO: Any other cleanup required ? */
 
     return 0;
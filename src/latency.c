@@ -0,0 +1,163 @@
+/*
+ *  latency.c: Per device I/O latency histograms for kwipe.
+ *
+ *  Each drive has a histogram for write(), read() and fdatasync(), recorded in the pass
+ *  loops. A drive with a failing head often keeps passing while its latency climbs, so the
+ *  p50/p99/max of these are shown in the GUI, the summary and the PDF report.
+ *
+ *  The histograms are log-linear, like HdrHistogram: values below 2^SUB_BITS ns get a bucket
+ *  each, above that every power of two is split into 2^SUB_BITS equal buckets. That keeps
+ *  the error within 12.5% from nanoseconds to minutes with a few hundred buckets, and
+ *  recording a value is a couple of shifts and an increment.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdio.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "latency.h"
+
+#define SUB_BITS NWIPE_KNOB_LATENCY_SUB_BITS
+#define SUB_COUNT ( 1 << SUB_BITS )
+
+static int kwipe_latency_bucket( u64 ns )
+{
+    int msb;
+
+    if( ns >= ( 1ULL << NWIPE_KNOB_LATENCY_MAX_BITS ) )
+    {
+        ns = ( 1ULL << NWIPE_KNOB_LATENCY_MAX_BITS ) - 1;
+    }
+
+    if( ns < SUB_COUNT )
+    {
+        return (int) ns;
+    }
+
+    /* The power of two selects the group of buckets, the next SUB_BITS bits the bucket within it. */
+    msb = 63 - __builtin_clzll( ns );
+
+    return ( ( msb - SUB_BITS + 1 ) << SUB_BITS ) + (int) ( ( ns >> ( msb - SUB_BITS ) ) & ( SUB_COUNT - 1 ) );
+}
+
+static u64 kwipe_latency_bucket_value( int bucket )
+{
+    /* Returns the middle of the range of values that fall in a bucket. */
+    int group = bucket >> SUB_BITS;
+    int sub = bucket & ( SUB_COUNT - 1 );
+    int shift;
+
+    if( group == 0 )
+    {
+        return (u64) sub;
+    }
+
+    shift = group - 1;
+
+    return ( ( (u64) ( SUB_COUNT + sub ) ) << shift ) + ( ( 1ULL << shift ) >> 1 );
+}
+
+void kwipe_latency_record( kwipe_latency_t* h, u64 ns )
+{
+    h->bucket[kwipe_latency_bucket( ns )]++;
+    h->count++;
+    h->total_ns += ns;
+    if( ns > h->max_ns )
+    {
+        h->max_ns = ns;
+    }
+}
+
+u64 kwipe_latency_percentile( const kwipe_latency_t* h, double percentile )
+{
+    u64 count = h->count;
+    u64 target;
+    u64 seen = 0;
+    u64 value;
+    int i;
+
+    if( count == 0 )
+    {
+        return 0;
+    }
+
+    target = (u64) ( count * percentile / 100.0 );
+    if( target == 0 )
+    {
+        target = 1;
+    }
+
+    for( i = 0; i < NWIPE_LATENCY_BUCKETS; i++ )
+    {
+        seen += h->bucket[i];
+        if( seen >= target )
+        {
+            /* The middle of a bucket can be beyond the slowest call actually seen. */
+            value = kwipe_latency_bucket_value( i );
+            return value < h->max_ns ? value : h->max_ns;
+        }
+    }
+
+    return h->max_ns;
+}
+
+void kwipe_latency_ns_to_text( u64 ns, char* text, size_t text_size )
+{
+    if( ns < 1000 )
+    {
+        snprintf( text, text_size, "%lluns", ns );
+    }
+    else if( ns < 10000 )
+    {
+        snprintf( text, text_size, "%.1fus", ns / 1e3 );
+    }
+    else if( ns < 1000000 )
+    {
+        snprintf( text, text_size, "%lluus", ns / 1000 );
+    }
+    else if( ns < 10000000 )
+    {
+        snprintf( text, text_size, "%.1fms", ns / 1e6 );
+    }
+    else if( ns < 1000000000 )
+    {
+        snprintf( text, text_size, "%llums", ns / 1000000 );
+    }
+    else
+    {
+        snprintf( text, text_size, "%.1fs", ns / 1e9 );
+    }
+}
+
+void kwipe_latency_summary_text( const kwipe_latency_t* h, char* text, size_t text_size )
+{
+    char p50[NWIPE_LATENCY_TXT_LENGTH];
+    char p99[NWIPE_LATENCY_TXT_LENGTH];
+    char max[NWIPE_LATENCY_TXT_LENGTH];
+
+    if( h->count == 0 )
+    {
+        snprintf( text, text_size, "-" );
+        return;
+    }
+
+    kwipe_latency_ns_to_text( kwipe_latency_percentile( h, 50 ), p50, sizeof( p50 ) );
+    kwipe_latency_ns_to_text( kwipe_latency_percentile( h, 99 ), p99, sizeof( p99 ) );
+    kwipe_latency_ns_to_text( h->max_ns, max, sizeof( max ) );
+
+    snprintf( text, text_size, "%s/%s/%s", p50, p99, max );
+}
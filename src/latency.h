@@ -0,0 +1,54 @@
+/*
+ *  latency.h: Per device I/O latency histograms for kwipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include "context.h"
+
+/* Enough for "999us/999ms/999.9s" */
+#define NWIPE_LATENCY_TXT_LENGTH 24
+
+/**
+ * Records the latency of one call in a histogram. Only the drive's wipe thread records,
+ * so no locking is needed, readers may see a histogram that is one call out of date.
+ * @param h the histogram, one of c->latency[]
+ * @param ns the latency in nanoseconds
+ */
+void kwipe_latency_record( kwipe_latency_t* h, u64 ns );
+
+/**
+ * Returns the given percentile of a histogram in nanoseconds, accurate to the width
+ * of a bucket, i.e. 1/8 of the value. Returns 0 if nothing has been recorded.
+ * @param h the histogram
+ * @param percentile 0 to 100, e.g. 50 or 99
+ */
+u64 kwipe_latency_percentile( const kwipe_latency_t* h, double percentile );
+
+/**
+ * Formats a latency as a short string such as "850us", "12ms" or "1.3s".
+ */
+void kwipe_latency_ns_to_text( u64 ns, char* text, size_t text_size );
+
+/**
+ * Formats the p50/p99/max of a histogram as "p50/p99/max", e.g. "120us/2.1ms/1.3s",
+ * or "-" if nothing has been recorded.
+ */
+void kwipe_latency_summary_text( const kwipe_latency_t* h, char* text, size_t text_size );
+
+#endif /* LATENCY_H_ */
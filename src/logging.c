@@ -38,14 +38,454 @@
 #include "logging.h"
 #include "create_pdf.h"
 #include "miscellaneous.h"
-
-/* Global array to hold log values to print when logging to STDOUT */
-char** log_lines;
-int log_current_element = 0;
-int log_elements_allocated = 0;
-int log_elements_displayed = 0;
+#include "latency.h"
+#include "event.h"
+#include "throttle.h"
+#include "temperature.h"
+#include "dmi.h"
+#include "io.h"
+
+/* In-memory log history.
+ *
+ * The most recent log lines are held in a fixed number of segments that are used as a ring. Each
+ * segment is a single arena of characters, so adding a line never reallocates. When every segment
+ * is full the oldest one is evicted: if all its lines were written to the log file we only remember
+ * where they start in it, otherwise the lines are spilled to an unlinked temporary file. Evicted
+ * lines are paged back in, a segment at a time, when kwipe_log_get_line() asks for them.
+ */
+typedef struct kwipe_log_segment_t_
+{
+    u64 first_line;  // number of the first line held in this segment
+    int lines;  // number of lines held in this segment
+    size_t used;  // bytes of the arena in use, including each line's terminator
+    int in_logfile;  // 1 if every line of this segment has been written to the log file
+    long offset;  // where the first line of this segment starts in the log file
+    u32 line_offset[NWIPE_LOG_SEGMENT_LINES];  // start of each line within the arena
+    char arena[NWIPE_LOG_SEGMENT_BYTES];
+} kwipe_log_segment_t;
+
+/* An evicted segment, either in the log file or in the spill file. */
+typedef struct kwipe_log_spill_t_
+{
+    u64 first_line;
+    int lines;
+    size_t bytes;
+    int in_logfile;
+    long offset;
+    int embedded_count;  // number of newlines inside the lines themselves, e.g. kwipe_log_OSinfo()
+    u32* embedded;  // their positions, so they are not mistaken for line ends when paging back
+} kwipe_log_spill_t;
+
+static kwipe_log_segment_t* log_ring[NWIPE_LOG_RING_SEGMENTS];
+static int log_ring_head = 0;  // segment currently being filled
+static int log_ring_count = 0;  // number of segments holding lines
+static kwipe_log_spill_t* log_spill;
+static int log_spill_count = 0;
+static int log_spill_allocated = 0;
+static FILE* log_spill_fp;
+static kwipe_log_segment_t* log_page;  // the most recently paged back segment
+static int log_page_index = -1;
+static u64 log_line_count = 0;
+static u64 log_lines_displayed = 0;
 pthread_mutex_t mutex1 = PTHREAD_MUTEX_INITIALIZER;
 
+static int kwipe_log_spill_segment( kwipe_log_segment_t* seg )
+{
+    /*
+     * Records an evicted segment in the spill index, writing its lines to the spill file
+     * first if they are not already in the log file. Called with mutex1 held.
+     */
+
+    kwipe_log_spill_t* spill;
+    kwipe_log_spill_t* result;
+    char* p;
+    int i;
+
+    if( log_spill_count == log_spill_allocated )
+    {
+        result = realloc( log_spill, ( log_spill_allocated + NWIPE_LOG_RING_SEGMENTS ) * sizeof( kwipe_log_spill_t ) );
+        if( result == NULL )
+        {
+            fprintf( stderr, "kwipe_log: realloc failed when spilling the log history.\n" );
+            return -1;
+        }
+        log_spill = result;
+        log_spill_allocated += NWIPE_LOG_RING_SEGMENTS;
+    }
+
+    spill = &log_spill[log_spill_count];
+    spill->first_line = seg->first_line;
+    spill->lines = seg->lines;
+    spill->bytes = seg->used;
+    spill->in_logfile = seg->in_logfile;
+    spill->offset = seg->offset;
+    spill->embedded_count = 0;
+    spill->embedded = NULL;
+
+    /* Newlines inside a line are rare, only remember them when there are some. */
+    for( i = 0; i < seg->lines; i++ )
+    {
+        for( p = strchr( seg->arena + seg->line_offset[i], '\n' ); p != NULL; p = strchr( p + 1, '\n' ) )
+        {
+            u32* embedded = realloc( spill->embedded, ( spill->embedded_count + 1 ) * sizeof( u32 ) );
+            if( embedded == NULL )
+            {
+                fprintf( stderr, "kwipe_log: realloc failed when spilling the log history.\n" );
+                free( spill->embedded );
+                return -1;
+            }
+            spill->embedded = embedded;
+            spill->embedded[spill->embedded_count++] = (u32) ( p - seg->arena );
+        }
+    }
+
+    if( !spill->in_logfile )
+    {
+        if( log_spill_fp == NULL )
+        {
+            log_spill_fp = tmpfile();
+            if( log_spill_fp == NULL )
+            {
+                perror( "kwipe_log: tmpfile:" );
+                free( spill->embedded );
+                return -1;
+            }
+        }
+
+        if( fseek( log_spill_fp, 0, SEEK_END ) != 0 )
+        {
+            free( spill->embedded );
+            return -1;
+        }
+        spill->offset = ftell( log_spill_fp );
+
+        /* Written in the same format as the log file, so both are paged back the same way. */
+        for( i = 0; i < seg->lines; i++ )
+        {
+            fprintf( log_spill_fp, "%s\n", seg->arena + seg->line_offset[i] );
+        }
+        if( fflush( log_spill_fp ) != 0 )
+        {
+            perror( "kwipe_log: fflush:" );
+            free( spill->embedded );
+            return -1;
+        }
+    }
+
+    log_spill_count++;
+
+    return 0;
+}
+
+static kwipe_log_segment_t* kwipe_log_ring_append( const char* line, int in_logfile )
+{
+    /*
+     * Stores a line in the ring, evicting the oldest segment if the ring is full.
+     * Returns the segment the line was stored in. Called with mutex1 held.
+     */
+
+    kwipe_log_segment_t* seg;
+    size_t length = strlen( line ) + 1;
+
+    seg = log_ring_count ? log_ring[log_ring_head] : NULL;
+
+    if( seg == NULL || seg->lines == NWIPE_LOG_SEGMENT_LINES || seg->used + length > NWIPE_LOG_SEGMENT_BYTES )
+    {
+        if( log_ring_count )
+        {
+            log_ring_head = ( log_ring_head + 1 ) % NWIPE_LOG_RING_SEGMENTS;
+        }
+
+        if( log_ring_count == NWIPE_LOG_RING_SEGMENTS )
+        {
+            /* The ring is full, the segment we are about to reuse is the oldest. */
+            if( kwipe_log_spill_segment( log_ring[log_ring_head] ) != 0 )
+            {
+                fprintf( stderr, "kwipe_log: %i log lines dropped from the history.\n", log_ring[log_ring_head]->lines );
+            }
+        }
+        else
+        {
+            log_ring_count++;
+        }
+
+        if( log_ring[log_ring_head] == NULL )
+        {
+            /* Deallocation is done by kwipe_log_free_history() from cleanup() in kwipe.c */
+            log_ring[log_ring_head] = malloc( sizeof( kwipe_log_segment_t ) );
+            if( log_ring[log_ring_head] == NULL )
+            {
+                fprintf( stderr, "kwipe_log: malloc failed when adding a log line.\n" );
+                log_ring_count--;
+                return NULL;
+            }
+        }
+
+        seg = log_ring[log_ring_head];
+        seg->first_line = log_line_count;
+        seg->lines = 0;
+        seg->used = 0;
+        seg->in_logfile = in_logfile;
+        seg->offset = -1;
+    }
+
+    seg->line_offset[seg->lines] = (u32) seg->used;
+    memcpy( seg->arena + seg->used, line, length );
+    seg->used += length;
+    seg->lines++;
+
+    if( !in_logfile )
+    {
+        seg->in_logfile = 0;
+    }
+
+    return seg;
+}
+
+static int kwipe_log_page_in( int index )
+{
+    /*
+     * Reads the lines of a spilled segment back from the log file or the spill file into
+     * log_page. Called with mutex1 held.
+     */
+
+    kwipe_log_spill_t* spill = &log_spill[index];
+    FILE* fp;
+    size_t bytes;
+    size_t pos;
+    int line;
+    int e;
+
+    if( log_page_index == index )
+    {
+        return 0;
+    }
+
+    if( log_page == NULL )
+    {
+        log_page = malloc( sizeof( kwipe_log_segment_t ) );
+        if( log_page == NULL )
+        {
+            fprintf( stderr, "kwipe_log: malloc failed when paging back the log history.\n" );
+            return -1;
+        }
+    }
+    log_page_index = -1;
+
+    if( spill->in_logfile )
+    {
+        fp = fopen( kwipe_options.logfile, "r" );
+    }
+    else
+    {
+        fp = log_spill_fp;
+    }
+    if( fp == NULL )
+    {
+        return -1;
+    }
+
+    bytes = 0;
+    if( fseek( fp, spill->offset, SEEK_SET ) == 0 )
+    {
+        bytes = fread( log_page->arena, 1, spill->bytes, fp );
+    }
+    if( spill->in_logfile )
+    {
+        fclose( fp );
+    }
+
+    /* The log file may have been truncated or rotated under us. */
+    if( bytes != spill->bytes || log_page->arena[bytes - 1] != '\n' )
+    {
+        return -1;
+    }
+
+    /* Split the lines back up at each newline that ended a line. */
+    line = 0;
+    e = 0;
+    log_page->line_offset[line++] = 0;
+    for( pos = 0; pos < bytes; pos++ )
+    {
+        if( log_page->arena[pos] != '\n' )
+        {
+            continue;
+        }
+        if( e < spill->embedded_count && spill->embedded[e] == pos )
+        {
+            e++;
+            continue;
+        }
+        log_page->arena[pos] = 0;
+        if( pos + 1 < bytes )
+        {
+            if( line == spill->lines )
+            {
+                return -1;
+            }
+            log_page->line_offset[line++] = (u32) ( pos + 1 );
+        }
+    }
+    if( line != spill->lines )
+    {
+        return -1;
+    }
+
+    log_page->first_line = spill->first_line;
+    log_page->lines = spill->lines;
+    log_page->used = bytes;
+    log_page_index = index;
+
+    return 0;
+}
+
+static const char* kwipe_log_lookup_line( u64 line_number )
+{
+    /*
+     * Finds a line of the log history, in the ring or paged back from disk.
+     * Called with mutex1 held. Returns NULL if the line is not available.
+     */
+
+    kwipe_log_segment_t* seg;
+    int low;
+    int high;
+    int mid;
+    int i;
+
+    if( line_number >= log_line_count )
+    {
+        return NULL;
+    }
+
+    /* Most lookups are for recent lines, which are still in the ring. */
+    for( i = 0; i < log_ring_count; i++ )
+    {
+        seg = log_ring[( log_ring_head + NWIPE_LOG_RING_SEGMENTS - i ) % NWIPE_LOG_RING_SEGMENTS];
+        if( line_number >= seg->first_line && line_number < seg->first_line + seg->lines )
+        {
+            return seg->arena + seg->line_offset[line_number - seg->first_line];
+        }
+    }
+
+    /* Otherwise binary search the spilled segments, which are in line order. */
+    low = 0;
+    high = log_spill_count - 1;
+    while( low <= high )
+    {
+        mid = ( low + high ) / 2;
+        if( line_number < log_spill[mid].first_line )
+        {
+            high = mid - 1;
+        }
+        else if( line_number >= log_spill[mid].first_line + log_spill[mid].lines )
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            if( kwipe_log_page_in( mid ) != 0 )
+            {
+                return NULL;
+            }
+            return log_page->arena + log_page->line_offset[line_number - log_page->first_line];
+        }
+    }
+
+    return NULL;
+}
+
+u64 kwipe_log_line_count( void )
+{
+    u64 count;
+
+    pthread_mutex_lock( &mutex1 );
+    count = log_line_count;
+    pthread_mutex_unlock( &mutex1 );
+
+    return count;
+}
+
+int kwipe_log_get_line( u64 line_number, char* buffer, size_t buffer_size )
+{
+    const char* line;
+    int r = -1;
+
+    if( buffer == NULL || buffer_size == 0 )
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock( &mutex1 );
+    line = kwipe_log_lookup_line( line_number );
+    if( line != NULL )
+    {
+        snprintf( buffer, buffer_size, "%s", line );
+        r = 0;
+    }
+    pthread_mutex_unlock( &mutex1 );
+
+    return r;
+}
+
+void kwipe_log_print_history( FILE* stream )
+{
+    const char* line;
+    u64 i;
+
+    pthread_mutex_lock( &mutex1 );
+    for( i = log_lines_displayed; i < log_line_count; i++ )
+    {
+        line = kwipe_log_lookup_line( i );
+        if( line == NULL )
+        {
+            fprintf( stream, "[log line %llu is no longer available]\n", i );
+            continue;
+        }
+        fprintf( stream, "%s\n", line );
+    }
+    log_lines_displayed = log_line_count;
+    fflush( stream );
+    pthread_mutex_unlock( &mutex1 );
+}
+
+void kwipe_log_free_history( void )
+{
+    int i;
+
+    pthread_mutex_lock( &mutex1 );
+    for( i = 0; i < NWIPE_LOG_RING_SEGMENTS; i++ )
+    {
+        free( log_ring[i] );
+        log_ring[i] = NULL;
+    }
+    log_ring_count = 0;
+    log_ring_head = 0;
+
+    for( i = 0; i < log_spill_count; i++ )
+    {
+        free( log_spill[i].embedded );
+    }
+    free( log_spill );
+    log_spill = NULL;
+    log_spill_count = 0;
+    log_spill_allocated = 0;
+
+    if( log_spill_fp != NULL )
+    {
+        fclose( log_spill_fp );
+        log_spill_fp = NULL;
+    }
+
+    free( log_page );
+    log_page = NULL;
+    log_page_index = -1;
+
+    /* Lines logged after this, e.g. by check_for_autopoweroff(), start a fresh history. */
+    log_lines_displayed = log_line_count;
+    pthread_mutex_unlock( &mutex1 );
+}
+
+
 void kwipe_log( kwipe_log_t level, const char* format, ... )
 {
     /**
@@ -53,15 +493,13 @@ void kwipe_log( kwipe_log_t level, const char* format, ... )
      *
      */
 
-    extern int terminate_signal;
     extern int user_abort;
 
-    char** result;
-    char* malloc_result;
+    kwipe_log_segment_t* seg;
     char message_buffer[MAX_LOG_LINE_CHARS * sizeof( char )];
     int chars_written;
+    long offset;
 
-    int message_buffer_length;
     int r; /* result buffer */
 
     /* A time buffer. */
@@ -271,42 +709,9 @@ void kwipe_log( kwipe_log_t level, const char* format, ... )
     }
 
     fflush( stdout );
-    /* Increase the current log element pointer - we will write here, deallocation is done in cleanup() in kwipe.c */
-    if( log_current_element == log_elements_allocated )
-    {
-        log_elements_allocated++;
-        result = realloc( log_lines, ( log_elements_allocated ) * sizeof( char* ) );
-        if( result == NULL )
-        {
-            fprintf( stderr, "kwipe_log: realloc failed when adding a log line.\n" );
-            r = pthread_mutex_unlock( &mutex1 );
-            if( r != 0 )
-            {
-                fprintf( stderr, "kwipe_log: pthread_mutex_unlock failed. Code %i \n", r );
-                va_end( ap );
-                return;
-            }
-        }
-        log_lines = result;
-
-        /* Allocate memory for storing a single log message, deallocation is done in cleanup() in kwipe.c */
-        message_buffer_length = strlen( message_buffer ) * sizeof( char );
-        malloc_result = malloc( ( message_buffer_length + 1 ) * sizeof( char ) );
-        if( malloc_result == NULL )
-        {
-            fprintf( stderr, "kwipe_log: malloc failed when adding a log line.\n" );
-            r = pthread_mutex_unlock( &mutex1 );
-            if( r != 0 )
-            {
-                fprintf( stderr, "kwipe_log: pthread_mutex_unlock failed. Code %i \n", r );
-                va_end( ap );
-                return;
-            }
-        }
-        log_lines[log_current_element] = malloc_result;
-    }
 
-    strcpy( log_lines[log_current_element], message_buffer );
+    /* Add the line to the in-memory history, the oldest lines are spilled to disk when it is full. */
+    seg = kwipe_log_ring_append( message_buffer, kwipe_options.logfile[0] != '\0' );
 
     /*
         if( level >= NWIPE_LOG_WARNING )
@@ -335,8 +740,11 @@ void kwipe_log( kwipe_log_t level, const char* format, ... )
     {
         if( kwipe_options.nogui )
         {
-            printf( "%s\n", log_lines[log_current_element] );
-            log_elements_displayed++;
+            printf( "%s\n", message_buffer );
+            if( log_lines_displayed == log_line_count )
+            {
+                log_lines_displayed++;
+            }
         }
     }
     else
@@ -369,7 +777,23 @@ void kwipe_log( kwipe_log_t level, const char* format, ... )
                 }
             }
 
-            fprintf( fp, "%s\n", log_lines[log_current_element] );
+            fprintf( fp, "%s\n", message_buffer );
+
+            /* Remember where the segment starts in the log file, so it can be paged back once evicted. */
+            if( seg != NULL && seg->lines == 1 && seg->in_logfile )
+            {
+                fflush( fp );
+                offset = ftell( fp );
+                if( offset < 0 )
+                {
+                    /* Not a regular file, e.g. a pipe, so the segment will have to be spilled. */
+                    seg->in_logfile = 0;
+                }
+                else
+                {
+                    seg->offset = offset - (long) strlen( message_buffer ) - 1;
+                }
+            }
 
             /* Unlock the file. */
             r = flock( fd, LOCK_UN );
@@ -400,11 +824,15 @@ void kwipe_log( kwipe_log_t level, const char* format, ... )
                 fprintf( stderr, "kwipe_log: pthread_mutex_unlock failed. Code %i \n", r );
             }
             user_abort = 1;
-            terminate_signal = 1;
+            kwipe_request_terminate();
+            if( seg != NULL )
+            {
+                seg->in_logfile = 0;
+            }
         }
     }
 
-    log_current_element++;
+    log_line_count++;
 
     r = pthread_mutex_unlock( &mutex1 );
     if( r != 0 )
@@ -513,11 +941,6 @@ void kwipe_log_OSinfo()
 
 int kwipe_log_sysinfo()
 {
-    FILE* fp;
-    char path[256];
-    int len;
-    int r;  // A result buffer.
-
     /*
      * Remove or add keywords to be searched, depending on what information is to
      * be logged, making sure the last entry in the array is a NULL string. To remove
@@ -555,95 +978,118 @@ int kwipe_log_sysinfo()
         { "", "" }  // terminates the keyword array. DO NOT REMOVE
     };
 
-    char dmidecode_command[] = "dmidecode -s %s";
-    char dmidecode_command2[] = "/sbin/dmidecode -s %s";
-    char dmidecode_command3[] = "/usr/bin/dmidecode -s %s";
-    char* p_dmidecode_command;
-
-    char cmd[sizeof( dmidecode_keywords ) + sizeof( dmidecode_command2 )];
+    /* The values of each keyword, read from sysfs and the SMBIOS table, see dmi.c */
+    kwipe_dmi_field_t fields[sizeof( dmidecode_keywords ) / sizeof( dmidecode_keywords[0] )];
 
-    unsigned int keywords_idx;
+    int keywords_idx;
+    int count;
+    int i;
 
-    keywords_idx = 0;
+    for( keywords_idx = 0; dmidecode_keywords[keywords_idx][0][0] != 0; keywords_idx++ )
+    {
+        fields[keywords_idx].keyword = &dmidecode_keywords[keywords_idx][0][0];
+    }
+    count = keywords_idx;
 
-    p_dmidecode_command = 0;
+    if( kwipe_dmi_read( fields, count ) == count )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "No SMBIOS/DMI data found. Install dmidecode !" );
+        return 1;
+    }
 
-    if( system( "which dmidecode > /dev/null 2>&1" ) )
+    for( keywords_idx = 0; keywords_idx < count; keywords_idx++ )
     {
-        if( system( "which /sbin/dmidecode > /dev/null 2>&1" ) )
+        /* One line for each value, e.g. one for each processor */
+        for( i = 0; i < fields[keywords_idx].count; i++ )
         {
-            if( system( "which /usr/bin/dmidecode > /dev/null 2>&1" ) )
+            if( kwipe_options.quiet && dmidecode_keywords[keywords_idx][1][0] == '0' )
             {
-                kwipe_log( NWIPE_LOG_WARNING, "Command not found. Install dmidecode !" );
+                kwipe_log( NWIPE_LOG_INFO, "%s = %s", &dmidecode_keywords[keywords_idx][0][0], "XXXXXXXXXXXXXXX" );
             }
             else
             {
-                p_dmidecode_command = &dmidecode_command3[0];
+                kwipe_log(
+                    NWIPE_LOG_INFO, "%s = %s", &dmidecode_keywords[keywords_idx][0][0], fields[keywords_idx].value[i] );
             }
         }
-        else
+    }
+
+    return 0;
+}
+
+static void kwipe_log_summary_errors( void )
+{
+    /* Repeats the errors of the run at the end of the summary, so they don't have to be searched for
+     * in a long log. Lines that have left the in-memory ring are paged back from disk.
+     */
+
+    char line[MAX_LOG_LINE_CHARS];
+    u64 count;
+    u64 i;
+    int listed = 0;
+    int unavailable = 0;
+
+    /* The lines logged below are not scanned again */
+    count = kwipe_log_line_count();
+
+    for( i = 0; i < count; i++ )
+    {
+        if( kwipe_log_get_line( i, line, sizeof( line ) ) != 0 )
         {
-            p_dmidecode_command = &dmidecode_command2[0];
+            unavailable++;
+            continue;
+        }
+        if( strstr( line, "  error: " ) == NULL && strstr( line, "  fatal: " ) == NULL )
+        {
+            continue;
+        }
+        if( listed == 0 )
+        {
+            kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                       "********************************* Errors logged ********************************" );
+        }
+        if( listed++ < NWIPE_LOG_SUMMARY_ERRORS )
+        {
+            kwipe_log( NWIPE_LOG_NOTIMESTAMP, "%s", line );
         }
     }
-    else
+
+    if( listed == 0 )
     {
-        p_dmidecode_command = &dmidecode_command[0];
+        return;
     }
-
-    if( p_dmidecode_command != 0 )
+    if( listed > NWIPE_LOG_SUMMARY_ERRORS )
     {
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP, "  ... and %i more, see the full log", listed - NWIPE_LOG_SUMMARY_ERRORS );
+    }
+    if( unavailable > 0 )
+    {
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP, "  %i lines of the log could not be read back", unavailable );
+    }
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+               "********************************************************************************" );
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP, "" );
+}
 
-        /* Run the dmidecode command to retrieve each dmidecode keyword, one at a time */
-        while( dmidecode_keywords[keywords_idx][0][0] != 0 )
-        {
-            sprintf( cmd, p_dmidecode_command, &dmidecode_keywords[keywords_idx][0][0] );
-            fp = popen( cmd, "r" );
-            if( fp == NULL )
-            {
-                kwipe_log( NWIPE_LOG_WARNING, "kwipe_log_sysinfo: Failed to create stream to %s", cmd );
-                return 1;
-            }
-            /* Read the output a line at a time - output it. */
-            while( fgets( path, sizeof( path ) - 1, fp ) != NULL )
-            {
-                /* Remove any trailing return from the string, as kwipe_log automatically adds a return */
-                len = strlen( path );
-                if( path[len - 1] == '\n' )
-                {
-                    path[len - 1] = 0;
-                }
-                if( kwipe_options.quiet )
-                {
-                    if( *( &dmidecode_keywords[keywords_idx][1][0] ) == '0' )
-                    {
-                        kwipe_log(
-                            NWIPE_LOG_INFO, "%s = %s", &dmidecode_keywords[keywords_idx][0][0], "XXXXXXXXXXXXXXX" );
-                    }
-                    else
-                    {
-                        kwipe_log( NWIPE_LOG_INFO, "%s = %s", &dmidecode_keywords[keywords_idx][0][0], path );
-                    }
-                }
-                else
-                {
-                    kwipe_log( NWIPE_LOG_INFO, "%s = %s", &dmidecode_keywords[keywords_idx][0][0], path );
-                }
-            }
-            /* close */
-            r = pclose( fp );
-            if( r > 0 )
-            {
-                kwipe_log( NWIPE_LOG_WARNING,
-                           "kwipe_log_sysinfo(): dmidecode failed, \"%s\" exit status = %u",
-                           cmd,
-                           WEXITSTATUS( r ) );
-                return 1;
-            }
-            keywords_idx++;
-        }
+const char* kwipe_log_wipe_status( kwipe_context_t* c )
+{
+    extern int user_abort;
+
+    /* A wipe that returned an error counts as failed even before main() has made it a pass error. */
+    if( c->pass_errors != 0 || c->verify_errors != 0 || c->fsyncdata_errors != 0 || c->result != 0 )
+    {
+        return "FAILED";
     }
-    return 0;
+    if( c->wipe_status == 0 )
+    {
+        /* The null and mem backends finish a wipe without writing anything to the drive, see --io */
+        return kwipe_options.io == &kwipe_io_device ? "ERASED" : "UNWRITTEN";
+    }
+    if( ( c->wipe_status == 1 || c->queued ) && user_abort == 1 )
+    {
+        return "ABORTED";
+    }
+    return "INSANITY";
 }
 
 void kwipe_log_summary( kwipe_context_t** ptr, int kwipe_selected )
@@ -672,6 +1118,10 @@ void kwipe_log_summary( kwipe_context_t** ptr, int kwipe_selected )
     char model[18];
     char serial_no[NWIPE_SERIALNUMBER_LENGTH + 1];
     char exclamation_flag[2];
+    char latency_write[NWIPE_LATENCY_TXT_LENGTH * 3];
+    char latency_read[NWIPE_LATENCY_TXT_LENGTH * 3];
+    char latency_sync[NWIPE_LATENCY_TXT_LENGTH * 3];
+    char throttle[NWIPE_THROTTLE_TXT_LENGTH];
     int hours;
     int minutes;
     int seconds;
@@ -783,67 +1233,61 @@ void kwipe_log_summary( kwipe_context_t** ptr, int kwipe_selected )
 
         kwipe_strip_path( device, c[i]->device_name );
 
-        extern int user_abort;
+        strcpy( c[i]->wipe_status_txt, kwipe_log_wipe_status( c[i] ) );  // copy to context for use by certificate
 
         /* Any errors ? if so set the exclamation_flag and fail message,
          * All status messages should be eight characters EXACTLY !
          */
-        if( c[i]->pass_errors != 0 || c[i]->verify_errors != 0 || c[i]->fsyncdata_errors != 0 )
+        if( !strcmp( c[i]->wipe_status_txt, "FAILED" ) )
         {
             strncpy( exclamation_flag, "!", 1 );
             exclamation_flag[1] = 0;
 
             strncpy( status, "-FAILED-", 8 );
             status[8] = 0;
-
-            strcpy( c[i]->wipe_status_txt, "FAILED" );  // copy to context for use by certificate
         }
-        else
+        else if( !strcmp( c[i]->wipe_status_txt, "ERASED" ) )
         {
-            if( c[i]->wipe_status == 0 /* && user_abort != 1 */ )
-            {
-                strncpy( exclamation_flag, " ", 1 );
-                exclamation_flag[1] = 0;
-
-                strncpy( status, " Erased ", 8 );
-                status[8] = 0;
-
-                strcpy( c[i]->wipe_status_txt, "ERASED" );  // copy to context for use by certificate
-            }
-            else
-            {
-                if( c[i]->wipe_status == 1 && user_abort == 1 )
-                {
-                    strncpy( exclamation_flag, "!", 1 );
-                    exclamation_flag[1] = 0;
+            strncpy( exclamation_flag, " ", 1 );
+            exclamation_flag[1] = 0;
 
-                    strncpy( status, "UABORTED", 8 );
-                    status[8] = 0;
+            strncpy( status, " Erased ", 8 );
+            status[8] = 0;
+        }
+        else if( !strcmp( c[i]->wipe_status_txt, "UNWRITTEN" ) )
+        {
+            strncpy( exclamation_flag, "!", 1 );
+            exclamation_flag[1] = 0;
 
-                    strcpy( c[i]->wipe_status_txt, "ABORTED" );  // copy to context for use by certificate
-                }
-                else
-                {
-                    /* If this ever happens, there is a bug ! */
-                    strncpy( exclamation_flag, " ", 1 );
-                    exclamation_flag[1] = 0;
+            strncpy( status, "NoWrite ", 8 );
+            status[8] = 0;
+        }
+        else if( !strcmp( c[i]->wipe_status_txt, "ABORTED" ) )
+        {
+            strncpy( exclamation_flag, "!", 1 );
+            exclamation_flag[1] = 0;
 
-                    strncpy( status, "INSANITY", 8 );
-                    status[8] = 0;
+            strncpy( status, "UABORTED", 8 );
+            status[8] = 0;
+        }
+        else
+        {
+            /* If this ever happens, there is a bug ! */
+            strncpy( exclamation_flag, " ", 1 );
+            exclamation_flag[1] = 0;
 
-                    strcpy( c[i]->wipe_status_txt, "INSANITY" );  // copy to context for use by certificate
-                }
-            }
+            strncpy( status, "INSANITY", 8 );
+            status[8] = 0;
         }
 
         /* Determine the size of throughput so that the correct nomenclature can be used */
-        Determine_C_B_nomenclature( c[i]->throughput, throughput, 13 );
+        Determine_C_B_nomenclature( c[i]->throughput_overall, throughput, 13 );
 
         /* write the duration string to the drive context for later use by create_pdf() */
         snprintf( c[i]->throughput_txt, sizeof( c[i]->throughput_txt ), "%s", throughput );
 
         /* Add this devices throughput to the total throughput */
-        total_throughput += c[i]->throughput;
+        total_throughput += c[i]->throughput_overall;
 
         /* Retrieve the duration of the wipe in seconds and convert to hours and minutes and seconds */
 
@@ -896,7 +1340,8 @@ void kwipe_log_summary( kwipe_context_t** ptr, int kwipe_selected )
                    serial_no );
 
         /* Create the PDF report/certificate */
-        if( kwipe_options.PDF_enable == 1 )
+        /* No certificate for a drive the passes didn't write, or wrote with faults injected, see --io */
+        if( kwipe_options.PDF_enable == 1 && kwipe_options.io == &kwipe_io_device && kwipe_options.io_faults == NULL )
         // if( strcmp( kwipe_options.PDFreportpath, "noPDF" ) != 0 )
         {
             /* to have some progress indication. can help if there are many/slow disks */
@@ -905,6 +1350,8 @@ void kwipe_log_summary( kwipe_context_t** ptr, int kwipe_selected )
         }
     }
 
+    create_pdf_release_key();
+
     /* Determine the size of throughput so that the correct nomenclature can be used */
     Determine_C_B_nomenclature( total_throughput, total_throughput_string, 13 );
 
@@ -949,10 +1396,76 @@ void kwipe_log_summary( kwipe_context_t** ptr, int kwipe_selected )
                kwipe_options.rounds,
                blank,
                verify );
+    if( kwipe_options.io != &kwipe_io_device )
+    {
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                   "NoWrite: --io=%s wrote nothing to the drives, this is no proof of erasure",
+                   kwipe_options.io->label );
+    }
     kwipe_log( NWIPE_LOG_NOTIMESTAMP,
                "********************************************************************************" );
     kwipe_log( NWIPE_LOG_NOTIMESTAMP, "" );
 
+    /* Print the I/O latency table, a drive that passed with a high p99 or max may be on its way out */
+    /* IMPORTANT: Keep maximum columns (line length) to 80 characters for use with 80x30 terminals, Shredos, ALT-F2 etc
+     * --------------------------------01234567890123456789012345678901234567890123456789012345678901234567890123456789-*/
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+               "************************ I/O Latency (p50/p99/maximum) *************************" );
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP, "    Device | Write                | Read                 | Sync" );
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+               "--------------------------------------------------------------------------------" );
+    for( i = 0; i < kwipe_selected; i++ )
+    {
+        kwipe_strip_path( device, c[i]->device_name );
+
+        kwipe_latency_summary_text( &c[i]->latency[NWIPE_LATENCY_WRITE], latency_write, sizeof( latency_write ) );
+        kwipe_latency_summary_text( &c[i]->latency[NWIPE_LATENCY_READ], latency_read, sizeof( latency_read ) );
+        kwipe_latency_summary_text( &c[i]->latency[NWIPE_LATENCY_SYNC], latency_sync, sizeof( latency_sync ) );
+
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                   "  %s | %-20s | %-20s | %s",
+                   device,
+                   latency_write,
+                   latency_read,
+                   latency_sync );
+    }
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+               "********************************************************************************" );
+    kwipe_log( NWIPE_LOG_NOTIMESTAMP, "" );
+
+    /* Print how long each drive's writes were slowed or paused for by the thermal throttle */
+    if( kwipe_options.thermal_throttle )
+    {
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                   "******************** Thermal Throttle (time, % of the wipe) ********************" );
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP, "    Device | Throttled          | Temperature (highest seen during wipe)" );
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                   "--------------------------------------------------------------------------------" );
+        for( i = 0; i < kwipe_selected; i++ )
+        {
+            kwipe_strip_path( device, c[i]->device_name );
+            kwipe_throttle_summary_text( c[i], throttle, sizeof( throttle ) );
+
+            if( c[i]->temp1_monitored_wipe_max != NO_TEMPERATURE_DATA )
+            {
+                kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                           "  %s | %-18s | %iC",
+                           device,
+                           throttle,
+                           c[i]->temp1_monitored_wipe_max );
+            }
+            else
+            {
+                kwipe_log( NWIPE_LOG_NOTIMESTAMP, "  %s | %-18s | N/A", device, throttle );
+            }
+        }
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP,
+                   "********************************************************************************" );
+        kwipe_log( NWIPE_LOG_NOTIMESTAMP, "" );
+    }
+
+    kwipe_log_summary_errors();
+
     /* Log information regarding where the PDF certificate is saved but log after the summary table so
      * this information is only printed once.
      */
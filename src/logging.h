@@ -29,6 +29,15 @@
 #define OS_info_Line_offset 31 /* OS_info line offset in log */
 #define OS_info_Line_Length 48 /* OS_info line length */
 
+/* The in-memory log history is a ring of NWIPE_LOG_RING_SEGMENTS segments, each holding up to
+ * NWIPE_LOG_SEGMENT_LINES lines in NWIPE_LOG_SEGMENT_BYTES. Older lines are kept on disk. */
+#define NWIPE_LOG_RING_SEGMENTS 8
+#define NWIPE_LOG_SEGMENT_LINES 512
+#define NWIPE_LOG_SEGMENT_BYTES ( 64 * 1024 )
+
+/* The most errors repeated at the end of the summary, see kwipe_log_summary() */
+#define NWIPE_LOG_SUMMARY_ERRORS 20
+
 typedef enum kwipe_log_t_ {
     NWIPE_LOG_NONE = 0,
     NWIPE_LOG_DEBUG,  // Output only when --verbose option used on cmd line.
@@ -57,9 +66,39 @@ typedef enum kwipe_log_t_ {
  */
 void kwipe_log( kwipe_log_t level, const char* format, ... );
 
+/**
+ * Returns the number of lines logged so far.
+ */
+u64 kwipe_log_line_count( void );
+
+/**
+ * Copies a line of the log history into buffer, paging it back from disk if it is no
+ * longer held in memory.
+ * @param line_number the line to fetch, counting from zero
+ * @return 0 on success, -1 if the line is not available
+ */
+int kwipe_log_get_line( u64 line_number, char* buffer, size_t buffer_size );
+
+/**
+ * Prints the lines of the log history that have not yet been displayed on the console.
+ */
+void kwipe_log_print_history( FILE* stream );
+
+/**
+ * Releases the log history, called from cleanup() in kwipe.c
+ */
+void kwipe_log_free_history( void );
+
 void kwipe_perror( int kwipe_errno, const char* f, const char* s );
 void kwipe_log_OSinfo();
 int kwipe_log_sysinfo();
 void kwipe_log_summary( kwipe_context_t**, int );  // This produces the wipe status table on exit
 
+/**
+ * The outcome of the wipe of a drive as the summary table, the certificate and --progress-json give it.
+ * @return "ERASED", "FAILED", "ABORTED", "UNWRITTEN" if the --io backend didn't write the drive, or
+ *         "INSANITY" for a drive in none of those states, which is a bug
+ */
+const char* kwipe_log_wipe_status( kwipe_context_t* c );
+
 #endif /* LOGGING_H_ */
@@ -47,6 +47,10 @@
 #include "options.h"
 #include "pass.h"
 #include "logging.h"
+#include "stats.h"
+#include "event.h"
+#include "shared_stream.h"
+#include "sanitize.h"
 
 /*
  * Comment Legend
@@ -68,6 +72,9 @@ const char* kwipe_one_label = "Fill With Ones";
 const char* kwipe_verify_zero_label = "Verify Zeros (0x00)";
 const char* kwipe_verify_one_label = "Verify Ones  (0xFF)";
 const char* kwipe_is5enh_label = "HMG IS5 Enhanced";
+const char* kwipe_sanitize_crypto_label = "Sanitize Crypto Erase";
+const char* kwipe_sanitize_block_label = "Sanitize Block Erase";
+const char* kwipe_sanitize_overwrite_label = "Sanitize Overwrite";
 
 const char* kwipe_unknown_label = "Unknown Method (FIXME)";
 
@@ -118,12 +125,41 @@ const char* kwipe_method_label( void* method )
     {
         return kwipe_is5enh_label;
     }
+    if( method == &kwipe_sanitize_crypto )
+    {
+        return kwipe_sanitize_crypto_label;
+    }
+    if( method == &kwipe_sanitize_block )
+    {
+        return kwipe_sanitize_block_label;
+    }
+    if( method == &kwipe_sanitize_overwrite )
+    {
+        return kwipe_sanitize_overwrite_label;
+    }
 
     /* else */
     return kwipe_unknown_label;
 
 } /* kwipe_method_label */
 
+static int kwipe_method_cancelled( kwipe_context_t* c )
+{
+    /**
+     * Returns 1 if kwipe_runmethod() stopped because main() cancelled the wipe. The result
+     * is cleared as the wipe did not fail, it was aborted by the user.
+     */
+
+    if( c->result != NWIPE_CANCELLED )
+    {
+        return 0;
+    }
+
+    c->result = 0;
+    return 1;
+
+} /* kwipe_method_cancelled */
+
 void* kwipe_zero( void* ptr )
 {
     /**
@@ -148,6 +184,12 @@ void* kwipe_zero( void* ptr )
     /* Run the method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -181,6 +223,12 @@ void* kwipe_one( void* ptr )
     /* Run the method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -211,6 +259,12 @@ void* kwipe_verify_zero( void* ptr )
     /* Run the method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -241,6 +295,12 @@ void* kwipe_verify_one( void* ptr )
     /* Run the method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -315,6 +375,12 @@ void* kwipe_dod522022m( void* ptr )
     /* Run the DoD 5220.22-M method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -383,6 +449,12 @@ void* kwipe_dodshort( void* ptr )
     /* Run the DoD 5220.022-M short method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -518,6 +590,12 @@ void* kwipe_gutmann( void* ptr )
     /* Run the Gutmann method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -686,6 +764,12 @@ void* kwipe_ops2( void* ptr )
 
     /* We're done. */
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -711,6 +795,12 @@ void* kwipe_is5enh( void* ptr )
                                    { 0, NULL } };
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     c->wipe_status = 0;
 
     /* get current time at the end of the wipe  */
@@ -741,6 +831,12 @@ void* kwipe_random( void* ptr )
     /* Run the method. */
     c->result = kwipe_runmethod( c, patterns );
 
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
     /* Finished. Set the wipe_status flag so that the GUI knows */
     c->wipe_status = 0;
 
@@ -750,6 +846,108 @@ void* kwipe_random( void* ptr )
     return NULL;
 } /* kwipe_random */
 
+void* kwipe_sanitize_crypto( void* ptr )
+{
+    /**
+     * Have the drive change its media encryption key, its own cryptographic erase.
+     *
+     */
+
+    kwipe_context_t* c;
+    c = (kwipe_context_t*) ptr;
+
+    /* get current time at the start of the wipe  */
+    time( &c->start_time );
+
+    /* set wipe in progress flag for GUI */
+    c->wipe_status = 1;
+
+    /* Run the sanitize operation. */
+    c->result = kwipe_sanitize( c, NWIPE_SANITIZE_CRYPTO );
+
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
+    /* Finished. Set the wipe_status flag so that the GUI knows */
+    c->wipe_status = 0;
+
+    /* get current time at the end of the wipe  */
+    time( &c->end_time );
+
+    return NULL;
+} /* kwipe_sanitize_crypto */
+
+void* kwipe_sanitize_block( void* ptr )
+{
+    /**
+     * Have the drive erase every block of its media, spare blocks included.
+     *
+     */
+
+    kwipe_context_t* c;
+    c = (kwipe_context_t*) ptr;
+
+    /* get current time at the start of the wipe  */
+    time( &c->start_time );
+
+    /* set wipe in progress flag for GUI */
+    c->wipe_status = 1;
+
+    /* Run the sanitize operation. */
+    c->result = kwipe_sanitize( c, NWIPE_SANITIZE_BLOCK );
+
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
+    /* Finished. Set the wipe_status flag so that the GUI knows */
+    c->wipe_status = 0;
+
+    /* get current time at the end of the wipe  */
+    time( &c->end_time );
+
+    return NULL;
+} /* kwipe_sanitize_block */
+
+void* kwipe_sanitize_overwrite( void* ptr )
+{
+    /**
+     * Have the drive overwrite its media with zeros, spare blocks included.
+     *
+     */
+
+    kwipe_context_t* c;
+    c = (kwipe_context_t*) ptr;
+
+    /* get current time at the start of the wipe  */
+    time( &c->start_time );
+
+    /* set wipe in progress flag for GUI */
+    c->wipe_status = 1;
+
+    /* Run the sanitize operation. */
+    c->result = kwipe_sanitize( c, NWIPE_SANITIZE_OVERWRITE );
+
+    /* A cancelled wipe is left in progress so that it is reported as aborted. */
+    if( kwipe_method_cancelled( c ) )
+    {
+        return NULL;
+    }
+
+    /* Finished. Set the wipe_status flag so that the GUI knows */
+    c->wipe_status = 0;
+
+    /* get current time at the end of the wipe  */
+    time( &c->end_time );
+
+    return NULL;
+} /* kwipe_sanitize_overwrite */
+
 int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
 {
     /**
@@ -766,6 +964,9 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
     /* Variable to track if it is the last pass */
     int lastpass = 0;
 
+    /* The time taken by the method in milliseconds. */
+    u64 elapsed_ms;
+
     i = 0;
 
     /* The zero-fill pattern for the final pass of most methods. */
@@ -774,6 +975,9 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
     /* The one-fill pattern for verification of the ones fill */
     kwipe_pattern_t pattern_one = { 1, "\xFF" };
 
+    /* The throughput and ETA are measured from here, see stats.c */
+    c->start_ns = kwipe_time_ns();
+
     /* Create the PRNG state buffer. */
     c->prng_seed.length = NWIPE_KNOB_PRNG_STATE_LENGTH;
     c->prng_seed.s = malloc( c->prng_seed.length );
@@ -805,6 +1009,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
     if( kwipe_options.method == &kwipe_verify_zero || kwipe_options.method == &kwipe_verify_one )
     {
         c->round_size = c->device_size;
+        c->round_verify_size = c->device_size;
     }
 
     /* Initialize the working round counter. */
@@ -863,7 +1068,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
                 c->pass_type = NWIPE_PASS_NONE;
 
                 /* Log number of bytes written to disk */
-                kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->pass_done, c->device_name );
+                kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->progress.pass_done, c->device_name );
 
                 /* Check for a fatal error. */
                 if( r < 0 )
@@ -887,7 +1092,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
                     r = kwipe_static_verify( c, &patterns[i] );
                     c->pass_type = NWIPE_PASS_NONE;
 
-                    kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->pass_done, c->device_name );
+                    kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->progress.pass_done, c->device_name );
 
                     /* Check for a fatal error. */
                     if( r < 0 )
@@ -910,8 +1115,21 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
             {
                 c->pass_type = NWIPE_PASS_WRITE;
 
-                /* Seed the PRNG. */
-                r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+                /* All the drives write the same stream with --shared-stream, see shared_stream.c */
+                if( kwipe_options.shared_stream )
+                {
+                    if( kwipe_shared_stream_seed( c ) != 0 )
+                    {
+                        c->pass_type = NWIPE_PASS_NONE;
+                        return -1;
+                    }
+                    r = c->prng_seed.length;
+                }
+                else
+                {
+                    /* Seed the PRNG. */
+                    r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+                }
 
                 /* Check the result. */
                 if( r < 0 )
@@ -935,7 +1153,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
                 c->pass_type = NWIPE_PASS_NONE;
 
                 /* Log number of bytes written to disk */
-                kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->pass_done, c->device_name );
+                kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->progress.pass_done, c->device_name );
 
                 /* Check for a fatal error. */
                 if( r < 0 )
@@ -961,7 +1179,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
                     r = kwipe_random_verify( c );
                     c->pass_type = NWIPE_PASS_NONE;
 
-                    kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->pass_done, c->device_name );
+                    kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->progress.pass_done, c->device_name );
 
                     /* Check for a fatal error. */
                     if( r < 0 )
@@ -1013,8 +1231,19 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
         /* Tell the parent that we are running the final pass. */
         c->pass_type = NWIPE_PASS_FINAL_OPS2;
 
-        /* Seed the PRNG. */
-        r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+        if( kwipe_options.shared_stream )
+        {
+            if( kwipe_shared_stream_seed( c ) != 0 )
+            {
+                return -1;
+            }
+            r = c->prng_seed.length;
+        }
+        else
+        {
+            /* Seed the PRNG. */
+            r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+        }
 
         /* Check the result. */
         if( r < 0 )
@@ -1037,7 +1266,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
         /* The final ops2 pass. */
         r = kwipe_random_pass( c );
 
-        kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->pass_done, c->device_name );
+        kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->progress.pass_done, c->device_name );
 
         /* Check for a fatal error. */
         if( r < 0 )
@@ -1052,7 +1281,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
             /* Verify the final zero pass. */
             r = kwipe_random_verify( c );
 
-            kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->pass_done, c->device_name );
+            kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->progress.pass_done, c->device_name );
 
             /* Check for a fatal error. */
             if( r < 0 )
@@ -1126,7 +1355,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
         r = kwipe_static_pass( c, &pattern_zero );
 
         /* Log number of bytes written to disk */
-        kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->pass_done, c->device_name );
+        kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes written to %s", c->progress.pass_done, c->device_name );
 
         /* Check for a fatal error. */
         if( r < 0 )
@@ -1144,7 +1373,7 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
             c->pass_type = NWIPE_PASS_NONE;
 
             /* Log number of bytes read from disk */
-            kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->pass_done, c->device_name );
+            kwipe_log( NWIPE_LOG_NOTICE, "%llu bytes read from %s", c->progress.pass_done, c->device_name );
 
             /* Check for a fatal error. */
             if( r < 0 )
@@ -1173,6 +1402,29 @@ int kwipe_runmethod( kwipe_context_t* c, kwipe_pattern_t* patterns )
 
     } /* final blank */
 
+    /* Release the flash of an SSD that has been wiped successfully, see kwipe_discard(). The verify
+     * methods only read the device, so they leave it as it is. */
+    if( kwipe_options.discard && kwipe_options.method != &kwipe_verify_zero
+        && kwipe_options.method != &kwipe_verify_one && c->pass_errors == 0 && c->verify_errors == 0 )
+    {
+        r = kwipe_discard( c );
+
+        /* Check for a fatal error. */
+        if( r < 0 )
+        {
+            return r;
+        }
+    }
+
+    /* The bytes the passes moved and the time they took, to the millisecond, for comparing builds, see bench/ */
+    elapsed_ms = ( kwipe_time_ns() - c->start_ns ) / 1000000;
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "%llu bytes in %llu.%03llu seconds on %s",
+               c->progress.round_done,
+               elapsed_ms / 1000,
+               elapsed_ms % 1000,
+               c->device_name );
+
     /* Release the state buffer. */
     c->prng_seed.length = 0;
     free( c->prng_seed.s );
@@ -1255,9 +1507,14 @@ void calculate_round_size( kwipe_context_t* c )
      * or it equals -1 which means no extra calculations are required that are method specific
      */
 
+    /* Alongside round_size we keep count of how many of its bytes are read back by verification passes,
+     * so the ETA can allow for reads and writes running at different speeds. */
+    c->round_verify_size = 0;
+
     if( kwipe_options.verify == NWIPE_VERIFY_ALL )
     {
         /* We must read back all passes, so double the byte count. */
+        c->round_verify_size = c->pass_size * kwipe_options.rounds;
         c->pass_size *= 2;
     }
 
@@ -1281,6 +1538,7 @@ void calculate_round_size( kwipe_context_t* c )
         if( kwipe_options.verify == NWIPE_VERIFY_LAST || kwipe_options.verify == NWIPE_VERIFY_ALL )
         {
             c->round_size += c->device_size;
+            c->round_verify_size += c->device_size;
         }
     }
     else
@@ -1289,6 +1547,7 @@ void calculate_round_size( kwipe_context_t* c )
         if( kwipe_options.verify == NWIPE_VERIFY_LAST )
         {
             c->round_size += c->device_size;
+            c->round_verify_size += c->device_size;
         }
     }
 
@@ -1312,6 +1571,7 @@ void calculate_round_size( kwipe_context_t* c )
             if( kwipe_options.verify == NWIPE_VERIFY_ALL || kwipe_options.verify == NWIPE_VERIFY_LAST )
             {
                 c->round_size += c->device_size;
+                c->round_verify_size += c->device_size;
             }
 
             /* As no final zero blanking pass is permitted by this standard reduce round size if it's selected */
@@ -1324,6 +1584,7 @@ void calculate_round_size( kwipe_context_t* c )
                 if( kwipe_options.verify == NWIPE_VERIFY_ALL || kwipe_options.verify == NWIPE_VERIFY_LAST )
                 {
                     c->round_size -= c->device_size;
+                    c->round_verify_size -= c->device_size;
                 }
             }
             else
@@ -1332,6 +1593,7 @@ void calculate_round_size( kwipe_context_t* c )
                 {
                     /* If blanking off & verification on reduce round size */
                     c->round_size -= c->device_size;
+                    c->round_verify_size -= c->device_size;
                 }
             }
 
@@ -1372,12 +1634,14 @@ void calculate_round_size( kwipe_context_t* c )
             if( kwipe_options.verify == NWIPE_VERIFY_LAST && kwipe_options.noblank == 1 )
             {
                 c->round_size -= c->device_size;
+                c->round_verify_size -= c->device_size;
             }
 
             /* Adjusts for verify on every third pass multiplied by number of rounds */
             if( kwipe_options.verify != NWIPE_VERIFY_ALL )
             {
                 c->round_size += ( c->device_size * c->round_count );
+                c->round_verify_size += ( c->device_size * c->round_count );
             }
 
             break;
@@ -54,6 +54,9 @@ void* kwipe_zero( void* ptr );
 void* kwipe_one( void* ptr );
 void* kwipe_verify_zero( void* ptr );
 void* kwipe_verify_one( void* ptr );
+void* kwipe_sanitize_crypto( void* ptr );
+void* kwipe_sanitize_block( void* ptr );
+void* kwipe_sanitize_overwrite( void* ptr );
 
 void calculate_round_size( kwipe_context_t* );
 
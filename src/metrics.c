@@ -0,0 +1,577 @@
+/*
+ *  metrics.c: Publishing the progress of the wipes as Prometheus metrics.
+ *
+ *  A thread of its own renders the gauges and counters of every drive in the Prometheus text
+ *  exposition format. It serves them to each connection on the Unix socket of --metrics-socket,
+ *  plain or as the reply to an HTTP GET, and every --metrics-interval seconds writes them to the
+ *  file of --metrics-file, for the textfile collector of node_exporter. The file is written under
+ *  a temporary name and renamed over the old one, so a scrape never sees half of it.
+ *
+ *  The wipe threads are never blocked. The counters of each drive are copied with
+ *  kwipe_progress_snapshot(), which only retries while a wipe thread is half way through an
+ *  update, and the latency histograms, which only their wipe thread writes, are copied as
+ *  they are, at worst a call out of date.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <math.h>
+#include <limits.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "latency.h"
+#include "temperature.h"
+#include "stats.h"
+#include "publish.h"
+#include "metrics.h"
+
+/* The gauges and counters with a single value per drive, in the order they are rendered */
+typedef enum kwipe_metric_t_ {
+    NWIPE_METRIC_SIZE = 0,
+    NWIPE_METRIC_STATE,
+    NWIPE_METRIC_RESULT,
+    NWIPE_METRIC_ROUND,
+    NWIPE_METRIC_ROUNDS,
+    NWIPE_METRIC_PASS,
+    NWIPE_METRIC_PASSES,
+    NWIPE_METRIC_PASS_DONE,
+    NWIPE_METRIC_ROUND_DONE,
+    NWIPE_METRIC_ROUND_SIZE,
+    NWIPE_METRIC_PERCENT,
+    NWIPE_METRIC_WRITTEN,
+    NWIPE_METRIC_READ,
+    NWIPE_METRIC_ERASED,
+    NWIPE_METRIC_THROUGHPUT,
+    NWIPE_METRIC_THROUGHPUT_AVERAGE,
+    NWIPE_METRIC_ETA,
+    NWIPE_METRIC_PASS_ERRORS,
+    NWIPE_METRIC_VERIFY_ERRORS,
+    NWIPE_METRIC_FDATASYNC_ERRORS,
+    NWIPE_METRIC_TEMPERATURE,
+    NWIPE_METRICS  // The number of metrics, not a metric.
+} kwipe_metric_t;
+
+typedef struct
+{
+    const char* name;
+    const char* label;  // An extra label of the sample, NULL if none.
+    const char* type;
+    const char* help;  // Printed once for samples of the same name.
+} kwipe_metric_desc_t;
+
+static const kwipe_metric_desc_t kwipe_metric_descs[NWIPE_METRICS] = {
+    { "kwipe_device_size_bytes", NULL, "gauge", "Size of the device." },
+    { "kwipe_state", NULL, "gauge", "Wipe state, -1 = not yet started, 1 = wiping, 0 = finished." },
+    { "kwipe_result", NULL, "gauge", "Return value of the wipe method once finished, 0 = success." },
+    { "kwipe_round", NULL, "gauge", "Round being wiped, from 1." },
+    { "kwipe_rounds", NULL, "gauge", "Rounds of the method to wipe." },
+    { "kwipe_pass", NULL, "gauge", "Pass of the method being wiped, from 1." },
+    { "kwipe_passes", NULL, "gauge", "Passes of the method in each round." },
+    { "kwipe_pass_done_bytes", NULL, "gauge", "Bytes written or verified in the current pass." },
+    { "kwipe_round_done_bytes", NULL, "gauge", "Bytes written or verified across all rounds." },
+    { "kwipe_round_size_bytes", NULL, "gauge", "Bytes to write or verify across all rounds." },
+    { "kwipe_done_percent", NULL, "gauge", "Percentage of the wipe done across all rounds." },
+    { "kwipe_written_bytes_total", NULL, "counter", "Bytes written to the device by the passes." },
+    { "kwipe_read_bytes_total", NULL, "counter", "Bytes read back from the device by the verifications." },
+    { "kwipe_erased_bytes", NULL, "gauge", "Bytes of the device erased at least once." },
+    { "kwipe_throughput_bytes_per_second", NULL, "gauge", "Throughput over the last 10 seconds." },
+    { "kwipe_average_throughput_bytes_per_second", NULL, "gauge", "Throughput since the start of the wipe." },
+    { "kwipe_eta_seconds", NULL, "gauge", "Estimated time until the wipe finishes." },
+    { "kwipe_errors_total", "type=\"pass\"", "counter", "Errors by type." },
+    { "kwipe_errors_total", "type=\"verify\"", "counter", "Errors by type." },
+    { "kwipe_errors_total", "type=\"fdatasync\"", "counter", "Errors by type." },
+    { "kwipe_temperature_celsius", NULL, "gauge", "Temperature of the drive." },
+};
+
+static const char* kwipe_metric_latency_ops[NWIPE_LATENCY_OPS] = { "write", "read", "sync" };
+
+static const double kwipe_metric_quantiles[] = { 0.5, 0.9, 0.99 };
+
+#define NWIPE_METRICS_QUANTILES ( sizeof( kwipe_metric_quantiles ) / sizeof( kwipe_metric_quantiles[0] ) )
+
+/* Room for device="...",serial="..." with every character escaped */
+#define NWIPE_METRICS_LABELS_LENGTH 600
+
+/* What is rendered of a drive, copied from its context in one go */
+typedef struct
+{
+    char labels[NWIPE_METRICS_LABELS_LENGTH];  // device="...",serial="..."
+    double value[NWIPE_METRICS];  // NAN where there is no value, e.g. no temperature.
+    kwipe_latency_t latency[NWIPE_LATENCY_OPS];
+} kwipe_metrics_drive_t;
+
+static kwipe_context_t** metrics_c;
+static int metrics_count;
+static kwipe_metrics_drive_t* metrics_drives;
+static kwipe_publish_text_t metrics_text;
+static int metrics_listen_fd = -1;
+static kwipe_publish_thread_t metrics_thread = NWIPE_PUBLISH_THREAD_INITIALIZER;
+
+static void kwipe_metrics_labels( char* labels, const char* name, const char* value, int first )
+{
+    size_t length = strlen( labels );
+
+    length += snprintf( labels + length, NWIPE_METRICS_LABELS_LENGTH - length, "%s%s=\"", first ? "" : ",", name );
+    length +=
+        kwipe_publish_escape( labels + length, NWIPE_METRICS_LABELS_LENGTH - length, value, NWIPE_PUBLISH_PROMETHEUS );
+    snprintf( labels + length, NWIPE_METRICS_LABELS_LENGTH - length, "\"" );
+}
+
+static void kwipe_metrics_snapshot( kwipe_metrics_drive_t* d, kwipe_context_t* c )
+{
+    kwipe_progress_t progress;
+    double* v = d->value;
+
+    /* Take a copy, the wipe thread keeps updating the counters. */
+    kwipe_progress_snapshot( c, &progress );
+
+    d->labels[0] = 0;
+    kwipe_metrics_labels( d->labels, "device", c->device_name, 1 );
+    kwipe_metrics_labels( d->labels, "serial", c->device_serial_no, 0 );
+
+    v[NWIPE_METRIC_SIZE] = (double) c->device_size;
+    v[NWIPE_METRIC_STATE] = c->wipe_status;
+    v[NWIPE_METRIC_RESULT] = c->wipe_status == 0 ? c->result : NAN;
+    v[NWIPE_METRIC_ROUND] = c->round_working;
+    v[NWIPE_METRIC_ROUNDS] = c->round_count;
+    v[NWIPE_METRIC_PASS] = c->pass_working;
+    v[NWIPE_METRIC_PASSES] = c->pass_count;
+    v[NWIPE_METRIC_PASS_DONE] = (double) progress.pass_done;
+    v[NWIPE_METRIC_ROUND_DONE] = (double) progress.round_done;
+    v[NWIPE_METRIC_ROUND_SIZE] = (double) c->round_size;
+    v[NWIPE_METRIC_PERCENT] = kwipe_progress_percent( c, &progress );
+    v[NWIPE_METRIC_WRITTEN] = (double) progress.bytes_written;
+    v[NWIPE_METRIC_READ] = (double) progress.bytes_read;
+    v[NWIPE_METRIC_ERASED] = (double) progress.bytes_erased;
+    v[NWIPE_METRIC_THROUGHPUT] = (double) c->throughput;
+    v[NWIPE_METRIC_THROUGHPUT_AVERAGE] = (double) c->throughput_overall;
+    v[NWIPE_METRIC_ETA] = c->wipe_status == 1 ? (double) c->eta : NAN;
+    v[NWIPE_METRIC_PASS_ERRORS] = (double) c->pass_errors;
+    v[NWIPE_METRIC_VERIFY_ERRORS] = (double) c->verify_errors;
+    v[NWIPE_METRIC_FDATASYNC_ERRORS] = (double) c->fsyncdata_errors;
+    v[NWIPE_METRIC_TEMPERATURE] = c->temp1_input != NO_TEMPERATURE_DATA ? c->temp1_input : NAN;
+
+    memcpy( d->latency, c->latency, sizeof( d->latency ) );
+}
+
+static void kwipe_metrics_render( kwipe_publish_text_t* t )
+{
+    const kwipe_metric_desc_t* desc;
+    const kwipe_latency_t* h;
+    const char* previous = NULL;
+    size_t q;
+    int op;
+    int m;
+    int i;
+
+    for( i = 0; i < metrics_count; i++ )
+    {
+        kwipe_metrics_snapshot( &metrics_drives[i], metrics_c[i] );
+    }
+
+    t->length = 0;
+    t->failed = 0;
+
+    kwipe_publish_printf( t, "# HELP kwipe_device_info Device being wiped, the value is always 1.\n" );
+    kwipe_publish_printf( t, "# TYPE kwipe_device_info gauge\n" );
+    for( i = 0; i < metrics_count; i++ )
+    {
+        char labels[NWIPE_METRICS_LABELS_LENGTH];
+
+        strcpy( labels, metrics_drives[i].labels );
+        kwipe_metrics_labels( labels, "model", metrics_c[i]->device_model, 0 );
+        kwipe_metrics_labels( labels, "bus", metrics_c[i]->device_type_str, 0 );
+        kwipe_publish_printf( t, "kwipe_device_info{%s} 1\n", labels );
+    }
+
+    for( m = 0; m < NWIPE_METRICS; m++ )
+    {
+        desc = &kwipe_metric_descs[m];
+        if( previous == NULL || strcmp( previous, desc->name ) != 0 )
+        {
+            kwipe_publish_printf( t, "# HELP %s %s\n# TYPE %s %s\n", desc->name, desc->help, desc->name, desc->type );
+            previous = desc->name;
+        }
+
+        for( i = 0; i < metrics_count; i++ )
+        {
+            if( isnan( metrics_drives[i].value[m] ) )
+            {
+                continue;
+            }
+            kwipe_publish_printf( t,
+                                  "%s{%s%s%s} %.17g\n",
+                                  desc->name,
+                                  metrics_drives[i].labels,
+                                  desc->label ? "," : "",
+                                  desc->label ? desc->label : "",
+                                  metrics_drives[i].value[m] );
+        }
+    }
+
+    /* The latencies of the calls to the device, as a summary for each type of call */
+    kwipe_publish_printf( t, "# HELP kwipe_io_latency_seconds Latency of the reads, writes and syncs.\n" );
+    kwipe_publish_printf( t, "# TYPE kwipe_io_latency_seconds summary\n" );
+    for( op = 0; op < NWIPE_LATENCY_OPS; op++ )
+    {
+        for( i = 0; i < metrics_count; i++ )
+        {
+            h = &metrics_drives[i].latency[op];
+            if( h->count == 0 )
+            {
+                continue;
+            }
+            for( q = 0; q < NWIPE_METRICS_QUANTILES; q++ )
+            {
+                kwipe_publish_printf( t,
+                                      "kwipe_io_latency_seconds{%s,op=\"%s\",quantile=\"%g\"} %.9f\n",
+                                      metrics_drives[i].labels,
+                                      kwipe_metric_latency_ops[op],
+                                      kwipe_metric_quantiles[q],
+                                      kwipe_latency_percentile( h, kwipe_metric_quantiles[q] * 100 ) / 1e9 );
+            }
+            kwipe_publish_printf( t,
+                                  "kwipe_io_latency_seconds_sum{%s,op=\"%s\"} %.9f\n",
+                                  metrics_drives[i].labels,
+                                  kwipe_metric_latency_ops[op],
+                                  h->total_ns / 1e9 );
+            kwipe_publish_printf( t,
+                                  "kwipe_io_latency_seconds_count{%s,op=\"%s\"} %llu\n",
+                                  metrics_drives[i].labels,
+                                  kwipe_metric_latency_ops[op],
+                                  h->count );
+        }
+    }
+
+    kwipe_publish_printf( t, "# HELP kwipe_io_latency_max_seconds Slowest read, write or sync.\n" );
+    kwipe_publish_printf( t, "# TYPE kwipe_io_latency_max_seconds gauge\n" );
+    for( op = 0; op < NWIPE_LATENCY_OPS; op++ )
+    {
+        for( i = 0; i < metrics_count; i++ )
+        {
+            h = &metrics_drives[i].latency[op];
+            if( h->count == 0 )
+            {
+                continue;
+            }
+            kwipe_publish_printf( t,
+                                  "kwipe_io_latency_max_seconds{%s,op=\"%s\"} %.9f\n",
+                                  metrics_drives[i].labels,
+                                  kwipe_metric_latency_ops[op],
+                                  h->max_ns / 1e9 );
+        }
+    }
+}
+
+/* Writes all of data to the file, or sends it to the socket without raising SIGPIPE if the client has gone. */
+static int kwipe_metrics_write_all( int fd, int is_socket, const char* data, size_t length )
+{
+    ssize_t r;
+
+    while( length > 0 )
+    {
+        if( is_socket )
+        {
+            r = send( fd, data, length, MSG_NOSIGNAL );
+        }
+        else
+        {
+            r = write( fd, data, length );
+        }
+        if( r < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            return -1;
+        }
+        data += r;
+        length -= r;
+    }
+
+    return 0;
+}
+
+/* Writes the metrics to a temporary file beside --metrics-file and renames it over it. */
+static void kwipe_metrics_write_file( void )
+{
+    char path[PATH_MAX];
+    int fd;
+
+    kwipe_metrics_render( &metrics_text );
+    if( metrics_text.failed )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to allocate memory for the metrics." );
+        return;
+    }
+
+    snprintf( path, sizeof( path ), "%s.tmp", kwipe_options.metrics_file );
+
+    fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if( fd < 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "open" );
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to create %s.", path );
+        return;
+    }
+
+    if( kwipe_metrics_write_all( fd, 0, metrics_text.text, metrics_text.length ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "write" );
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to write %s.", path );
+        close( fd );
+        unlink( path );
+        return;
+    }
+    close( fd );
+
+    if( rename( path, kwipe_options.metrics_file ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "rename" );
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to rename %s to %s.", path, kwipe_options.metrics_file );
+        unlink( path );
+    }
+}
+
+/* Answers a connection to --metrics-socket, with an HTTP response if it sent an HTTP request. */
+static void kwipe_metrics_serve( int fd )
+{
+    static const char http_header[] = "HTTP/1.0 200 OK\r\n"
+                                      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                      "Connection: close\r\n\r\n";
+    struct timeval timeout = { 1, 0 };
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    char request[512];
+    ssize_t r = 0;
+    int http = 0;
+    int head = 0;
+
+    /* A slow client holds up only this thread, and not for long. */
+    setsockopt( fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof( timeout ) );
+
+    /* A client that sends nothing, e.g. socat or nc, is given the metrics straight away. */
+    if( poll( &pfd, 1, 100 ) > 0 )
+    {
+        r = recv( fd, request, sizeof( request ) - 1, MSG_DONTWAIT );
+    }
+    if( r > 0 )
+    {
+        request[r] = 0;
+        head = strncmp( request, "HEAD ", 5 ) == 0;
+        http = head || strncmp( request, "GET ", 4 ) == 0;
+    }
+
+    kwipe_metrics_render( &metrics_text );
+    if( metrics_text.failed )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to allocate memory for the metrics." );
+        return;
+    }
+
+    if( http && kwipe_metrics_write_all( fd, 1, http_header, sizeof( http_header ) - 1 ) != 0 )
+    {
+        return;
+    }
+    if( !head )
+    {
+        kwipe_metrics_write_all( fd, 1, metrics_text.text, metrics_text.length );
+    }
+}
+
+static void* kwipe_metrics_thread( void* ptr )
+{
+    struct pollfd pfd[2];
+    u64 interval_ns = (u64) kwipe_options.metrics_interval * 1000000000ULL;
+    u64 next_ns = 0;
+    u64 now_ns;
+    int timeout_ms;
+    int fd;
+
+    (void) ptr;
+
+    pfd[0].fd = metrics_thread.stop_pipe[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = metrics_listen_fd;
+    pfd[1].events = POLLIN;
+
+    for( ;; )
+    {
+        timeout_ms = -1;
+        if( kwipe_options.metrics_file != NULL )
+        {
+            now_ns = kwipe_time_ns();
+            if( now_ns >= next_ns )
+            {
+                kwipe_metrics_write_file();
+                next_ns = now_ns + interval_ns;
+            }
+            timeout_ms = (int) ( ( next_ns - now_ns + 999999 ) / 1000000 );
+        }
+
+        pfd[0].revents = 0;
+        pfd[1].revents = 0;
+        if( poll( pfd, metrics_listen_fd >= 0 ? 2 : 1, timeout_ms ) < 0 && errno != EINTR )
+        {
+            kwipe_perror( errno, __FUNCTION__, "poll" );
+            break;
+        }
+
+        if( pfd[0].revents )
+        {
+            break;
+        }
+
+        if( pfd[1].revents & POLLIN )
+        {
+            fd = accept4( metrics_listen_fd, NULL, NULL, SOCK_CLOEXEC );
+            if( fd >= 0 )
+            {
+                kwipe_metrics_serve( fd );
+                close( fd );
+            }
+        }
+    }
+
+    /* Record the results of the wipes */
+    if( kwipe_options.metrics_file != NULL )
+    {
+        kwipe_metrics_write_file();
+    }
+
+    return NULL;
+}
+
+static int kwipe_metrics_listen( const char* path )
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    memset( &addr, 0, sizeof( addr ) );
+    addr.sun_family = AF_UNIX;
+    if( strlen( path ) >= sizeof( addr.sun_path ) )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: The socket path %s is too long.", path );
+        return -1;
+    }
+    strcpy( addr.sun_path, path );
+
+    /* Replace the socket left behind by a kwipe that didn't exit cleanly, but nothing else. */
+    if( lstat( path, &st ) == 0 )
+    {
+        if( !S_ISSOCK( st.st_mode ) )
+        {
+            kwipe_log( NWIPE_LOG_ERROR, "metrics: %s exists and isn't a socket.", path );
+            return -1;
+        }
+        unlink( path );
+    }
+
+    fd = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0 );
+    if( fd < 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "socket" );
+        return -1;
+    }
+
+    if( bind( fd, (struct sockaddr*) &addr, sizeof( addr ) ) != 0 || chmod( path, 0660 ) != 0
+        || listen( fd, 16 ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "bind" );
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to listen on %s.", path );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+int kwipe_metrics_start( kwipe_context_t** c, int count )
+{
+    if( kwipe_options.metrics_socket == NULL && kwipe_options.metrics_file == NULL )
+    {
+        return 0;
+    }
+
+    metrics_c = c;
+    metrics_count = count;
+    metrics_drives = calloc( count > 0 ? count : 1, sizeof( kwipe_metrics_drive_t ) );
+    if( metrics_drives == NULL )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "metrics: Unable to allocate memory for the metrics." );
+        return -1;
+    }
+
+    if( kwipe_options.metrics_socket != NULL )
+    {
+        metrics_listen_fd = kwipe_metrics_listen( kwipe_options.metrics_socket );
+        if( metrics_listen_fd < 0 )
+        {
+            kwipe_metrics_stop();
+            return -1;
+        }
+    }
+
+    if( kwipe_publish_start( &metrics_thread, kwipe_metrics_thread ) != 0 )
+    {
+        kwipe_metrics_stop();
+        return -1;
+    }
+
+    if( kwipe_options.metrics_socket != NULL )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "metrics: Serving the metrics on %s", kwipe_options.metrics_socket );
+    }
+    if( kwipe_options.metrics_file != NULL )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE,
+                   "metrics: Writing the metrics to %s every %i seconds",
+                   kwipe_options.metrics_file,
+                   kwipe_options.metrics_interval );
+    }
+
+    return 0;
+}
+
+void kwipe_metrics_stop( void )
+{
+    kwipe_publish_stop( &metrics_thread );
+
+    if( metrics_listen_fd >= 0 )
+    {
+        close( metrics_listen_fd );
+        metrics_listen_fd = -1;
+        unlink( kwipe_options.metrics_socket );
+    }
+
+    free( metrics_drives );
+    metrics_drives = NULL;
+    kwipe_publish_free( &metrics_text );
+}
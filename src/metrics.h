@@ -0,0 +1,42 @@
+/*
+ *  metrics.h: Publishing the progress of the wipes as Prometheus metrics.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "context.h"
+
+/* The default of --metrics-interval, in seconds */
+#define NWIPE_METRICS_DEFAULT_INTERVAL 10
+
+/**
+ * Starts the thread that publishes the metrics of the drives, on the Unix socket of --metrics-socket
+ * and in the file of --metrics-file. Does nothing if neither was given.
+ * @param c the contexts of the drives being wiped, which must outlive kwipe_metrics_stop()
+ * @param count the number of drives
+ * @return 0 on success, -1 if the socket or thread couldn't be created, the reason has been logged
+ */
+int kwipe_metrics_start( kwipe_context_t** c, int count );
+
+/**
+ * Stops the metrics thread, once the wipe threads have finished, writing the file of --metrics-file
+ * a last time with the results of the wipes and removing the socket.
+ */
+void kwipe_metrics_stop( void );
+
+#endif /* METRICS_H_ */
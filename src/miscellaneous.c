@@ -28,6 +28,7 @@
 #endif
 
 #include <stdio.h>
+#include <limits.h>
 #include "kwipe.h"
 #include "context.h"
 #include "logging.h"
@@ -664,3 +665,93 @@ void fix_endian_model_names( char* model )
         strcpy( model, tmp_string );
     }
 }
+
+const char* kwipe_find_command( const char* name )
+{
+    static struct
+    {
+        char name[NWIPE_COMMAND_PATH_LENGTH];
+        char path[NWIPE_COMMAND_PATH_LENGTH];  // Empty if the command wasn't found
+    } commands[NWIPE_COMMANDS_MAX];
+    static int commands_count = 0;
+    static pthread_mutex_t commands_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+    const char* directories[] = { "/sbin", "/usr/sbin", "/usr/bin", NULL };
+    const char* found = NULL;
+    const char* result = NULL;
+    const char* env_path;
+    const char* dir;
+    const char* end;
+    char candidate[PATH_MAX];
+    int idx;
+
+    pthread_mutex_lock( &commands_mutex );
+
+    for( idx = 0; idx < commands_count; idx++ )
+    {
+        if( strcmp( commands[idx].name, name ) == 0 )
+        {
+            found = commands[idx].path[0] != 0 ? commands[idx].path : NULL;
+            pthread_mutex_unlock( &commands_mutex );
+            return found;
+        }
+    }
+
+    /* Search the PATH first, the command is then run by name as it was when 'which' found it */
+    env_path = getenv( "PATH" );
+    for( dir = env_path; dir != NULL && *dir != 0 && found == NULL; dir = *end ? end + 1 : end )
+    {
+        end = strchr( dir, ':' );
+        if( end == NULL )
+        {
+            end = dir + strlen( dir );
+        }
+        if( end > dir )
+        {
+            snprintf( candidate, sizeof( candidate ), "%.*s/%s", (int) ( end - dir ), dir, name );
+            if( access( candidate, X_OK ) == 0 )
+            {
+                found = name;
+            }
+        }
+    }
+
+    for( idx = 0; directories[idx] != NULL && found == NULL; idx++ )
+    {
+        snprintf( candidate, sizeof( candidate ), "%s/%s", directories[idx], name );
+        if( access( candidate, X_OK ) == 0 )
+        {
+            found = candidate;
+        }
+    }
+
+    if( found != NULL && strlen( found ) >= NWIPE_COMMAND_PATH_LENGTH )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "kwipe_find_command: %s is too long a path", found );
+        found = NULL;
+    }
+
+    if( commands_count < NWIPE_COMMANDS_MAX && strlen( name ) < NWIPE_COMMAND_PATH_LENGTH )
+    {
+        strcpy( commands[commands_count].name, name );
+        strcpy( commands[commands_count].path, found != NULL ? found : "" );
+        if( found != NULL )
+        {
+            result = commands[commands_count].path;
+        }
+        commands_count++;
+    }
+    else if( found == name )
+    {
+        result = name;
+    }
+    else if( found != NULL )
+    {
+        /* Only the remembered copy outlives this call, NWIPE_COMMANDS_MAX needs raising */
+        kwipe_log( NWIPE_LOG_WARNING, "kwipe_find_command: Too many commands to remember %s", name );
+    }
+
+    pthread_mutex_unlock( &commands_mutex );
+
+    return result;
+}
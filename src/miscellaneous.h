@@ -129,4 +129,20 @@ int write_system_datetime( char*, char*, char*, char*, char*, char* );
  */
 void fix_endian_model_names( char* model );
 
+/* The most helper commands kwipe_find_command() remembers, and the longest path it can return */
+#define NWIPE_COMMANDS_MAX 16
+#define NWIPE_COMMAND_PATH_LENGTH 64
+
+/**
+ * Finds a helper command such as hdparm or smartctl, in place of running 'which' each time
+ * one is needed. The command is looked for once and the result remembered, so probing
+ * each device doesn't fork a shell for every command it runs. If the command isn't on the
+ * PATH, /sbin, /usr/sbin and /usr/bin are tried, for when the PATH environment isn't set
+ * up, i.e. Debian sid 'su' as opposed to 'su -'.
+ *
+ * @param name the name of the command
+ * @return the name if it is on the PATH, else its full path, NULL if it wasn't found
+ */
+const char* kwipe_find_command( const char* name );
+
 #endif /* HPA_DCO_H_ */
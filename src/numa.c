@@ -0,0 +1,361 @@
+/*
+ *  numa.c: Placing wipe threads on the NUMA node of the drive's controller.
+ *
+ *  On a server with more than one socket each HBA is attached to one node, and a wipe thread
+ *  left to float across sockets generates its PRNG stream in memory on one node while the
+ *  controller DMAs it from another, across the interconnect. The node of each drive is read
+ *  from the numa_node file of the first device above it in sysfs that has one, usually the
+ *  PCI function of the HBA or NVMe controller. Its wipe thread is pinned to that node's CPUs
+ *  and its memory policy set to prefer that node, so its buffers, which are allocated by the
+ *  wipe thread itself, are local to the controller.
+ *
+ *  The lowest numbered online CPU is kept for housekeeping. main() pins itself to it before
+ *  creating any other thread, so the GUI, signal and temperature threads inherit it, and the
+ *  wipe threads are kept off it whenever their node has another CPU to run on.
+ *
+ *  libnuma isn't required, everything comes from sysfs and the set_mempolicy system call.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sched.h>
+#include <pthread.h>
+#include <limits.h>
+#include <sys/syscall.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "logging.h"
+#include "numa.h"
+
+/* From linux/mempolicy.h, which isn't always installed */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+/* Bits in each word of a set_mempolicy node mask */
+#define NWIPE_NUMA_MASK_BITS ( 8 * sizeof( unsigned long ) )
+
+static int numa_enabled;
+static int numa_node_count;  // One more than the highest online node
+static cpu_set_t* numa_node_cpus;  // The CPUs wipe threads on each node may run on
+static cpu_set_t numa_other_cpus;  // For drives whose node isn't known, every CPU but housekeeping
+static cpu_set_t numa_housekeeping_cpus;
+
+static int kwipe_numa_read_list( const char* path, cpu_set_t* set )
+{
+    /* Parses a sysfs list such as "0-7,16-23" into a set. Returns the number of entries, or -1
+     * if the file can't be read.
+     */
+    FILE* fp;
+    char list[4096];
+    char* p;
+    char* end;
+    long first;
+    long last;
+
+    CPU_ZERO( set );
+
+    fp = fopen( path, "r" );
+    if( fp == NULL )
+    {
+        return -1;
+    }
+    if( fgets( list, sizeof( list ), fp ) == NULL )
+    {
+        fclose( fp );
+        return -1;
+    }
+    fclose( fp );
+
+    p = list;
+    while( *p && *p != '\n' )
+    {
+        first = strtol( p, &end, 10 );
+        if( end == p )
+        {
+            break;
+        }
+        last = first;
+        p = end;
+
+        if( *p == '-' )
+        {
+            last = strtol( p + 1, &end, 10 );
+            p = end;
+        }
+
+        for( ; first <= last && first < CPU_SETSIZE; first++ )
+        {
+            CPU_SET( first, set );
+        }
+
+        if( *p == ',' )
+        {
+            p++;
+        }
+    }
+
+    return CPU_COUNT( set );
+}
+
+static void kwipe_numa_list_text( cpu_set_t* set, char* text, size_t text_size )
+{
+    /* The reverse of kwipe_numa_read_list(), for the log */
+    size_t length = 0;
+    int first;
+    int last;
+    int i;
+
+    text[0] = 0;
+
+    for( i = 0; i < CPU_SETSIZE && length < text_size; i++ )
+    {
+        if( !CPU_ISSET( i, set ) )
+        {
+            continue;
+        }
+
+        first = i;
+        while( i + 1 < CPU_SETSIZE && CPU_ISSET( i + 1, set ) )
+        {
+            i++;
+        }
+        last = i;
+
+        if( first == last )
+        {
+            length += snprintf( text + length, text_size - length, "%s%i", length ? "," : "", first );
+        }
+        else
+        {
+            length += snprintf( text + length, text_size - length, "%s%i-%i", length ? "," : "", first, last );
+        }
+    }
+}
+
+void kwipe_numa_init( void )
+{
+    char path[PATH_MAX];
+    char text[NWIPE_NUMA_LIST_LENGTH];
+    cpu_set_t nodes;
+    cpu_set_t online;
+    int housekeeping;
+    int i;
+    int r;
+
+    if( kwipe_numa_read_list( "/sys/devices/system/node/online", &nodes ) < 2 )
+    {
+        kwipe_log( NWIPE_LOG_INFO, "NUMA: single node system, wipe threads are not pinned" );
+        return;
+    }
+
+    if( kwipe_numa_read_list( "/sys/devices/system/cpu/online", &online ) < 2 )
+    {
+        kwipe_log( NWIPE_LOG_INFO, "NUMA: single CPU online, wipe threads are not pinned" );
+        return;
+    }
+
+    for( i = 0; i < CPU_SETSIZE; i++ )
+    {
+        if( CPU_ISSET( i, &nodes ) )
+        {
+            numa_node_count = i + 1;
+        }
+    }
+
+    numa_node_cpus = calloc( numa_node_count, sizeof( cpu_set_t ) );
+    if( numa_node_cpus == NULL )
+    {
+        kwipe_perror( errno, __FUNCTION__, "calloc" );
+        kwipe_log( NWIPE_LOG_ERROR, "NUMA: unable to allocate memory, wipe threads are not pinned" );
+        return;
+    }
+
+    /* The lowest numbered CPU usually takes most of the interrupts that aren't steered, keep
+     * it for the GUI, logging and temperature threads */
+    housekeeping = 0;
+    while( !CPU_ISSET( housekeeping, &online ) )
+    {
+        housekeeping++;
+    }
+    CPU_ZERO( &numa_housekeeping_cpus );
+    CPU_SET( housekeeping, &numa_housekeeping_cpus );
+
+    numa_other_cpus = online;
+    CPU_CLR( housekeeping, &numa_other_cpus );
+
+    for( i = 0; i < numa_node_count; i++ )
+    {
+        if( !CPU_ISSET( i, &nodes ) )
+        {
+            continue;
+        }
+
+        snprintf( path, sizeof( path ), "/sys/devices/system/node/node%i/cpulist", i );
+        kwipe_numa_read_list( path, &numa_node_cpus[i] );
+        CPU_AND( &numa_node_cpus[i], &numa_node_cpus[i], &online );
+
+        /* Keep the wipe threads off the housekeeping CPU, unless it's all the node has */
+        if( CPU_ISSET( housekeeping, &numa_node_cpus[i] ) && CPU_COUNT( &numa_node_cpus[i] ) > 1 )
+        {
+            CPU_CLR( housekeeping, &numa_node_cpus[i] );
+        }
+    }
+
+    r = pthread_setaffinity_np( pthread_self(), sizeof( cpu_set_t ), &numa_housekeeping_cpus );
+    if( r != 0 )
+    {
+        kwipe_perror( r, __FUNCTION__, "pthread_setaffinity_np" );
+        kwipe_log( NWIPE_LOG_WARNING, "NUMA: unable to pin the housekeeping threads, wipe threads are not pinned" );
+        return;
+    }
+
+    numa_enabled = 1;
+
+    kwipe_numa_list_text( &nodes, text, sizeof( text ) );
+    kwipe_log( NWIPE_LOG_INFO,
+               "NUMA: nodes %s, GUI, logging and temperature threads on CPU %i",
+               text,
+               housekeeping );
+}
+
+static int kwipe_numa_node( kwipe_context_t* c )
+{
+    /* Walks up from the block device's device until a numa_node file is found, the SCSI and
+     * NVMe devices don't have one, the PCI function of their controller does.
+     */
+    char link[PATH_MAX];
+    char path[PATH_MAX];
+    char file[PATH_MAX + 16];
+    char* name;
+    char* p;
+    FILE* fp;
+    int node;
+
+    name = strrchr( c->device_name, '/' );
+    name = name ? name + 1 : c->device_name;
+
+    snprintf( link, sizeof( link ), "/sys/block/%s/device", name );
+    if( realpath( link, path ) == NULL )
+    {
+        return -1;
+    }
+
+    while( strncmp( path, "/sys/devices/", 13 ) == 0 )
+    {
+        snprintf( file, sizeof( file ), "%s/numa_node", path );
+
+        fp = fopen( file, "r" );
+        if( fp != NULL )
+        {
+            if( fscanf( fp, "%i", &node ) != 1 )
+            {
+                node = -1;
+            }
+            fclose( fp );
+            return node;
+        }
+
+        if( ( p = strrchr( path, '/' ) ) == NULL )
+        {
+            break;
+        }
+        *p = 0;
+    }
+
+    return -1;
+}
+
+void kwipe_numa_place( kwipe_context_t* c )
+{
+    char text[NWIPE_NUMA_LIST_LENGTH];
+
+    c->numa_node = -1;
+
+    if( !numa_enabled )
+    {
+        return;
+    }
+
+    c->numa_node = kwipe_numa_node( c );
+    if( c->numa_node >= numa_node_count || ( c->numa_node >= 0 && CPU_COUNT( &numa_node_cpus[c->numa_node] ) == 0 ) )
+    {
+        c->numa_node = -1;
+    }
+
+    if( c->numa_node < 0 )
+    {
+        kwipe_numa_list_text( &numa_other_cpus, text, sizeof( text ) );
+        kwipe_log( NWIPE_LOG_INFO, "NUMA: %s node unknown, wipe thread on CPUs %s", c->device_name, text );
+    }
+    else
+    {
+        kwipe_numa_list_text( &numa_node_cpus[c->numa_node], text, sizeof( text ) );
+        kwipe_log( NWIPE_LOG_INFO,
+                   "NUMA: %s on node %i, wipe thread on CPUs %s, buffers on node %i",
+                   c->device_name,
+                   c->numa_node,
+                   text,
+                   c->numa_node );
+    }
+}
+
+void kwipe_numa_bind( kwipe_context_t* c )
+{
+    unsigned long nodemask[( CPU_SETSIZE + NWIPE_NUMA_MASK_BITS - 1 ) / NWIPE_NUMA_MASK_BITS];
+    int r;
+
+    if( !numa_enabled )
+    {
+        return;
+    }
+
+    /* The thread inherited the housekeeping CPU from main(), so move it even if the node is unknown */
+    if( c->numa_node < 0 )
+    {
+        r = pthread_setaffinity_np( pthread_self(), sizeof( cpu_set_t ), &numa_other_cpus );
+        if( r != 0 )
+        {
+            kwipe_perror( r, __FUNCTION__, "pthread_setaffinity_np" );
+        }
+        return;
+    }
+
+    r = pthread_setaffinity_np( pthread_self(), sizeof( cpu_set_t ), &numa_node_cpus[c->numa_node] );
+    if( r != 0 )
+    {
+        kwipe_perror( r, __FUNCTION__, "pthread_setaffinity_np" );
+        kwipe_log( NWIPE_LOG_WARNING,
+                   "NUMA: unable to pin the wipe thread of %s to node %i",
+                   c->device_name,
+                   c->numa_node );
+    }
+
+    /* Prefer rather than bind, so the wipe carries on if the node runs short of memory */
+    memset( nodemask, 0, sizeof( nodemask ) );
+    nodemask[c->numa_node / NWIPE_NUMA_MASK_BITS] |= 1UL << ( c->numa_node % NWIPE_NUMA_MASK_BITS );
+
+    if( syscall( SYS_set_mempolicy, MPOL_PREFERRED, nodemask, sizeof( nodemask ) * 8 ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "set_mempolicy" );
+        kwipe_log(
+            NWIPE_LOG_WARNING, "NUMA: unable to prefer node %i for the buffers of %s", c->numa_node, c->device_name );
+    }
+}
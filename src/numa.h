@@ -0,0 +1,48 @@
+/*
+ *  numa.h: Placing wipe threads on the NUMA node of the drive's controller.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef NUMA_H_
+#define NUMA_H_
+
+#include "context.h"
+
+/* Enough for the CPU list of a node on a large server, longer lists are truncated in the log */
+#define NWIPE_NUMA_LIST_LENGTH 128
+
+/**
+ * Reads the NUMA topology from sysfs. On a system with more than one node it pins the calling
+ * thread, and so every thread it creates afterwards, the GUI, signal and temperature threads,
+ * to a housekeeping CPU that the wipe threads are kept off. Called early in main(), before
+ * any thread other than main() has been created.
+ */
+void kwipe_numa_init( void );
+
+/**
+ * Works out which NUMA node the drive's controller is on, sets c->numa_node and logs the CPUs
+ * its wipe thread will run on.
+ */
+void kwipe_numa_place( kwipe_context_t* c );
+
+/**
+ * Pins the calling wipe thread to the CPUs of the drive's node and prefers that node's memory
+ * for its allocations, so the I/O buffers and PRNG state are local to the controller.
+ * Called at the start of kwipe_wipe_thread(), does nothing on a single node system.
+ */
+void kwipe_numa_bind( kwipe_context_t* c );
+
+#endif /* NUMA_H_ */
@@ -28,6 +28,9 @@
 #include "logging.h"
 #include "version.h"
 #include "conf.h"
+#include "io.h"
+#include "metrics.h"
+#include "progress_json.h"
 
 /* The global options struct. */
 kwipe_options_t kwipe_options;
@@ -131,6 +134,12 @@ int kwipe_options_parse( int argc, char** argv )
         /* Whether to blank the disk after wiping. */
         { "noblank", no_argument, 0, 0 },
 
+        /* Whether to discard the blocks of an SSD after wiping. */
+        { "discard", no_argument, 0, 0 },
+
+        /* Whether to allocate the holes of regular file targets before wiping them. */
+        { "preallocate", no_argument, 0, 0 },
+
         /* Whether to ignore all USB devices. */
         { "nousb", no_argument, 0, 0 },
 
@@ -149,6 +158,45 @@ int kwipe_options_parse( int argc, char** argv )
         /* A flag to indicate whether the devices would be opened in sync mode. */
         { "sync", required_argument, 0, 0 },
 
+        /* Write back in windows with sync_file_range instead of a periodic fdatasync. */
+        { "sync-window", required_argument, 0, 0 },
+
+        /* Whether to slow down writes to drives approaching their maximum temperature. */
+        { "thermal-throttle", no_argument, 0, 0 },
+
+        /* The most wipes to run at once on one HBA, SAS expander or USB hub. */
+        { "controller-limit", required_argument, 0, 0 },
+
+        /* Whether to measure each drive to choose its write size. */
+        { "autotune", no_argument, 0, 0 },
+
+        /* Whether the random passes on all drives write one shared PRNG stream. */
+        { "shared-stream", no_argument, 0, 0 },
+
+        /* Whether to log how long each phase of start-up took. */
+        { "profile-startup", no_argument, 0, 0 },
+
+        /* The I/O backend of the passes, the device or a null or in-memory device for benchmarking. */
+        { "io", required_argument, 0, 0 },
+
+        /* Faults to inject into the I/O of the passes, to test how they handle failing media. */
+        { "io-faults", required_argument, 0, 0 },
+
+        /* The Unix socket to serve the Prometheus metrics of the wipes on. */
+        { "metrics-socket", required_argument, 0, 0 },
+
+        /* The file to write the Prometheus metrics of the wipes to, for the textfile collector. */
+        { "metrics-file", required_argument, 0, 0 },
+
+        /* The number of seconds between writes of the metrics file. */
+        { "metrics-interval", required_argument, 0, 0 },
+
+        /* The file descriptor or file to write the progress of the wipes to as JSON lines. */
+        { "progress-json", required_argument, 0, 0 },
+
+        /* The number of seconds between the JSON progress records of each drive. */
+        { "progress-json-interval", required_argument, 0, 0 },
+
         /* Verify that wipe patterns are being written to the device. */
         { "verify", required_argument, 0, 0 },
 
@@ -185,14 +233,29 @@ int kwipe_options_parse( int argc, char** argv )
         kwipe_options.prng = &kwipe_add_lagg_fibonacci_prng;
     }
 
+    kwipe_options.io = &kwipe_io_device;
+    kwipe_options.io_faults = NULL;
+    kwipe_options.metrics_socket = NULL;
+    kwipe_options.metrics_file = NULL;
+    kwipe_options.metrics_interval = NWIPE_METRICS_DEFAULT_INTERVAL;
+    kwipe_options.progress_json = NULL;
+    kwipe_options.progress_json_interval = NWIPE_PROGRESS_JSON_DEFAULT_INTERVAL;
     kwipe_options.rounds = 1;
     kwipe_options.noblank = 0;
+    kwipe_options.discard = 0;
+    kwipe_options.preallocate = 0;
     kwipe_options.nousb = 0;
     kwipe_options.nowait = 0;
     kwipe_options.nosignals = 0;
     kwipe_options.nogui = 0;
     kwipe_options.quiet = 0;
     kwipe_options.sync = DEFAULT_SYNC_RATE;
+    kwipe_options.sync_window = 0;
+    kwipe_options.thermal_throttle = 0;
+    kwipe_options.controller_limit = 0;
+    kwipe_options.autotune = 0;
+    kwipe_options.shared_stream = 0;
+    kwipe_options.profile_startup = 0;
     kwipe_options.verbose = 0;
     kwipe_options.verify = NWIPE_VERIFY_LAST;
     memset( kwipe_options.logfile, '\0', sizeof( kwipe_options.logfile ) );
@@ -307,6 +370,18 @@ int kwipe_options_parse( int argc, char** argv )
                     break;
                 }
 
+                if( strcmp( kwipe_options_long[i].name, "discard" ) == 0 )
+                {
+                    kwipe_options.discard = 1;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "preallocate" ) == 0 )
+                {
+                    kwipe_options.preallocate = 1;
+                    break;
+                }
+
                 if( strcmp( kwipe_options_long[i].name, "nousb" ) == 0 )
                 {
                     kwipe_options.nousb = 1;
@@ -338,6 +413,112 @@ int kwipe_options_parse( int argc, char** argv )
                     break;
                 }
 
+                if( strcmp( kwipe_options_long[i].name, "thermal-throttle" ) == 0 )
+                {
+                    kwipe_options.thermal_throttle = 1;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "autotune" ) == 0 )
+                {
+                    kwipe_options.autotune = 1;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "shared-stream" ) == 0 )
+                {
+                    kwipe_options.shared_stream = 1;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "profile-startup" ) == 0 )
+                {
+                    kwipe_options.profile_startup = 1;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "controller-limit" ) == 0 )
+                {
+                    if( sscanf( optarg, " %i", &kwipe_options.controller_limit ) != 1
+                        || kwipe_options.controller_limit < 0 )
+                    {
+                        fprintf( stderr, "Error: The controller-limit argument must be a positive integer or zero.\n" );
+                        exit( EINVAL );
+                    }
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "io" ) == 0 )
+                {
+                    kwipe_options.io = kwipe_io_find( optarg );
+                    if( kwipe_options.io == NULL )
+                    {
+                        fprintf( stderr, "Error: Unknown I/O backend '%s', use device, null or mem.\n", optarg );
+                        exit( EINVAL );
+                    }
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "io-faults" ) == 0 )
+                {
+                    if( kwipe_io_faults_parse( optarg, &kwipe_io_faults ) != 0 )
+                    {
+                        exit( EINVAL );
+                    }
+                    kwipe_options.io_faults = optarg;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "metrics-socket" ) == 0 )
+                {
+                    kwipe_options.metrics_socket = optarg;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "metrics-file" ) == 0 )
+                {
+                    kwipe_options.metrics_file = optarg;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "metrics-interval" ) == 0 )
+                {
+                    if( sscanf( optarg, " %i", &kwipe_options.metrics_interval ) != 1
+                        || kwipe_options.metrics_interval < 1 )
+                    {
+                        fprintf( stderr, "Error: The metrics-interval argument must be a positive integer.\n" );
+                        exit( EINVAL );
+                    }
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "progress-json" ) == 0 )
+                {
+                    kwipe_options.progress_json = optarg;
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "progress-json-interval" ) == 0 )
+                {
+                    if( sscanf( optarg, " %i", &kwipe_options.progress_json_interval ) != 1
+                        || kwipe_options.progress_json_interval < 1 )
+                    {
+                        fprintf( stderr, "Error: The progress-json-interval argument must be a positive integer.\n" );
+                        exit( EINVAL );
+                    }
+                    break;
+                }
+
+                if( strcmp( kwipe_options_long[i].name, "sync-window" ) == 0 )
+                {
+                    if( sscanf( optarg, " %i", &kwipe_options.sync_window ) != 1 || kwipe_options.sync_window < 0 )
+                    {
+                        fprintf( stderr, "Error: The sync-window argument must be a positive integer or zero.\n" );
+                        exit( EINVAL );
+                    }
+                    break;
+                }
+
                 if( strcmp( kwipe_options_long[i].name, "sync" ) == 0 )
                 {
                     if( sscanf( optarg, " %i", &kwipe_options.sync ) != 1 || kwipe_options.sync < 0 )
@@ -440,6 +621,24 @@ int kwipe_options_parse( int argc, char** argv )
                     break;
                 }
 
+                if( strcmp( optarg, "sanitize_crypto" ) == 0 )
+                {
+                    kwipe_options.method = &kwipe_sanitize_crypto;
+                    break;
+                }
+
+                if( strcmp( optarg, "sanitize_block" ) == 0 )
+                {
+                    kwipe_options.method = &kwipe_sanitize_block;
+                    break;
+                }
+
+                if( strcmp( optarg, "sanitize_overwrite" ) == 0 )
+                {
+                    kwipe_options.method = &kwipe_sanitize_overwrite;
+                    break;
+                }
+
                 /* Else we do not know this wipe method. */
                 fprintf( stderr, "Error: Unknown wipe method '%s'.\n", optarg );
                 exit( EINVAL );
@@ -643,6 +842,16 @@ void kwipe_options_log( void )
         kwipe_log( NWIPE_LOG_NOTICE, "  do not perform a final blank pass" );
     }
 
+    if( kwipe_options.discard )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  discard the blocks of SSDs after the wipe" );
+    }
+
+    if( kwipe_options.preallocate )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  preallocate regular file targets before the wipe" );
+    }
+
     if( kwipe_options.nowait )
     {
         kwipe_log( NWIPE_LOG_NOTICE, "  do not wait for a key before exiting" );
@@ -658,6 +867,31 @@ void kwipe_options_log( void )
         kwipe_log( NWIPE_LOG_NOTICE, "  do not show GUI interface" );
     }
 
+    if( kwipe_options.thermal_throttle )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  slow down writes to drives approaching their maximum temperature" );
+    }
+
+    if( kwipe_options.autotune )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  calibrate the write size of each drive on the first write pass" );
+    }
+
+    if( kwipe_options.shared_stream )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  random passes on all drives write one shared PRNG stream" );
+    }
+
+    if( kwipe_options.profile_startup )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  log the time taken by each phase of start-up" );
+    }
+
+    if( kwipe_options.controller_limit )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  run at most %i wipes at once per controller", kwipe_options.controller_limit );
+    }
+
     kwipe_log( NWIPE_LOG_NOTICE, "  banner   = %s", banner );
 
     if( kwipe_options.prng == &kwipe_twister )
@@ -690,9 +924,42 @@ void kwipe_options_log( void )
     }
 
     kwipe_log( NWIPE_LOG_NOTICE, "  method   = %s", kwipe_method_label( kwipe_options.method ) );
+    if( kwipe_options.io != &kwipe_io_device )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "  io       = %s, the drives aren't written", kwipe_options.io->label );
+    }
+    if( kwipe_options.io_faults != NULL )
+    {
+        kwipe_log( NWIPE_LOG_WARNING, "  io faults = %s", kwipe_options.io_faults );
+    }
+    if( kwipe_options.metrics_socket != NULL )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  metrics  = %s", kwipe_options.metrics_socket );
+    }
+    if( kwipe_options.metrics_file != NULL )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE,
+                   "  metrics  = %s, every %i seconds",
+                   kwipe_options.metrics_file,
+                   kwipe_options.metrics_interval );
+    }
+    if( kwipe_options.progress_json != NULL )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE,
+                   "  progress = JSON to %s, every %i seconds",
+                   kwipe_options.progress_json,
+                   kwipe_options.progress_json_interval );
+    }
     kwipe_log( NWIPE_LOG_NOTICE, "  quiet    = %i", kwipe_options.quiet );
     kwipe_log( NWIPE_LOG_NOTICE, "  rounds   = %i", kwipe_options.rounds );
-    kwipe_log( NWIPE_LOG_NOTICE, "  sync     = %i", kwipe_options.sync );
+    if( kwipe_options.sync_window )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  sync     = %i MiB write-back window", kwipe_options.sync_window );
+    }
+    else
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "  sync     = %i", kwipe_options.sync );
+    }
 
     switch( kwipe_options.verify )
     {
@@ -721,6 +988,7 @@ void display_help()
      */
 
     printf( "Usage: %s [options] [device1] [device2] ...\n", program_name );
+    printf( "A device may also be a regular file, such as a disk image.\n" );
     printf( "Options:\n" );
     /* Limit line length to a maximum of 80 characters so it looks good in 80x25 terminals i.e shredos */
     /*  ___12345678901234567890123456789012345678901234567890123456789012345678901234567890< Do not exceed */
@@ -742,6 +1010,10 @@ void display_help()
     puts( "                          1    - fdatasync after every write" );
     puts( "                                 Warning: Lower values will reduce wipe speeds." );
     puts( "                          1000 - fdatasync after 1000 writes etc.\n" );
+    puts( "      --sync-window=MIB   Instead of --sync, start write-back of every MIB" );
+    puts( "                          written and wait only on the window two back, keeps" );
+    puts( "                          the drive busy and bounds the dirty page cache." );
+    puts( "                          fdatasync at the end of each pass (default: 0, off)\n" );
     puts( "      --verify=TYPE       Whether to perform verification of erasure" );
     puts( "                          (default: last)" );
     puts( "                          off   - Do not verify" );
@@ -761,7 +1033,10 @@ void display_help()
     puts( "                          one                    - Overwrite with ones (0xFF)" );
     puts( "                          verify_zero            - Verifies disk is zero filled" );
     puts( "                          verify_one             - Verifies disk is 0xFF filled" );
-    puts( "                          is5enh                 - HMG IS5 enhanced\n" );
+    puts( "                          is5enh                 - HMG IS5 enhanced" );
+    puts( "                          sanitize_crypto        - Drive's own crypto erase" );
+    puts( "                          sanitize_block         - Drive's own block erase" );
+    puts( "                          sanitize_overwrite     - Drive's own zero overwrite\n" );
     puts( "  -l, --logfile=FILE      Filename to log to. Default is STDOUT\n" );
     puts( "  -P, --PDFreportpath=PATH Path to write PDF reports to. Default is \".\"" );
     puts( "                           If set to \"noPDF\" no PDF reports are written.\n" );
@@ -774,6 +1049,12 @@ void display_help()
     puts( "                          method (default: 1)\n" );
     puts( "      --noblank           Do NOT blank disk after wipe" );
     puts( "                          (default is to complete a final blank pass)\n" );
+    puts( "      --discard           Discard every block of an SSD after a successful wipe," );
+    puts( "                          sample verified if discarded blocks read as zeros" );
+    puts( "                          (default is not to discard)\n" );
+    puts( "      --preallocate       Allocate the holes of sparse regular files, such as" );
+    puts( "                          VM disk images, before wiping them" );
+    puts( "                          (default is to allocate them as they are written)\n" );
     puts( "      --nowait            Do NOT wait for a key before exiting" );
     puts( "                          (default is to wait)\n" );
     puts( "      --nosignals         Do NOT allow signals to interrupt a wipe" );
@@ -783,6 +1064,54 @@ void display_help()
     puts( "                          option. Send SIGUSR1 to log current stats\n" );
     puts( "      --nousb             Do NOT show or wipe any USB devices whether in GUI" );
     puts( "                          mode, --nogui or --autonuke modes.\n" );
+    puts( "      --thermal-throttle  Slow down writes to a drive as it approaches its maximum" );
+    puts( "                          temperature and pause them near its critical temperature" );
+    puts( "                          (default is to write at full speed)\n" );
+    puts( "      --autotune          Try a range of write sizes at the start of the first" );
+    puts( "                          write pass and use the fastest for each drive" );
+    puts( "                          (default is to write st_blksize, usually 4KiB)\n" );
+    puts( "      --shared-stream     Generate each random pass once and write the same" );
+    puts( "                          stream to every drive, for batches of identical drives" );
+    puts( "                          (default is a separate stream for each drive)\n" );
+    puts( "      --profile-startup   Log how long each phase of start-up and each device" );
+    puts( "                          probe took, up to the drive selection screen\n" );
+    puts( "      --io=BACKEND        Where the passes read and write, for benchmarking" );
+    puts( "                          (default: device)" );
+    puts( "                          device - The drive itself" );
+    puts( "                          null   - Writes are discarded, reads return zeros" );
+    puts( "                          mem    - Writes are kept in memory and read back" );
+    puts( "                          The drive is not written with null or mem, no PDF" );
+    puts( "                          certificates are created and the log summary shows" );
+    puts( "                          the drives as NoWrite rather than Erased\n" );
+    puts( "      --io-faults=FAULTS  Inject faults into the reads, writes and syncs of the" );
+    puts( "                          passes, to test the handling of failing media. FAULTS" );
+    puts( "                          is a comma separated list of:" );
+    puts( "                          eio=P      - Fail a read or write with EIO" );
+    puts( "                          partial=P  - Transfer half of a read or write" );
+    puts( "                          sync=P     - Fail an fdatasync or sync_file_range" );
+    puts( "                          spike=P    - Delay a call by delay=MS (default: 100)" );
+    puts( "                          bad=LBA[-LBA] - Fail 512 byte LBAs, up to 16 ranges" );
+    puts( "                          seed=N     - Choose other faults (default: 0)" );
+    puts( "                          where P is the probability per call, e.g. 0.001." );
+    puts( "                          No PDF certificates are created\n" );
+    puts( "      --metrics-socket=PATH  Serve Prometheus metrics of the wipes, e.g. bytes" );
+    puts( "                          written, throughput, ETA, errors and temperature, to" );
+    puts( "                          each connection on the Unix socket PATH\n" );
+    puts( "      --metrics-file=PATH Write the Prometheus metrics to PATH, atomically, for" );
+    puts( "                          the textfile collector of node_exporter\n" );
+    puts( "      --metrics-interval=SEC  Seconds between writes of --metrics-file" );
+    puts( "                          (default: 10)\n" );
+    puts( "      --progress-json=FD|PATH  Write the progress of each drive as one JSON" );
+    puts( "                          object per line to the file descriptor FD, e.g. 3," );
+    puts( "                          or to the file PATH: its pass, round, bytes done," );
+    puts( "                          throughput, ETA and errors, its state changes and" );
+    puts( "                          the result of its wipe. A FIFO must already have" );
+    puts( "                          a reader\n" );
+    puts( "      --progress-json-interval=SEC  Seconds between the progress records of" );
+    puts( "                          each drive (default: 1)\n" );
+    puts( "      --controller-limit=NUM  Wipe at most NUM drives at once on each HBA, SAS" );
+    puts( "                          expander or USB hub, largest drives first, the rest" );
+    puts( "                          wait in a queue (default: 0, no limit)\n" );
     puts( "  -e, --exclude=DEVICES   Up to ten comma separated devices to be excluded" );
     puts( "                          --exclude=/dev/sdc" );
     puts( "                          --exclude=/dev/sdc,/dev/sdd" );
@@ -52,6 +52,8 @@ typedef struct
     int autonuke;  // Do not prompt the user for confirmation when set.
     int autopoweroff;  // Power off on completion of wipe
     int noblank;  // Do not perform a final blanking pass.
+    int discard;  // Discard every block of an SSD after a successful wipe.
+    int preallocate;  // Allocate the holes of regular file targets before wiping them.
     int nousb;  // Do not show or wipe any USB devices.
     int nowait;  // Do not wait for a final key before exiting.
     int nosignals;  // Do not allow signals to interrupt a wipe.
@@ -62,9 +64,22 @@ typedef struct
     char PDFreportpath[PATHNAME_MAX];  // The path to write the PDF report to.
     char exclude[MAX_NUMBER_EXCLUDED_DRIVES][MAX_DRIVE_PATH_LENGTH];  // Drives excluded from the search.
     kwipe_prng_t* prng;  // The pseudo random number generator implementation. pointer to the function.
+    const struct kwipe_io_backend_t_* io;  // The I/O backend of the passes, see io.c
+    const char* io_faults;  // The --io-faults argument, NULL when no faults are injected, see io.c
+    const char* metrics_socket;  // The Unix socket to serve the metrics on, NULL = none, see metrics.c
+    const char* metrics_file;  // The file to write the metrics to, NULL = none, see metrics.c
+    int metrics_interval;  // Seconds between writes of metrics_file.
+    const char* progress_json;  // The file descriptor or file to write the JSON progress to, NULL = none.
+    int progress_json_interval;  // Seconds between the progress records of progress_json.
     int quiet;  // Anonymize serial numbers
     int rounds;  // The number of times that the wipe method should be called.
     int sync;  // A flag to indicate whether and how often writes should be sync'd.
+    int sync_window;  // Write back in windows of this many MiB instead of --sync, 0 = off.
+    int thermal_throttle;  // Slow down or pause writes to drives approaching their maximum temperature.
+    int controller_limit;  // The most wipes to run at once on one controller, 0 = no limit.
+    int autotune;  // Calibrate the write size of each drive at the start of the first write pass.
+    int shared_stream;  // Random passes on all drives write one PRNG stream, generated once.
+    int profile_startup;  // Log the time taken by each phase of start-up and each device probe.
     int verbose;  // Make log more verbose
     int PDF_enable;  // 0=PDF creation disabled, 1=PDF creation enabled
     int PDF_preview_details;  // 0=Disable preview Org/Cust/date/time before drive selection, 1=Enable Preview
@@ -31,11 +31,22 @@
 #include "pass.h"
 #include "logging.h"
 #include "gui.h"
+#include "stats.h"
+#include "latency.h"
+#include "progress.h"
+#include "event.h"
+#include "throttle.h"
+#include "autotune.h"
+#include "writeback.h"
+#include "pattern_cache.h"
+#include "shared_stream.h"
+#include "io.h"
+#include "trace.h"
 #include "aes/aes_ctr_prng.h"
 
 extern kwipe_prng_t kwipe_aes_ctr_prng;
 
-int kwipe_random_verify( kwipe_context_t* c )
+static int kwipe_random_verify_blocks( kwipe_context_t* c )
 {
     /**
      * Verifies that a random pass was correctly written to the device.
@@ -45,6 +56,12 @@ int kwipe_random_verify( kwipe_context_t* c )
     /* The result holder. */
     int r;
 
+    /* The time at which the current I/O call started, for the latency histograms. */
+    u64 io_start;
+
+    /* The time the current I/O call took. */
+    u64 io_ns;
+
     /* The IO size. */
     size_t blocksize;
 
@@ -57,6 +74,15 @@ int kwipe_random_verify( kwipe_context_t* c )
     /* The pattern buffer that is used to check the input buffer. */
     char* d;
 
+    /* The block to check against, from the pattern buffer or the shared stream. */
+    const char* p;
+
+    /* The stream shared with the other drives when --shared-stream is set, see shared_stream.c */
+    kwipe_shared_stream_reader_t stream;
+
+    /* The offset of the next block in the PRNG stream. */
+    u64 stream_offset = 0;
+
     /* The number of bytes remaining in the pass. */
     u64 z = c->device_size;
 
@@ -96,10 +122,10 @@ int kwipe_random_verify( kwipe_context_t* c )
     }
 
     /* Reset the file pointer. */
-    offset = lseek( c->device_fd, 0, SEEK_SET );
+    offset = kwipe_io_lseek( c, 0, SEEK_SET );
 
     /* Reset the pass byte counter. */
-    c->pass_done = 0;
+    kwipe_progress_start_pass( c );
 
     if( offset == (off64_t) -1 )
     {
@@ -120,13 +146,17 @@ int kwipe_random_verify( kwipe_context_t* c )
     }
 
     /* Tell our parent that we are syncing the device. */
-    c->sync_status = 1;
+    kwipe_progress_sync_status( c, 1 );
 
     /* Sync the device. */
-    r = fdatasync( c->device_fd );
+    io_start = kwipe_time_ns();
+    r = kwipe_io_fdatasync( c );
+    io_ns = kwipe_time_ns() - io_start;
+    kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+    NWIPE_TRACE_FDATASYNC( c, r, io_ns );
 
     /* Tell our parent that we have finished syncing the device. */
-    c->sync_status = 0;
+    kwipe_progress_sync_status( c, 0 );
 
     if( r != 0 )
     {
@@ -135,8 +165,12 @@ int kwipe_random_verify( kwipe_context_t* c )
         c->fsyncdata_errors++;
     }
 
-    /* Reseed the PRNG. */
-    c->prng->init( &c->prng_state, &c->prng_seed );
+    /* Reseed the PRNG, or start regenerating the stream shared with the other drives. */
+    kwipe_shared_stream_open( &stream, c, 1 );
+    if( !kwipe_options.shared_stream )
+    {
+        c->prng->init( &c->prng_state, &c->prng_seed );
+    }
 
     while( z > 0 )
     {
@@ -157,24 +191,50 @@ int kwipe_random_verify( kwipe_context_t* c )
         }
 
         /* Fill the output buffer with the random pattern. */
-        c->prng->read( &c->prng_state, d, blocksize );
+        if( kwipe_options.shared_stream )
+        {
+            p = kwipe_shared_stream_read( &stream, stream_offset, &blocksize );
+            if( p == NULL )
+            {
+                if( kwipe_cancel_requested( c ) )
+                {
+                    break;
+                }
+                kwipe_log( NWIPE_LOG_FATAL, "Unable to regenerate the shared stream for '%s'.", c->device_name );
+                kwipe_shared_stream_close( &stream );
+                free( b );
+                free( d );
+                return -1;
+            }
+        }
+        else
+        {
+            NWIPE_TRACE_PRNG_START( c, blocksize );
+            c->prng->read( &c->prng_state, d, blocksize );
+            NWIPE_TRACE_PRNG_DONE( c, blocksize );
+            p = d;
+        }
+        stream_offset += blocksize;
 
         /* Read the buffer in from the device. */
-        r = read( c->device_fd, b, blocksize );
+        io_start = kwipe_time_ns();
+        r = kwipe_io_read( c, b, blocksize );
+        io_ns = kwipe_time_ns() - io_start;
+        kwipe_latency_record( &c->latency[NWIPE_LATENCY_READ], io_ns );
+        NWIPE_TRACE_READ( c, c->device_size - z, blocksize, r, io_ns );
 
         /* Check the result. */
         if( r < 0 )
         {
             kwipe_perror( errno, __FUNCTION__, "read" );
             kwipe_log( NWIPE_LOG_ERROR, "Unable to read from '%s'.", c->device_name );
+            kwipe_shared_stream_close( &stream );
             return -1;
         }
 
         /* Check for a partial read. */
         if( r != blocksize )
         {
-            /* TODO: Handle a partial read. */
-
             /* The number of bytes that were not read. */
             int s = blocksize - r;
 
@@ -185,38 +245,44 @@ int kwipe_random_verify( kwipe_context_t* c )
             c->verify_errors += 1;
 
             /* Bump the file pointer to the next block. */
-            offset = lseek( c->device_fd, s, SEEK_CUR );
+            offset = kwipe_io_lseek( c, s, SEEK_CUR );
 
             if( offset == (off64_t) -1 )
             {
                 kwipe_perror( errno, __FUNCTION__, "lseek" );
                 kwipe_log(
                     NWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial read.", c->device_name );
+                kwipe_shared_stream_close( &stream );
                 return -1;
             }
 
         } /* partial read */
 
-        /* Compare buffer contents. */
-        if( memcmp( b, d, blocksize ) != 0 )
+        /* Compare what was read, the bytes that weren't have been counted as an error above. */
+        if( memcmp( b, p, r ) != 0 )
         {
             c->verify_errors += 1;
+            NWIPE_TRACE_VERIFY_MISMATCH( c, c->device_size - z, r );
         }
 
-        /* Decrement the bytes remaining in this pass. */
-        z -= r;
+        /* Decrement the bytes remaining in this pass, a partial transfer skipped the rest of the block. */
+        z -= blocksize;
 
         /* Increment the total progress counters. */
-        c->pass_done += r;
-        c->round_done += r;
+        kwipe_progress_add_read( c, r );
 
-        pthread_testcancel();
+        /* Stop at the end of the block if main() has cancelled the wipe. */
+        if( kwipe_cancel_requested( c ) )
+        {
+            break;
+        }
 
     } /* while bytes remaining */
 
     /* Release the buffers. */
     free( b );
     free( d );
+    kwipe_shared_stream_close( &stream );
 
     // Cleanup PRNG state at the end of function
     // Check before cleaning up AES PRNG state
@@ -226,12 +292,17 @@ int kwipe_random_verify( kwipe_context_t* c )
         kwipe_log( NWIPE_LOG_DEBUG, "Called aes_ctr_prng_general_cleanup(), and cleaned up AES context." );
     }
 
+    if( kwipe_cancel_requested( c ) )
+    {
+        return NWIPE_CANCELLED;
+    }
+
     /* We're done. */
     return 0;
 
-} /* kwipe_random_verify */
+} /* kwipe_random_verify_blocks */
 
-int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
+static int kwipe_random_pass_blocks( NWIPE_METHOD_SIGNATURE )
 {
     /**
      * Writes a random pattern to the device.
@@ -241,6 +312,12 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
     /* The result holder. */
     int r;
 
+    /* The time at which the current I/O call started, for the latency histograms. */
+    u64 io_start;
+
+    /* The time the current I/O call took. */
+    u64 io_ns;
+
     /* The IO size. */
     size_t blocksize;
 
@@ -250,11 +327,20 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
     /* The output buffer. */
     char* b;
 
+    /* The block to write, from the output buffer or the shared stream. */
+    const char* p;
+
+    /* The stream shared with the other drives when --shared-stream is set, see shared_stream.c */
+    kwipe_shared_stream_reader_t stream;
+
+    /* The offset of the next block in the PRNG stream. */
+    u64 stream_offset = 0;
+
     /* The number of bytes remaining in the pass. */
     u64 z = c->device_size;
 
-    /* Number of writes to do before a fdatasync. */
-    int syncRate = kwipe_options.sync;
+    /* Number of writes to do before a fdatasync, --sync-window replaces the periodic fdatasync. */
+    int syncRate = kwipe_options.sync_window ? 0 : kwipe_options.sync;
 
     /* Counter to track when to do a fdatasync. */
     int i = 0;
@@ -276,7 +362,7 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
 
     /* Create the initialised output buffer. Initialised because we don't want memory leaks
      * to disk in the event of some future undetected bug in a prng or its implementation. */
-    b = calloc( c->device_stat.st_blksize, sizeof( char ) );
+    b = calloc( kwipe_autotune_buffer_size( c ), sizeof( char ) );
 
     /* Check the memory allocation. */
     if( !b )
@@ -286,20 +372,31 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
         return -1;
     }
 
-    /* Seed the PRNG. */
-    c->prng->init( &c->prng_state, &c->prng_seed );
+    /* Seed the PRNG, or start reading the stream shared with the other drives. */
+    kwipe_shared_stream_open( &stream, c, 0 );
+    if( !kwipe_options.shared_stream )
+    {
+        c->prng->init( &c->prng_state, &c->prng_seed );
+    }
 
     /* Reset the file pointer. */
-    offset = lseek( c->device_fd, 0, SEEK_SET );
+    offset = kwipe_io_lseek( c, 0, SEEK_SET );
 
     /* Reset the pass byte counter. */
-    c->pass_done = 0;
+    kwipe_progress_start_pass( c );
+
+    /* Calibrate the write size on the first write pass if --autotune is set */
+    kwipe_autotune_start_pass( c );
+
+    /* Reset the write-back window */
+    kwipe_writeback_start_pass( c );
 
     if( offset == (off64_t) -1 )
     {
         kwipe_perror( errno, __FUNCTION__, "lseek" );
         kwipe_log( NWIPE_LOG_FATAL, "Unable to reset the '%s' file offset.", c->device_name );
         free( b );
+        kwipe_shared_stream_close( &stream );
         return -1;
     }
 
@@ -308,29 +405,55 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
         /* This is system insanity. */
         kwipe_log( NWIPE_LOG_SANITY, "__FUNCTION__: lseek() returned a bogus offset on '%s'.", c->device_name );
         free( b );
+        kwipe_shared_stream_close( &stream );
         return -1;
     }
 
     while( z > 0 )
     {
-        if( c->device_stat.st_blksize <= z )
-        {
-            blocksize = c->device_stat.st_blksize;
-        }
-        else
+        /* st_blksize, or the size chosen by --autotune */
+        blocksize = kwipe_autotune_size( c );
+
+        if( blocksize > z )
         {
-            /* This is a seatbelt for buggy drivers and programming errors because */
-            /* the device size should always be an even multiple of its blocksize. */
+            if( c->device_stat.st_blksize > z )
+            {
+                /* This is a seatbelt for buggy drivers and programming errors because */
+                /* the device size should always be an even multiple of its blocksize. */
+                kwipe_log( NWIPE_LOG_WARNING,
+                           "%s: The size of '%s' is not a multiple of its block size %i.",
+                           __FUNCTION__,
+                           c->device_name,
+                           c->device_stat.st_blksize );
+            }
             blocksize = z;
-            kwipe_log( NWIPE_LOG_WARNING,
-                       "%s: The size of '%s' is not a multiple of its block size %i.",
-                       __FUNCTION__,
-                       c->device_name,
-                       c->device_stat.st_blksize );
         }
 
         /* Fill the output buffer with the random pattern. */
-        c->prng->read( &c->prng_state, b, blocksize );
+        if( kwipe_options.shared_stream )
+        {
+            p = kwipe_shared_stream_read( &stream, stream_offset, &blocksize );
+            if( p == NULL )
+            {
+                if( kwipe_cancel_requested( c ) )
+                {
+                    break;
+                }
+                kwipe_log( NWIPE_LOG_FATAL, "Unable to generate the shared stream for '%s'.", c->device_name );
+                kwipe_shared_stream_close( &stream );
+                free( b );
+                kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+                return -1;
+            }
+        }
+        else
+        {
+            NWIPE_TRACE_PRNG_START( c, blocksize );
+            c->prng->read( &c->prng_state, b, blocksize );
+            NWIPE_TRACE_PRNG_DONE( c, blocksize );
+            p = b;
+        }
+        stream_offset += blocksize;
 
         /* For the first block only, check the prng actually wrote something to the buffer */
         if( z == c->device_size )
@@ -338,7 +461,7 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
             idx = c->device_stat.st_blksize - 1;
             while( idx > 0 )
             {
-                if( b[idx] != 0 )
+                if( p[idx] != 0 )
                 {
                     kwipe_log( NWIPE_LOG_NOTICE, "prng stream is active" );
                     break;
@@ -348,34 +471,38 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
             if( idx == 0 )
             {
                 kwipe_log( NWIPE_LOG_FATAL, "ERROR, prng wrote nothing to the buffer" );
-                if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-                {
-                    c->bytes_erased = c->device_size - z;
-                }
+                kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+                kwipe_shared_stream_close( &stream );
                 return -1;
             }
         }
 
         /* Write the next block out to the device. */
-        r = write( c->device_fd, b, blocksize );
+        io_start = kwipe_time_ns();
+        r = kwipe_io_write( c, p, blocksize );
+        io_ns = kwipe_time_ns() - io_start;
+        kwipe_latency_record( &c->latency[NWIPE_LATENCY_WRITE], io_ns );
+        NWIPE_TRACE_WRITE( c, c->device_size - z, blocksize, r, io_ns );
+
+        /* Slow down or pause if the drive is getting too hot, see throttle.c */
+        if( kwipe_options.thermal_throttle )
+        {
+            kwipe_throttle( c, io_start );
+        }
 
         /* Check the result for a fatal error. */
         if( r < 0 )
         {
             kwipe_perror( errno, __FUNCTION__, "write" );
             kwipe_log( NWIPE_LOG_FATAL, "Unable to read from '%s'.", c->device_name );
-            if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-            {
-                c->bytes_erased = c->device_size - z;
-            }
+            kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+            kwipe_shared_stream_close( &stream );
             return -1;
         }
 
         /* Check for a partial write. */
         if( r != blocksize )
         {
-            /* TODO: Handle a partial write. */
-
             /* The number of bytes that were not written. */
             int s = blocksize - r;
 
@@ -385,28 +512,37 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
             kwipe_log( NWIPE_LOG_WARNING, "Partial write on '%s', %i bytes short.", c->device_name, s );
 
             /* Bump the file pointer to the next block. */
-            offset = lseek( c->device_fd, s, SEEK_CUR );
+            offset = kwipe_io_lseek( c, s, SEEK_CUR );
 
             if( offset == (off64_t) -1 )
             {
                 kwipe_perror( errno, __FUNCTION__, "lseek" );
                 kwipe_log(
                     NWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial write.", c->device_name );
-                if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-                {
-                    c->bytes_erased = c->device_size - z;
-                }
+                kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+                kwipe_shared_stream_close( &stream );
                 return -1;
             }
 
         } /* partial write */
 
-        /* Decrement the bytes remaining in this pass. */
-        z -= r;
+        /* Decrement the bytes remaining in this pass, a partial transfer skipped the rest of the block. */
+        z -= blocksize;
 
         /* Increment the total progress counters. */
-        c->pass_done += r;
-        c->round_done += r;
+        kwipe_progress_add_write( c, r );
+
+        /* Move the autotuner on, see autotune.c */
+        kwipe_autotune_update( c, r );
+
+        /* Windowed write-back instead of the periodic sync, see writeback.c */
+        if( kwipe_options.sync_window > 0 && kwipe_writeback( c, c->device_size - z ) != 0 )
+        {
+            free( b );
+            kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+            kwipe_shared_stream_close( &stream );
+            return -1;
+        }
 
         /* Perodic Sync */
         if( syncRate > 0 )
@@ -416,25 +552,27 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
             if( i >= syncRate )
             {
                 /* Tell our parent that we are syncing the device. */
-                c->sync_status = 1;
+                kwipe_progress_sync_status( c, 1 );
 
                 /* Sync the device. */
-                r = fdatasync( c->device_fd );
+                io_start = kwipe_time_ns();
+                r = kwipe_io_fdatasync( c );
+                io_ns = kwipe_time_ns() - io_start;
+                kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+                NWIPE_TRACE_FDATASYNC( c, r, io_ns );
 
                 /* Tell our parent that we have finished syncing the device. */
-                c->sync_status = 0;
+                kwipe_progress_sync_status( c, 0 );
 
                 if( r != 0 )
                 {
                     kwipe_perror( errno, __FUNCTION__, "fdatasync" );
                     kwipe_log( NWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
-                    kwipe_log( NWIPE_LOG_WARNING, "Wrote %llu bytes on '%s'.", c->pass_done, c->device_name );
+                    kwipe_log( NWIPE_LOG_WARNING, "Wrote %llu bytes on '%s'.", c->progress.pass_done, c->device_name );
                     c->fsyncdata_errors++;
                     free( b );
-                    if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-                    {
-                        c->bytes_erased = c->device_size - z;
-                    }
+                    kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+                    kwipe_shared_stream_close( &stream );
                     return -1;
                 }
 
@@ -442,37 +580,40 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
             }
         }
 
-        pthread_testcancel();
+        /* bytes_erased only ever goes up, so it does not reset on subsequent passes */
+        kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
 
-        /* If statement required so that it does not reset on subsequent passes */
-        if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
+        /* Stop at the end of the block if main() has cancelled the wipe. */
+        if( kwipe_cancel_requested( c ) )
         {
-            c->bytes_erased = c->device_size - z;
+            break;
         }
 
     } /* /remaining bytes */
 
     /* Release the output buffer. */
     free( b );
+    kwipe_shared_stream_close( &stream );
 
     /* Tell our parent that we are syncing the device. */
-    c->sync_status = 1;
+    kwipe_progress_sync_status( c, 1 );
 
     /* Sync the device. */
-    r = fdatasync( c->device_fd );
+    io_start = kwipe_time_ns();
+    r = kwipe_io_fdatasync( c );
+    io_ns = kwipe_time_ns() - io_start;
+    kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+    NWIPE_TRACE_FDATASYNC( c, r, io_ns );
 
     /* Tell our parent that we have finished syncing the device. */
-    c->sync_status = 0;
+    kwipe_progress_sync_status( c, 0 );
 
     if( r != 0 )
     {
         kwipe_perror( errno, __FUNCTION__, "fdatasync" );
         kwipe_log( NWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
         c->fsyncdata_errors++;
-        if( c->bytes_erased < ( c->device_size - z - blocksize ) )  // How much of the device has been erased?
-        {
-            c->bytes_erased = c->device_size - z - blocksize;
-        }
+        kwipe_progress_erased( c, c->device_size - z - blocksize );  // How much of the device has been erased?
         return -1;
     }
 
@@ -484,12 +625,17 @@ int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
         kwipe_log( NWIPE_LOG_DEBUG, "Called aes_ctr_prng_general_cleanup(), and cleaned up AES context." );
     }
 
+    if( kwipe_cancel_requested( c ) )
+    {
+        return NWIPE_CANCELLED;
+    }
+
     /* We're done. */
     return 0;
 
-} /* kwipe_random_pass */
+} /* kwipe_random_pass_blocks */
 
-int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
+static int kwipe_static_verify_blocks( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
 {
     /**
      * Verifies that a static pass was correctly written to the device.
@@ -498,6 +644,12 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
     /* The result holder. */
     int r;
 
+    /* The time at which the current I/O call started, for the latency histograms. */
+    u64 io_start;
+
+    /* The time the current I/O call took. */
+    u64 io_ns;
+
     /* The IO size. */
     size_t blocksize;
 
@@ -507,11 +659,8 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
     /* The input buffer. */
     char* b;
 
-    /* The pattern buffer that is used to check the input buffer. */
-    char* d;
-
-    /* A pointer into the pattern buffer. */
-    char* q;
+    /* The shared pattern buffer that is used to check the input buffer, see pattern_cache.c */
+    const char* d;
 
     /* The pattern buffer window offset. */
     int w = 0;
@@ -544,32 +693,29 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
         return -1;
     }
 
-    /* Create the pattern buffer */
-    d = malloc( c->device_stat.st_blksize + pattern->length * 2 );
+    /* Get the pattern buffer, built by the first pass to use this pattern */
+    d = kwipe_pattern_cache_get( pattern, c->device_stat.st_blksize );
 
     /* Check the memory allocation. */
     if( !d )
     {
-        kwipe_perror( errno, __FUNCTION__, "malloc" );
         kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the pattern buffer." );
         free( b );
         return -1;
     }
 
-    for( q = d; q < d + c->device_stat.st_blksize + pattern->length; q += pattern->length )
-    {
-        /* Fill the pattern buffer with the pattern. */
-        memcpy( q, pattern->s, pattern->length );
-    }
-
     /* Tell our parent that we are syncing the device. */
-    c->sync_status = 1;
+    kwipe_progress_sync_status( c, 1 );
 
     /* Sync the device. */
-    r = fdatasync( c->device_fd );
+    io_start = kwipe_time_ns();
+    r = kwipe_io_fdatasync( c );
+    io_ns = kwipe_time_ns() - io_start;
+    kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+    NWIPE_TRACE_FDATASYNC( c, r, io_ns );
 
     /* Tell our parent that we have finished syncing the device. */
-    c->sync_status = 0;
+    kwipe_progress_sync_status( c, 0 );
 
     if( r != 0 )
     {
@@ -579,10 +725,10 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
     }
 
     /* Reset the file pointer. */
-    offset = lseek( c->device_fd, 0, SEEK_SET );
+    offset = kwipe_io_lseek( c, 0, SEEK_SET );
 
     /* Reset the pass byte counter. */
-    c->pass_done = 0;
+    kwipe_progress_start_pass( c );
 
     if( offset == (off64_t) -1 )
     {
@@ -597,7 +743,6 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
         /* This is system insanity. */
         kwipe_log( NWIPE_LOG_SANITY, "kwipe_static_verify: lseek() returned a bogus offset on '%s'.", c->device_name );
         free( b );
-        free( d );
         return -1;
     }
 
@@ -621,7 +766,11 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
 
         /* Fill the output buffer with the random pattern. */
         /* Read the buffer in from the device. */
-        r = read( c->device_fd, b, blocksize );
+        io_start = kwipe_time_ns();
+        r = kwipe_io_read( c, b, blocksize );
+        io_ns = kwipe_time_ns() - io_start;
+        kwipe_latency_record( &c->latency[NWIPE_LATENCY_READ], io_ns );
+        NWIPE_TRACE_READ( c, c->device_size - z, blocksize, r, io_ns );
 
         /* Check the result. */
         if( r < 0 )
@@ -638,6 +787,7 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
             if( memcmp( b, &d[w], r ) != 0 )
             {
                 c->verify_errors += 1;
+                NWIPE_TRACE_VERIFY_MISMATCH( c, c->device_size - z, r );
             }
         }
         else
@@ -645,15 +795,13 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
             /* The number of bytes that were not read. */
             int s = blocksize - r;
 
-            /* TODO: Handle a partial read. */
-
             /* Increment the error count. */
             c->verify_errors += 1;
 
             kwipe_log( NWIPE_LOG_WARNING, "Partial read on '%s', %i bytes short.", c->device_name, s );
 
             /* Bump the file pointer to the next block. */
-            offset = lseek( c->device_fd, s, SEEK_CUR );
+            offset = kwipe_io_lseek( c, s, SEEK_CUR );
 
             if( offset == (off64_t) -1 )
             {
@@ -673,27 +821,34 @@ int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
          *   then ( w == 0 ) always.
          */
 
-        /* Decrement the bytes remaining in this pass. */
-        z -= r;
+        /* Decrement the bytes remaining in this pass, a partial transfer skipped the rest of the block. */
+        z -= blocksize;
 
         /* Increment the total progress counters. */
-        c->pass_done += r;
-        c->round_done += r;
+        kwipe_progress_add_read( c, r );
 
-        pthread_testcancel();
+        /* Stop at the end of the block if main() has cancelled the wipe. */
+        if( kwipe_cancel_requested( c ) )
+        {
+            break;
+        }
 
     } /* while bytes remaining */
 
     /* Release the buffers. */
     free( b );
-    free( d );
+
+    if( kwipe_cancel_requested( c ) )
+    {
+        return NWIPE_CANCELLED;
+    }
 
     /* We're done. */
     return 0;
 
-} /* kwipe_static_verify */
+} /* kwipe_static_verify_blocks */
 
-int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
+static int kwipe_static_pass_blocks( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
 {
     /**
      * Writes a static pattern to the device.
@@ -702,17 +857,20 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
     /* The result holder. */
     int r;
 
+    /* The time at which the current I/O call started, for the latency histograms. */
+    u64 io_start;
+
+    /* The time the current I/O call took. */
+    u64 io_ns;
+
     /* The IO size. */
     size_t blocksize;
 
     /* The result buffer for calls to lseek. */
     off64_t offset;
 
-    /* The output buffer. */
-    char* b;
-
-    /* A pointer into the output buffer. */
-    char* p;
+    /* The shared output buffer, see pattern_cache.c */
+    const char* b;
 
     /* The output buffer window offset. */
     int w = 0;
@@ -720,8 +878,8 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
     /* The number of bytes remaining in the pass. */
     u64 z = c->device_size;
 
-    /* Number of writes to do before a fdatasync. */
-    int syncRate = kwipe_options.sync;
+    /* Number of writes to do before a fdatasync, --sync-window replaces the periodic fdatasync. */
+    int syncRate = kwipe_options.sync_window ? 0 : kwipe_options.sync;
 
     /* Counter to track when to do a fdatasync. */
     int i = 0;
@@ -740,28 +898,27 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
         return -1;
     }
 
-    /* Create the output buffer. */
-    b = malloc( c->device_stat.st_blksize + pattern->length * 2 );
+    /* Get the output buffer, built by the first pass to use this pattern */
+    b = kwipe_pattern_cache_get( pattern, kwipe_autotune_buffer_size( c ) );
 
     /* Check the memory allocation. */
     if( !b )
     {
-        kwipe_perror( errno, __FUNCTION__, "malloc" );
         kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the pattern buffer." );
         return -1;
     }
-
-    for( p = b; p < b + c->device_stat.st_blksize + pattern->length; p += pattern->length )
-    {
-        /* Fill the output buffer with the pattern. */
-        memcpy( p, pattern->s, pattern->length );
-    }
     ///
     /* Reset the file pointer. */
-    offset = lseek( c->device_fd, 0, SEEK_SET );
+    offset = kwipe_io_lseek( c, 0, SEEK_SET );
 
     /* Reset the pass byte counter. */
-    c->pass_done = 0;
+    kwipe_progress_start_pass( c );
+
+    /* Calibrate the write size on the first write pass if --autotune is set */
+    kwipe_autotune_start_pass( c );
+
+    /* Reset the write-back window */
+    kwipe_writeback_start_pass( c );
 
     if( offset == (off64_t) -1 )
     {
@@ -779,43 +936,50 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
 
     while( z > 0 )
     {
-        if( c->device_stat.st_blksize <= z )
-        {
-            blocksize = c->device_stat.st_blksize;
-        }
-        else
+        /* st_blksize, or the size chosen by --autotune */
+        blocksize = kwipe_autotune_size( c );
+
+        if( blocksize > z )
         {
-            /* This is a seatbelt for buggy drivers and programming errors because */
-            /* the device size should always be an even multiple of its blocksize. */
+            if( c->device_stat.st_blksize > z )
+            {
+                /* This is a seatbelt for buggy drivers and programming errors because */
+                /* the device size should always be an even multiple of its blocksize. */
+                kwipe_log( NWIPE_LOG_WARNING,
+                           "%s: The size of '%s' is not a multiple of its block size %i.",
+                           __FUNCTION__,
+                           c->device_name,
+                           c->device_stat.st_blksize );
+            }
             blocksize = z;
-            kwipe_log( NWIPE_LOG_WARNING,
-                       "%s: The size of '%s' is not a multiple of its block size %i.",
-                       __FUNCTION__,
-                       c->device_name,
-                       c->device_stat.st_blksize );
         }
 
         /* Fill the output buffer with the random pattern. */
         /* Write the next block out to the device. */
-        r = write( c->device_fd, &b[w], blocksize );
+        io_start = kwipe_time_ns();
+        r = kwipe_io_write( c, &b[w], blocksize );
+        io_ns = kwipe_time_ns() - io_start;
+        kwipe_latency_record( &c->latency[NWIPE_LATENCY_WRITE], io_ns );
+        NWIPE_TRACE_WRITE( c, c->device_size - z, blocksize, r, io_ns );
+
+        /* Slow down or pause if the drive is getting too hot, see throttle.c */
+        if( kwipe_options.thermal_throttle )
+        {
+            kwipe_throttle( c, io_start );
+        }
 
         /* Check the result for a fatal error. */
         if( r < 0 )
         {
             kwipe_perror( errno, __FUNCTION__, "write" );
             kwipe_log( NWIPE_LOG_FATAL, "Unable to write to '%s'.", c->device_name );
-            if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-            {
-                c->bytes_erased = c->device_size - z;
-            }
+            kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
             return -1;
         }
 
         /* Check for a partial write. */
         if( r != blocksize )
         {
-            /* TODO: Handle a partial write. */
-
             /* The number of bytes that were not written. */
             int s = blocksize - r;
 
@@ -825,24 +989,21 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
             kwipe_log( NWIPE_LOG_WARNING, "Partial write on '%s', %i bytes short.", c->device_name, s );
 
             /* Bump the file pointer to the next block. */
-            offset = lseek( c->device_fd, s, SEEK_CUR );
+            offset = kwipe_io_lseek( c, s, SEEK_CUR );
 
             if( offset == (off64_t) -1 )
             {
                 kwipe_perror( errno, __FUNCTION__, "lseek" );
                 kwipe_log(
                     NWIPE_LOG_ERROR, "Unable to bump the '%s' file offset after a partial write.", c->device_name );
-                if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-                {
-                    c->bytes_erased = c->device_size - z;
-                }
+                kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
                 return -1;
             }
 
         } /* partial write */
 
         /* Adjust the window. */
-        w = ( c->device_stat.st_blksize + w ) % pattern->length;
+        w = ( blocksize + w ) % pattern->length;
 
         /* Intuition check:
          *
@@ -850,12 +1011,21 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
          *   then ( w == 0 ) always.
          */
 
-        /* Decrement the bytes remaining in this pass. */
-        z -= r;
+        /* Decrement the bytes remaining in this pass, a partial transfer skipped the rest of the block. */
+        z -= blocksize;
 
         /* Increment the total progress counterr. */
-        c->pass_done += r;
-        c->round_done += r;
+        kwipe_progress_add_write( c, r );
+
+        /* Move the autotuner on, see autotune.c */
+        kwipe_autotune_update( c, r );
+
+        /* Windowed write-back instead of the periodic sync, see writeback.c */
+        if( kwipe_options.sync_window > 0 && kwipe_writeback( c, c->device_size - z ) != 0 )
+        {
+            kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
+            return -1;
+        }
 
         /* Perodic Sync */
         if( syncRate > 0 )
@@ -865,25 +1035,25 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
             if( i >= syncRate )
             {
                 /* Tell our parent that we are syncing the device. */
-                c->sync_status = 1;
+                kwipe_progress_sync_status( c, 1 );
 
                 /* Sync the device. */
-                r = fdatasync( c->device_fd );
+                io_start = kwipe_time_ns();
+                r = kwipe_io_fdatasync( c );
+                io_ns = kwipe_time_ns() - io_start;
+                kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+                NWIPE_TRACE_FDATASYNC( c, r, io_ns );
 
                 /* Tell our parent that we have finished syncing the device. */
-                c->sync_status = 0;
+                kwipe_progress_sync_status( c, 0 );
 
                 if( r != 0 )
                 {
                     kwipe_perror( errno, __FUNCTION__, "fdatasync" );
                     kwipe_log( NWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
-                    kwipe_log( NWIPE_LOG_WARNING, "Wrote %llu bytes on '%s'.", c->pass_done, c->device_name );
+                    kwipe_log( NWIPE_LOG_WARNING, "Wrote %llu bytes on '%s'.", c->progress.pass_done, c->device_name );
                     c->fsyncdata_errors++;
-                    free( b );
-                    if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
-                    {
-                        c->bytes_erased = c->device_size - z;
-                    }
+                    kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
                     return -1;
                 }
 
@@ -891,40 +1061,86 @@ int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
             }
         }
 
-        pthread_testcancel();
+        kwipe_progress_erased( c, c->device_size - z );  // How much of the device has been erased?
 
-        if( c->bytes_erased < ( c->device_size - z ) )  // How much of the device has been erased?
+        /* Stop at the end of the block if main() has cancelled the wipe. */
+        if( kwipe_cancel_requested( c ) )
         {
-            c->bytes_erased = c->device_size - z;
+            break;
         }
 
     } /* /remaining bytes */
 
     /* Tell our parent that we are syncing the device. */
-    c->sync_status = 1;
+    kwipe_progress_sync_status( c, 1 );
 
     /* Sync the device. */
-    r = fdatasync( c->device_fd );
+    io_start = kwipe_time_ns();
+    r = kwipe_io_fdatasync( c );
+    io_ns = kwipe_time_ns() - io_start;
+    kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+    NWIPE_TRACE_FDATASYNC( c, r, io_ns );
 
     /* Tell our parent that we have finished syncing the device. */
-    c->sync_status = 0;
+    kwipe_progress_sync_status( c, 0 );
 
     if( r != 0 )
     {
         kwipe_perror( errno, __FUNCTION__, "fdatasync" );
         kwipe_log( NWIPE_LOG_WARNING, "Buffer flush failure on '%s'.", c->device_name );
         c->fsyncdata_errors++;
-        if( c->bytes_erased < ( c->device_size - z - blocksize ) )  // How much of the device has been erased?
-        {
-            c->bytes_erased = c->device_size - z - blocksize;
-        }
+        kwipe_progress_erased( c, c->device_size - z - blocksize );  // How much of the device has been erased?
         return -1;
     }
 
-    /* Release the output buffer. */
-    free( b );
+    if( kwipe_cancel_requested( c ) )
+    {
+        return NWIPE_CANCELLED;
+    }
 
     /* We're done. */
     return 0;
 
-} /* kwipe_static_pass */
+} /* kwipe_static_pass_blocks */
+
+/* The passes, between the tracepoints at their start and end */
+
+int kwipe_random_verify( kwipe_context_t* c )
+{
+    int r;
+
+    NWIPE_TRACE_PASS_START( c, "random_verify" );
+    r = kwipe_random_verify_blocks( c );
+    NWIPE_TRACE_PASS_END( c, "random_verify", r, c->verify_errors );
+    return r;
+}
+
+int kwipe_random_pass( NWIPE_METHOD_SIGNATURE )
+{
+    int r;
+
+    NWIPE_TRACE_PASS_START( c, "random" );
+    r = kwipe_random_pass_blocks( c );
+    NWIPE_TRACE_PASS_END( c, "random", r, c->pass_errors );
+    return r;
+}
+
+int kwipe_static_verify( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
+{
+    int r;
+
+    NWIPE_TRACE_PASS_START( c, "static_verify" );
+    r = kwipe_static_verify_blocks( c, pattern );
+    NWIPE_TRACE_PASS_END( c, "static_verify", r, c->verify_errors );
+    return r;
+}
+
+int kwipe_static_pass( NWIPE_METHOD_SIGNATURE, kwipe_pattern_t* pattern )
+{
+    int r;
+
+    NWIPE_TRACE_PASS_START( c, "static" );
+    r = kwipe_static_pass_blocks( c, pattern );
+    NWIPE_TRACE_PASS_END( c, "static", r, c->pass_errors );
+    return r;
+}
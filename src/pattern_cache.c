@@ -0,0 +1,149 @@
+/*
+ *  pattern_cache.c: Read-only pattern buffers shared by every static pass.
+ *
+ *  Every static pass and verify used to malloc its own buffer and fill it by copying a one
+ *  or three byte pattern over and over, for every pass on every drive, so a Gutmann wipe
+ *  of twenty drives built the same buffers hundreds of times. The buffers are built once
+ *  per pattern instead and shared by all threads. Each is the pattern repeated end to end,
+ *  so any phase of a three byte pattern is found at an offset below its length and blocks
+ *  can be written from &b[w] however they fall across the pattern. The buffers are mapped
+ *  anonymously, rounded up to whole hugepages and advised as such, and made read-only once
+ *  filled, so a bug in a pass can't corrupt the pattern written to every other drive.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "logging.h"
+#include "pattern_cache.h"
+
+typedef struct kwipe_pattern_buffer_t_
+{
+    struct kwipe_pattern_buffer_t_* next;
+    char* buffer;  // The pattern repeated end to end, read-only
+    size_t size;  // The size of the mapping
+    int length;  // The length of the pattern
+    char pattern[];  // A copy of the pattern
+} kwipe_pattern_buffer_t;
+
+static pthread_mutex_t pattern_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static kwipe_pattern_buffer_t* pattern_cache;
+
+static kwipe_pattern_buffer_t* kwipe_pattern_cache_build( kwipe_pattern_t* pattern, size_t size )
+{
+    kwipe_pattern_buffer_t* entry;
+    size_t filled;
+    size_t copy;
+
+    entry = malloc( sizeof( kwipe_pattern_buffer_t ) + pattern->length );
+    if( entry == NULL )
+    {
+        kwipe_perror( errno, __FUNCTION__, "malloc" );
+        return NULL;
+    }
+
+    entry->size = ( size + NWIPE_PATTERN_CACHE_ALIGN - 1 ) / NWIPE_PATTERN_CACHE_ALIGN * NWIPE_PATTERN_CACHE_ALIGN;
+    entry->length = pattern->length;
+    memcpy( entry->pattern, pattern->s, pattern->length );
+
+    entry->buffer = mmap( NULL, entry->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if( entry->buffer == MAP_FAILED )
+    {
+        kwipe_perror( errno, __FUNCTION__, "mmap" );
+        free( entry );
+        return NULL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    /* Only a hint, the buffer works just as well in small pages */
+    madvise( entry->buffer, entry->size, MADV_HUGEPAGE );
+#endif
+
+    /* Tile the pattern by doubling, every copy starts on a whole number of patterns */
+    memcpy( entry->buffer, pattern->s, pattern->length );
+    for( filled = pattern->length; filled < entry->size; filled += copy )
+    {
+        copy = filled < entry->size - filled ? filled : entry->size - filled;
+        memcpy( entry->buffer + filled, entry->buffer, copy );
+    }
+
+    if( mprotect( entry->buffer, entry->size, PROT_READ ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "mprotect" );
+    }
+
+    kwipe_log( NWIPE_LOG_DEBUG,
+               "Pattern cache: %i byte pattern in a %zu KiB buffer",
+               entry->length,
+               entry->size / 1024 );
+
+    return entry;
+}
+
+const char* kwipe_pattern_cache_get( kwipe_pattern_t* pattern, size_t size )
+{
+    kwipe_pattern_buffer_t* entry;
+
+    /* Room for a block starting at any phase of the pattern */
+    size += pattern->length * 2;
+
+    pthread_mutex_lock( &pattern_cache_mutex );
+
+    for( entry = pattern_cache; entry != NULL; entry = entry->next )
+    {
+        if( entry->length == pattern->length && entry->size >= size
+            && memcmp( entry->pattern, pattern->s, pattern->length ) == 0 )
+        {
+            break;
+        }
+    }
+
+    if( entry == NULL )
+    {
+        entry = kwipe_pattern_cache_build( pattern, size );
+        if( entry != NULL )
+        {
+            entry->next = pattern_cache;
+            pattern_cache = entry;
+        }
+    }
+
+    pthread_mutex_unlock( &pattern_cache_mutex );
+
+    return entry ? entry->buffer : NULL;
+}
+
+void kwipe_pattern_cache_free( void )
+{
+    kwipe_pattern_buffer_t* entry;
+
+    pthread_mutex_lock( &pattern_cache_mutex );
+
+    while( pattern_cache != NULL )
+    {
+        entry = pattern_cache;
+        pattern_cache = entry->next;
+
+        munmap( entry->buffer, entry->size );
+        free( entry );
+    }
+
+    pthread_mutex_unlock( &pattern_cache_mutex );
+}
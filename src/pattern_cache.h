@@ -0,0 +1,44 @@
+/*
+ *  pattern_cache.h: Read-only pattern buffers shared by every static pass.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PATTERN_CACHE_H_
+#define PATTERN_CACHE_H_
+
+#include "method.h"
+
+/* Buffers are rounded up to a whole number of transparent hugepages */
+#define NWIPE_PATTERN_CACHE_ALIGN ( 2 * 1024 * 1024 )
+
+/**
+ * Returns a read-only buffer filled with the pattern repeated end to end, shared by every
+ * thread that asks for the same pattern. A block of 'size' bytes starting at any offset
+ * below pattern->length * 2 is within the buffer, so the passes write &b[w] for the
+ * pattern phase w of each block without copying. The buffer stays valid until
+ * kwipe_pattern_cache_free().
+ * @param pattern the pattern
+ * @param size the largest block that will be written or compared
+ * @return the buffer, or NULL if it could not be allocated
+ */
+const char* kwipe_pattern_cache_get( kwipe_pattern_t* pattern, size_t size );
+
+/**
+ * Releases every buffer, called from main() once the wipe threads have been joined.
+ */
+void kwipe_pattern_cache_free( void );
+
+#endif /* PATTERN_CACHE_H_ */
@@ -0,0 +1,79 @@
+/*
+ *  profile.c: Timing the phases of start-up for --profile-startup.
+ *
+ *  Start-up runs a series of steps, reading kwipe.conf, logging the system information,
+ *  probing each device with readlink, smartctl and hdparm, loading drivetemp and reading
+ *  each drive's temperature limits, before the drive selection screen appears. Which of
+ *  them dominates depends on the station, e.g. a slow USB bridge or a BMC with a large
+ *  SMBIOS table, so with --profile-startup each is timed with the monotonic clock and
+ *  logged. Without it the cost is one clock read per phase.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "stats.h"
+#include "profile.h"
+
+/* The time start-up began */
+static u64 kwipe_profile_origin_ns;
+
+u64 kwipe_profile_init( void )
+{
+    kwipe_profile_origin_ns = kwipe_time_ns();
+    return kwipe_profile_origin_ns;
+}
+
+u64 kwipe_profile_phase( u64 start_ns, const char* format, ... )
+{
+    char phase[128];
+    va_list ap;
+    u64 end_ns;
+    u64 took_us;
+    u64 since_us;
+
+    end_ns = kwipe_time_ns();
+
+    if( !kwipe_options.profile_startup )
+    {
+        return end_ns;
+    }
+
+    va_start( ap, format );
+    vsnprintf( phase, sizeof( phase ), format, ap );
+    va_end( ap );
+
+    took_us = ( end_ns - start_ns ) / 1000;
+    since_us = ( end_ns - kwipe_profile_origin_ns ) / 1000;
+
+    kwipe_log( NWIPE_LOG_INFO,
+               "startup: %-40s %6llu.%03llu ms, at %6llu.%03llu ms",
+               phase,
+               took_us / 1000,
+               took_us % 1000,
+               since_us / 1000,
+               since_us % 1000 );
+
+    /* Don't count the time taken to log it */
+    return kwipe_time_ns();
+}
@@ -0,0 +1,43 @@
+/*
+ *  profile.h: Timing the phases of start-up for --profile-startup.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include "kwipe.h"
+
+/**
+ * Notes the time start-up began, called first thing in main().
+ * @return the time, as returned by kwipe_time_ns()
+ */
+u64 kwipe_profile_init( void );
+
+/**
+ * Logs how long a phase of start-up took, and how long since start-up began, when
+ * --profile-startup is set. Phases follow one another, so the end of one is the start of
+ * the next:
+ *
+ *     profile_ns = kwipe_profile_phase( profile_ns, "device scan" );
+ *
+ * @param start_ns the time the phase started
+ * @param format printf style description of the phase
+ * @return the time the phase ended, i.e. now
+ */
+u64 kwipe_profile_phase( u64 start_ns, const char* format, ... );
+
+#endif /* PROFILE_H_ */
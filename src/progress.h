@@ -0,0 +1,146 @@
+/*
+ *  progress.h: Publishing a drive's progress counters from its wipe thread.
+ *
+ *  The counters that the wipe thread updates after every block live in their own cache
+ *  line in kwipe_context_t, so dozens of wipe threads don't keep invalidating the lines
+ *  the GUI and temperature threads use. The wipe thread is the only writer and publishes
+ *  them under a sequence lock, readers take a consistent snapshot without blocking it.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PROGRESS_H_
+#define PROGRESS_H_
+
+#include "context.h"
+
+/*
+ * Writer side, only to be called from the drive's own wipe thread. The wipe thread may
+ * read its own counters directly, e.g. c->progress.pass_done, without a snapshot.
+ */
+
+static inline void kwipe_progress_write_begin( kwipe_progress_t* p )
+{
+    __atomic_store_n( &p->seq, p->seq + 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+static inline void kwipe_progress_write_end( kwipe_progress_t* p )
+{
+    __atomic_store_n( &p->seq, p->seq + 1, __ATOMIC_RELEASE );
+}
+
+/* Adds to the pass and round counters progress that isn't I/O of kwipe's own, e.g. a sanitize reported by the drive. */
+static inline void kwipe_progress_add( kwipe_context_t* c, u64 bytes )
+{
+    kwipe_progress_t* p = &c->progress;
+
+    kwipe_progress_write_begin( p );
+    __atomic_store_n( &p->pass_done, p->pass_done + bytes, __ATOMIC_RELAXED );
+    __atomic_store_n( &p->round_done, p->round_done + bytes, __ATOMIC_RELAXED );
+    kwipe_progress_write_end( p );
+}
+
+/* Adds the bytes of a completed write, counted in bytes_written as well as the pass and round. */
+static inline void kwipe_progress_add_write( kwipe_context_t* c, u64 bytes )
+{
+    kwipe_progress_t* p = &c->progress;
+
+    kwipe_progress_write_begin( p );
+    __atomic_store_n( &p->pass_done, p->pass_done + bytes, __ATOMIC_RELAXED );
+    __atomic_store_n( &p->round_done, p->round_done + bytes, __ATOMIC_RELAXED );
+    __atomic_store_n( &p->bytes_written, p->bytes_written + bytes, __ATOMIC_RELAXED );
+    kwipe_progress_write_end( p );
+}
+
+/* Adds the bytes of a completed read, counted in bytes_read as well as the pass and round. */
+static inline void kwipe_progress_add_read( kwipe_context_t* c, u64 bytes )
+{
+    kwipe_progress_t* p = &c->progress;
+
+    kwipe_progress_write_begin( p );
+    __atomic_store_n( &p->pass_done, p->pass_done + bytes, __ATOMIC_RELAXED );
+    __atomic_store_n( &p->round_done, p->round_done + bytes, __ATOMIC_RELAXED );
+    __atomic_store_n( &p->bytes_read, p->bytes_read + bytes, __ATOMIC_RELAXED );
+    kwipe_progress_write_end( p );
+}
+
+/* Resets the pass counter at the start of a pass. */
+static inline void kwipe_progress_start_pass( kwipe_context_t* c )
+{
+    kwipe_progress_write_begin( &c->progress );
+    __atomic_store_n( &c->progress.pass_done, 0, __ATOMIC_RELAXED );
+    kwipe_progress_write_end( &c->progress );
+}
+
+/* Raises the number of bytes erased at least once, it never goes down. */
+static inline void kwipe_progress_erased( kwipe_context_t* c, u64 bytes_erased )
+{
+    if( c->progress.bytes_erased < bytes_erased )
+    {
+        kwipe_progress_write_begin( &c->progress );
+        __atomic_store_n( &c->progress.bytes_erased, bytes_erased, __ATOMIC_RELAXED );
+        kwipe_progress_write_end( &c->progress );
+    }
+}
+
+/* Tells the other threads whether the device is being synced. */
+static inline void kwipe_progress_sync_status( kwipe_context_t* c, short sync_status )
+{
+    kwipe_progress_write_begin( &c->progress );
+    __atomic_store_n( &c->progress.sync_status, sync_status, __ATOMIC_RELAXED );
+    kwipe_progress_write_end( &c->progress );
+}
+
+/*
+ * Reader side, may be called from any thread.
+ */
+
+/* Copies the counters of a drive, all from the same moment, into s. The seq member of s is not used. */
+static inline void kwipe_progress_snapshot( const kwipe_context_t* c, kwipe_progress_t* s )
+{
+    const kwipe_progress_t* p = &c->progress;
+    unsigned int seq;
+
+    do
+    {
+        /* Spin while the wipe thread is half way through an update, that's only a few instructions. */
+        while( ( seq = __atomic_load_n( &p->seq, __ATOMIC_ACQUIRE ) ) & 1 )
+        {
+        }
+
+        s->pass_done = __atomic_load_n( &p->pass_done, __ATOMIC_RELAXED );
+        s->round_done = __atomic_load_n( &p->round_done, __ATOMIC_RELAXED );
+        s->bytes_erased = __atomic_load_n( &p->bytes_erased, __ATOMIC_RELAXED );
+        s->bytes_written = __atomic_load_n( &p->bytes_written, __ATOMIC_RELAXED );
+        s->bytes_read = __atomic_load_n( &p->bytes_read, __ATOMIC_RELAXED );
+        s->sync_status = __atomic_load_n( &p->sync_status, __ATOMIC_RELAXED );
+
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+
+    } while( __atomic_load_n( &p->seq, __ATOMIC_RELAXED ) != seq );
+}
+
+/* The percentage of the round done by the snapshot s of drive c, 0 until the size of the round is known */
+static inline double kwipe_progress_percent( const kwipe_context_t* c, const kwipe_progress_t* s )
+{
+    if( c->round_size == 0 )
+    {
+        return 0.0;
+    }
+    return (double) s->round_done / (double) c->round_size * 100;
+}
+
+#endif /* PROGRESS_H_ */
@@ -0,0 +1,586 @@
+/*
+ *  progress_json.c: A machine readable stream of the progress of the wipes, one JSON object per line.
+ *
+ *  With --progress-json=FD|PATH a thread of its own writes, every --progress-json-interval
+ *  seconds, a "progress" record for each drive with its serial number, pass and round, bytes
+ *  done, throughput, ETA, errors and temperature. In between it looks at the drives ten times
+ *  a second and writes a "state" record whenever a drive is started, moves on to another pass
+ *  or round or finishes, and a "result" record with the outcome of the wipe once it has. The
+ *  records go to a file descriptor inherited from the caller, e.g. --progress-json=3, or to a
+ *  file or FIFO, with or without the GUI.
+ *
+ *  Neither the wipe threads nor this thread ever wait for the reader. The counters are copied
+ *  with kwipe_progress_snapshot(), and the records are buffered and written without blocking,
+ *  the descriptor is made non-blocking. An inherited descriptor shares its flags with the caller,
+ *  they are put back once the stream stops. A FIFO must already have a reader, kwipe doesn't wait
+ *  for one to open it. While a reader has more than NWIPE_PROGRESS_JSON_BACKLOG
+ *  bytes to catch up on, progress records are dropped, but never state or result records. A record
+ *  that can't be buffered whole for want of memory is left out entirely and counted in the log.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdarg.h>
+#include <limits.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/time.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "progress.h"
+#include "temperature.h"
+#include "stats.h"
+#include "event.h"
+#include "publish.h"
+#include "progress_json.h"
+
+/* How often the drives are looked at for state changes, in milliseconds */
+#define NWIPE_PROGRESS_JSON_POLL_MS 100
+
+/* The most bytes buffered for a slow reader before progress records are dropped */
+#define NWIPE_PROGRESS_JSON_BACKLOG ( 4 * 1024 * 1024 )
+
+/* The longest time kwipe_progress_json_stop() waits for the reader to take the last records */
+#define NWIPE_PROGRESS_JSON_FLUSH_MS 5000
+
+typedef enum kwipe_progress_json_state_t_ {
+    NWIPE_PROGRESS_JSON_QUEUED = 0,
+    NWIPE_PROGRESS_JSON_WIPING,
+    NWIPE_PROGRESS_JSON_FINISHED
+} kwipe_progress_json_state_t;
+
+static const char* kwipe_progress_json_states[] = { "queued", "wiping", "finished" };
+
+/* Indexed by kwipe_pass_t */
+static const char* kwipe_progress_json_passes[] = { "none", "write", "verify", "blank", "ops2", "discard" };
+
+#define NWIPE_PROGRESS_JSON_PASSES ( sizeof( kwipe_progress_json_passes ) / sizeof( kwipe_progress_json_passes[0] ) )
+
+/* What was last written about a drive, to notice when it changes */
+typedef struct
+{
+    kwipe_progress_json_state_t state;
+    int round;
+    int pass;
+    kwipe_pass_t pass_type;
+    int reported;  // Set once the state of the drive has been written.
+    int result_reported;  // Set once the result of the drive has been written.
+} kwipe_progress_json_drive_t;
+
+static kwipe_context_t** progress_json_c;
+static int progress_json_count;
+static kwipe_progress_json_drive_t* progress_json_drives;
+static kwipe_publish_text_t progress_json_buffer;  // The records not yet taken by the reader, from start to length.
+static size_t progress_json_record;  // Where the record being printed starts in the buffer.
+static int progress_json_fd = -1;
+static int progress_json_close_fd;  // Set if the descriptor was opened for a PATH, rather than inherited.
+static int progress_json_fd_flags = -1;  // The flags of an inherited descriptor made non-blocking, to put back.
+static kwipe_publish_thread_t progress_json_thread = NWIPE_PUBLISH_THREAD_INITIALIZER;
+static u64 progress_json_dropped;
+static u64 progress_json_lost;  // Records there was no memory to buffer.
+static int progress_json_broken;  // Set once a write has failed, nothing more is written.
+
+static void kwipe_progress_json_printf( const char* format, ... )
+{
+    va_list ap;
+
+    va_start( ap, format );
+    kwipe_publish_vprintf( &progress_json_buffer, format, ap );
+    va_end( ap );
+}
+
+/* Appends a JSON string, quoted and escaped */
+static void kwipe_progress_json_string( const char* value )
+{
+    char escaped[512];
+
+    /* Device names and serial numbers are short, anything longer is cut off. */
+    kwipe_publish_escape( escaped, sizeof( escaped ), value, NWIPE_PUBLISH_JSON );
+    kwipe_progress_json_printf( "\"%s\"", escaped );
+}
+
+/* Starts a record with the fields common to all of them */
+static void kwipe_progress_json_begin( const char* type, kwipe_context_t* c )
+{
+    kwipe_publish_text_t* b = &progress_json_buffer;
+    struct timeval now;
+
+    /* Move what the reader hasn't taken yet to the front, so the buffer only grows for a reader that falls behind. */
+    if( b->start > 0 )
+    {
+        memmove( b->text, b->text + b->start, b->length - b->start );
+        b->length -= b->start;
+        b->start = 0;
+    }
+    progress_json_record = b->length;
+
+    gettimeofday( &now, NULL );
+
+    kwipe_progress_json_printf(
+        "{\"type\":\"%s\",\"time\":%ld.%03ld,\"device\":", type, (long) now.tv_sec, (long) now.tv_usec / 1000 );
+    kwipe_progress_json_string( c->device_name );
+    kwipe_progress_json_printf( ",\"serial\":" );
+    kwipe_progress_json_string( c->device_serial_no );
+}
+
+/* Ends a record, or takes all of it back out of the buffer if it couldn't be buffered whole */
+static void kwipe_progress_json_end( void )
+{
+    kwipe_publish_text_t* b = &progress_json_buffer;
+
+    kwipe_progress_json_printf( "}\n" );
+    if( b->failed )
+    {
+        b->length = progress_json_record;
+        b->failed = 0;
+        progress_json_lost++;
+    }
+}
+
+static void kwipe_progress_json_errors( kwipe_context_t* c )
+{
+    kwipe_progress_json_printf( ",\"errors\":{\"pass\":%llu,\"verify\":%llu,\"fdatasync\":%llu}",
+                                c->pass_errors,
+                                c->verify_errors,
+                                c->fsyncdata_errors );
+}
+
+static const char* kwipe_progress_json_pass_name( kwipe_pass_t pass_type )
+{
+    if( (unsigned int) pass_type >= NWIPE_PROGRESS_JSON_PASSES )
+    {
+        return "none";
+    }
+    return kwipe_progress_json_passes[pass_type];
+}
+
+static kwipe_progress_json_state_t kwipe_progress_json_state( kwipe_context_t* c )
+{
+    /* The wipe thread marks itself finished with release semantics once the result and errors are final. */
+    if( kwipe_thread_finished( c ) )
+    {
+        return NWIPE_PROGRESS_JSON_FINISHED;
+    }
+    if( c->wipe_status == -1 )
+    {
+        return NWIPE_PROGRESS_JSON_QUEUED;
+    }
+    return NWIPE_PROGRESS_JSON_WIPING;
+}
+
+static void kwipe_progress_json_progress( kwipe_context_t* c, kwipe_progress_json_state_t state )
+{
+    kwipe_progress_t progress;
+
+    /* Take a copy, the wipe thread keeps updating the counters. */
+    kwipe_progress_snapshot( c, &progress );
+
+    kwipe_progress_json_begin( "progress", c );
+    kwipe_progress_json_printf(
+        ",\"state\":\"%s\",\"round\":%i,\"rounds\":%i,\"pass\":%i,\"passes\":%i,\"pass_type\":\"%s\"",
+        kwipe_progress_json_states[state],
+        c->round_working,
+        c->round_count,
+        c->pass_working,
+        c->pass_count,
+        kwipe_progress_json_pass_name( c->pass_type ) );
+    kwipe_progress_json_printf( ",\"pass_done\":%llu,\"round_done\":%llu,\"round_size\":%llu",
+                                progress.pass_done,
+                                progress.round_done,
+                                c->round_size );
+
+    /* From the same snapshot as round_done, so the record never contradicts itself */
+    kwipe_progress_json_printf( ",\"percent\":%.2f", kwipe_progress_percent( c, &progress ) );
+    kwipe_progress_json_printf( ",\"bytes_written\":%llu,\"bytes_read\":%llu,\"bytes_erased\":%llu",
+                                progress.bytes_written,
+                                progress.bytes_read,
+                                progress.bytes_erased );
+    kwipe_progress_json_printf( ",\"throughput\":%llu,\"eta\":", c->throughput );
+    if( state == NWIPE_PROGRESS_JSON_WIPING )
+    {
+        kwipe_progress_json_printf( "%llu", c->eta );
+    }
+    else
+    {
+        kwipe_progress_json_printf( "null" );
+    }
+    kwipe_progress_json_errors( c );
+    if( c->temp1_input != NO_TEMPERATURE_DATA )
+    {
+        kwipe_progress_json_printf( ",\"temperature\":%i", c->temp1_input );
+    }
+    else
+    {
+        kwipe_progress_json_printf( ",\"temperature\":null" );
+    }
+    if( progress_json_dropped > 0 )
+    {
+        kwipe_progress_json_printf( ",\"dropped\":%llu", progress_json_dropped );
+    }
+    kwipe_progress_json_end();
+}
+
+static void kwipe_progress_json_result( kwipe_context_t* c, kwipe_progress_json_state_t state )
+{
+    kwipe_progress_t progress;
+    const char* status;
+    long duration = 0;
+
+    kwipe_progress_snapshot( c, &progress );
+
+    /* Classed as in the summary table of the log and on the certificate */
+    status = kwipe_log_wipe_status( c );
+
+    if( state == NWIPE_PROGRESS_JSON_FINISHED && c->start_time != 0 && c->end_time >= c->start_time )
+    {
+        duration = (long) ( c->end_time - c->start_time );
+    }
+
+    kwipe_progress_json_begin( "result", c );
+    kwipe_progress_json_printf( ",\"status\":\"%s\",\"result\":%i", status, c->result );
+    kwipe_progress_json_printf( ",\"round_done\":%llu,\"bytes_written\":%llu,\"bytes_read\":%llu",
+                                progress.round_done,
+                                progress.bytes_written,
+                                progress.bytes_read );
+    kwipe_progress_json_printf( ",\"bytes_erased\":%llu", progress.bytes_erased );
+    kwipe_progress_json_printf( ",\"duration\":%ld,\"throughput\":%llu", duration, c->throughput_overall );
+    kwipe_progress_json_errors( c );
+    kwipe_progress_json_end();
+}
+
+/* Writes a state record for each drive that has changed state, pass or round, and its result once it has finished */
+static void kwipe_progress_json_changes( void )
+{
+    kwipe_progress_json_drive_t* d;
+    kwipe_progress_json_state_t state;
+    kwipe_context_t* c;
+    int i;
+
+    for( i = 0; i < progress_json_count; i++ )
+    {
+        c = progress_json_c[i];
+        d = &progress_json_drives[i];
+        state = kwipe_progress_json_state( c );
+
+        if( d->reported && d->state == state && d->round == c->round_working && d->pass == c->pass_working
+            && d->pass_type == c->pass_type )
+        {
+            continue;
+        }
+
+        kwipe_progress_json_begin( "state", c );
+        kwipe_progress_json_printf( ",\"state\":\"%s\",\"previous\":", kwipe_progress_json_states[state] );
+        if( d->reported )
+        {
+            kwipe_progress_json_printf( "\"%s\"", kwipe_progress_json_states[d->state] );
+        }
+        else
+        {
+            kwipe_progress_json_printf( "null" );
+        }
+        kwipe_progress_json_printf( ",\"round\":%i,\"pass\":%i,\"pass_type\":\"%s\"",
+                                    c->round_working,
+                                    c->pass_working,
+                                    kwipe_progress_json_pass_name( c->pass_type ) );
+        kwipe_progress_json_end();
+
+        d->state = state;
+        d->round = c->round_working;
+        d->pass = c->pass_working;
+        d->pass_type = c->pass_type;
+        d->reported = 1;
+
+        if( state == NWIPE_PROGRESS_JSON_FINISHED && !d->result_reported )
+        {
+            kwipe_progress_json_result( c, state );
+            d->result_reported = 1;
+        }
+    }
+}
+
+/* Writes as much of the buffer as the reader takes without waiting, returns -1 if the stream is broken */
+static int kwipe_progress_json_flush( void )
+{
+    kwipe_publish_text_t* b = &progress_json_buffer;
+    ssize_t r;
+
+    if( progress_json_broken )
+    {
+        return -1;
+    }
+
+    while( b->start < b->length )
+    {
+        r = write( progress_json_fd, b->text + b->start, b->length - b->start );
+        if( r < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+            if( errno == EAGAIN || errno == EWOULDBLOCK )
+            {
+                return 0;
+            }
+            kwipe_perror( errno, __FUNCTION__, "write" );
+            kwipe_log( NWIPE_LOG_ERROR, "progress-json: Unable to write the progress, no more will be written." );
+            progress_json_broken = 1;
+            return -1;
+        }
+        b->start += r;
+    }
+
+    b->start = 0;
+    b->length = 0;
+
+    return 0;
+}
+
+/* Writes the last changes and the result of every drive, including those that never finished, and waits a little for
+ * the reader to take them */
+static void kwipe_progress_json_final( void )
+{
+    struct pollfd pfd;
+    u64 deadline_ns;
+    u64 now_ns;
+    int i;
+
+    kwipe_progress_json_changes();
+    for( i = 0; i < progress_json_count; i++ )
+    {
+        if( !progress_json_drives[i].result_reported )
+        {
+            kwipe_progress_json_result( progress_json_c[i], progress_json_drives[i].state );
+            progress_json_drives[i].result_reported = 1;
+        }
+    }
+
+    deadline_ns = kwipe_time_ns() + NWIPE_PROGRESS_JSON_FLUSH_MS * 1000000ULL;
+    pfd.fd = progress_json_fd;
+    pfd.events = POLLOUT;
+    while( kwipe_progress_json_flush() == 0 && progress_json_buffer.length > 0 )
+    {
+        now_ns = kwipe_time_ns();
+        if( now_ns >= deadline_ns )
+        {
+            kwipe_log( NWIPE_LOG_WARNING, "progress-json: The reader didn't take the last of the progress." );
+            break;
+        }
+        poll( &pfd, 1, (int) ( ( deadline_ns - now_ns ) / 1000000 ) + 1 );
+    }
+}
+
+static void* kwipe_progress_json_thread( void* ptr )
+{
+    struct pollfd pfd[2];
+    sigset_t sigset;
+    u64 interval_ns = (u64) kwipe_options.progress_json_interval * 1000000000ULL;
+    u64 next_ns = 0;
+    u64 now_ns;
+    int i;
+
+    (void) ptr;
+
+    /* A reader that goes away fails the write with EPIPE, instead of killing kwipe with SIGPIPE. */
+    sigemptyset( &sigset );
+    sigaddset( &sigset, SIGPIPE );
+    pthread_sigmask( SIG_BLOCK, &sigset, NULL );
+
+    pfd[0].fd = progress_json_thread.stop_pipe[0];
+    pfd[0].events = POLLIN;
+    pfd[1].fd = progress_json_fd;
+
+    for( ;; )
+    {
+        kwipe_progress_json_changes();
+
+        now_ns = kwipe_time_ns();
+        if( now_ns >= next_ns )
+        {
+            for( i = 0; i < progress_json_count; i++ )
+            {
+                if( progress_json_buffer.length - progress_json_buffer.start > NWIPE_PROGRESS_JSON_BACKLOG )
+                {
+                    progress_json_dropped++;
+                    continue;
+                }
+                kwipe_progress_json_progress( progress_json_c[i], progress_json_drives[i].state );
+            }
+            next_ns = now_ns + interval_ns;
+        }
+
+        if( kwipe_progress_json_flush() != 0 )
+        {
+            break;
+        }
+
+        /* Wait for the next look at the drives, or for the reader to make room. */
+        pfd[0].revents = 0;
+        pfd[1].events = progress_json_buffer.length > 0 ? POLLOUT : 0;
+        pfd[1].revents = 0;
+        if( poll( pfd, 2, NWIPE_PROGRESS_JSON_POLL_MS ) < 0 && errno != EINTR )
+        {
+            kwipe_perror( errno, __FUNCTION__, "poll" );
+            break;
+        }
+
+        if( pfd[0].revents )
+        {
+            kwipe_progress_json_final();
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int kwipe_progress_json_open( const char* target )
+{
+    char* end;
+    long fd;
+    int flags;
+
+    /* A number is a descriptor inherited from the caller, anything else a path. */
+    fd = strtol( target, &end, 10 );
+    if( *target != 0 && *end == 0 && fd >= 0 && fd <= INT_MAX )
+    {
+        progress_json_fd = (int) fd;
+        progress_json_close_fd = 0;
+        flags = fcntl( progress_json_fd, F_GETFL );
+        if( flags < 0 )
+        {
+            kwipe_log( NWIPE_LOG_ERROR, "progress-json: File descriptor %s is not open.", target );
+            progress_json_fd = -1;
+            return -1;
+        }
+
+        /* The flags belong to the open file shared with the caller, kwipe_progress_json_stop() puts them back. */
+        if( ( flags & O_NONBLOCK ) == 0 )
+        {
+            if( fcntl( progress_json_fd, F_SETFL, flags | O_NONBLOCK ) < 0 )
+            {
+                kwipe_perror( errno, __FUNCTION__, "fcntl" );
+            }
+            else
+            {
+                progress_json_fd_flags = flags;
+            }
+        }
+    }
+    else
+    {
+        /* Without O_NONBLOCK, opening a FIFO would wait for a reader, with it the open fails with ENXIO instead. */
+        progress_json_fd = open( target, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | O_NONBLOCK, 0644 );
+        progress_json_close_fd = 1;
+        if( progress_json_fd < 0 && errno == ENXIO )
+        {
+            kwipe_log( NWIPE_LOG_ERROR,
+                       "progress-json: Nothing is reading the FIFO %s, start the reader before kwipe.",
+                       target );
+            return -1;
+        }
+        if( progress_json_fd < 0 )
+        {
+            kwipe_perror( errno, __FUNCTION__, "open" );
+            kwipe_log( NWIPE_LOG_ERROR, "progress-json: Unable to open %s.", target );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int kwipe_progress_json_start( kwipe_context_t** c, int count )
+{
+    if( kwipe_options.progress_json == NULL )
+    {
+        return 0;
+    }
+
+    progress_json_c = c;
+    progress_json_count = count;
+    progress_json_drives = calloc( count > 0 ? count : 1, sizeof( kwipe_progress_json_drive_t ) );
+    if( progress_json_drives == NULL )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "progress-json: Unable to allocate memory for the progress." );
+        return -1;
+    }
+
+    if( kwipe_progress_json_open( kwipe_options.progress_json ) != 0 )
+    {
+        kwipe_progress_json_stop();
+        return -1;
+    }
+
+    if( kwipe_publish_start( &progress_json_thread, kwipe_progress_json_thread ) != 0 )
+    {
+        kwipe_progress_json_stop();
+        return -1;
+    }
+
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "progress-json: Writing the progress to %s every %i seconds",
+               kwipe_options.progress_json,
+               kwipe_options.progress_json_interval );
+
+    return 0;
+}
+
+void kwipe_progress_json_stop( void )
+{
+    kwipe_publish_stop( &progress_json_thread );
+    if( progress_json_dropped > 0 )
+    {
+        kwipe_log( NWIPE_LOG_WARNING,
+                   "progress-json: %llu progress records were dropped, the reader fell behind.",
+                   progress_json_dropped );
+        progress_json_dropped = 0;
+    }
+    if( progress_json_lost > 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "progress-json: %llu records were lost, there was no memory to buffer them.",
+                   progress_json_lost );
+        progress_json_lost = 0;
+    }
+
+    if( progress_json_fd >= 0 && progress_json_close_fd )
+    {
+        close( progress_json_fd );
+    }
+    else if( progress_json_fd >= 0 && progress_json_fd_flags >= 0 )
+    {
+        if( fcntl( progress_json_fd, F_SETFL, progress_json_fd_flags ) < 0 )
+        {
+            kwipe_perror( errno, __FUNCTION__, "fcntl" );
+        }
+    }
+    progress_json_fd = -1;
+    progress_json_fd_flags = -1;
+
+    free( progress_json_drives );
+    progress_json_drives = NULL;
+    kwipe_publish_free( &progress_json_buffer );
+}
@@ -0,0 +1,42 @@
+/*
+ *  progress_json.h: A machine readable stream of the progress of the wipes, one JSON object per line.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PROGRESS_JSON_H_
+#define PROGRESS_JSON_H_
+
+#include "context.h"
+
+/* The default of --progress-json-interval, in seconds */
+#define NWIPE_PROGRESS_JSON_DEFAULT_INTERVAL 1
+
+/**
+ * Starts the thread that writes the progress of the drives to the file descriptor or file of
+ * --progress-json. Does nothing if it wasn't given.
+ * @param c the contexts of the drives being wiped, which must outlive kwipe_progress_json_stop()
+ * @param count the number of drives
+ * @return 0 on success, -1 if the stream couldn't be opened or the thread created, the reason has been logged
+ */
+int kwipe_progress_json_start( kwipe_context_t** c, int count );
+
+/**
+ * Stops the progress thread once the wipe threads have finished, after writing the result of each
+ * drive and flushing what the reader hasn't taken yet, waiting a few seconds at most.
+ */
+void kwipe_progress_json_stop( void );
+
+#endif /* PROGRESS_JSON_H_ */
@@ -0,0 +1,183 @@
+/*
+ *  publish.c: What the threads publishing the progress of the wipes, metrics.c and progress_json.c, share.
+ *
+ *  Both render text of a size not known beforehand, escape the names and serial numbers of the
+ *  drives into it, and run on a thread of their own until the wipes have finished, woken to stop
+ *  by a pipe they poll along with their sockets or stream.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdarg.h>
+#include <fcntl.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "publish.h"
+
+/* The size of a text when it is first printed to */
+#define NWIPE_PUBLISH_TEXT_SIZE 65536
+
+void kwipe_publish_printf( kwipe_publish_text_t* t, const char* format, ... )
+{
+    va_list ap;
+
+    va_start( ap, format );
+    kwipe_publish_vprintf( t, format, ap );
+    va_end( ap );
+}
+
+void kwipe_publish_vprintf( kwipe_publish_text_t* t, const char* format, va_list ap )
+{
+    va_list copy;
+    size_t size;
+    char* text;
+    int n;
+
+    if( t->failed )
+    {
+        return;
+    }
+
+    for( ;; )
+    {
+        va_copy( copy, ap );
+        n = vsnprintf( t->text + t->length, t->size - t->length, format, copy );
+        va_end( copy );
+
+        if( n < 0 )
+        {
+            t->failed = 1;
+            return;
+        }
+        if( t->length + n < t->size )
+        {
+            t->length += n;
+            return;
+        }
+
+        size = t->size ? t->size * 2 : NWIPE_PUBLISH_TEXT_SIZE;
+        while( size <= t->length + n )
+        {
+            size *= 2;
+        }
+        text = realloc( t->text, size );
+        if( text == NULL )
+        {
+            t->failed = 1;
+            return;
+        }
+        t->text = text;
+        t->size = size;
+    }
+}
+
+void kwipe_publish_free( kwipe_publish_text_t* t )
+{
+    free( t->text );
+    memset( t, 0, sizeof( kwipe_publish_text_t ) );
+}
+
+size_t kwipe_publish_escape( char* out, size_t size, const char* value, kwipe_publish_escape_t how )
+{
+    size_t length = 0;
+    size_t end;
+    size_t i;
+    unsigned char ch;
+
+    end = value != NULL ? strlen( value ) : 0;
+    while( end > 0 && value[end - 1] == ' ' )
+    {
+        end--;
+    }
+
+    /* Stop while there is room for the longest escape, \u00XX, and the terminator */
+    for( i = 0; i < end && length + 7 < size; i++ )
+    {
+        ch = (unsigned char) value[i];
+        if( ch == '"' || ch == '\\' )
+        {
+            out[length++] = '\\';
+            out[length++] = (char) ch;
+        }
+        else if( ch == '\n' && how == NWIPE_PUBLISH_PROMETHEUS )
+        {
+            out[length++] = '\\';
+            out[length++] = 'n';
+        }
+        else if( ch < 0x20 && how == NWIPE_PUBLISH_JSON )
+        {
+            length += snprintf( out + length, size - length, "\\u%04x", ch );
+        }
+        else
+        {
+            out[length++] = (char) ch;
+        }
+    }
+    out[length] = 0;
+
+    return length;
+}
+
+int kwipe_publish_start( kwipe_publish_thread_t* t, void* ( *run )( void* ) )
+{
+    if( pipe2( t->stop_pipe, O_CLOEXEC ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "pipe2" );
+        t->stop_pipe[0] = -1;
+        t->stop_pipe[1] = -1;
+        return -1;
+    }
+
+    errno = pthread_create( &t->thread, NULL, run, NULL );
+    if( errno != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "pthread_create" );
+        kwipe_publish_stop( t );
+        return -1;
+    }
+    t->started = 1;
+
+    return 0;
+}
+
+void kwipe_publish_stop( kwipe_publish_thread_t* t )
+{
+    if( t->started )
+    {
+        if( write( t->stop_pipe[1], "", 1 ) != 1 )
+        {
+            kwipe_perror( errno, __FUNCTION__, "write" );
+        }
+        pthread_join( t->thread, NULL );
+        t->started = 0;
+    }
+
+    if( t->stop_pipe[0] >= 0 )
+    {
+        close( t->stop_pipe[0] );
+        close( t->stop_pipe[1] );
+        t->stop_pipe[0] = -1;
+        t->stop_pipe[1] = -1;
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ *  publish.h: What the threads publishing the progress of the wipes, metrics.c and progress_json.c, share.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef PUBLISH_H_
+#define PUBLISH_H_
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <pthread.h>
+
+/* Text that grows as it is printed. A stream writes it out from start, see progress_json.c. */
+typedef struct
+{
+    char* text;
+    size_t start;  // The first byte not yet written out.
+    size_t length;
+    size_t size;
+    int failed;  // Set once the text couldn't be grown, nothing more is printed until it is cleared.
+} kwipe_publish_text_t;
+
+/* How kwipe_publish_escape() escapes a string */
+typedef enum kwipe_publish_escape_t_ {
+    NWIPE_PUBLISH_PROMETHEUS = 0,  // A label value of the Prometheus text exposition format.
+    NWIPE_PUBLISH_JSON  // A JSON string.
+} kwipe_publish_escape_t;
+
+/* A publishing thread, asked to stop by making stop_pipe[0] readable */
+typedef struct
+{
+    pthread_t thread;
+    int stop_pipe[2];
+    int started;
+} kwipe_publish_thread_t;
+
+#define NWIPE_PUBLISH_THREAD_INITIALIZER \
+    {                                    \
+        .stop_pipe = { -1, -1 }          \
+    }
+
+/**
+ * Appends to the text, growing it as needed. Sets t->failed if it can't be grown.
+ */
+void kwipe_publish_printf( kwipe_publish_text_t* t, const char* format, ... );
+void kwipe_publish_vprintf( kwipe_publish_text_t* t, const char* format, va_list ap );
+
+/**
+ * Releases the text and empties it.
+ */
+void kwipe_publish_free( kwipe_publish_text_t* t );
+
+/**
+ * Escapes a string into out, without the quotes around it. The spaces the GUI pads
+ * serial numbers and bus types with are left out, and a value too long for out is cut off.
+ * @param size the size of out, at least 8
+ * @return the length of the escaped string
+ */
+size_t kwipe_publish_escape( char* out, size_t size, const char* value, kwipe_publish_escape_t how );
+
+/**
+ * Starts run( NULL ) on a thread of its own, which returns once t->stop_pipe[0] is readable.
+ * @return 0 on success, -1 if the pipe or thread couldn't be created, the reason has been logged
+ */
+int kwipe_publish_start( kwipe_publish_thread_t* t, void* ( *run )( void* ) );
+
+/**
+ * Asks the thread to stop, waits for it to return and closes the pipe. Does nothing if it wasn't started.
+ */
+void kwipe_publish_stop( kwipe_publish_thread_t* t );
+
+#endif /* PUBLISH_H_ */
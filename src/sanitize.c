@@ -0,0 +1,1480 @@
+/*
+ *  sanitize.c: The drive's own sanitize commands, ATA SANITIZE, NVMe Sanitize/Format NVM and
+ *  SCSI SANITIZE, as wipe methods.
+ *
+ *  An overwrite from the host takes hours on a large drive and can't reach the spare or
+ *  remapped blocks of an SSD, while a crypto erase changes the media encryption key in a few
+ *  seconds and a block erase resets every block, spare ones included. The sanitize methods ask
+ *  the drive to do one of these, or a single overwrite, and follow its progress:
+ *
+ *  ATA   SANITIZE (CRYPTO SCRAMBLE / BLOCK ERASE / OVERWRITE) EXT sent as ATA PASS-THROUGH (16)
+ *        through SG_IO, the progress is read with SANITIZE STATUS EXT. Its status bits only come
+ *        back in descriptor format sense data, which is switched on with D_SENSE first.
+ *  NVMe  Sanitize through the admin ioctl, the progress is read from the Sanitize Status log page.
+ *        Controllers without Sanitize get a Format NVM with the matching Secure Erase Setting,
+ *        which reports no progress until it completes.
+ *  SCSI  SANITIZE with IMMED set, the progress is read with REQUEST SENSE.
+ *
+ *  The progress feeds the drive's progress counters, so round_percent and the ETA work as they do
+ *  for the other methods. Unless --verify=off, NWIPE_SANITIZE_VERIFY_SAMPLES blocks spread across
+ *  the drive are then read back. After an overwrite they must be zeros, after a crypto or block
+ *  erase each sample that held data beforehand must have changed, as what they read as afterwards
+ *  is up to the drive.
+ *
+ *  kwipe_discard() is the lighter relative run after an ordinary wipe of an SSD with --discard,
+ *  a BLKDISCARD of the whole device, verified by the same sampled read when the device guarantees
+ *  that discarded blocks read as zeros.
+ *
+ *  The commands are sent through kwipe_sanitize_ops_t, so they can be replaced to test the methods
+ *  without a device.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <scsi/sg.h>
+#include <linux/nvme_ioctl.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "stats.h"
+#include "progress.h"
+#include "event.h"
+#include "sanitize.h"
+#include "io.h"
+
+#define NWIPE_SCSI_STATUS_CHECK_CONDITION 0x02
+
+#define NWIPE_SCSI_SANITIZE 0x48
+#define NWIPE_SCSI_REQUEST_SENSE 0x03
+#define NWIPE_SCSI_MODE_SELECT_10 0x55
+#define NWIPE_SCSI_MODE_SENSE_10 0x5A
+#define NWIPE_SCSI_ATA_PASS_THROUGH_16 0x85
+
+/* The Control mode page, and its D_SENSE bit that selects descriptor format sense data */
+#define NWIPE_SCSI_CONTROL_PAGE 0x0A
+#define NWIPE_SCSI_CONTROL_D_SENSE 0x04
+
+#define NWIPE_SENSE_NO_SENSE 0x0
+#define NWIPE_SENSE_NOT_READY 0x2
+#define NWIPE_SENSE_ILLEGAL_REQUEST 0x5
+#define NWIPE_SENSE_UNIT_ATTENTION 0x6
+
+#define NWIPE_ATA_IDENTIFY_DEVICE 0xEC
+#define NWIPE_ATA_SANITIZE 0xB4
+#define NWIPE_ATA_STATUS_ERR 0x01
+
+#define NWIPE_ATA_SANITIZE_STATUS_EXT 0x0000
+#define NWIPE_ATA_CRYPTO_SCRAMBLE_EXT 0x0011
+#define NWIPE_ATA_BLOCK_ERASE_EXT 0x0012
+#define NWIPE_ATA_OVERWRITE_EXT 0x0014
+
+/* The values of the SANITIZE STATUS EXT count field */
+#define NWIPE_ATA_SANITIZE_COMPLETED 0x8000
+#define NWIPE_ATA_SANITIZE_IN_PROGRESS 0x4000
+#define NWIPE_ATA_SANITIZE_FROZEN 0x2000
+
+#define NWIPE_NVME_GET_LOG_PAGE 0x02
+#define NWIPE_NVME_IDENTIFY 0x06
+#define NWIPE_NVME_FORMAT_NVM 0x80
+#define NWIPE_NVME_SANITIZE 0x84
+#define NWIPE_NVME_LOG_SANITIZE_STATUS 0x81
+#define NWIPE_NVME_IDENTIFY_SIZE 4096
+#define NWIPE_NVME_SANITIZE_LOG_SIZE 512
+
+/* The Sanitize Status field of the Sanitize Status log page */
+#define NWIPE_NVME_SANITIZE_NEVER 0
+#define NWIPE_NVME_SANITIZE_SUCCEEDED 1
+#define NWIPE_NVME_SANITIZE_IN_PROGRESS 2
+#define NWIPE_NVME_SANITIZE_FAILED 3
+#define NWIPE_NVME_SANITIZE_SUCCEEDED_NO_DEALLOCATE 4
+
+static const char* kwipe_sanitize_action_name[] = { "crypto erase", "block erase", "overwrite" };
+
+typedef struct
+{
+    int key;
+    int asc;
+    int ascq;
+    int progress;  // 0 to 65535, -1 if the sense data has no progress indication
+} kwipe_sense_t;
+
+/* The registers an ATA command returned */
+typedef struct
+{
+    unsigned char error;
+    unsigned char status;
+    unsigned int count;
+    u64 lba;
+    int count_upper_unknown;  // Set if fixed format sense data says the upper byte of the count isn't zero.
+} kwipe_ata_result_t;
+
+/* Returns 1 while the device is sanitizing, with *progress from 0 to 65535 or -1 if it isn't known,
+ * 0 once the operation completed successfully, -1 if it failed */
+typedef int ( *kwipe_sanitize_poll_t )( kwipe_context_t* c, int* progress );
+
+static int kwipe_sanitize_sg_io( int fd, kwipe_scsi_command_t* command )
+{
+    sg_io_hdr_t io;
+
+    memset( &io, 0, sizeof( io ) );
+    io.interface_id = 'S';
+    io.cmdp = command->cdb;
+    io.cmd_len = command->cdb_length;
+    io.dxferp = command->data;
+    io.dxfer_len = command->data_length;
+    io.sbp = command->sense;
+    io.mx_sb_len = sizeof( command->sense );
+    io.timeout = command->timeout_ms;
+
+    switch( command->direction )
+    {
+        case NWIPE_SANITIZE_DATA_IN:
+            io.dxfer_direction = SG_DXFER_FROM_DEV;
+            break;
+
+        case NWIPE_SANITIZE_DATA_OUT:
+            io.dxfer_direction = SG_DXFER_TO_DEV;
+            break;
+
+        default:
+            io.dxfer_direction = SG_DXFER_NONE;
+            break;
+    }
+
+    if( ioctl( fd, SG_IO, &io ) < 0 )
+    {
+        return -1;
+    }
+
+    /* The command didn't reach the device */
+    if( io.host_status != 0 )
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    command->status = io.status;
+    command->sense_length = io.sb_len_wr;
+
+    return 0;
+}
+
+static int kwipe_sanitize_nvme_ioctl( int fd, kwipe_nvme_command_t* command )
+{
+    struct nvme_admin_cmd admin;
+    int r;
+
+    memset( &admin, 0, sizeof( admin ) );
+    admin.opcode = command->opcode;
+    admin.nsid = command->nsid;
+    admin.cdw10 = command->cdw10;
+    admin.cdw11 = command->cdw11;
+    admin.addr = (u64) (uintptr_t) command->data;
+    admin.data_len = command->data_length;
+    admin.timeout_ms = command->timeout_ms;
+
+    r = ioctl( fd, NVME_IOCTL_ADMIN_CMD, &admin );
+
+    command->result = admin.result;
+
+    return r;
+}
+
+static int kwipe_sanitize_nvme_ioctl_id( int fd )
+{
+    return ioctl( fd, NVME_IOCTL_ID );
+}
+
+static const kwipe_sanitize_ops_t kwipe_sanitize_device_ops = {
+    kwipe_sanitize_sg_io,
+    kwipe_sanitize_nvme_ioctl,
+    kwipe_sanitize_nvme_ioctl_id,
+};
+
+static const kwipe_sanitize_ops_t* kwipe_sanitize_ops = &kwipe_sanitize_device_ops;
+
+void kwipe_sanitize_set_ops( const kwipe_sanitize_ops_t* ops )
+{
+    kwipe_sanitize_ops = ops != NULL ? ops : &kwipe_sanitize_device_ops;
+}
+
+int kwipe_method_is_sanitize( void* method )
+{
+    return method == &kwipe_sanitize_crypto || method == &kwipe_sanitize_block || method == &kwipe_sanitize_overwrite;
+}
+
+static void kwipe_sanitize_parse_sense( const unsigned char* s, unsigned int length, kwipe_sense_t* sense )
+{
+    /* Both the fixed and the descriptor format, with the progress of the sense key specific field */
+    const unsigned char* d;
+    unsigned int end;
+    unsigned int n;
+
+    sense->key = 0;
+    sense->asc = 0;
+    sense->ascq = 0;
+    sense->progress = -1;
+
+    if( length < 8 )
+    {
+        return;
+    }
+
+    switch( s[0] & 0x7F )
+    {
+        case 0x70:
+        case 0x71:
+            sense->key = s[2] & 0x0F;
+            if( length >= 14 )
+            {
+                sense->asc = s[12];
+                sense->ascq = s[13];
+            }
+            if( length >= 18 && ( s[15] & 0x80 ) )
+            {
+                sense->progress = ( s[16] << 8 ) | s[17];
+            }
+            break;
+
+        case 0x72:
+        case 0x73:
+            sense->key = s[1] & 0x0F;
+            sense->asc = s[2];
+            sense->ascq = s[3];
+
+            end = 8u + s[7] < length ? 8u + s[7] : length;
+            for( n = 8; n + 2 <= end; n += 2 + s[n + 1] )
+            {
+                d = &s[n];
+                if( d[0] == 0x02 && n + 7 <= end && ( d[4] & 0x80 ) )
+                {
+                    sense->progress = ( d[5] << 8 ) | d[6];
+                }
+            }
+            break;
+    }
+}
+
+static int kwipe_sanitize_ata_registers( const unsigned char* s, unsigned int length, kwipe_ata_result_t* result )
+{
+    /* Finds the registers the SAT layer returned in the sense data, the ATA Status Return descriptor
+     * of descriptor format sense data or the fields of fixed format sense data, which only hold
+     * the low bytes of the count and the LBA. Returns -1 if there are none. */
+    const unsigned char* d;
+    unsigned int end;
+    unsigned int n;
+
+    if( length >= 8 && ( s[0] & 0x7F ) == 0x72 )
+    {
+        end = 8u + s[7] < length ? 8u + s[7] : length;
+        for( n = 8; n + 2 <= end; n += 2 + s[n + 1] )
+        {
+            d = &s[n];
+            if( d[0] == 0x09 && n + 14 <= end )
+            {
+                result->error = d[3];
+                result->count = ( d[4] << 8 ) | d[5];
+                result->lba = (u64) d[7] | ( (u64) d[9] << 8 ) | ( (u64) d[11] << 16 ) | ( (u64) d[6] << 24 )
+                              | ( (u64) d[8] << 32 ) | ( (u64) d[10] << 40 );
+                result->status = d[13];
+                return 0;
+            }
+        }
+    }
+
+    if( length >= 12 && ( s[0] & 0x7F ) == 0x70 )
+    {
+        result->error = s[3];
+        result->status = s[4];
+        result->count = s[6];
+        result->lba = (u64) s[9] | ( (u64) s[10] << 8 ) | ( (u64) s[11] << 16 );
+
+        /* COUNT UPPER NONZERO, only descriptor format sense data says which bits are set */
+        result->count_upper_unknown = ( s[8] & 0x40 ) != 0;
+        return 0;
+    }
+
+    return -1;
+}
+
+static int kwipe_sanitize_ata_command( kwipe_context_t* c,
+                                       unsigned char ata_command,
+                                       unsigned int feature,
+                                       unsigned int count,
+                                       u64 lba,
+                                       void* data,
+                                       unsigned int data_length,
+                                       kwipe_ata_result_t* result )
+{
+    /**
+     * Sends an ATA command as ATA PASS-THROUGH (16), without data or reading data_length bytes.
+     * Returns 0 if the device completed it, 1 if it completed it with an error, -1 if it couldn't
+     * be sent or no registers came back.
+     */
+
+    kwipe_scsi_command_t command;
+    kwipe_sense_t sense;
+    int extend = ata_command == NWIPE_ATA_SANITIZE;
+
+    memset( &command, 0, sizeof( command ) );
+    memset( result, 0, sizeof( *result ) );
+
+    command.cdb_length = 16;
+    command.cdb[0] = NWIPE_SCSI_ATA_PASS_THROUGH_16;
+    if( data != NULL )
+    {
+        /* PIO data-in, the length is in sectors in the count field */
+        command.cdb[1] = ( 4 << 1 ) | extend;
+        command.cdb[2] = 0x0E;
+        command.direction = NWIPE_SANITIZE_DATA_IN;
+        command.data = data;
+        command.data_length = data_length;
+    }
+    else
+    {
+        /* Non-data, with CK_COND set so the registers are returned */
+        command.cdb[1] = ( 3 << 1 ) | extend;
+        command.cdb[2] = 0x20;
+    }
+    command.cdb[3] = ( feature >> 8 ) & 0xFF;
+    command.cdb[4] = feature & 0xFF;
+    command.cdb[5] = ( count >> 8 ) & 0xFF;
+    command.cdb[6] = count & 0xFF;
+    command.cdb[7] = ( lba >> 24 ) & 0xFF;
+    command.cdb[8] = lba & 0xFF;
+    command.cdb[9] = ( lba >> 32 ) & 0xFF;
+    command.cdb[10] = ( lba >> 8 ) & 0xFF;
+    command.cdb[11] = ( lba >> 40 ) & 0xFF;
+    command.cdb[12] = ( lba >> 16 ) & 0xFF;
+    command.cdb[13] = 0x40;
+    command.cdb[14] = ata_command;
+    command.timeout_ms = NWIPE_SANITIZE_COMMAND_TIMEOUT_MS;
+
+    if( kwipe_sanitize_ops->scsi_command( c->device_fd, &command ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "SG_IO" );
+        return -1;
+    }
+
+    if( command.status != NWIPE_SCSI_STATUS_CHECK_CONDITION )
+    {
+        /* A data-in command that completed without error returns no registers */
+        return command.status == 0 && data != NULL ? 0 : -1;
+    }
+
+    if( kwipe_sanitize_ata_registers( command.sense, command.sense_length, result ) != 0 )
+    {
+        kwipe_sanitize_parse_sense( command.sense, command.sense_length, &sense );
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "ATA PASS-THROUGH command %02x on %s failed, sense key %x ASC/ASCQ %02x/%02x",
+                   ata_command,
+                   c->device_name,
+                   sense.key,
+                   sense.asc,
+                   sense.ascq );
+        return -1;
+    }
+
+    return ( result->status & NWIPE_ATA_STATUS_ERR ) ? 1 : 0;
+}
+
+static int kwipe_sanitize_ata_status( kwipe_context_t* c, kwipe_ata_result_t* result )
+{
+    /* SANITIZE STATUS EXT, returns as kwipe_sanitize_ata_command() does. The status bits are in the
+     * upper byte of the count, -1 is returned if the sense data didn't hold it. */
+    int r;
+
+    r = kwipe_sanitize_ata_command( c, NWIPE_ATA_SANITIZE, NWIPE_ATA_SANITIZE_STATUS_EXT, 0, 0, NULL, 0, result );
+    if( r == 0 && result->count_upper_unknown )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "The sanitize status of %s came back in fixed format sense data, which doesn't hold it",
+                   c->device_name );
+        return -1;
+    }
+
+    return r;
+}
+
+static int kwipe_sanitize_ata_descriptor_sense( kwipe_context_t* c )
+{
+    /* Fixed format sense data only says whether the upper byte of the count is zero, the sanitize
+     * status needs descriptor format. libata returns fixed format unless D_SENSE is set in the
+     * Control mode page, so it is set here, the page is sent back as it was read otherwise. It
+     * stays set until the drive is reset. Returns 0 if the sense data is in descriptor format. */
+    kwipe_scsi_command_t command;
+    kwipe_sense_t sense;
+    unsigned char data[40];  // The mode parameter header, a block descriptor if DBD is ignored, the Control mode page
+    unsigned char* page;
+    unsigned int length;
+
+    memset( &command, 0, sizeof( command ) );
+    memset( data, 0, sizeof( data ) );
+    command.cdb_length = 10;
+    command.cdb[0] = NWIPE_SCSI_MODE_SENSE_10;
+    command.cdb[1] = 0x08;  // DBD
+    command.cdb[2] = NWIPE_SCSI_CONTROL_PAGE;
+    command.cdb[8] = sizeof( data );
+    command.direction = NWIPE_SANITIZE_DATA_IN;
+    command.data = data;
+    command.data_length = sizeof( data );
+    command.timeout_ms = NWIPE_SANITIZE_COMMAND_TIMEOUT_MS;
+
+    if( kwipe_sanitize_ops->scsi_command( c->device_fd, &command ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "SG_IO" );
+        return -1;
+    }
+
+    /* The header, the block descriptors and the page, which must all have been returned */
+    length = 8 + ( ( data[6] << 8 ) | data[7] );
+    page = data + length;
+    if( command.status != 0 || length + 12 > sizeof( data ) || ( page[0] & 0x3F ) != NWIPE_SCSI_CONTROL_PAGE
+        || page[1] < 10 || length + 2 + page[1] > sizeof( data ) )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "%s didn't return its Control mode page", c->device_name );
+        return -1;
+    }
+
+    if( page[2] & NWIPE_SCSI_CONTROL_D_SENSE )
+    {
+        return 0;
+    }
+
+    /* The mode data length and PS are reserved in MODE SELECT */
+    data[0] = 0;
+    data[1] = 0;
+    page[0] &= 0x3F;
+    page[2] |= NWIPE_SCSI_CONTROL_D_SENSE;
+
+    memset( &command, 0, sizeof( command ) );
+    command.cdb_length = 10;
+    command.cdb[0] = NWIPE_SCSI_MODE_SELECT_10;
+    command.cdb[1] = 0x10;  // PF
+    length += 2 + page[1];
+    command.cdb[8] = length;
+    command.direction = NWIPE_SANITIZE_DATA_OUT;
+    command.data = data;
+    command.data_length = length;
+    command.timeout_ms = NWIPE_SANITIZE_COMMAND_TIMEOUT_MS;
+
+    if( kwipe_sanitize_ops->scsi_command( c->device_fd, &command ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "SG_IO" );
+        return -1;
+    }
+
+    if( command.status != 0 )
+    {
+        kwipe_sanitize_parse_sense( command.sense, command.sense_length, &sense );
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "%s refused descriptor format sense data, sense key %x ASC/ASCQ %02x/%02x",
+                   c->device_name,
+                   sense.key,
+                   sense.asc,
+                   sense.ascq );
+        return -1;
+    }
+
+    kwipe_log( NWIPE_LOG_NOTICE, "Set D_SENSE on %s, to read its sanitize status", c->device_name );
+
+    return 0;
+}
+
+static int kwipe_sanitize_ata_poll( kwipe_context_t* c, int* progress )
+{
+    kwipe_ata_result_t result;
+    int r;
+
+    *progress = -1;
+
+    r = kwipe_sanitize_ata_status( c, &result );
+    if( r < 0 )
+    {
+        return -1;
+    }
+    if( r > 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "ATA SANITIZE failed on %s, error %02x, reason %02x",
+                   c->device_name,
+                   result.error,
+                   (unsigned int) ( result.lba & 0xFF ) );
+        return -1;
+    }
+    if( result.count & NWIPE_ATA_SANITIZE_IN_PROGRESS )
+    {
+        *progress = result.lba & 0xFFFF;
+        return 1;
+    }
+    if( result.count & NWIPE_ATA_SANITIZE_COMPLETED )
+    {
+        return 0;
+    }
+
+    kwipe_log( NWIPE_LOG_ERROR, "ATA SANITIZE on %s stopped without completing", c->device_name );
+    return -1;
+}
+
+static int kwipe_sanitize_ata_start( kwipe_context_t* c, kwipe_sanitize_action_t action )
+{
+    /* The features and the signatures in the LBA field that the device checks */
+    const unsigned int features[] = {
+        NWIPE_ATA_CRYPTO_SCRAMBLE_EXT, NWIPE_ATA_BLOCK_ERASE_EXT, NWIPE_ATA_OVERWRITE_EXT };
+    const u64 signatures[] = { 0x43727970ULL, 0x426B4572ULL, 0x00004F5700000000ULL };
+
+    /* The bits of IDENTIFY DEVICE word 59 that say which operations are supported */
+    const unsigned int supported[] = { 0x2000, 0x8000, 0x4000 };
+
+    kwipe_ata_result_t result;
+    unsigned char* identify;
+    unsigned int word59;
+    int r;
+
+    if( posix_memalign( (void**) &identify, 4096, 512 ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the IDENTIFY DEVICE data." );
+        return -1;
+    }
+
+    r = kwipe_sanitize_ata_command( c, NWIPE_ATA_IDENTIFY_DEVICE, 0, 1, 0, identify, 512, &result );
+    word59 = identify[118] | ( identify[119] << 8 );
+    free( identify );
+
+    if( r != 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "%s doesn't respond to ATA PASS-THROUGH, it can't be sanitized", c->device_name );
+        return -1;
+    }
+
+    if( !( word59 & 0x1000 ) || !( word59 & supported[action] ) )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "%s doesn't support the ATA SANITIZE %s operation",
+                   c->device_name,
+                   kwipe_sanitize_action_name[action] );
+        return -1;
+    }
+
+    /* Without the sanitize status the operation couldn't be followed, it isn't started */
+    if( kwipe_sanitize_ata_descriptor_sense( c ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "The sanitize status of %s can't be read, it isn't sanitized", c->device_name );
+        return -1;
+    }
+
+    r = kwipe_sanitize_ata_status( c, &result );
+    if( r < 0 )
+    {
+        return -1;
+    }
+    if( r == 0 && ( result.count & NWIPE_ATA_SANITIZE_FROZEN ) )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "Sanitize is frozen on %s by SANITIZE FREEZE LOCK, usually sent by the BIOS. "
+                   "Suspending and resuming the system may clear it.",
+                   c->device_name );
+        return -1;
+    }
+
+    kwipe_log( NWIPE_LOG_NOTICE, "Sending ATA SANITIZE %s to %s", kwipe_sanitize_action_name[action], c->device_name );
+
+    /* An overwrite writes the pattern in the low LBA bits, zeros, once */
+    r = kwipe_sanitize_ata_command( c,
+                                    NWIPE_ATA_SANITIZE,
+                                    features[action],
+                                    action == NWIPE_SANITIZE_OVERWRITE ? 1 : 0,
+                                    signatures[action],
+                                    NULL,
+                                    0,
+                                    &result );
+    if( r != 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "ATA SANITIZE %s was refused by %s, error %02x, reason %02x",
+                   kwipe_sanitize_action_name[action],
+                   c->device_name,
+                   result.error,
+                   (unsigned int) ( result.lba & 0xFF ) );
+        return -1;
+    }
+
+    return 0;
+}
+
+static int kwipe_sanitize_nvme_command( kwipe_context_t* c,
+                                        unsigned char opcode,
+                                        unsigned int nsid,
+                                        unsigned int cdw10,
+                                        unsigned int cdw11,
+                                        void* data,
+                                        unsigned int data_length,
+                                        unsigned int timeout_ms )
+{
+    kwipe_nvme_command_t command;
+    int r;
+
+    memset( &command, 0, sizeof( command ) );
+    command.opcode = opcode;
+    command.nsid = nsid;
+    command.cdw10 = cdw10;
+    command.cdw11 = cdw11;
+    command.data = data;
+    command.data_length = data_length;
+    command.timeout_ms = timeout_ms;
+
+    r = kwipe_sanitize_ops->nvme_admin_command( c->device_fd, &command );
+    if( r < 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "NVME_IOCTL_ADMIN_CMD" );
+    }
+    else if( r > 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "NVMe admin command %02x on %s failed with status %03x",
+                   opcode,
+                   c->device_name,
+                   (unsigned int) r );
+    }
+
+    return r;
+}
+
+static int kwipe_sanitize_nvme_poll( kwipe_context_t* c, int* progress )
+{
+    unsigned char* log_page;
+    int status;
+    int r;
+
+    *progress = -1;
+
+    if( posix_memalign( (void**) &log_page, 4096, NWIPE_NVME_SANITIZE_LOG_SIZE ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the sanitize status log." );
+        return -1;
+    }
+
+    /* The number of dwords to read, less one, is in the upper half of cdw10 */
+    r = kwipe_sanitize_nvme_command( c,
+                                     NWIPE_NVME_GET_LOG_PAGE,
+                                     0xFFFFFFFF,
+                                     NWIPE_NVME_LOG_SANITIZE_STATUS
+                                         | ( ( NWIPE_NVME_SANITIZE_LOG_SIZE / 4 - 1 ) << 16 ),
+                                     0,
+                                     log_page,
+                                     NWIPE_NVME_SANITIZE_LOG_SIZE,
+                                     NWIPE_SANITIZE_COMMAND_TIMEOUT_MS );
+
+    if( r != 0 )
+    {
+        free( log_page );
+        return -1;
+    }
+
+    *progress = log_page[0] | ( log_page[1] << 8 );
+    status = log_page[2] & 0x07;
+    free( log_page );
+
+    switch( status )
+    {
+        case NWIPE_NVME_SANITIZE_SUCCEEDED:
+        case NWIPE_NVME_SANITIZE_SUCCEEDED_NO_DEALLOCATE:
+            return 0;
+
+        case NWIPE_NVME_SANITIZE_IN_PROGRESS:
+            return 1;
+
+        case NWIPE_NVME_SANITIZE_FAILED:
+            kwipe_log( NWIPE_LOG_ERROR, "NVMe Sanitize failed on %s", c->device_name );
+            return -1;
+
+        case NWIPE_NVME_SANITIZE_NEVER:
+            /* The log is updated before the Sanitize command completes, so the operation never started */
+            kwipe_log( NWIPE_LOG_ERROR,
+                       "NVMe Sanitize was accepted by %s but its sanitize log reports it was never sanitized",
+                       c->device_name );
+            return -1;
+
+        default:
+            kwipe_log( NWIPE_LOG_ERROR, "NVMe Sanitize on %s reports the unknown status %i", c->device_name, status );
+            return -1;
+    }
+}
+
+static int kwipe_sanitize_nvme_format( kwipe_context_t* c, kwipe_sanitize_action_t action, int crypto_supported )
+{
+    /**
+     * Erases the namespace with Format NVM, keeping its LBA format and protection information.
+     * Returns 0 once it has completed, -1 on error.
+     */
+
+    unsigned char* identify;
+    unsigned int flbas;
+    unsigned int dps;
+    unsigned int ses;
+    int nsid;
+    int r;
+
+    if( action == NWIPE_SANITIZE_CRYPTO && !crypto_supported )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "%s supports neither Sanitize nor Format NVM crypto erase", c->device_name );
+        return -1;
+    }
+
+    /* User data erase, or cryptographic erase */
+    ses = action == NWIPE_SANITIZE_CRYPTO ? 2 : 1;
+
+    nsid = kwipe_sanitize_ops->nvme_namespace_id( c->device_fd );
+    if( nsid <= 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "NVME_IOCTL_ID" );
+        return -1;
+    }
+
+    if( posix_memalign( (void**) &identify, 4096, NWIPE_NVME_IDENTIFY_SIZE ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the NVMe identify data." );
+        return -1;
+    }
+
+    r = kwipe_sanitize_nvme_command(
+        c, NWIPE_NVME_IDENTIFY, nsid, 0, 0, identify, NWIPE_NVME_IDENTIFY_SIZE, NWIPE_SANITIZE_COMMAND_TIMEOUT_MS );
+    flbas = identify[26];
+    dps = identify[29];
+    free( identify );
+
+    if( r != 0 )
+    {
+        return -1;
+    }
+
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "%s doesn't support the NVMe Sanitize %s operation, sending Format NVM with Secure Erase Setting %u "
+               "to namespace %i instead, it reports no progress until it completes",
+               c->device_name,
+               kwipe_sanitize_action_name[action],
+               ses,
+               nsid );
+
+    r = kwipe_sanitize_nvme_command( c,
+                                     NWIPE_NVME_FORMAT_NVM,
+                                     nsid,
+                                     ( flbas & 0x0F ) | ( ( ( flbas >> 4 ) & 0x01 ) << 4 ) | ( ( dps & 0x07 ) << 5 )
+                                         | ( ( ( dps >> 3 ) & 0x01 ) << 8 ) | ( ses << 9 )
+                                         | ( ( ( flbas >> 5 ) & 0x03 ) << 12 ),
+                                     0,
+                                     NULL,
+                                     0,
+                                     NWIPE_SANITIZE_FORMAT_TIMEOUT_MS );
+
+    return r == 0 ? 0 : -1;
+}
+
+static void kwipe_sanitize_nvme_controller( kwipe_context_t* c, char* name, size_t name_size )
+{
+    /* The controller of a namespace such as /dev/nvme0n1 is /dev/nvme0 */
+    const char* base = strrchr( c->device_name, '/' );
+    size_t length;
+
+    base = base == NULL ? c->device_name : base + 1;
+    length = strspn( base + ( strncmp( base, "nvme", 4 ) == 0 ? 4 : 0 ), "0123456789" );
+
+    if( strncmp( base, "nvme", 4 ) != 0 || length == 0 )
+    {
+        snprintf( name, name_size, "the controller of %s", c->device_name );
+        return;
+    }
+    snprintf( name, name_size, "/dev/%.*s", (int) ( length + 4 ), base );
+}
+
+static int kwipe_sanitize_nvme_start( kwipe_context_t* c, kwipe_sanitize_action_t action, int* formatted )
+{
+    /* The Sanitize Action of each operation and the bit of SANICAP that says it is supported */
+    const unsigned int sanact[] = { 4, 2, 3 };
+    const unsigned int supported[] = { 0x1, 0x2, 0x4 };
+
+    char controller[64];
+    unsigned char* identify;
+    unsigned int sanicap;
+    unsigned int oacs;
+    unsigned int fna;
+    unsigned int nn;
+    int r;
+
+    *formatted = 0;
+
+    if( posix_memalign( (void**) &identify, 4096, NWIPE_NVME_IDENTIFY_SIZE ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the NVMe identify data." );
+        return -1;
+    }
+
+    /* Identify Controller */
+    r = kwipe_sanitize_nvme_command(
+        c, NWIPE_NVME_IDENTIFY, 0, 1, 0, identify, NWIPE_NVME_IDENTIFY_SIZE, NWIPE_SANITIZE_COMMAND_TIMEOUT_MS );
+    oacs = identify[256] | ( identify[257] << 8 );
+    sanicap = identify[328] | ( identify[329] << 8 ) | ( identify[330] << 16 ) | ( (unsigned int) identify[331] << 24 );
+    fna = identify[524];
+    nn = identify[516] | ( identify[517] << 8 ) | ( identify[518] << 16 ) | ( (unsigned int) identify[519] << 24 );
+    free( identify );
+
+    if( r != 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "%s doesn't respond to NVMe Identify, it can't be sanitized", c->device_name );
+        return -1;
+    }
+
+    if( !( sanicap & supported[action] ) )
+    {
+        /* Format NVM erases, but can't overwrite */
+        if( action == NWIPE_SANITIZE_OVERWRITE || !( oacs & 0x2 ) )
+        {
+            kwipe_log( NWIPE_LOG_ERROR,
+                       "%s doesn't support the NVMe Sanitize %s operation",
+                       c->device_name,
+                       kwipe_sanitize_action_name[action] );
+            return -1;
+        }
+
+        *formatted = 1;
+        return kwipe_sanitize_nvme_format( c, action, fna & 0x4 );
+    }
+
+    /* Unlike Format NVM, Sanitize can't be limited to one namespace */
+    kwipe_sanitize_nvme_controller( c, controller, sizeof( controller ) );
+    kwipe_log( NWIPE_LOG_WARNING,
+               "NVMe Sanitize erases every namespace of %s, which supports up to %u, not only %s",
+               controller,
+               nn,
+               c->device_name );
+    kwipe_log( NWIPE_LOG_NOTICE, "Sending NVMe Sanitize %s to %s", kwipe_sanitize_action_name[action], c->device_name );
+
+    /* An overwrite writes the pattern in cdw11, zeros, in one pass */
+    r = kwipe_sanitize_nvme_command( c,
+                                     NWIPE_NVME_SANITIZE,
+                                     0,
+                                     sanact[action] | ( action == NWIPE_SANITIZE_OVERWRITE ? 1 << 4 : 0 ),
+                                     0,
+                                     NULL,
+                                     0,
+                                     NWIPE_SANITIZE_COMMAND_TIMEOUT_MS );
+
+    return r == 0 ? 0 : -1;
+}
+
+static int kwipe_sanitize_scsi_poll( kwipe_context_t* c, int* progress )
+{
+    kwipe_scsi_command_t command;
+    kwipe_sense_t sense;
+    unsigned char data[252];
+
+    *progress = -1;
+
+    memset( &command, 0, sizeof( command ) );
+    command.cdb_length = 6;
+    command.cdb[0] = NWIPE_SCSI_REQUEST_SENSE;
+    command.cdb[4] = sizeof( data );
+    command.direction = NWIPE_SANITIZE_DATA_IN;
+    command.data = data;
+    command.data_length = sizeof( data );
+    command.timeout_ms = NWIPE_SANITIZE_COMMAND_TIMEOUT_MS;
+
+    memset( data, 0, sizeof( data ) );
+
+    if( kwipe_sanitize_ops->scsi_command( c->device_fd, &command ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "SG_IO" );
+        return -1;
+    }
+
+    if( command.status != 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "REQUEST SENSE failed on %s, status %02x", c->device_name, command.status );
+        return -1;
+    }
+
+    kwipe_sanitize_parse_sense( data, sizeof( data ), &sense );
+    *progress = sense.progress;
+
+    /* SANITIZE IN PROGRESS */
+    if( sense.key == NWIPE_SENSE_NOT_READY && sense.asc == 0x04 && sense.ascq == 0x1B )
+    {
+        return 1;
+    }
+
+    /* SANITIZE COMMAND FAILED */
+    if( sense.asc == 0x31 && sense.ascq == 0x03 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "SCSI SANITIZE failed on %s", c->device_name );
+        return -1;
+    }
+
+    if( sense.key == NWIPE_SENSE_NO_SENSE || sense.key == NWIPE_SENSE_UNIT_ATTENTION )
+    {
+        /* Some devices report the progress of the operation with no sense key */
+        return sense.progress >= 0 ? 1 : 0;
+    }
+
+    kwipe_log( NWIPE_LOG_ERROR,
+               "SCSI SANITIZE on %s stopped, sense key %x ASC/ASCQ %02x/%02x",
+               c->device_name,
+               sense.key,
+               sense.asc,
+               sense.ascq );
+    return -1;
+}
+
+static int kwipe_sanitize_scsi_start( kwipe_context_t* c, kwipe_sanitize_action_t action )
+{
+    /* The service action of each operation */
+    const unsigned char service_action[] = { 0x03, 0x02, 0x01 };
+
+    /* The parameters of an overwrite, one pass of a four byte pattern of zeros */
+    unsigned char overwrite[8] = { 0x01, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00 };
+
+    kwipe_scsi_command_t command;
+    kwipe_sense_t sense;
+
+    memset( &command, 0, sizeof( command ) );
+    command.cdb_length = 10;
+    command.cdb[0] = NWIPE_SCSI_SANITIZE;
+    command.cdb[1] = 0x80 | service_action[action];  // IMMED, return once the operation has started
+    command.timeout_ms = NWIPE_SANITIZE_COMMAND_TIMEOUT_MS;
+
+    if( action == NWIPE_SANITIZE_OVERWRITE )
+    {
+        command.cdb[8] = sizeof( overwrite );
+        command.direction = NWIPE_SANITIZE_DATA_OUT;
+        command.data = overwrite;
+        command.data_length = sizeof( overwrite );
+    }
+
+    kwipe_log( NWIPE_LOG_NOTICE, "Sending SCSI SANITIZE %s to %s", kwipe_sanitize_action_name[action], c->device_name );
+
+    if( kwipe_sanitize_ops->scsi_command( c->device_fd, &command ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "SG_IO" );
+        return -1;
+    }
+
+    if( command.status == 0 )
+    {
+        return 0;
+    }
+
+    kwipe_sanitize_parse_sense( command.sense, command.sense_length, &sense );
+
+    if( sense.key == NWIPE_SENSE_ILLEGAL_REQUEST )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "%s doesn't support the SCSI SANITIZE %s operation",
+                   c->device_name,
+                   kwipe_sanitize_action_name[action] );
+    }
+    else
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "SCSI SANITIZE %s was refused by %s, sense key %x ASC/ASCQ %02x/%02x",
+                   kwipe_sanitize_action_name[action],
+                   c->device_name,
+                   sense.key,
+                   sense.asc,
+                   sense.ascq );
+    }
+
+    return -1;
+}
+
+static void kwipe_sanitize_progress( kwipe_context_t* c, u64 done )
+{
+    /* The device reports how far it has got, the counters are moved on to match */
+    if( done > c->device_size )
+    {
+        done = c->device_size;
+    }
+    if( done > c->progress.pass_done )
+    {
+        kwipe_progress_add( c, done - c->progress.pass_done );
+    }
+}
+
+static int kwipe_sanitize_wait( kwipe_context_t* c, kwipe_sanitize_poll_t poll )
+{
+    int progress;
+    int r;
+    int ms;
+
+    while( ( r = poll( c, &progress ) ) > 0 )
+    {
+        if( progress >= 0 )
+        {
+            kwipe_sanitize_progress( c, c->device_size / 65536 * (u64) progress );
+        }
+
+        for( ms = 0; ms < NWIPE_SANITIZE_POLL_MS; ms += 100 )
+        {
+            if( kwipe_cancel_requested( c ) )
+            {
+                kwipe_log( NWIPE_LOG_WARNING,
+                           "The sanitize operation on %s can't be stopped, it continues in the device and "
+                           "resumes if it is power cycled",
+                           c->device_name );
+                return NWIPE_CANCELLED;
+            }
+            usleep( 100000 );
+        }
+    }
+
+    return r;
+}
+
+static u64 kwipe_sanitize_hash( const unsigned char* block, size_t length, int* uniform )
+{
+    /* FNV-1a, and whether every byte of the block is the same */
+    u64 hash = 0xCBF29CE484222325ULL;
+    size_t i;
+
+    *uniform = 1;
+
+    for( i = 0; i < length; i++ )
+    {
+        hash = ( hash ^ block[i] ) * 0x100000001B3ULL;
+        if( block[i] != block[0] )
+        {
+            *uniform = 0;
+        }
+    }
+
+    return hash;
+}
+
+static int kwipe_sanitize_read_sample( kwipe_context_t* c, int sample, int samples, char* buffer, size_t length )
+{
+    /* The samples are spread evenly from the first block, which holds the partition table */
+    u64 offset = (u64) sample * ( c->device_size / length ) / samples * length;
+    ssize_t r;
+    size_t done = 0;
+
+    while( done < length )
+    {
+        r = pread( c->device_fd, buffer + done, length - done, offset + done );
+        if( r <= 0 )
+        {
+            if( r < 0 && errno == EINTR )
+            {
+                continue;
+            }
+            kwipe_log( NWIPE_LOG_WARNING, "Unable to read the sample at offset %llu of %s", offset, c->device_name );
+            return -1;
+        }
+        done += r;
+    }
+
+    return 0;
+}
+
+int kwipe_sanitize( kwipe_context_t* c, kwipe_sanitize_action_t action )
+{
+    /* The hash of each sample before the operation, and whether it was uniform, -1 if it couldn't be read */
+    u64* hashes = NULL;
+    signed char* before = NULL;
+
+    char* buffer = NULL;
+    size_t blocksize = c->device_stat.st_blksize;
+    u64 samples = 0;
+    u64 unchanged = 0;
+    u64 i;
+    int formatted = 0;
+    int uniform;
+    int r;
+
+    /* The drive would really be erased, whatever --io says */
+    if( c->io != &kwipe_io_device )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "%s sends its commands to the drive, it can't be used with the %s I/O backend",
+                   kwipe_method_label( kwipe_options.method ),
+                   c->io->label );
+        return -1;
+    }
+
+    /* One operation, and a sampled read back unless --verify=off */
+    if( kwipe_options.verify != NWIPE_VERIFY_NONE && blocksize > 0 )
+    {
+        samples = c->device_size / blocksize;
+        if( samples > NWIPE_SANITIZE_VERIFY_SAMPLES )
+        {
+            samples = NWIPE_SANITIZE_VERIFY_SAMPLES;
+        }
+    }
+
+    c->start_ns = kwipe_time_ns();
+    c->round_count = 1;
+    c->round_working = 1;
+    c->pass_count = 1;
+    c->pass_working = 1;
+    c->pass_size = c->device_size;
+    c->round_size = c->device_size + samples * blocksize;
+    c->round_verify_size = samples * blocksize;
+
+    kwipe_log(
+        NWIPE_LOG_NOTICE, "Invoking method '%s' on %s", kwipe_method_label( kwipe_options.method ), c->device_name );
+
+    if( kwipe_options.rounds > 1 )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "The rounds option doesn't apply to %s, it is sanitized once", c->device_name );
+    }
+
+    if( samples > 0 )
+    {
+        hashes = calloc( samples, sizeof( u64 ) );
+        before = calloc( samples, sizeof( signed char ) );
+        if( hashes == NULL || before == NULL || posix_memalign( (void**) &buffer, 4096, blocksize ) != 0 )
+        {
+            kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the sampled verification." );
+            free( hashes );
+            free( before );
+            return -1;
+        }
+
+        /* What the drive held, to check it has changed after an erase */
+        if( action != NWIPE_SANITIZE_OVERWRITE )
+        {
+            for( i = 0; i < samples; i++ )
+            {
+                if( kwipe_sanitize_read_sample( c, i, samples, buffer, blocksize ) == 0 )
+                {
+                    hashes[i] = kwipe_sanitize_hash( (unsigned char*) buffer, blocksize, &uniform );
+                    before[i] = uniform;
+                }
+                else
+                {
+                    before[i] = -1;
+                }
+            }
+        }
+    }
+
+    c->pass_type = NWIPE_PASS_WRITE;
+    kwipe_progress_start_pass( c );
+
+    if( c->device_type == NWIPE_DEVICE_NVME || strncmp( c->device_name, "/dev/nvme", 9 ) == 0 )
+    {
+        r = kwipe_sanitize_nvme_start( c, action, &formatted );
+        if( r == 0 && !formatted )
+        {
+            r = kwipe_sanitize_wait( c, kwipe_sanitize_nvme_poll );
+        }
+    }
+    else if( c->device_type == NWIPE_DEVICE_SCSI || c->device_type == NWIPE_DEVICE_SAS )
+    {
+        r = kwipe_sanitize_scsi_start( c, action );
+        if( r == 0 )
+        {
+            r = kwipe_sanitize_wait( c, kwipe_sanitize_scsi_poll );
+        }
+    }
+    else if( c->device_type == NWIPE_DEVICE_MMC || c->device_type == NWIPE_DEVICE_VIRT
+             || c->device_type == NWIPE_DEVICE_FILE )
+    {
+        kwipe_log( NWIPE_LOG_ERROR, "%s has no sanitize command", c->device_name );
+        r = -1;
+    }
+    else
+    {
+        /* ATA drives, including those behind SAT capable USB bridges */
+        r = kwipe_sanitize_ata_start( c, action );
+        if( r == 0 )
+        {
+            r = kwipe_sanitize_wait( c, kwipe_sanitize_ata_poll );
+        }
+    }
+
+    c->pass_type = NWIPE_PASS_NONE;
+
+    if( r != 0 )
+    {
+        free( hashes );
+        free( before );
+        free( buffer );
+        return r;
+    }
+
+    kwipe_sanitize_progress( c, c->device_size );
+    kwipe_progress_erased( c, c->device_size );
+
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "[SUCCESS] %s %s completed on %s",
+               formatted ? "Format NVM" : "Sanitize",
+               kwipe_sanitize_action_name[action],
+               c->device_name );
+
+    if( samples == 0 )
+    {
+        return 0;
+    }
+
+    /* The blocks read before the operation must not be read back from the page cache */
+    posix_fadvise( c->device_fd, 0, 0, POSIX_FADV_DONTNEED );
+
+    kwipe_log( NWIPE_LOG_NOTICE, "Verifying %llu sampled blocks of %s", samples, c->device_name );
+
+    c->pass_type = NWIPE_PASS_VERIFY;
+    kwipe_progress_start_pass( c );
+
+    for( i = 0; i < samples; i++ )
+    {
+        if( kwipe_cancel_requested( c ) )
+        {
+            c->pass_type = NWIPE_PASS_NONE;
+            free( hashes );
+            free( before );
+            free( buffer );
+            return NWIPE_CANCELLED;
+        }
+
+        if( kwipe_sanitize_read_sample( c, i, samples, buffer, blocksize ) != 0 )
+        {
+            c->verify_errors++;
+        }
+        else if( action == NWIPE_SANITIZE_OVERWRITE )
+        {
+            /* The overwrite pattern is zeros */
+            kwipe_sanitize_hash( (unsigned char*) buffer, blocksize, &uniform );
+            if( !uniform || buffer[0] != 0 )
+            {
+                c->verify_errors++;
+            }
+        }
+        else if( before[i] == 0 && kwipe_sanitize_hash( (unsigned char*) buffer, blocksize, &uniform ) == hashes[i] )
+        {
+            /* What the block reads as after an erase is up to the drive, but it can't be what it was */
+            unchanged++;
+            c->verify_errors++;
+        }
+
+        kwipe_progress_add_read( c, blocksize );
+    }
+
+    c->pass_type = NWIPE_PASS_NONE;
+
+    free( hashes );
+    free( before );
+    free( buffer );
+
+    if( c->verify_errors == 0 )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "[SUCCESS] Verified %llu sampled blocks of %s", samples, c->device_name );
+        return 0;
+    }
+
+    if( unchanged > 0 )
+    {
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "[FAILURE] %llu of %llu sampled blocks of %s still hold what they held before",
+                   unchanged,
+                   samples,
+                   c->device_name );
+    }
+    kwipe_log( NWIPE_LOG_ERROR, "%llu verification errors on '%s'.", c->verify_errors, c->device_name );
+
+    return 1;
+}
+
+static long long kwipe_discard_sysfs( const char* name, const char* file )
+{
+    /* Returns the number in /sys/block/<name>/<file>, -1 if the kernel doesn't have it */
+    char path[PATH_MAX];
+    long long value;
+    FILE* fp;
+
+    snprintf( path, sizeof( path ), "%s/%s/%s", NWIPE_SANITIZE_SYSFS_BLOCK, name, file );
+
+    if( ( fp = fopen( path, "r" ) ) == NULL )
+    {
+        return -1;
+    }
+    if( fscanf( fp, "%lld", &value ) != 1 )
+    {
+        value = -1;
+    }
+    fclose( fp );
+
+    return value;
+}
+
+static int kwipe_discard_lbprz( const char* name )
+{
+    /* 1 if the LBPRZ field of the Logical Block Provisioning VPD page says unmapped blocks read as
+     * zeros, which SBC-4 gives as any value xx1b, the other bits tell how the zeros are provided.
+     * libata fills the page in for ATA drives, with LBPRZ set if they report both DRAT and RZAT,
+     * deterministic reads of zeros after TRIM. Returns 0 if they don't, -1 if the page isn't there. */
+    char path[PATH_MAX];
+    unsigned char page[8];
+    ssize_t r;
+    int fd;
+
+    snprintf( path, sizeof( path ), "%s/%s/device/vpd_pgb2", NWIPE_SANITIZE_SYSFS_BLOCK, name );
+
+    if( ( fd = open( path, O_RDONLY ) ) < 0 )
+    {
+        return -1;
+    }
+    r = read( fd, page, sizeof( page ) );
+    close( fd );
+
+    if( r < 6 || page[1] != 0xB2 )
+    {
+        return -1;
+    }
+
+    return ( page[5] & 0x04 ) ? 1 : 0;
+}
+
+int kwipe_discard( kwipe_context_t* c )
+{
+    const char* name;
+    char* buffer;
+    size_t blocksize = c->device_stat.st_blksize;
+    u64 range[2];
+    u64 samples;
+    u64 errors = 0;
+    u64 i;
+    int zeros;
+    int uniform;
+
+    if( c->io != &kwipe_io_device )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "%s isn't discarded with the %s I/O backend", c->device_name, c->io->label );
+        return 0;
+    }
+
+    name = strrchr( c->device_name, '/' );
+    name = name ? name + 1 : c->device_name;
+
+    /* smartctl may not have been able to tell, the kernel's rotational flag is the fallback */
+    if( !c->device_is_ssd && kwipe_discard_sysfs( name, "queue/rotational" ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "%s isn't a solid state drive, it isn't discarded", c->device_name );
+        return 0;
+    }
+
+    if( kwipe_discard_sysfs( name, "queue/discard_max_bytes" ) <= 0 )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "%s doesn't support discard, it isn't discarded", c->device_name );
+        return 0;
+    }
+
+    /* discard_zeroes_data is only ever set by kernels before 4.12, write_zeroes_unmap_max_hw_bytes
+     * is set by newer kernels for devices whose unmapped blocks read as zeros, NVMe ones included */
+    zeros = kwipe_discard_sysfs( name, "queue/discard_zeroes_data" ) == 1 || kwipe_discard_lbprz( name ) == 1
+            || kwipe_discard_sysfs( name, "queue/write_zeroes_unmap_max_hw_bytes" ) > 0;
+
+    kwipe_log( NWIPE_LOG_NOTICE, "Discarding every block of %s", c->device_name );
+
+    c->pass_type = NWIPE_PASS_DISCARD;
+
+    range[0] = 0;
+    range[1] = c->device_size;
+    if( ioctl( c->device_fd, BLKDISCARD, range ) != 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "BLKDISCARD" );
+        kwipe_log(
+            NWIPE_LOG_WARNING, "Unable to discard %s, it is wiped but its flash isn't released", c->device_name );
+        c->pass_type = NWIPE_PASS_NONE;
+        return 0;
+    }
+
+    if( !zeros || kwipe_options.verify == NWIPE_VERIFY_NONE || blocksize == 0 )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE,
+                   "[SUCCESS] Discarded %s%s",
+                   c->device_name,
+                   zeros ? "" : ", it doesn't guarantee what discarded blocks read as so they aren't verified" );
+        c->pass_type = NWIPE_PASS_NONE;
+        return 0;
+    }
+
+    samples = c->device_size / blocksize;
+    if( samples > NWIPE_SANITIZE_VERIFY_SAMPLES )
+    {
+        samples = NWIPE_SANITIZE_VERIFY_SAMPLES;
+    }
+
+    if( posix_memalign( (void**) &buffer, 4096, blocksize ) != 0 )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the sampled verification." );
+        c->pass_type = NWIPE_PASS_NONE;
+        return -1;
+    }
+
+    /* The blocks must come from the device, not from what the wipe left in the page cache */
+    posix_fadvise( c->device_fd, 0, 0, POSIX_FADV_DONTNEED );
+
+    for( i = 0; i < samples; i++ )
+    {
+        if( kwipe_cancel_requested( c ) )
+        {
+            free( buffer );
+            c->pass_type = NWIPE_PASS_NONE;
+            return NWIPE_CANCELLED;
+        }
+
+        if( kwipe_sanitize_read_sample( c, i, samples, buffer, blocksize ) != 0 )
+        {
+            errors++;
+            continue;
+        }
+
+        kwipe_sanitize_hash( (unsigned char*) buffer, blocksize, &uniform );
+        if( !uniform || buffer[0] != 0 )
+        {
+            errors++;
+        }
+    }
+
+    free( buffer );
+    c->pass_type = NWIPE_PASS_NONE;
+
+    if( errors > 0 )
+    {
+        c->verify_errors += errors;
+        kwipe_log( NWIPE_LOG_ERROR,
+                   "[FAILURE] %llu of %llu sampled blocks of %s don't read as zeros after the discard",
+                   errors,
+                   samples,
+                   c->device_name );
+        return 1;
+    }
+
+    kwipe_log( NWIPE_LOG_NOTICE,
+               "[SUCCESS] Discarded %s and verified %llu sampled blocks read as zeros",
+               c->device_name,
+               samples );
+
+    return 0;
+}
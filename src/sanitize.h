@@ -0,0 +1,125 @@
+/*
+ *  sanitize.h: The drive's own sanitize commands, ATA SANITIZE, NVMe Sanitize/Format NVM and
+ *  SCSI SANITIZE, as wipe methods.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SANITIZE_H_
+#define SANITIZE_H_
+
+#include "context.h"
+
+/* How often the device's sanitize status is read while it sanitizes */
+#define NWIPE_SANITIZE_POLL_MS 1000
+
+/* The timeout of each command, and of a Format NVM, which reports no progress and so is waited on */
+#define NWIPE_SANITIZE_COMMAND_TIMEOUT_MS 60000
+#define NWIPE_SANITIZE_FORMAT_TIMEOUT_MS ( 4 * 60 * 60 * 1000 )
+
+/* The number of blocks read back, spread evenly across the device, by the verification */
+#define NWIPE_SANITIZE_VERIFY_SAMPLES 1024
+
+/* The discard properties of a device are read from its queue directory here */
+#define NWIPE_SANITIZE_SYSFS_BLOCK "/sys/block"
+
+typedef enum kwipe_sanitize_action_t_ {
+    NWIPE_SANITIZE_CRYPTO = 0,  // Change the media encryption key.
+    NWIPE_SANITIZE_BLOCK,  // Erase every block of the media.
+    NWIPE_SANITIZE_OVERWRITE  // Overwrite the media with zeros, once.
+} kwipe_sanitize_action_t;
+
+typedef enum kwipe_sanitize_direction_t_ {
+    NWIPE_SANITIZE_DATA_NONE = 0,
+    NWIPE_SANITIZE_DATA_IN,  // From the device.
+    NWIPE_SANITIZE_DATA_OUT  // To the device.
+} kwipe_sanitize_direction_t;
+
+/* A SCSI command sent with SG_IO. The ATA commands are sent as ATA PASS-THROUGH (16) commands. */
+typedef struct
+{
+    unsigned char cdb[16];
+    int cdb_length;
+    kwipe_sanitize_direction_t direction;
+    void* data;
+    unsigned int data_length;
+    unsigned int timeout_ms;
+    unsigned char status;  // The SCSI status, set by the command layer.
+    unsigned char sense[64];  // The sense data, set by the command layer.
+    unsigned int sense_length;  // The number of bytes of sense data.
+} kwipe_scsi_command_t;
+
+/* An NVMe admin command */
+typedef struct
+{
+    unsigned char opcode;
+    unsigned int nsid;
+    unsigned int cdw10;
+    unsigned int cdw11;
+    void* data;  // Always from the device.
+    unsigned int data_length;
+    unsigned int timeout_ms;
+    unsigned int result;  // Dword 0 of the completion, set by the command layer.
+} kwipe_nvme_command_t;
+
+/* The commands are sent through these, so they can be replaced to test the methods without a device */
+typedef struct
+{
+    /* Returns 0 once the command has been sent, whatever its SCSI status, -1 with errno set if it couldn't be */
+    int ( *scsi_command )( int fd, kwipe_scsi_command_t* command );
+
+    /* Returns the NVMe status of the command, 0 = success, or -1 with errno set if it couldn't be sent */
+    int ( *nvme_admin_command )( int fd, kwipe_nvme_command_t* command );
+
+    /* Returns the namespace ID of the NVMe block device, or -1 with errno set */
+    int ( *nvme_namespace_id )( int fd );
+} kwipe_sanitize_ops_t;
+
+/**
+ * Replaces the command layer.
+ * @param ops the replacement, NULL to send the commands to the device again
+ */
+void kwipe_sanitize_set_ops( const kwipe_sanitize_ops_t* ops );
+
+/**
+ * Runs a sanitize operation on the drive, the method of the kwipe_sanitize_* methods. The progress
+ * the device reports feeds the drive's progress counters, and unless --verify=off a sample of its
+ * blocks is read back afterwards.
+ * @param c the drive context
+ * @param action the sanitize operation
+ * @return 0 on success, 1 if the sampled verification found errors, NWIPE_CANCELLED if the wipe was
+ * cancelled, -1 if the device couldn't be sanitized
+ */
+int kwipe_sanitize( kwipe_context_t* c, kwipe_sanitize_action_t action );
+
+/**
+ * Discards every block of an SSD after its wipe (--discard), so the drive gets all of its flash back
+ * as free and its next workload doesn't wait on garbage collection. If the device guarantees that
+ * discarded blocks read as zeros, a sample of them is read back unless --verify=off. Devices that
+ * aren't SSDs or don't support discard are left as they are.
+ * @param c the drive context
+ * @return 0 when done or skipped, 1 if sampled blocks weren't zeros, NWIPE_CANCELLED if the wipe was
+ * cancelled. A failed discard is logged but doesn't fail the wipe, the data was already wiped.
+ */
+int kwipe_discard( kwipe_context_t* c );
+
+/**
+ * Whether a method is one of the sanitize methods, which don't write the device from the host.
+ * @param method a method, as in kwipe_options.method
+ * @return 1 if it is, 0 if it isn't
+ */
+int kwipe_method_is_sanitize( void* method );
+
+#endif /* SANITIZE_H_ */
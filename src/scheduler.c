@@ -0,0 +1,408 @@
+/*
+ *  scheduler.c: Scheduling wipes across the controllers the drives are attached to.
+ *
+ *  When dozens of drives hang off one SAS expander, HBA or USB hub, starting every wipe
+ *  at once saturates the shared link and all of the drives slow down together. Each drive
+ *  is grouped by the controller it is attached to, found by resolving its sysfs device
+ *  link, and with --controller-limit=N no more than N wipes run on a controller at once,
+ *  the rest wait in a queue. The queue is ordered largest drive first: every drive is
+ *  wiped with the same method, so a drive's round_size is proportional to its size and
+ *  starting the longest jobs first lets the whole batch finish as early as possible.
+ *
+ *  The throughput of the running wipes on each controller is added up at every sample,
+ *  and the peak is logged so the limit can be tuned to what the link actually delivers.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <limits.h>
+#include <pthread.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "miscellaneous.h"
+#include "event.h"
+#include "scheduler.h"
+#include "shared_stream.h"
+
+extern int terminate_signal;
+
+typedef struct kwipe_controller_t_
+{
+    char path[NWIPE_SCHED_PATH_LENGTH];  // The sysfs path of the HBA, SAS expander or USB hub
+    int drives;  // The number of drives queued on this controller
+    int running;  // The number of wipes running on this controller
+    int peak_running;  // The most wipes that have run at once
+    u64 throughput;  // The throughput of the running wipes at the last sample
+    u64 peak_throughput;  // The highest total throughput seen
+    int peak_throughput_running;  // The number of wipes running when the peak was seen
+} kwipe_controller_t;
+
+typedef struct kwipe_sched_entry_t_
+{
+    kwipe_context_t* c;
+    int order;  // The order the drive was added in, so equal sizes keep their order
+} kwipe_sched_entry_t;
+
+/* kwipe_sched_start() runs in main(), kwipe_sched_sample() in the GUI or SIGUSR1 thread. */
+static pthread_mutex_t sched_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static kwipe_sched_entry_t* sched_queue;
+static int sched_count;
+static int sched_sorted;
+
+static kwipe_controller_t* sched_controllers;
+static int sched_controller_count;
+
+static void kwipe_sched_controller_path( kwipe_context_t* c, char* path, size_t path_size )
+{
+    /* Resolves /sys/block/<dev>/device to a path such as
+     *   /sys/devices/pci0000:00/0000:00:1f.2/ata1/host0/target0:0:0/0:0:0:0
+     *   /sys/devices/pci0000:00/0000:03:00.0/host0/port-0:0/expander-0:0/port-0:0:1/end_device-0:0:1/...
+     *   /sys/devices/pci0000:00/0000:00:14.0/usb2/2-1/2-1.3/2-1.3:1.0/host6/target6:0:0/6:0:0:0
+     *   /sys/devices/pci0000:00/0000:00:1d.0/0000:3d:00.0/nvme/nvme0
+     * and cuts it back to the device the drive shares its link with, the SAS expander, USB hub
+     * or SATA/SAS HBA. The SCSI host, channel, target and lun are filled in from the path on the way.
+     */
+    char link[NWIPE_SCHED_PATH_LENGTH];
+    char resolved[PATH_MAX];
+    char* name;
+    char* p;
+    char* q;
+
+    name = strrchr( c->device_name, '/' );
+    name = name ? name + 1 : c->device_name;
+
+    snprintf( link, sizeof( link ), "/sys/block/%s/device", name );
+    if( realpath( link, resolved ) == NULL )
+    {
+        snprintf( path, path_size, "unknown (%s)", name );
+        return;
+    }
+
+    if( ( p = strrchr( resolved, '/' ) ) != NULL )
+    {
+        sscanf( p, "/%i:%i:%i:%i", &c->device_host, &c->device_bus, &c->device_target, &c->device_lun );
+    }
+
+    if( ( p = strstr( resolved, "/usb" ) ) != NULL )
+    {
+        /* The drive's USB interface is the first component with a ':', the port above it is
+         * the drive itself and the one above that is the hub */
+        if( ( q = strchr( p + 1, ':' ) ) != NULL )
+        {
+            while( q > p && *q != '/' )
+            {
+                q--;
+            }
+            *q = 0;
+
+            if( ( q = strrchr( resolved, '/' ) ) != NULL && q > p )
+            {
+                *q = 0;
+            }
+        }
+    }
+    else if( ( p = strstr( resolved, "/expander-" ) ) != NULL )
+    {
+        if( ( q = strchr( p + 1, '/' ) ) != NULL )
+        {
+            *q = 0;
+        }
+    }
+    else if( ( p = strstr( resolved, "/ata" ) ) != NULL )
+    {
+        /* Each AHCI port has its own ataN, they share the controller above it */
+        *p = 0;
+    }
+    else if( ( p = strstr( resolved, "/host" ) ) != NULL )
+    {
+        *p = 0;
+    }
+    else if( ( p = strstr( resolved, "/nvme/" ) ) != NULL )
+    {
+        *p = 0;
+    }
+    else if( ( p = strrchr( resolved, '/' ) ) != NULL )
+    {
+        *p = 0;
+    }
+
+    snprintf( path, path_size, "%s", resolved );
+}
+
+int kwipe_sched_add( kwipe_context_t* c )
+{
+    char path[NWIPE_SCHED_PATH_LENGTH];
+    kwipe_sched_entry_t* queue;
+    kwipe_controller_t* controllers;
+    int i;
+
+    kwipe_sched_controller_path( c, path, sizeof( path ) );
+
+    pthread_mutex_lock( &sched_mutex );
+
+    for( i = 0; i < sched_controller_count; i++ )
+    {
+        if( strcmp( sched_controllers[i].path, path ) == 0 )
+        {
+            break;
+        }
+    }
+
+    if( i == sched_controller_count )
+    {
+        controllers = realloc( sched_controllers, ( sched_controller_count + 1 ) * sizeof( kwipe_controller_t ) );
+        if( controllers == NULL )
+        {
+            pthread_mutex_unlock( &sched_mutex );
+            kwipe_perror( errno, __FUNCTION__, "realloc" );
+            kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the controller list." );
+            return -1;
+        }
+        sched_controllers = controllers;
+        memset( &sched_controllers[i], 0, sizeof( kwipe_controller_t ) );
+        snprintf( sched_controllers[i].path, sizeof( sched_controllers[i].path ), "%s", path );
+        sched_controller_count++;
+    }
+
+    queue = realloc( sched_queue, ( sched_count + 1 ) * sizeof( kwipe_sched_entry_t ) );
+    if( queue == NULL )
+    {
+        pthread_mutex_unlock( &sched_mutex );
+        kwipe_perror( errno, __FUNCTION__, "realloc" );
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to allocate memory for the wipe queue." );
+        return -1;
+    }
+    sched_queue = queue;
+    sched_queue[sched_count].c = c;
+    sched_queue[sched_count].order = sched_count;
+    sched_count++;
+    sched_sorted = 0;
+
+    c->controller = i;
+    c->queued = 1;
+    sched_controllers[i].drives++;
+
+    pthread_mutex_unlock( &sched_mutex );
+
+    kwipe_log( NWIPE_LOG_INFO, "%s is on controller %i, %s", c->device_name, i, path );
+
+    return 0;
+}
+
+static int kwipe_sched_compare( const void* a, const void* b )
+{
+    const kwipe_sched_entry_t* x = (const kwipe_sched_entry_t*) a;
+    const kwipe_sched_entry_t* y = (const kwipe_sched_entry_t*) b;
+
+    /* Largest drive first */
+    if( x->c->device_size != y->c->device_size )
+    {
+        return x->c->device_size > y->c->device_size ? -1 : 1;
+    }
+    return x->order - y->order;
+}
+
+int kwipe_sched_start( void )
+{
+    kwipe_context_t* c;
+    kwipe_controller_t* controller;
+    int started = 0;
+    int i;
+    int r;
+
+    pthread_mutex_lock( &sched_mutex );
+
+    if( !sched_sorted )
+    {
+        qsort( sched_queue, sched_count, sizeof( kwipe_sched_entry_t ), kwipe_sched_compare );
+        sched_sorted = 1;
+    }
+
+    /* Count the wipes still running on each controller */
+    for( i = 0; i < sched_controller_count; i++ )
+    {
+        sched_controllers[i].running = 0;
+    }
+    for( i = 0; i < sched_count; i++ )
+    {
+        c = sched_queue[i].c;
+        if( c->thread && !kwipe_thread_finished( c ) )
+        {
+            sched_controllers[c->controller].running++;
+        }
+    }
+
+    /* The wipes started together share the streams of their random passes with --shared-stream */
+    kwipe_shared_stream_batch_begin();
+
+    for( i = 0; i < sched_count && terminate_signal != 1; i++ )
+    {
+        c = sched_queue[i].c;
+        controller = &sched_controllers[c->controller];
+
+        if( !c->queued )
+        {
+            continue;
+        }
+
+        if( kwipe_options.controller_limit > 0 && controller->running >= kwipe_options.controller_limit )
+        {
+            continue;
+        }
+
+        /* Mark the wipe in progress before the thread starts, so the GUI never sees it as neither
+         * queued nor running */
+        c->wipe_status = 1;
+        c->queued = 0;
+
+        kwipe_shared_stream_join( c );
+
+        r = pthread_create( &c->thread, NULL, kwipe_wipe_thread, (void*) c );
+        if( r != 0 )
+        {
+            c->wipe_status = -1;
+            c->thread = 0;
+            kwipe_shared_stream_batch_end();
+            kwipe_shared_stream_leave( c );
+            pthread_mutex_unlock( &sched_mutex );
+            errno = r;
+            return -1;
+        }
+
+        controller->running++;
+        if( controller->running > controller->peak_running )
+        {
+            controller->peak_running = controller->running;
+        }
+        started++;
+
+        if( kwipe_options.controller_limit > 0 )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE,
+                       "Starting the wipe of %s, %i of %i wipes running on controller %i",
+                       c->device_name,
+                       controller->running,
+                       kwipe_options.controller_limit,
+                       c->controller );
+        }
+    }
+
+    kwipe_shared_stream_batch_end();
+
+    pthread_mutex_unlock( &sched_mutex );
+
+    return started;
+}
+
+int kwipe_sched_queued( void )
+{
+    int queued = 0;
+    int i;
+
+    pthread_mutex_lock( &sched_mutex );
+    for( i = 0; i < sched_count; i++ )
+    {
+        if( sched_queue[i].c->queued )
+        {
+            queued++;
+        }
+    }
+    pthread_mutex_unlock( &sched_mutex );
+
+    return queued;
+}
+
+void kwipe_sched_sample( void )
+{
+    kwipe_context_t* c;
+    kwipe_controller_t* controller;
+    int running;
+    int i;
+    int j;
+
+    pthread_mutex_lock( &sched_mutex );
+
+    for( i = 0; i < sched_controller_count; i++ )
+    {
+        controller = &sched_controllers[i];
+        controller->throughput = 0;
+        running = 0;
+
+        for( j = 0; j < sched_count; j++ )
+        {
+            c = sched_queue[j].c;
+            if( c->controller == i && c->wipe_status == 1 )
+            {
+                controller->throughput += c->throughput;
+                running++;
+            }
+        }
+
+        if( controller->throughput > controller->peak_throughput )
+        {
+            controller->peak_throughput = controller->throughput;
+            controller->peak_throughput_running = running;
+        }
+    }
+
+    pthread_mutex_unlock( &sched_mutex );
+}
+
+void kwipe_sched_log_summary( void )
+{
+    kwipe_controller_t* controller;
+    char throughput[13];
+    int i;
+
+    pthread_mutex_lock( &sched_mutex );
+
+    for( i = 0; i < sched_controller_count; i++ )
+    {
+        controller = &sched_controllers[i];
+        Determine_C_B_nomenclature( controller->peak_throughput, throughput, sizeof( throughput ) );
+
+        kwipe_log( NWIPE_LOG_INFO, "Controller %i: %s", i, controller->path );
+        kwipe_log( NWIPE_LOG_INFO,
+                   "Controller %i: %i drive(s), up to %i wiped at once, peak %s/s with %i running",
+                   i,
+                   controller->drives,
+                   controller->peak_running,
+                   throughput,
+                   controller->peak_throughput_running );
+    }
+
+    pthread_mutex_unlock( &sched_mutex );
+}
+
+void kwipe_sched_free( void )
+{
+    pthread_mutex_lock( &sched_mutex );
+
+    free( sched_queue );
+    sched_queue = NULL;
+    sched_count = 0;
+
+    free( sched_controllers );
+    sched_controllers = NULL;
+    sched_controller_count = 0;
+
+    pthread_mutex_unlock( &sched_mutex );
+}
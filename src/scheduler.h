@@ -0,0 +1,66 @@
+/*
+ *  scheduler.h: Scheduling wipes across the controllers the drives are attached to.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include <limits.h>
+
+#include "context.h"
+
+/* Maximum length of the sysfs path that identifies a controller, as long as realpath() can resolve */
+#define NWIPE_SCHED_PATH_LENGTH PATH_MAX
+
+/**
+ * Works out which controller, HBA, SAS expander or USB hub, a drive is attached to and queues
+ * its wipe. Called from main() once the drive has been opened and its size is known.
+ * @param c the drive context
+ * @return 0 on success, -1 if the queue could not be grown
+ */
+int kwipe_sched_add( kwipe_context_t* c );
+
+/**
+ * Starts queued wipes, largest drives first, as long as their controller is running fewer
+ * than --controller-limit wipes. Called from main() after the drives are queued and
+ * whenever a wipe finishes.
+ * @return the number of wipes started, or -1 if a thread could not be created, errno is set
+ */
+int kwipe_sched_start( void );
+
+/**
+ * Returns the number of wipes still waiting to be started.
+ */
+int kwipe_sched_queued( void );
+
+/**
+ * Adds up the throughput of the running wipes on each controller and records the peak,
+ * called by compute_stats() after the throughput of each drive has been updated.
+ */
+void kwipe_sched_sample( void );
+
+/**
+ * Logs each controller's drives, the most wipes it ran at once and its peak throughput.
+ */
+void kwipe_sched_log_summary( void );
+
+/**
+ * Releases the queue and controller list, called from cleanup() in kwipe.c
+ */
+void kwipe_sched_free( void );
+
+#endif /* SCHEDULER_H_ */
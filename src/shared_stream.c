@@ -0,0 +1,681 @@
+/*
+ *  shared_stream.c: One PRNG stream for the random passes of a batch of drives.
+ *
+ *  A random pass normally seeds a PRNG for every drive, so a batch of twenty four drives
+ *  generates twenty four streams and runs out of CPU long before the drives run out of
+ *  bandwidth. With --shared-stream the drives started together form a batch, the first to
+ *  reach each random pass reads its seed, and the stream is generated once, a slot at a
+ *  time, into a ring that every drive writes from. Whichever drive is furthest ahead
+ *  generates the next slot when it needs it, so there is no generator thread to feed.
+ *  Verifying the pass generates the stream once more, into a second ring.
+ *
+ *  Each drive has a cursor on the slot it is writing and a slot can't be generated over
+ *  until every cursor has moved past it, so a drive can be at most a ring ahead of the
+ *  slowest, and the batch moves at the speed of the slowest drive. A drive that holds the
+ *  others back for NWIPE_SHARED_STREAM_STALL_NS, a failing drive retrying a sector or one
+ *  that never reaches the pass, is dropped from the ring and carries on with its own copy of
+ *  the stream, generated from the same seed, so what it writes is the same either way. So do
+ *  the drives started later by --controller-limit and drives larger than the rest of the
+ *  batch once the others have finished the pass.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "stats.h"
+#include "event.h"
+#include "shared_stream.h"
+#include "trace.h"
+#include "aes/aes_ctr_prng.h"
+
+extern kwipe_prng_t kwipe_aes_ctr_prng;
+
+/* The state of each drive's cursor */
+#define NWIPE_SHARED_STREAM_NONE 0  // Not in the batch when the stream was created
+#define NWIPE_SHARED_STREAM_PENDING 1  // Expected, holds the first slot until it arrives
+#define NWIPE_SHARED_STREAM_ATTACHED 2  // Writing from the ring
+#define NWIPE_SHARED_STREAM_DETACHING 3  // Dropped, still holds its slot until its next read
+#define NWIPE_SHARED_STREAM_GONE 4  // Finished the pass or carrying on alone
+
+typedef struct
+{
+    int state;
+    u64 slot;  // The slot the drive is reading
+} kwipe_shared_stream_cursor_t;
+
+struct kwipe_shared_stream_t_
+{
+    struct kwipe_shared_stream_t_* next;
+    int epoch;  // The random pass, counted from 1 on each drive
+    int verify;  // Set for the stream that verifies the pass
+    kwipe_entropy_t seed;
+    void* state;  // The PRNG state of the generator
+    char* ring;  // NWIPE_SHARED_STREAM_SLOTS slots, allocated by the first read
+    u64 produced;  // The number of slots generated
+    int producing;  // Set while a drive generates the next slot outside the mutex
+    int closed;  // Set once every drive has left and the ring has been released
+    u64 stall_slot;  // The slot the ring has been waiting on ...
+    u64 stall_since;  // ... since this time, 0 if it isn't waiting
+    int cursor_count;
+    kwipe_shared_stream_cursor_t cursors[];
+};
+
+static pthread_mutex_t shared_stream_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shared_stream_cond = PTHREAD_COND_INITIALIZER;
+
+static kwipe_shared_stream_t* shared_streams;
+
+/* The drives in a batch, in the order they joined. Their index is their cursor in each stream. */
+static kwipe_context_t** shared_stream_members;
+static int shared_stream_member_count;
+
+static int kwipe_shared_stream_member( kwipe_context_t* c )
+{
+    int i;
+
+    for( i = 0; i < shared_stream_member_count; i++ )
+    {
+        if( shared_stream_members[i] == c )
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static int kwipe_shared_stream_holding( kwipe_shared_stream_cursor_t* cursor )
+{
+    /* Whether the cursor stops its slot being generated over */
+    return cursor->state == NWIPE_SHARED_STREAM_PENDING || cursor->state == NWIPE_SHARED_STREAM_ATTACHED
+           || cursor->state == NWIPE_SHARED_STREAM_DETACHING;
+}
+
+static void kwipe_shared_stream_prng_free( void* state )
+{
+    if( state == NULL )
+    {
+        return;
+    }
+
+    if( kwipe_options.prng == &kwipe_aes_ctr_prng )
+    {
+        aes_ctr_prng_general_cleanup( (aes_ctr_state_t*) state );
+    }
+
+    free( state );
+}
+
+static void kwipe_shared_stream_release_ring( kwipe_shared_stream_t* s )
+{
+    if( s->ring != NULL )
+    {
+        munmap( s->ring, (size_t) NWIPE_SHARED_STREAM_SLOTS * NWIPE_SHARED_STREAM_SLOT_SIZE );
+        s->ring = NULL;
+    }
+
+    kwipe_shared_stream_prng_free( s->state );
+    s->state = NULL;
+}
+
+static kwipe_shared_stream_t* kwipe_shared_stream_find( int epoch, int verify )
+{
+    kwipe_shared_stream_t* s;
+
+    for( s = shared_streams; s != NULL; s = s->next )
+    {
+        if( s->epoch == epoch && s->verify == verify )
+        {
+            return s;
+        }
+    }
+
+    return NULL;
+}
+
+static kwipe_shared_stream_t* kwipe_shared_stream_create( int epoch, int verify, kwipe_entropy_t* seed )
+{
+    /* The drives in the batch that have reached the pass before it are expected in the new
+     * stream, those started later by --controller-limit aren't. Called with the mutex held. */
+    kwipe_context_t* member;
+    kwipe_shared_stream_t* s;
+    int i;
+
+    s = calloc( 1,
+                sizeof( kwipe_shared_stream_t )
+                    + shared_stream_member_count * sizeof( kwipe_shared_stream_cursor_t ) );
+    if( s == NULL )
+    {
+        kwipe_perror( errno, __FUNCTION__, "calloc" );
+        return NULL;
+    }
+
+    s->seed.length = seed->length;
+    s->seed.s = malloc( seed->length );
+    if( s->seed.s == NULL )
+    {
+        kwipe_perror( errno, __FUNCTION__, "malloc" );
+        free( s );
+        return NULL;
+    }
+    memcpy( s->seed.s, seed->s, seed->length );
+
+    s->epoch = epoch;
+    s->verify = verify;
+    s->cursor_count = shared_stream_member_count;
+
+    for( i = 0; i < s->cursor_count; i++ )
+    {
+        member = shared_stream_members[i];
+        if( member != NULL && member->shared_stream_epoch >= ( verify ? epoch : epoch - 1 ) )
+        {
+            s->cursors[i].state = NWIPE_SHARED_STREAM_PENDING;
+        }
+    }
+
+    s->next = shared_streams;
+    shared_streams = s;
+
+    return s;
+}
+
+static void kwipe_shared_stream_drop( kwipe_shared_stream_t* s, int member )
+{
+    /* The drive stops holding back the stream, the ring goes once no drive needs it. Called with
+     * the mutex held. */
+    int i;
+
+    if( member < 0 || member >= s->cursor_count || !kwipe_shared_stream_holding( &s->cursors[member] ) )
+    {
+        return;
+    }
+
+    s->cursors[member].state = NWIPE_SHARED_STREAM_GONE;
+    pthread_cond_broadcast( &shared_stream_cond );
+
+    for( i = 0; i < s->cursor_count; i++ )
+    {
+        if( kwipe_shared_stream_holding( &s->cursors[i] ) )
+        {
+            return;
+        }
+    }
+
+    kwipe_shared_stream_release_ring( s );
+    s->closed = 1;
+}
+
+void kwipe_shared_stream_init( void )
+{
+    pthread_condattr_t attr;
+
+    /* The waits are timed on the monotonic clock, so a change of the system time doesn't stall them */
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &shared_stream_cond, &attr );
+    pthread_condattr_destroy( &attr );
+}
+
+void kwipe_shared_stream_batch_begin( void )
+{
+    if( kwipe_options.shared_stream )
+    {
+        pthread_mutex_lock( &shared_stream_mutex );
+    }
+}
+
+void kwipe_shared_stream_join( kwipe_context_t* c )
+{
+    kwipe_context_t** members;
+
+    if( !kwipe_options.shared_stream )
+    {
+        return;
+    }
+
+    members = realloc( shared_stream_members, ( shared_stream_member_count + 1 ) * sizeof( kwipe_context_t* ) );
+    if( members == NULL )
+    {
+        kwipe_perror( errno, __FUNCTION__, "realloc" );
+        kwipe_log( NWIPE_LOG_WARNING, "Shared stream: %s will generate its own streams", c->device_name );
+        return;
+    }
+
+    shared_stream_members = members;
+    shared_stream_members[shared_stream_member_count++] = c;
+}
+
+void kwipe_shared_stream_batch_end( void )
+{
+    if( kwipe_options.shared_stream )
+    {
+        pthread_mutex_unlock( &shared_stream_mutex );
+    }
+}
+
+void kwipe_shared_stream_leave( kwipe_context_t* c )
+{
+    kwipe_shared_stream_t* s;
+    int member;
+
+    if( !kwipe_options.shared_stream )
+    {
+        return;
+    }
+
+    pthread_mutex_lock( &shared_stream_mutex );
+
+    member = kwipe_shared_stream_member( c );
+    if( member >= 0 )
+    {
+        for( s = shared_streams; s != NULL; s = s->next )
+        {
+            kwipe_shared_stream_drop( s, member );
+        }
+
+        /* Streams created from now on don't expect it */
+        shared_stream_members[member] = NULL;
+    }
+
+    pthread_mutex_unlock( &shared_stream_mutex );
+}
+
+int kwipe_shared_stream_seed( kwipe_context_t* c )
+{
+    kwipe_shared_stream_t* s;
+    ssize_t r;
+
+    pthread_mutex_lock( &shared_stream_mutex );
+
+    c->shared_stream_epoch++;
+
+    s = kwipe_shared_stream_find( c->shared_stream_epoch, 0 );
+    if( s != NULL )
+    {
+        memcpy( c->prng_seed.s, s->seed.s, c->prng_seed.length );
+        pthread_mutex_unlock( &shared_stream_mutex );
+        return 0;
+    }
+
+    /* The first drive to reach the pass seeds it for the batch */
+    r = read( c->entropy_fd, c->prng_seed.s, c->prng_seed.length );
+    if( r < 0 )
+    {
+        kwipe_perror( errno, __FUNCTION__, "read" );
+        kwipe_log( NWIPE_LOG_FATAL, "Unable to seed the PRNG." );
+        pthread_mutex_unlock( &shared_stream_mutex );
+        return -1;
+    }
+
+    if( (size_t) r != c->prng_seed.length )
+    {
+        kwipe_log( NWIPE_LOG_FATAL, "Insufficient entropy is available." );
+        pthread_mutex_unlock( &shared_stream_mutex );
+        return -1;
+    }
+
+    /* Without the stream the drive still has its seed and generates its own copy */
+    if( kwipe_shared_stream_create( c->shared_stream_epoch, 0, &c->prng_seed ) != NULL )
+    {
+        kwipe_log( NWIPE_LOG_INFO,
+                   "Shared stream: %s seeded random pass %i for the batch",
+                   c->device_name,
+                   c->shared_stream_epoch );
+    }
+
+    pthread_mutex_unlock( &shared_stream_mutex );
+
+    return 0;
+}
+
+void kwipe_shared_stream_open( kwipe_shared_stream_reader_t* reader, kwipe_context_t* c, int verify )
+{
+    kwipe_shared_stream_t* s;
+    kwipe_shared_stream_t* pass;
+    int member;
+
+    memset( reader, 0, sizeof( kwipe_shared_stream_reader_t ) );
+    reader->c = c;
+
+    if( !kwipe_options.shared_stream )
+    {
+        return;
+    }
+
+    pthread_mutex_lock( &shared_stream_mutex );
+
+    s = kwipe_shared_stream_find( c->shared_stream_epoch, verify );
+    if( s == NULL && verify && ( pass = kwipe_shared_stream_find( c->shared_stream_epoch, 0 ) ) != NULL )
+    {
+        /* The first drive to verify the pass creates the stream to verify it from */
+        s = kwipe_shared_stream_create( c->shared_stream_epoch, verify, &pass->seed );
+    }
+
+    /* A drive that couldn't be given the batch's seed has a stream of its own */
+    member = kwipe_shared_stream_member( c );
+    if( s != NULL && !s->closed && member >= 0 && member < s->cursor_count
+        && s->cursors[member].state == NWIPE_SHARED_STREAM_PENDING
+        && memcmp( s->seed.s, c->prng_seed.s, c->prng_seed.length ) == 0 )
+    {
+        s->cursors[member].state = NWIPE_SHARED_STREAM_ATTACHED;
+        s->cursors[member].slot = 0;
+        reader->stream = s;
+        reader->member = member;
+    }
+
+    pthread_mutex_unlock( &shared_stream_mutex );
+
+    if( reader->stream == NULL )
+    {
+        kwipe_log( NWIPE_LOG_INFO,
+                   "Shared stream: %s generates its own copy of random pass %i",
+                   c->device_name,
+                   c->shared_stream_epoch );
+    }
+}
+
+static u64 kwipe_shared_stream_oldest( kwipe_shared_stream_t* s )
+{
+    /* The oldest slot a drive still needs, slots before it can be generated over */
+    u64 oldest = s->produced;
+    int i;
+
+    for( i = 0; i < s->cursor_count; i++ )
+    {
+        if( kwipe_shared_stream_holding( &s->cursors[i] ) && s->cursors[i].slot < oldest )
+        {
+            oldest = s->cursors[i].slot;
+        }
+    }
+
+    return oldest;
+}
+
+static void kwipe_shared_stream_stall( kwipe_shared_stream_t* s, u64 oldest )
+{
+    /* The ring is full, drop the drives on the oldest slot if they have held it too long.
+     * Called with the mutex held. */
+    u64 now = kwipe_time_ns();
+    int i;
+
+    if( s->stall_since == 0 || s->stall_slot != oldest )
+    {
+        s->stall_slot = oldest;
+        s->stall_since = now;
+        return;
+    }
+
+    if( now - s->stall_since < NWIPE_SHARED_STREAM_STALL_NS )
+    {
+        return;
+    }
+
+    for( i = 0; i < s->cursor_count; i++ )
+    {
+        if( s->cursors[i].slot != oldest || shared_stream_members[i] == NULL )
+        {
+            continue;
+        }
+
+        if( s->cursors[i].state == NWIPE_SHARED_STREAM_PENDING )
+        {
+            s->cursors[i].state = NWIPE_SHARED_STREAM_GONE;
+            kwipe_log( NWIPE_LOG_WARNING,
+                       "Shared stream: %s hasn't started random pass %i, the batch carries on without it",
+                       shared_stream_members[i]->device_name,
+                       s->epoch );
+        }
+        else if( s->cursors[i].state == NWIPE_SHARED_STREAM_ATTACHED )
+        {
+            s->cursors[i].state = NWIPE_SHARED_STREAM_DETACHING;
+            kwipe_log( NWIPE_LOG_WARNING,
+                       "Shared stream: %s is holding back the batch, it carries on alone",
+                       shared_stream_members[i]->device_name );
+        }
+    }
+
+    s->stall_since = now;
+}
+
+static int kwipe_shared_stream_ring( kwipe_shared_stream_t* s )
+{
+    /* Allocates the ring and seeds its generator. Called with the mutex held. */
+    s->ring = mmap( NULL,
+                    (size_t) NWIPE_SHARED_STREAM_SLOTS * NWIPE_SHARED_STREAM_SLOT_SIZE,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1,
+                    0 );
+    if( s->ring == MAP_FAILED )
+    {
+        kwipe_perror( errno, __FUNCTION__, "mmap" );
+        s->ring = NULL;
+        return -1;
+    }
+
+#ifdef MADV_HUGEPAGE
+    madvise( s->ring, (size_t) NWIPE_SHARED_STREAM_SLOTS * NWIPE_SHARED_STREAM_SLOT_SIZE, MADV_HUGEPAGE );
+#endif
+
+    if( kwipe_options.prng->init( &s->state, &s->seed ) != 0 )
+    {
+        kwipe_shared_stream_release_ring( s );
+        return -1;
+    }
+
+    return 0;
+}
+
+static const char* kwipe_shared_stream_slot( kwipe_shared_stream_reader_t* reader, u64 slot )
+{
+    /* Returns the slot from the ring, generating it if no drive has yet. Sets reader->stream to
+     * NULL if the drive has been dropped from the ring. */
+    kwipe_shared_stream_t* s = reader->stream;
+    kwipe_shared_stream_cursor_t* cursor = &s->cursors[reader->member];
+    struct timespec timeout;
+    char* data;
+
+    pthread_mutex_lock( &shared_stream_mutex );
+
+    /* Moving the cursor releases the slots before it */
+    cursor->slot = slot;
+    pthread_cond_broadcast( &shared_stream_cond );
+
+    while( cursor->state == NWIPE_SHARED_STREAM_ATTACHED && slot >= s->produced )
+    {
+        if( kwipe_cancel_requested( reader->c ) )
+        {
+            pthread_mutex_unlock( &shared_stream_mutex );
+            return NULL;
+        }
+
+        if( !s->producing && s->produced - kwipe_shared_stream_oldest( s ) < NWIPE_SHARED_STREAM_SLOTS )
+        {
+            if( s->ring == NULL && kwipe_shared_stream_ring( s ) != 0 )
+            {
+                kwipe_log( NWIPE_LOG_WARNING,
+                           "Shared stream: unable to allocate the ring, %s generates its own copy",
+                           reader->c->device_name );
+                break;
+            }
+
+            /* Generate the next slot outside the mutex, no drive reads it until produced moves */
+            s->producing = 1;
+            data = s->ring + ( s->produced % NWIPE_SHARED_STREAM_SLOTS ) * NWIPE_SHARED_STREAM_SLOT_SIZE;
+            pthread_mutex_unlock( &shared_stream_mutex );
+
+            NWIPE_TRACE_PRNG_START( reader->c, NWIPE_SHARED_STREAM_SLOT_SIZE );
+            kwipe_options.prng->read( &s->state, data, NWIPE_SHARED_STREAM_SLOT_SIZE );
+            NWIPE_TRACE_PRNG_DONE( reader->c, NWIPE_SHARED_STREAM_SLOT_SIZE );
+
+            pthread_mutex_lock( &shared_stream_mutex );
+            s->produced++;
+            s->producing = 0;
+            s->stall_since = 0;
+            pthread_cond_broadcast( &shared_stream_cond );
+            continue;
+        }
+
+        if( !s->producing )
+        {
+            kwipe_shared_stream_stall( s, kwipe_shared_stream_oldest( s ) );
+        }
+
+        /* Wake at least once a second to check for a stall or cancellation */
+        clock_gettime( CLOCK_MONOTONIC, &timeout );
+        timeout.tv_sec += 1;
+        pthread_cond_timedwait( &shared_stream_cond, &shared_stream_mutex, &timeout );
+    }
+
+    if( cursor->state != NWIPE_SHARED_STREAM_ATTACHED || slot >= s->produced )
+    {
+        /* Dropped from the ring, or the ring couldn't be allocated */
+        kwipe_shared_stream_drop( s, reader->member );
+        pthread_mutex_unlock( &shared_stream_mutex );
+        reader->stream = NULL;
+        return NULL;
+    }
+
+    data = s->ring + ( slot % NWIPE_SHARED_STREAM_SLOTS ) * NWIPE_SHARED_STREAM_SLOT_SIZE;
+
+    pthread_mutex_unlock( &shared_stream_mutex );
+
+    return data;
+}
+
+static const char* kwipe_shared_stream_own( kwipe_shared_stream_reader_t* reader, u64 slot )
+{
+    /* Generates the drive's own copy of the stream up to the slot, from the same seed */
+    kwipe_context_t* c = reader->c;
+
+    if( reader->own == NULL )
+    {
+        reader->own = malloc( NWIPE_SHARED_STREAM_SLOT_SIZE );
+        if( reader->own == NULL )
+        {
+            kwipe_perror( errno, __FUNCTION__, "malloc" );
+            return NULL;
+        }
+
+        if( c->prng->init( &reader->own_state, &c->prng_seed ) != 0 )
+        {
+            return NULL;
+        }
+
+        if( slot > 0 )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE,
+                       "Shared stream: %s generating its own copy from %llu MiB",
+                       c->device_name,
+                       slot * NWIPE_SHARED_STREAM_SLOT_SIZE / ( 1024 * 1024 ) );
+        }
+    }
+
+    /* Catch up with the slot, the slots before it are the same as in the ring */
+    while( reader->own_slot <= slot )
+    {
+        NWIPE_TRACE_PRNG_START( c, NWIPE_SHARED_STREAM_SLOT_SIZE );
+        c->prng->read( &reader->own_state, reader->own, NWIPE_SHARED_STREAM_SLOT_SIZE );
+        NWIPE_TRACE_PRNG_DONE( c, NWIPE_SHARED_STREAM_SLOT_SIZE );
+        reader->own_slot++;
+
+        if( kwipe_cancel_requested( c ) )
+        {
+            return NULL;
+        }
+    }
+
+    return reader->own;
+}
+
+const char* kwipe_shared_stream_read( kwipe_shared_stream_reader_t* reader, u64 offset, size_t* length )
+{
+    u64 slot = offset / NWIPE_SHARED_STREAM_SLOT_SIZE;
+    size_t within = offset % NWIPE_SHARED_STREAM_SLOT_SIZE;
+    const char* data;
+
+    if( *length > NWIPE_SHARED_STREAM_SLOT_SIZE - within )
+    {
+        *length = NWIPE_SHARED_STREAM_SLOT_SIZE - within;
+    }
+
+    if( reader->stream != NULL )
+    {
+        data = kwipe_shared_stream_slot( reader, slot );
+        if( data != NULL )
+        {
+            return data + within;
+        }
+
+        if( reader->stream != NULL )
+        {
+            /* Cancelled */
+            return NULL;
+        }
+    }
+
+    data = kwipe_shared_stream_own( reader, slot );
+
+    return data ? data + within : NULL;
+}
+
+void kwipe_shared_stream_close( kwipe_shared_stream_reader_t* reader )
+{
+    if( reader->stream != NULL )
+    {
+        pthread_mutex_lock( &shared_stream_mutex );
+        kwipe_shared_stream_drop( reader->stream, reader->member );
+        pthread_mutex_unlock( &shared_stream_mutex );
+        reader->stream = NULL;
+    }
+
+    kwipe_shared_stream_prng_free( reader->own_state );
+    reader->own_state = NULL;
+
+    free( reader->own );
+    reader->own = NULL;
+}
+
+void kwipe_shared_stream_free( void )
+{
+    kwipe_shared_stream_t* s;
+
+    pthread_mutex_lock( &shared_stream_mutex );
+
+    while( shared_streams != NULL )
+    {
+        s = shared_streams;
+        shared_streams = s->next;
+
+        kwipe_shared_stream_release_ring( s );
+        free( s->seed.s );
+        free( s );
+    }
+
+    free( shared_stream_members );
+    shared_stream_members = NULL;
+    shared_stream_member_count = 0;
+
+    pthread_mutex_unlock( &shared_stream_mutex );
+}
@@ -0,0 +1,98 @@
+/*
+ *  shared_stream.h: One PRNG stream for the random passes of a batch of drives.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef SHARED_STREAM_H_
+#define SHARED_STREAM_H_
+
+#include "context.h"
+#include "autotune.h"
+
+/* The stream is generated in slots the size of the largest write --autotune may choose, so
+ * that no write straddles two slots, and kept in a ring of NWIPE_SHARED_STREAM_SLOTS. */
+#define NWIPE_SHARED_STREAM_SLOT_SIZE NWIPE_AUTOTUNE_MAX_SIZE
+#define NWIPE_SHARED_STREAM_SLOTS 16
+
+/* A drive that holds the others back this long, a full ring behind them, carries on alone. */
+#define NWIPE_SHARED_STREAM_STALL_NS ( 60ULL * 1000000000ULL )
+
+typedef struct kwipe_shared_stream_t_ kwipe_shared_stream_t;
+
+/* A drive's place in the stream of one pass */
+typedef struct
+{
+    kwipe_context_t* c;
+    kwipe_shared_stream_t* stream;  // The shared stream, NULL if the drive generates its own copy
+    int member;  // The drive's cursor in the shared stream
+    char* own;  // The current slot of the drive's own copy
+    void* own_state;  // The PRNG state of the drive's own copy
+    u64 own_slot;  // The number of slots of its own copy the drive has generated
+} kwipe_shared_stream_reader_t;
+
+/**
+ * Initialises the condition the drives of a stream wait on, must be called before any thread is created.
+ */
+void kwipe_shared_stream_init( void );
+
+/**
+ * The drives started by one call to kwipe_sched_start() form a batch. Between
+ * kwipe_shared_stream_batch_begin() and kwipe_shared_stream_batch_end() each is added with
+ * kwipe_shared_stream_join() before its thread is created, and the streams of their first
+ * pass aren't created until the whole batch has joined. They do nothing unless
+ * --shared-stream is set.
+ */
+void kwipe_shared_stream_batch_begin( void );
+void kwipe_shared_stream_join( kwipe_context_t* c );
+void kwipe_shared_stream_batch_end( void );
+
+/**
+ * Called at the end of the wipe thread. The drive stops holding back every stream it was
+ * expected in.
+ */
+void kwipe_shared_stream_leave( kwipe_context_t* c );
+
+/**
+ * Used by kwipe_runmethod() in place of reading the seed of a random pass from the entropy
+ * source. The first drive to reach each random pass reads the seed and the others copy it.
+ * @return 0 on success, -1 if the seed could not be read
+ */
+int kwipe_shared_stream_seed( kwipe_context_t* c );
+
+/**
+ * Starts reading the stream of the drive's current random pass, to write it or, with
+ * verify set, to verify it. Only clears the reader unless --shared-stream is set.
+ */
+void kwipe_shared_stream_open( kwipe_shared_stream_reader_t* reader, kwipe_context_t* c, int verify );
+
+/**
+ * Returns the stream from 'offset', which only ever moves forward, and reduces *length to what
+ * is left of the slot it is in. The data stays valid until the next call.
+ * @return the data, or NULL if the wipe was cancelled or memory ran out
+ */
+const char* kwipe_shared_stream_read( kwipe_shared_stream_reader_t* reader, u64 offset, size_t* length );
+
+/**
+ * Stops reading, the drive no longer holds back the others.
+ */
+void kwipe_shared_stream_close( kwipe_shared_stream_reader_t* reader );
+
+/**
+ * Releases every stream, called from main() once the wipe threads have been joined.
+ */
+void kwipe_shared_stream_free( void );
+
+#endif /* SHARED_STREAM_H_ */
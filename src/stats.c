@@ -0,0 +1,204 @@
+/*
+ *  stats.c: Throughput and ETA calculations for kwipe.
+ *
+ *  Every drive is sampled at least 4 times a second on the monotonic clock. From the
+ *  samples we derive a windowed throughput over the last NWIPE_KNOB_STATS_WINDOW samples,
+ *  which is what the user sees and which drops straight away if a drive stalls, and a
+ *  smoothed (EWMA) throughput for writing and for verifying, which is what the ETA uses.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <time.h>
+#include <pthread.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "stats.h"
+#include "progress.h"
+
+/* compute_stats() runs in the GUI thread and from the SIGUSR1 handler thread. */
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+u64 kwipe_time_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (u64) ts.tv_sec * 1000000000ULL + (u64) ts.tv_nsec;
+}
+
+static double kwipe_stats_rate( u64 bytes, u64 ns )
+{
+    if( ns == 0 )
+    {
+        return 0;
+    }
+    return (double) bytes * 1e9 / (double) ns;
+}
+
+static void kwipe_stats_ewma( double* ewma, double rate, double seconds )
+{
+    /* The weight of the new sample depends on how long it covers, so irregular sampling intervals
+     * don't change the time constant. dt / ( tau + dt ) approximates 1 - exp( -dt / tau ). */
+    double alpha = seconds / ( NWIPE_KNOB_STATS_EWMA_TAU + seconds );
+
+    if( *ewma == 0 )
+    {
+        *ewma = rate;
+    }
+    else
+    {
+        *ewma += alpha * ( rate - *ewma );
+    }
+}
+
+void kwipe_stats_update( kwipe_context_t* c, u64 now_ns )
+{
+    kwipe_stats_t* s = &c->stats;
+    kwipe_progress_t progress;
+    u64 round_done;
+    u64 pass_done;
+    u64 bytes;
+    u64 interval;
+    u64 oldest;
+    u64 write_left;
+    u64 verify_left;
+    u64 left;
+    kwipe_pass_t pass_type;
+    double write_rate;
+    double verify_rate;
+    int pass_key;
+
+    /* The wipe thread sets start_ns once the method is running. */
+    if( c->start_ns == 0 || now_ns <= c->start_ns )
+    {
+        return;
+    }
+
+    pthread_mutex_lock( &stats_mutex );
+
+    if( s->finished )
+    {
+        pthread_mutex_unlock( &stats_mutex );
+        return;
+    }
+
+    /* Take a copy, the wipe thread keeps updating these. */
+    kwipe_progress_snapshot( c, &progress );
+    round_done = progress.round_done;
+    pass_done = progress.pass_done;
+    pass_type = c->pass_type;
+
+    if( s->last_ns == 0 )
+    {
+        /* The first sample is the start of the wipe. */
+        s->last_ns = c->start_ns;
+        s->last_bytes = 0;
+        s->sample_ns[0] = c->start_ns;
+        s->sample_bytes[0] = 0;
+        s->position = 1;
+        s->samples = 1;
+    }
+
+    /* Notice the start of a new pass, the per pass throughput is measured from there. */
+    pass_key = ( c->round_working << 16 ) | ( c->pass_working << 4 ) | pass_type;
+    if( pass_type != NWIPE_PASS_NONE && pass_key != s->pass_key )
+    {
+        s->pass_key = pass_key;
+        s->pass_start_ns = now_ns;
+        s->pass_start_bytes = pass_done;
+    }
+
+    if( now_ns - s->last_ns >= NWIPE_KNOB_STATS_SAMPLE_NS && round_done >= s->last_bytes )
+    {
+        bytes = round_done - s->last_bytes;
+        interval = now_ns - s->last_ns;
+
+        if( pass_type == NWIPE_PASS_VERIFY )
+        {
+            s->verify_done += bytes;
+            kwipe_stats_ewma( &s->verify_ewma, kwipe_stats_rate( bytes, interval ), interval / 1e9 );
+        }
+        else if( pass_type != NWIPE_PASS_NONE && pass_type != NWIPE_PASS_DISCARD )
+        {
+            kwipe_stats_ewma( &s->write_ewma, kwipe_stats_rate( bytes, interval ), interval / 1e9 );
+        }
+
+        s->sample_ns[s->position] = now_ns;
+        s->sample_bytes[s->position] = round_done;
+        s->position = ( s->position + 1 ) % NWIPE_KNOB_STATS_WINDOW;
+        if( s->samples < NWIPE_KNOB_STATS_WINDOW )
+        {
+            s->samples++;
+        }
+
+        s->last_ns = now_ns;
+        s->last_bytes = round_done;
+    }
+
+    /* The windowed throughput runs from the oldest sample up to now rather than the latest sample,
+     * so a drive that has stalled shows its throughput falling while it is stalled. */
+    oldest = ( s->position + NWIPE_KNOB_STATS_WINDOW - s->samples ) % NWIPE_KNOB_STATS_WINDOW;
+    if( round_done >= s->sample_bytes[oldest] )
+    {
+        c->throughput = kwipe_stats_rate( round_done - s->sample_bytes[oldest], now_ns - s->sample_ns[oldest] );
+    }
+
+    if( pass_type != NWIPE_PASS_NONE && now_ns > s->pass_start_ns && pass_done >= s->pass_start_bytes )
+    {
+        c->throughput_pass = kwipe_stats_rate( pass_done - s->pass_start_bytes, now_ns - s->pass_start_ns );
+    }
+
+    c->throughput_overall = kwipe_stats_rate( round_done, now_ns - c->start_ns );
+
+    /* The remaining bytes are a mix of writing and reading back, which often run at different
+     * speeds, so estimate each with its own throughput. Until a verification pass has run we
+     * assume it will be as fast as writing, and vice versa for the verify only methods. */
+    left = c->round_size > round_done ? c->round_size - round_done : 0;
+    verify_left = c->round_verify_size > s->verify_done ? c->round_verify_size - s->verify_done : 0;
+    if( verify_left > left )
+    {
+        verify_left = left;
+    }
+    write_left = left - verify_left;
+
+    write_rate = s->write_ewma ? s->write_ewma : s->verify_ewma;
+    verify_rate = s->verify_ewma ? s->verify_ewma : s->write_ewma;
+
+    if( ( write_left == 0 || write_rate > NWIPE_STATS_MIN_ETA_THROUGHPUT )
+        && ( verify_left == 0 || verify_rate > NWIPE_STATS_MIN_ETA_THROUGHPUT ) )
+    {
+        c->eta = 0;
+        if( write_left )
+        {
+            c->eta += (u64) ( write_left / write_rate );
+        }
+        if( verify_left )
+        {
+            c->eta += (u64) ( verify_left / verify_rate );
+        }
+    }
+
+    /* One last sample after the wipe has finished, so the overall throughput is final. */
+    if( c->wipe_status == 0 )
+    {
+        c->eta = 0;
+        s->finished = 1;
+    }
+
+    pthread_mutex_unlock( &stats_mutex );
+}
@@ -0,0 +1,42 @@
+/*
+ *  stats.h: Throughput and ETA calculations for kwipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "context.h"
+
+/* Throughput below which no ETA is calculated, this prevents enormous ETA's on an unresponsive drive. */
+#define NWIPE_STATS_MIN_ETA_THROUGHPUT 100000
+
+/**
+ * Returns the time of the monotonic clock in nanoseconds.
+ */
+u64 kwipe_time_ns( void );
+
+/**
+ * Takes a throughput sample of a drive, if at least NWIPE_KNOB_STATS_SAMPLE_NS has elapsed
+ * since the previous one, and updates the drive's throughput and eta fields.
+ * Safe to call from more than one thread. compute_stats() calls it from the --nogui loop every
+ * NWIPE_KNOB_STATS_SAMPLE_NS and from the GUI loop on each refresh, so samples are taken at 4Hz.
+ * @param c the drive context
+ * @param now_ns the current time as returned by kwipe_time_ns()
+ */
+void kwipe_stats_update( kwipe_context_t* c, u64 now_ns );
+
+#endif /* STATS_H_ */
@@ -37,10 +37,75 @@
 #include "device.h"
 #include "logging.h"
 #include "temperature.h"
+#include "trace.h"
 #include "miscellaneous.h"
+#include "stats.h"
+#include "event.h"
+#include "throttle.h"
 
 extern int terminate_signal;
 
+static int kwipe_hwmon_open( kwipe_context_t* c, const char* label )
+{
+    /* Opens one of the hwmon files of a drive, returning -1 if it doesn't have it.
+     */
+    char path[256];
+    int fd;
+
+    snprintf( path, sizeof( path ), "%s/%s", c->temp1_path, label );
+
+    fd = open( path, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 && kwipe_options.verbose )
+    {
+        kwipe_log( NWIPE_LOG_NOTICE, "hwmon: Unable to  open %s", path );
+    }
+
+    return fd;
+}
+
+static int kwipe_hwmon_read( int fd, int* temperature_pcontext )
+{
+    /* Reads a temperature in millidegrees from an open hwmon file and stores it in degrees
+     * celsius. sysfs regenerates the value on every read from offset 0, so the file is
+     * never reopened or rewound.
+     */
+    char temperature[32];
+    ssize_t r;
+
+    if( fd < 0 )
+    {
+        return -1;
+    }
+
+    r = pread( fd, temperature, sizeof( temperature ) - 1, 0 );
+    if( r <= 0 )
+    {
+        return -1;
+    }
+    temperature[r] = 0;
+
+    /* Convert numeric ascii to binary integer and divide by 1000 to get degrees celsius */
+    *temperature_pcontext = atoi( temperature ) / 1000;
+
+    return 0;
+}
+
+static void kwipe_hwmon_read_limit( kwipe_context_t* c, const char* label, int* temperature_pcontext )
+{
+    /* The limits never change, so they are read once when the drive is initialised.
+     */
+    int fd;
+
+    if( ( fd = kwipe_hwmon_open( c, label ) ) >= 0 )
+    {
+        if( kwipe_hwmon_read( fd, temperature_pcontext ) == 0 && kwipe_options.verbose )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE, "hwmon: %s/%s %dC", c->temp1_path, label, *temperature_pcontext );
+        }
+        close( fd );
+    }
+}
+
 int kwipe_init_temperature( kwipe_context_t* c )
 {
     /* See header definition for description of function
@@ -77,6 +142,11 @@ int kwipe_init_temperature( kwipe_context_t* c )
     c->temp1_flash_rate_counter = 0;
     c->temp1_path[0] = 0;
     c->temp1_time = 0;
+    c->temp1_input_fd = -1;
+    c->temp1_highest_fd = -1;
+    c->temp1_lowest_fd = -1;
+    c->temp1_thread = 0;
+    c->temp1_interval = NWIPE_TEMP_SCSI_INTERVAL;
 
     /* Each hwmonX directory is processed in turn and once a hwmonX directory has been
      * found that is a block device and the block device name matches the drive
@@ -200,6 +270,20 @@ int kwipe_init_temperature( kwipe_context_t* c )
         }
         closedir( dir );
     }
+
+    if( c->templ_has_hwmon_data == 1 )
+    {
+        /* Read the static limits once and keep the files that change open */
+        kwipe_hwmon_read_limit( c, "temp1_crit", &c->temp1_crit );
+        kwipe_hwmon_read_limit( c, "temp1_lcrit", &c->temp1_lcrit );
+        kwipe_hwmon_read_limit( c, "temp1_max", &c->temp1_max );
+        kwipe_hwmon_read_limit( c, "temp1_min", &c->temp1_min );
+
+        c->temp1_input_fd = kwipe_hwmon_open( c, "temp1_input" );
+        c->temp1_highest_fd = kwipe_hwmon_open( c, "temp1_highest" );
+        c->temp1_lowest_fd = kwipe_hwmon_open( c, "temp1_lowest" );
+    }
+
     /* if no hwmon data available try scsi access (SAS Disks are known to be not working in hwmon */
     if( c->templ_has_hwmon_data == 0 && ( c->device_type == NWIPE_DEVICE_SAS || c->device_type == NWIPE_DEVICE_SCSI ) )
     {
@@ -242,6 +326,24 @@ void* kwipe_update_temperature_thread( void* ptr )
     /* mark start second of update */
     time_t kwipe_timemark = time( NULL );
 
+    /* The generation of the event last seen, we are woken by it when kwipe terminates */
+    u64 event_seen = kwipe_event_generation();
+
+    /* SCSI/SAS drives can take seconds to answer, so each is polled by its own thread rather
+     * than holding up the other drives. If the thread can't be created the drive is polled
+     * here as before. */
+    for( i = 0; i < kwipe_misc_thread_data->kwipe_enumerated; i++ )
+    {
+        if( c[i]->templ_has_hwmon_data == 0 && c[i]->templ_has_scsitemp_data == 1 )
+        {
+            if( pthread_create( &c[i]->temp1_thread, NULL, kwipe_scsi_temperature_thread, c[i] ) != 0 )
+            {
+                kwipe_log( NWIPE_LOG_WARNING, "Unable to create SCSI temperature thread for %s", c[i]->device_name );
+                c[i]->temp1_thread = 0;
+            }
+        }
+    }
+
     /* update immediately on entry to thread */
     for( i = 0; i < kwipe_misc_thread_data->kwipe_enumerated; i++ )
     {
@@ -267,7 +369,88 @@ void* kwipe_update_temperature_thread( void* ptr )
         }
         else
         {
-            sleep( 1 );
+            event_seen = kwipe_event_wait( event_seen, 1000000000ULL );
+        }
+    }
+
+    /* The SCSI temperature threads are woken by the same event, wait for them */
+    for( i = 0; i < kwipe_misc_thread_data->kwipe_enumerated; i++ )
+    {
+        if( c[i]->temp1_thread )
+        {
+            pthread_join( c[i]->temp1_thread, NULL );
+            c[i]->temp1_thread = 0;
+        }
+    }
+    return NULL;
+}
+
+static int kwipe_scsi_temperature_interval( kwipe_context_t* c, u64 elapsed_ns )
+{
+    /* Works out how long to wait before polling a SCSI/SAS drive again, see temperature.h
+     */
+    u64 interval = NWIPE_TEMP_SCSI_INTERVAL;
+
+    if( c->temp1_max != NO_TEMPERATURE_DATA && c->temp1_input != NO_TEMPERATURE_DATA
+        && c->temp1_input >= c->temp1_max - NWIPE_TEMP_SCSI_HOT_MARGIN )
+    {
+        interval = NWIPE_TEMP_SCSI_INTERVAL_HOT;
+    }
+
+    if( elapsed_ns * NWIPE_TEMP_SCSI_DUTY / 1000000000ULL > interval )
+    {
+        interval = elapsed_ns * NWIPE_TEMP_SCSI_DUTY / 1000000000ULL;
+    }
+
+    if( interval > NWIPE_TEMP_SCSI_INTERVAL_MAX )
+    {
+        interval = NWIPE_TEMP_SCSI_INTERVAL_MAX;
+    }
+
+    /* The thermal throttle must not act on a stale temperature, whatever the cost of polling */
+    if( kwipe_options.thermal_throttle && interval > NWIPE_THROTTLE_TEMP_INTERVAL )
+    {
+        interval = NWIPE_THROTTLE_TEMP_INTERVAL;
+    }
+
+    return (int) interval;
+}
+
+void* kwipe_scsi_temperature_thread( void* ptr )
+{
+    kwipe_context_t* c = (kwipe_context_t*) ptr;
+    u64 event_seen = kwipe_event_generation();
+    u64 start_ns;
+    u64 elapsed_ns;
+    u64 next_ns;
+    u64 now_ns;
+
+    while( terminate_signal != 1 )
+    {
+        start_ns = kwipe_time_ns();
+        if( kwipe_get_scsi_temperature( c ) != 0 )
+        {
+            kwipe_log( NWIPE_LOG_ERROR, "get_scsi_temperature error" );
+        }
+        c->temp1_time = time( NULL );
+        elapsed_ns = kwipe_time_ns() - start_ns;
+        NWIPE_TRACE_TEMP_POLL( c, elapsed_ns );
+
+        c->temp1_interval = kwipe_scsi_temperature_interval( c, elapsed_ns );
+        if( kwipe_options.verbose )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE,
+                       "get temperature for %s took %f ms, next in %i seconds",
+                       c->device_name,
+                       elapsed_ns / 1000000.0,
+                       c->temp1_interval );
+        }
+
+        /* Sleep until the next poll, we are woken early by the event when kwipe terminates */
+        next_ns = start_ns + c->temp1_interval * 1000000000ULL;
+        while( terminate_signal != 1 && ( now_ns = kwipe_time_ns() ) < next_ns )
+        {
+            event_seen = kwipe_event_wait( event_seen, next_ns - now_ns );
         }
     }
     return NULL;
@@ -286,30 +469,14 @@ void kwipe_update_temperature( kwipe_context_t* c )
      * performed. The temperaures should be updated no more frequently than every 60 seconds
      */
 
-    char temperature_label[NUMBER_OF_FILES][20] = {
-        "temp1_crit", "temp1_highest", "temp1_input", "temp1_lcrit", "temp1_lowest", "temp1_max", "temp1_min" };
-    int* temperature_pcontext[NUMBER_OF_FILES] = {
-
-        &( c->temp1_crit ),
-        &( c->temp1_highest ),
-        &( c->temp1_input ),
-        &( c->temp1_lcrit ),
-        &( c->temp1_lowest ),
-        &( c->temp1_max ),
-        &( c->temp1_min ) };
-
-    char path[256];
-    char temperature[256];
-    FILE* fptr;
-    int idx;
-    int result;
     struct timeval tv_start;
     struct timeval tv_end;
     float delta_t;
 
-    /* avoid being called more often than 1x per 60 seconds */
+    /* avoid being called more often than 1x per 60 seconds, or every few seconds when the
+     * thermal throttle needs to follow the temperature */
     time_t kwipe_time_now = time( NULL );
-    if( kwipe_time_now - c->temp1_time < 60 )
+    if( kwipe_time_now - c->temp1_time < ( kwipe_options.thermal_throttle ? NWIPE_THROTTLE_TEMP_INTERVAL : 60 ) )
     {
         return;
     }
@@ -317,50 +484,30 @@ void kwipe_update_temperature( kwipe_context_t* c )
     /* measure time it takes to get the temperatures */
     gettimeofday( &tv_start, 0 );
 
-    /* try to get temperatures from hwmon, standard */
+    /* try to get temperatures from hwmon, standard, the files were opened by kwipe_init_temperature() */
     if( c->templ_has_hwmon_data == 1 )
     {
-        for( idx = 0; idx < NUMBER_OF_FILES; idx++ )
-        {
-            /* Construct the full path including filename */
-            strcpy( path, c->temp1_path );
-            strcat( path, "/" );
-            strcat( path, &( temperature_label[idx][0] ) );
+        kwipe_hwmon_read( c->temp1_input_fd, &c->temp1_input );
+        kwipe_hwmon_read( c->temp1_highest_fd, &c->temp1_highest );
+        kwipe_hwmon_read( c->temp1_lowest_fd, &c->temp1_lowest );
 
-            /* Open the file */
-            if( ( fptr = fopen( path, "r" ) ) != NULL )
-            {
-                /* Acquire data until we reach a newline */
-                result = fscanf( fptr, "%[^\n]", temperature );
-
-                /* Convert numeric ascii to binary integer */
-                *( temperature_pcontext[idx] ) = atoi( temperature );
-
-                /* Divide by 1000 to get degrees celsius */
-                *( temperature_pcontext[idx] ) = *( temperature_pcontext[idx] ) / 1000;
-
-                if( kwipe_options.verbose )
-                {
-                    kwipe_log( NWIPE_LOG_NOTICE, "hwmon: %s %dC", path, *( temperature_pcontext[idx] ) );
-                }
-
-                fclose( fptr );
-            }
-            else
-            {
-                if( kwipe_options.verbose )
-                {
-                    kwipe_log( NWIPE_LOG_NOTICE, "hwmon: Unable to  open %s", path );
-                }
-            }
+        if( kwipe_options.verbose )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE,
+                       "hwmon: %s input %dC, highest %dC, lowest %dC",
+                       c->temp1_path,
+                       c->temp1_input,
+                       c->temp1_highest,
+                       c->temp1_lowest );
         }
     }
     else
     {
-        /* alternative method to get temperature from SCSI/SAS disks */
+        /* alternative method to get temperature from SCSI/SAS disks, normally polled by
+         * kwipe_scsi_temperature_thread() unless it couldn't be created */
         if( c->device_type == NWIPE_DEVICE_SAS || c->device_type == NWIPE_DEVICE_SCSI )
         {
-            if( c->templ_has_scsitemp_data == 1 )
+            if( c->templ_has_scsitemp_data == 1 && c->temp1_thread == 0 )
             {
                 if( kwipe_options.verbose )
                 {
@@ -377,6 +524,11 @@ void kwipe_update_temperature( kwipe_context_t* c )
                     kwipe_log( NWIPE_LOG_ERROR, "get_scsi_temperature error" );
                 }
             }
+            else
+            {
+                /* The drive's own thread keeps the temperature and time stamp up to date */
+                return;
+            }
         }
     }
 
@@ -387,6 +539,7 @@ void kwipe_update_temperature( kwipe_context_t* c )
 
     gettimeofday( &tv_end, 0 );
     delta_t = timedifference_msec( tv_start, tv_end );
+    NWIPE_TRACE_TEMP_POLL( c, (u64) ( delta_t * 1000000 ) );
     if( kwipe_options.verbose )
     {
         kwipe_log( NWIPE_LOG_NOTICE, "get temperature for %s took %f ms", c->device_name, delta_t );
@@ -493,3 +646,24 @@ void kwipe_log_drives_temperature_limits( kwipe_context_t* c )
 
     return;
 }
+
+void kwipe_shut_temperature( kwipe_context_t* c )
+{
+    /* See header for description of function
+     */
+    if( c->temp1_input_fd >= 0 )
+    {
+        close( c->temp1_input_fd );
+        c->temp1_input_fd = -1;
+    }
+    if( c->temp1_highest_fd >= 0 )
+    {
+        close( c->temp1_highest_fd );
+        c->temp1_highest_fd = -1;
+    }
+    if( c->temp1_lowest_fd >= 0 )
+    {
+        close( c->temp1_lowest_fd );
+        c->temp1_lowest_fd = -1;
+    }
+}
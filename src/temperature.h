@@ -45,6 +45,13 @@ int kwipe_get_scsi_temperature( kwipe_context_t* );
 void kwipe_shut_scsi_temperature( kwipe_context_t* );
 void* kwipe_update_temperature_thread( void* ptr );
 
+/**
+ * Polls the temperature of a single SCSI/SAS drive on its own adaptive interval until kwipe
+ * terminates, started by kwipe_update_temperature_thread() so a slow drive doesn't delay the others.
+ * @param pointer to a drive context
+ */
+void* kwipe_scsi_temperature_thread( void* ptr );
+
 /**
  * This function is normally called only once. It's called after both the
  * kwipe_init_temperature() function and kwipe_update_temperature()
@@ -54,8 +61,27 @@ void* kwipe_update_temperature_thread( void* ptr );
  */
 void kwipe_log_drives_temperature_limits( kwipe_context_t* );
 
+/**
+ * Closes the hwmon files kept open by kwipe_init_temperature(), called once the
+ * temperature thread has terminated.
+ * @param pointer to a drive context
+ */
+void kwipe_shut_temperature( kwipe_context_t* );
+
 #define NUMBER_OF_FILES 7
 
 #define NO_TEMPERATURE_DATA 1000000
 
+/* SCSI/SAS temperatures are polled by a thread per drive, as a LOG SENSE can take up to 2 seconds.
+ * A drive is polled every NWIPE_TEMP_SCSI_INTERVAL seconds, every NWIPE_TEMP_SCSI_INTERVAL_HOT
+ * seconds when it is within NWIPE_TEMP_SCSI_HOT_MARGIN degrees of its maximum. A slow drive is
+ * polled less often, so that it spends no more than 1/NWIPE_TEMP_SCSI_DUTY of its time answering,
+ * but at least every NWIPE_TEMP_SCSI_INTERVAL_MAX seconds. With --thermal-throttle, every drive
+ * is polled at least every NWIPE_THROTTLE_TEMP_INTERVAL seconds, however slow it answers. */
+#define NWIPE_TEMP_SCSI_INTERVAL 60
+#define NWIPE_TEMP_SCSI_INTERVAL_HOT 10
+#define NWIPE_TEMP_SCSI_INTERVAL_MAX 300
+#define NWIPE_TEMP_SCSI_HOT_MARGIN 5
+#define NWIPE_TEMP_SCSI_DUTY 20
+
 #endif /* TEMPERATURE_H_ */
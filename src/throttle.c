@@ -0,0 +1,219 @@
+/*
+ *  throttle.c: Thermal-aware write throttling for kwipe.
+ *
+ *  Drives in a dense chassis can overheat during a long wipe and then throttle themselves,
+ *  or start returning errors, which costs far more time than slowing down a little early.
+ *  When --thermal-throttle is set the write passes call kwipe_throttle() after every block.
+ *  As the drive approaches temp1_max its write rate is reduced smoothly by sleeping in
+ *  proportion to the time spent writing, and near temp1_crit writing is paused until the
+ *  drive has cooled back below temp1_max. The temperatures are those last read by the
+ *  temperature thread, so the cost per block when the drive is cool is a few comparisons.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <time.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "logging.h"
+#include "temperature.h"
+#include "miscellaneous.h"
+#include "stats.h"
+#include "event.h"
+#include "throttle.h"
+
+extern int terminate_signal;
+
+static int kwipe_throttle_limits( kwipe_context_t* c, int* max, int* pause )
+{
+    /* Works out the temperature at which slowing reaches its limit and the temperature at
+     * which writing pauses. Returns 0 if the drive doesn't report enough to throttle.
+     */
+    if( c->temp1_input == NO_TEMPERATURE_DATA )
+    {
+        return 0;
+    }
+
+    if( c->temp1_max != NO_TEMPERATURE_DATA )
+    {
+        *max = c->temp1_max;
+    }
+    else if( c->temp1_crit != NO_TEMPERATURE_DATA )
+    {
+        *max = c->temp1_crit - NWIPE_THROTTLE_RAMP;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if( c->temp1_crit != NO_TEMPERATURE_DATA && c->temp1_crit - NWIPE_THROTTLE_PAUSE_MARGIN > *max )
+    {
+        *pause = c->temp1_crit - NWIPE_THROTTLE_PAUSE_MARGIN;
+    }
+    else
+    {
+        *pause = *max + NWIPE_THROTTLE_RAMP;
+    }
+
+    return 1;
+}
+
+static void kwipe_throttle_pause( kwipe_context_t* c, int max )
+{
+    /* Waits for the drive to cool below max, or for the wipe to be cancelled. The temperature
+     * threads update c->temp1_input every NWIPE_THROTTLE_TEMP_INTERVAL seconds, the hwmon thread
+     * for SATA drives and the per drive threads for SCSI/SAS drives, see temperature.h.
+     */
+    char pause_time[NWIPE_THROTTLE_TXT_LENGTH];
+    int hours = 0;
+    int minutes;
+    int seconds;
+    u64 event_seen = kwipe_event_generation();
+    u64 start_ns = kwipe_time_ns();
+    u64 paused_ns;
+
+    kwipe_log( NWIPE_LOG_WARNING,
+               "Thermal throttle: %s paused at %iC, critical is %iC, resuming below %iC",
+               c->device_name,
+               c->temp1_input,
+               c->temp1_crit,
+               max );
+    c->throttle_state = NWIPE_THROTTLE_PAUSED;
+
+    while( c->temp1_input >= max && !kwipe_cancel_requested( c ) && terminate_signal != 1 )
+    {
+        event_seen = kwipe_event_wait( event_seen, 1000000000ULL );
+    }
+
+    paused_ns = kwipe_time_ns() - start_ns;
+    c->throttle_ns += paused_ns;
+    c->throttle_debt_ns = 0;
+
+    convert_seconds_to_hours_minutes_seconds( paused_ns / 1000000000ULL, &hours, &minutes, &seconds );
+    snprintf( pause_time, sizeof( pause_time ), "%02i:%02i:%02i", hours, minutes, seconds );
+    kwipe_log(
+        NWIPE_LOG_NOTICE, "Thermal throttle: %s resumed at %iC after %s", c->device_name, c->temp1_input, pause_time );
+}
+
+void kwipe_throttle( kwipe_context_t* c, u64 io_start_ns )
+{
+    struct timespec ts;
+    u64 now_ns;
+    int temperature;
+    int duty;
+    int state;
+    int max;
+    int pause;
+
+    if( !kwipe_throttle_limits( c, &max, &pause ) )
+    {
+        return;
+    }
+
+    /* Read it once, the temperature thread may update it at any time */
+    temperature = c->temp1_input;
+
+    /* Record the highest temperature seen while wiping for the summary */
+    if( c->temp1_monitored_wipe_max == NO_TEMPERATURE_DATA || temperature > c->temp1_monitored_wipe_max )
+    {
+        c->temp1_monitored_wipe_max = temperature;
+    }
+
+    if( temperature >= pause )
+    {
+        kwipe_throttle_pause( c, max );
+        return;
+    }
+
+    if( temperature <= max - NWIPE_THROTTLE_RAMP )
+    {
+        duty = 100;
+    }
+    else if( temperature < max )
+    {
+        /* Linearly from 100% at max - NWIPE_THROTTLE_RAMP down to NWIPE_THROTTLE_MIN_DUTY at max */
+        duty = 100
+               - ( 100 - NWIPE_THROTTLE_MIN_DUTY ) * ( temperature - max + NWIPE_THROTTLE_RAMP ) / NWIPE_THROTTLE_RAMP;
+    }
+    else
+    {
+        duty = NWIPE_THROTTLE_MIN_DUTY;
+    }
+
+    /* Log when the drive starts and stops being slowed down */
+    state = duty < 100 ? NWIPE_THROTTLE_SLOWED : NWIPE_THROTTLE_NONE;
+    if( state != c->throttle_state )
+    {
+        if( state == NWIPE_THROTTLE_SLOWED )
+        {
+            kwipe_log( NWIPE_LOG_NOTICE,
+                       "Thermal throttle: %s slowed to %i%% at %iC, max is %iC",
+                       c->device_name,
+                       duty,
+                       temperature,
+                       max );
+        }
+        else
+        {
+            kwipe_log(
+                NWIPE_LOG_NOTICE, "Thermal throttle: %s back to full speed at %iC", c->device_name, temperature );
+        }
+        c->throttle_state = state;
+    }
+
+    if( duty == 100 )
+    {
+        c->throttle_debt_ns = 0;
+        return;
+    }
+
+    /* Sleep so that the time spent writing is 'duty' percent of the total */
+    now_ns = kwipe_time_ns();
+    c->throttle_debt_ns += ( now_ns - io_start_ns ) * ( 100 - duty ) / duty;
+
+    if( c->throttle_debt_ns >= NWIPE_THROTTLE_MIN_SLEEP_NS )
+    {
+        ts.tv_sec = c->throttle_debt_ns / 1000000000ULL;
+        ts.tv_nsec = c->throttle_debt_ns % 1000000000ULL;
+        nanosleep( &ts, NULL );
+
+        c->throttle_ns += kwipe_time_ns() - now_ns;
+        c->throttle_debt_ns = 0;
+    }
+}
+
+void kwipe_throttle_summary_text( const kwipe_context_t* c, char* text, size_t text_size )
+{
+    int hours = 0;
+    int minutes;
+    int seconds;
+    double percent = 0;
+
+    if( c->throttle_ns == 0 )
+    {
+        snprintf( text, text_size, "none" );
+        return;
+    }
+
+    if( c->duration > 0 )
+    {
+        percent = c->throttle_ns / 1e9 / c->duration * 100.0;
+    }
+
+    convert_seconds_to_hours_minutes_seconds( c->throttle_ns / 1000000000ULL, &hours, &minutes, &seconds );
+    snprintf( text, text_size, "%02i:%02i:%02i (%.1f%%)", hours, minutes, seconds, percent );
+}
@@ -0,0 +1,60 @@
+/*
+ *  throttle.h: Thermal-aware write throttling for kwipe.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef THROTTLE_H_
+#define THROTTLE_H_
+
+#include "context.h"
+
+/* Writes are slowed from NWIPE_THROTTLE_RAMP degrees below temp1_max, down to NWIPE_THROTTLE_MIN_DUTY
+ * percent of the drive's speed at temp1_max. They are paused NWIPE_THROTTLE_PAUSE_MARGIN degrees below
+ * temp1_crit and resume once the drive is back below temp1_max. */
+#define NWIPE_THROTTLE_RAMP 5
+#define NWIPE_THROTTLE_MIN_DUTY 20
+#define NWIPE_THROTTLE_PAUSE_MARGIN 2
+
+/* Delays shorter than this are carried over to the next block rather than slept. */
+#define NWIPE_THROTTLE_MIN_SLEEP_NS 10000000ULL
+
+/* How often the temperatures are read when throttling is enabled, in seconds. */
+#define NWIPE_THROTTLE_TEMP_INTERVAL 5
+
+/* Enough for "hh:mm:ss (100.0%)" */
+#define NWIPE_THROTTLE_TXT_LENGTH 32
+
+/* The throttle states, c->throttle_state */
+#define NWIPE_THROTTLE_NONE 0
+#define NWIPE_THROTTLE_SLOWED 1
+#define NWIPE_THROTTLE_PAUSED 2
+
+/**
+ * Called by the write passes after every block when --thermal-throttle is set. Depending
+ * on the drive's last temperature reading this returns straight away, sleeps long enough to
+ * bring the drive's write rate down to its duty cycle, or pauses until the drive has cooled.
+ * @param c the drive context
+ * @param io_start_ns the time the block's write started, see kwipe_time_ns()
+ */
+void kwipe_throttle( kwipe_context_t* c, u64 io_start_ns );
+
+/**
+ * Formats the time a drive spent throttled as "hh:mm:ss (n.n%)" of the wipe duration,
+ * or "none" if it was never throttled.
+ */
+void kwipe_throttle_summary_text( const kwipe_context_t* c, char* text, size_t text_size );
+
+#endif /* THROTTLE_H_ */
@@ -0,0 +1,94 @@
+/*
+ *  trace.h: Static tracepoints (USDT) in the wipe passes, which bpftrace and perf can attach to
+ *  a running kwipe, see the scripts in trace/.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+/*
+ * The tracepoints are those of sys/sdt.h, from systemtap-sdt-dev or systemtap-sdt-devel. Each is a
+ * single nop and a note in the ELF file until a tracer attaches to it. Without sys/sdt.h, or built
+ * with -DNWIPE_NO_TRACE, they compile to nothing.
+ *
+ * The provider is kwipe, e.g. usdt:/usr/bin/kwipe:kwipe:write in bpftrace. List them with
+ * bpftrace -l 'usdt:/usr/bin/kwipe:*'. Offsets and lengths are in bytes, latencies in nanoseconds,
+ * and results are what the call returned, or the pass's return value for pass_end.
+ *
+ * pass_start( device, pass, round, pass number, device size )
+ * pass_end( device, pass, result, bytes done, errors )
+ *     pass is "random", "random_verify", "static" or "static_verify". errors are the pass errors
+ *     for a write pass and the verify errors for a verification, counted over the whole wipe.
+ * write( device, offset, length, result, latency )
+ * read( device, offset, length, result, latency )
+ * fdatasync( device, result, latency )
+ * sync_range( device, offset, length, result, latency )
+ *     A wait for the write-back of a window of --sync-window.
+ * prng_start( device, length )
+ * prng_done( device, length )
+ *     Around each fill of a block from the PRNG.
+ * verify_mismatch( device, offset, length )
+ *     A block that read back differently from what was written.
+ * temp_poll( device, temperature, latency )
+ *     A poll of the drive's temperature, in degrees Celsius.
+ */
+
+#if !defined( NWIPE_NO_TRACE ) && defined( __has_include )
+#if __has_include( <sys/sdt.h> )
+#include <sys/sdt.h>
+#define NWIPE_TRACE 1
+#endif
+#endif
+
+#ifdef NWIPE_TRACE
+
+#define NWIPE_TRACE_PASS_START( c, pass ) \
+    DTRACE_PROBE5(                        \
+        kwipe, pass_start, ( c )->device_name, pass, ( c )->round_working, ( c )->pass_working, ( c )->device_size )
+#define NWIPE_TRACE_PASS_END( c, pass, result, errors ) \
+    DTRACE_PROBE5( kwipe, pass_end, ( c )->device_name, pass, result, ( c )->progress.pass_done, errors )
+#define NWIPE_TRACE_WRITE( c, offset, length, result, latency ) \
+    DTRACE_PROBE5( kwipe, write, ( c )->device_name, offset, length, result, latency )
+#define NWIPE_TRACE_READ( c, offset, length, result, latency ) \
+    DTRACE_PROBE5( kwipe, read, ( c )->device_name, offset, length, result, latency )
+#define NWIPE_TRACE_FDATASYNC( c, result, latency ) \
+    DTRACE_PROBE3( kwipe, fdatasync, ( c )->device_name, result, latency )
+#define NWIPE_TRACE_SYNC_RANGE( c, offset, length, result, latency ) \
+    DTRACE_PROBE5( kwipe, sync_range, ( c )->device_name, offset, length, result, latency )
+#define NWIPE_TRACE_PRNG_START( c, length ) DTRACE_PROBE2( kwipe, prng_start, ( c )->device_name, length )
+#define NWIPE_TRACE_PRNG_DONE( c, length ) DTRACE_PROBE2( kwipe, prng_done, ( c )->device_name, length )
+#define NWIPE_TRACE_VERIFY_MISMATCH( c, offset, length ) \
+    DTRACE_PROBE3( kwipe, verify_mismatch, ( c )->device_name, offset, length )
+#define NWIPE_TRACE_TEMP_POLL( c, latency ) \
+    DTRACE_PROBE3( kwipe, temp_poll, ( c )->device_name, ( c )->temp1_input, latency )
+
+#else
+
+#define NWIPE_TRACE_PASS_START( c, pass ) ( (void) 0 )
+#define NWIPE_TRACE_PASS_END( c, pass, result, errors ) ( (void) 0 )
+#define NWIPE_TRACE_WRITE( c, offset, length, result, latency ) ( (void) 0 )
+#define NWIPE_TRACE_READ( c, offset, length, result, latency ) ( (void) 0 )
+#define NWIPE_TRACE_FDATASYNC( c, result, latency ) ( (void) 0 )
+#define NWIPE_TRACE_SYNC_RANGE( c, offset, length, result, latency ) ( (void) 0 )
+#define NWIPE_TRACE_PRNG_START( c, length ) ( (void) 0 )
+#define NWIPE_TRACE_PRNG_DONE( c, length ) ( (void) 0 )
+#define NWIPE_TRACE_VERIFY_MISMATCH( c, offset, length ) ( (void) 0 )
+#define NWIPE_TRACE_TEMP_POLL( c, latency ) ( (void) 0 )
+
+#endif /* NWIPE_TRACE */
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,95 @@
+/*
+ *  writeback.c: Windowed write-back with sync_file_range().
+ *
+ *  With --sync the passes call fdatasync() every N writes. That empties the pipeline each
+ *  time, the drive sits idle while the next writes are generated, and between syncs the
+ *  page cache fills with gigabytes of dirty data. With --sync-window=MiB the pass is split
+ *  into windows instead. As each window is completed its write-back is started without
+ *  waiting, sync_file_range( SYNC_FILE_RANGE_WRITE ), and only the window two before it is
+ *  waited on. The drive always has the last window to write while the next is generated,
+ *  and no more than three windows per drive are dirty or in flight at once. The pass still
+ *  ends with an fdatasync() so the wipe is durable.
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <fcntl.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+#include "stats.h"
+#include "latency.h"
+#include "progress.h"
+#include "writeback.h"
+#include "io.h"
+#include "trace.h"
+
+void kwipe_writeback_start_pass( kwipe_context_t* c )
+{
+    c->writeback_done = 0;
+}
+
+int kwipe_writeback( kwipe_context_t* c, u64 done )
+{
+    u64 window = (u64) kwipe_options.sync_window * 1024 * 1024;
+    u64 io_start;
+    u64 io_ns;
+    int r;
+
+    while( done - c->writeback_done >= window )
+    {
+        /* Start writing back the window just completed */
+        r = kwipe_io_sync_file_range( c, c->writeback_done, window, SYNC_FILE_RANGE_WRITE );
+
+        if( r == 0 && c->writeback_done >= 2 * window )
+        {
+            /* Wait for the window two back, it has had the last window's worth of time to be written */
+            kwipe_progress_sync_status( c, 1 );
+
+            io_start = kwipe_time_ns();
+            r = kwipe_io_sync_file_range( c,
+                                          c->writeback_done - 2 * window,
+                                          window,
+                                          SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE
+                                              | SYNC_FILE_RANGE_WAIT_AFTER );
+            io_ns = kwipe_time_ns() - io_start;
+            kwipe_latency_record( &c->latency[NWIPE_LATENCY_SYNC], io_ns );
+            NWIPE_TRACE_SYNC_RANGE( c, c->writeback_done - 2 * window, window, r, io_ns );
+
+            kwipe_progress_sync_status( c, 0 );
+        }
+
+        if( r != 0 )
+        {
+            kwipe_perror( errno, __FUNCTION__, "sync_file_range" );
+            kwipe_log( NWIPE_LOG_WARNING, "Write-back failure on '%s'.", c->device_name );
+            kwipe_log( NWIPE_LOG_WARNING, "Wrote %llu bytes on '%s'.", done, c->device_name );
+            c->fsyncdata_errors++;
+            return -1;
+        }
+
+        c->writeback_done += window;
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+/*
+ *  writeback.h: Windowed write-back with sync_file_range().
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef WRITEBACK_H_
+#define WRITEBACK_H_
+
+#include "context.h"
+
+/**
+ * Called by the write passes before their first write when --sync-window is set.
+ */
+void kwipe_writeback_start_pass( kwipe_context_t* c );
+
+/**
+ * Called by the write passes after every write when --sync-window is set, with the number
+ * of bytes of the pass written so far. Each time a window is completed its write-back is
+ * started, and the window two before it is waited on.
+ * @return 0 on success, -1 if write-back failed, c->fsyncdata_errors has been incremented
+ */
+int kwipe_writeback( kwipe_context_t* c, u64 done );
+
+#endif /* WRITEBACK_H_ */
@@ -33,7 +33,7 @@
 void xoroshiro256_init( xoroshiro256_state_t* state, uint64_t init_key[], unsigned long key_length )
 {
     // Initialization logic; ensure 256 bits are properly seeded
-    for( int i = 0; i < 4; i++ )
+    for( unsigned long i = 0; i < 4; i++ )
     {
         if( i < key_length )
         {
@@ -42,9 +42,15 @@ void xoroshiro256_init( xoroshiro256_state_t* state, uint64_t init_key[], unsign
         else
         {
             // Example fallback for insufficient seeds; consider better seeding strategies
-            state->s[i] = state->s[i - 1] * 6364136223846793005ULL + 1;
+            state->s[i] = ( i > 0 ? state->s[i - 1] : 0 ) * 6364136223846793005ULL + 1;
         }
     }
+
+    // An all zero state would only ever produce zeros
+    if( ( state->s[0] | state->s[1] | state->s[2] | state->s[3] ) == 0 )
+    {
+        state->s[0] = 1;
+    }
 }
 
 static inline uint64_t rotl( const uint64_t x, int k )
@@ -52,7 +58,7 @@ static inline uint64_t rotl( const uint64_t x, int k )
     return ( x << k ) | ( x >> ( 64 - k ) );
 }
 
-void xoroshiro256_genrand_uint256_to_buf( xoroshiro256_state_t* state, unsigned char* bufpos )
+static inline uint64_t xoroshiro256_next( xoroshiro256_state_t* state )
 {
     // This part of the code updates the state using xoroshiro256**'s algorithm.
     const uint64_t result_starstar = rotl( state->s[1] * 5, 7 ) * 9;
@@ -66,9 +72,21 @@ void xoroshiro256_genrand_uint256_to_buf( xoroshiro256_state_t* state, unsigned
     state->s[2] ^= t;
     state->s[3] = rotl( state->s[3], 45 );
 
-    // Note: 'result_starstar' was only used for demonstration purposes and is not part of the
-    // original Xoroshiro256** specification. Here, we write the complete state into the buffer.
-    // Ensure that 'bufpos' has enough storage space (256 bits / 32 bytes).
+    return result_starstar;
+}
+
+void xoroshiro256_genrand_uint256_to_buf( xoroshiro256_state_t* state, unsigned char* bufpos )
+{
+    // Four outputs of xoroshiro256** fill the 256 bits, each written low byte first. The state
+    // itself is never written, the next outputs could be predicted from it.
+    for( int i = 0; i < 4; i++ )
+    {
+        uint64_t result = xoroshiro256_next( state );
 
-    memcpy( bufpos, state->s, 32 );  // Copies the entire 256-bit (32 bytes) state into 'bufpos'
+        for( int j = 0; j < 8; j++ )
+        {
+            bufpos[i * 8 + j] = (unsigned char) ( result & 0xFF );
+            result >>= 8;
+        }
+    }
 }
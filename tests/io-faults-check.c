@@ -0,0 +1,396 @@
+/*
+ *  io-faults-check.c: Tests the handling of I/O errors by the wipe passes, run by make check.
+ *
+ *  Runs kwipe against a sparse file through the memory backend, with EIO, partial transfers,
+ *  failed fdatasyncs and a bad LBA range injected by --io-faults. Each case is run twice with
+ *  the same seed and the pass, verification and fdatasync error counts of the error summary
+ *  in its log are checked to be the same both times and zero or not as expected. A partial
+ *  transfer leaves the rest of its block unwritten or unread, so there are never more
+ *  verification errors than partial transfers. kwipe needs root, without it the test is skipped.
+ *  hdparm isn't needed, kwipe only requires it of the device backend.
+ *
+ *  io-faults-check [--kwipe=PATH] [--verbose]
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/* The exit status that tells automake a test was skipped */
+#define NWIPE_CHECK_SKIP 77
+
+/* The size of the sparse file wiped, the memory backend holds all of it */
+#define NWIPE_CHECK_FILE_SIZE ( 16 * 1024 * 1024 )
+
+#define NWIPE_CHECK_MAX_ARGS 16
+#define NWIPE_CHECK_LINE_LENGTH 4096
+
+/* What a count of the error summary must be */
+typedef enum {
+    NWIPE_CHECK_ZERO = 0,
+    NWIPE_CHECK_NONZERO
+} kwipe_check_count_t;
+
+typedef struct
+{
+    const char* name;
+    const char* method;
+    const char* options;  // One more option for kwipe, --verify or --sync.
+    const char* faults;  // The argument of --io-faults.
+    int fails;  // 1 if kwipe must exit with an error.
+    kwipe_check_count_t pass_errors;
+    kwipe_check_count_t verify_errors;
+    kwipe_check_count_t fsync_errors;
+} kwipe_check_case_t;
+
+static const kwipe_check_case_t kwipe_check_cases[] = {
+    { "no faults",
+      "zero",
+      "--verify=all",
+      "seed=1",
+      0,
+      NWIPE_CHECK_ZERO,
+      NWIPE_CHECK_ZERO,
+      NWIPE_CHECK_ZERO },
+    { "eio",
+      "zero",
+      "--verify=all",
+      "eio=0.005,seed=3",
+      1,
+      NWIPE_CHECK_NONZERO,
+      NWIPE_CHECK_ZERO,
+      NWIPE_CHECK_ZERO },
+    { "partial",
+      "dodshort",
+      "--verify=all",
+      "partial=0.01,seed=7",
+      1,
+      NWIPE_CHECK_NONZERO,
+      NWIPE_CHECK_NONZERO,
+      NWIPE_CHECK_ZERO },
+    { "sync",
+      "zero",
+      "--sync=1",
+      "sync=0.2,seed=5",
+      1,
+      NWIPE_CHECK_NONZERO,
+      NWIPE_CHECK_ZERO,
+      NWIPE_CHECK_NONZERO },
+    { "bad lba",
+      "zero",
+      "--verify=all",
+      "bad=4096-4103,seed=1",
+      1,
+      NWIPE_CHECK_NONZERO,
+      NWIPE_CHECK_ZERO,
+      NWIPE_CHECK_ZERO } };
+
+#define NWIPE_CHECK_CASES ( sizeof( kwipe_check_cases ) / sizeof( kwipe_check_cases[0] ) )
+
+/* What a run of kwipe left in its log */
+typedef struct
+{
+    int status;  // The exit status of kwipe, -1 if it didn't exit normally.
+    unsigned long long pass_errors;
+    unsigned long long verify_errors;
+    unsigned long long fsync_errors;
+    unsigned long long partial;  // The partial transfers injected.
+} kwipe_check_result_t;
+
+static int verbose = 0;
+
+/* Reads the row of the error summary and the count of the faults injected from the log */
+static int kwipe_check_parse_log( const char* log, kwipe_check_result_t* result )
+{
+    char line[NWIPE_CHECK_LINE_LENGTH];
+    unsigned long long eio;
+    int in_summary = 0;
+    int found = 0;
+    char* p;
+    FILE* fp;
+
+    fp = fopen( log, "r" );
+    if( fp == NULL )
+    {
+        return -1;
+    }
+
+    while( fgets( line, sizeof( line ), fp ) != NULL )
+    {
+        if( verbose )
+        {
+            fputs( line, stdout );
+        }
+
+        if( strstr( line, " Error Summary " ) != NULL )
+        {
+            in_summary = 1;
+        }
+        else if( in_summary && strncmp( line, "****", 4 ) == 0 )
+        {
+            in_summary = 0;
+        }
+        else if( in_summary && ( p = strchr( line, '|' ) ) != NULL
+                 && sscanf( p,
+                            "| %llu | %llu | %llu",
+                            &result->pass_errors,
+                            &result->verify_errors,
+                            &result->fsync_errors )
+                     == 3 )
+        {
+            found = 1;
+        }
+
+        p = strstr( line, "Faults injected on " );
+        if( p != NULL && ( p = strstr( p, ": " ) ) != NULL )
+        {
+            sscanf( p, ": %llu EIO, %llu partial transfers", &eio, &result->partial );
+        }
+    }
+
+    fclose( fp );
+    return found ? 0 : -1;
+}
+
+static int kwipe_check_run( const char* kwipe,
+                            const kwipe_check_case_t* t,
+                            const char* target,
+                            const char* log,
+                            kwipe_check_result_t* result )
+{
+    char* argv[NWIPE_CHECK_MAX_ARGS];
+    char method[64];
+    char faults[128];
+    int argc = 0;
+    pid_t pid;
+    int status;
+    int fd;
+
+    snprintf( method, sizeof( method ), "--method=%s", t->method );
+    snprintf( faults, sizeof( faults ), "--io-faults=%s", t->faults );
+
+    argv[argc++] = (char*) kwipe;
+    argv[argc++] = "--nogui";
+    argv[argc++] = "--autonuke";
+    argv[argc++] = "--nowait";
+    argv[argc++] = "--PDFreportpath=noPDF";
+    argv[argc++] = "--io=mem";
+    argv[argc++] = method;
+    argv[argc++] = (char*) t->options;
+    argv[argc++] = faults;
+    argv[argc++] = "--logfile";
+    argv[argc++] = (char*) log;
+    argv[argc++] = (char*) target;
+    argv[argc] = NULL;
+
+    /* kwipe appends to its log */
+    unlink( log );
+    memset( result, 0, sizeof( kwipe_check_result_t ) );
+
+    pid = fork();
+    if( pid < 0 )
+    {
+        fprintf( stderr, "io-faults-check: fork: %s\n", strerror( errno ) );
+        return -1;
+    }
+
+    if( pid == 0 )
+    {
+        fd = open( "/dev/null", O_RDWR );
+        if( fd >= 0 )
+        {
+            dup2( fd, STDIN_FILENO );
+            dup2( fd, STDOUT_FILENO );
+            dup2( fd, STDERR_FILENO );
+        }
+        execv( kwipe, argv );
+        _exit( 127 );
+    }
+
+    while( waitpid( pid, &status, 0 ) < 0 && errno == EINTR )
+    {
+    }
+    result->status = WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+
+    if( kwipe_check_parse_log( log, result ) != 0 )
+    {
+        fprintf( stderr,
+                 "io-faults-check: %s: no error summary in the log, kwipe exited with %i\n",
+                 t->name,
+                 result->status );
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+kwipe_check_count( const char* name, const char* what, unsigned long long count, kwipe_check_count_t expected )
+{
+    if( ( count != 0 ) != ( expected == NWIPE_CHECK_NONZERO ) )
+    {
+        printf( "  %s: %llu %s, expected %s\n", name, count, what, expected == NWIPE_CHECK_ZERO ? "none" : "some" );
+        return 1;
+    }
+    return 0;
+}
+
+static int kwipe_check_case( const char* kwipe, const kwipe_check_case_t* t, const char* target, const char* log )
+{
+    kwipe_check_result_t first;
+    kwipe_check_result_t second;
+    int f = 0;
+
+    if( kwipe_check_run( kwipe, t, target, log, &first ) != 0
+        || kwipe_check_run( kwipe, t, target, log, &second ) != 0 )
+    {
+        return 1;
+    }
+
+    printf( "  %-10s pass %llu, verify %llu, fdatasync %llu errors, %llu partial transfers\n",
+            t->name,
+            first.pass_errors,
+            first.verify_errors,
+            first.fsync_errors,
+            first.partial );
+
+    if( first.status != second.status || first.pass_errors != second.pass_errors
+        || first.verify_errors != second.verify_errors || first.fsync_errors != second.fsync_errors
+        || first.partial != second.partial )
+    {
+        printf( "  %s: the second run with the same seed differs, pass %llu, verify %llu, fdatasync %llu errors\n",
+                t->name,
+                second.pass_errors,
+                second.verify_errors,
+                second.fsync_errors );
+        f++;
+    }
+
+    if( ( first.status != 0 ) != t->fails )
+    {
+        printf( "  %s: kwipe exited with %i\n", t->name, first.status );
+        f++;
+    }
+
+    f += kwipe_check_count( t->name, "pass errors", first.pass_errors, t->pass_errors );
+    f += kwipe_check_count( t->name, "verification errors", first.verify_errors, t->verify_errors );
+    f += kwipe_check_count( t->name, "fdatasync errors", first.fsync_errors, t->fsync_errors );
+
+    if( first.verify_errors > first.partial && t->verify_errors == NWIPE_CHECK_NONZERO )
+    {
+        printf( "  %s: %llu verification errors from %llu partial transfers, the blocks were compared at the wrong "
+                "offset\n",
+                t->name,
+                first.verify_errors,
+                first.partial );
+        f++;
+    }
+
+    return f;
+}
+
+static void usage( void )
+{
+    printf( "Usage: io-faults-check [--kwipe=PATH] [--verbose]\n" );
+    printf( "  --kwipe=PATH  The kwipe to test (default KWIPE_CHECK_KWIPE or ../src/kwipe)\n" );
+    printf( "  --verbose     Show the logs of kwipe\n" );
+}
+
+int main( int argc, char** argv )
+{
+    const char* kwipe = "../src/kwipe";
+    const char* tmp;
+    char directory[PATH_MAX];
+    char target[PATH_MAX + 16];
+    char log[PATH_MAX + 16];
+    int failures = 0;
+    int fd;
+
+    if( getenv( "KWIPE_CHECK_KWIPE" ) != NULL )
+    {
+        kwipe = getenv( "KWIPE_CHECK_KWIPE" );
+    }
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strncmp( argv[i], "--kwipe=", 8 ) == 0 )
+        {
+            kwipe = argv[i] + 8;
+        }
+        else if( strcmp( argv[i], "--verbose" ) == 0 )
+        {
+            verbose = 1;
+        }
+        else
+        {
+            usage();
+            return strcmp( argv[i], "--help" ) == 0 ? 0 : 2;
+        }
+    }
+
+    if( geteuid() != 0 )
+    {
+        printf( "io-faults-check: skipped, kwipe must run as root\n" );
+        return NWIPE_CHECK_SKIP;
+    }
+
+    /* The faults of a drive depend on its name, so it is always called img */
+    tmp = getenv( "TMPDIR" ) != NULL ? getenv( "TMPDIR" ) : "/tmp";
+    snprintf( directory, sizeof( directory ), "%s/io-faults-check.XXXXXX", tmp );
+    if( mkdtemp( directory ) == NULL )
+    {
+        fprintf( stderr, "io-faults-check: Unable to create a directory in %s: %s\n", tmp, strerror( errno ) );
+        return 2;
+    }
+    snprintf( target, sizeof( target ), "%s/img", directory );
+    snprintf( log, sizeof( log ), "%s/kwipe.log", directory );
+
+    fd = open( target, O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+    if( fd < 0 || ftruncate( fd, NWIPE_CHECK_FILE_SIZE ) != 0 )
+    {
+        fprintf( stderr, "io-faults-check: Unable to create %s: %s\n", target, strerror( errno ) );
+        failures++;
+    }
+    else
+    {
+        for( size_t i = 0; i < NWIPE_CHECK_CASES; i++ )
+        {
+            failures += kwipe_check_case( kwipe, &kwipe_check_cases[i], target, log );
+        }
+    }
+    if( fd >= 0 )
+    {
+        close( fd );
+    }
+
+    unlink( target );
+    unlink( log );
+    rmdir( directory );
+
+    printf( "  %s\n", failures ? "FAILED" : "passed" );
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,718 @@
+/*
+ *  prng-check.c: Tests the pseudo random number generators of kwipe, run by make check.
+ *
+ *  Each generator is checked against known answers, the first from the reference implementation of its
+ *  algorithm where there is one, then its stream is read in one call, a value at a time and in odd sized
+ *  pieces and the bytes compared, the AES-256-CTR stream also with the AES instructions of the CPU turned
+ *  off. Last a battery of statistical tests is run on PRNG_CHECK_MIB mebibytes (default 512) of its stream
+ *  and the throughput of the generator is reported.
+ *
+ *  prng-check [--mib=N] [--prng=NAME] [--verbose]
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdarg.h>
+#include <sys/wait.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "prng.h"
+#include "options.h"
+#include "logging.h"
+
+extern kwipe_prng_t kwipe_twister;
+extern kwipe_prng_t kwipe_isaac;
+extern kwipe_prng_t kwipe_isaac64;
+extern kwipe_prng_t kwipe_add_lagg_fibonacci_prng;
+extern kwipe_prng_t kwipe_xoroshiro256_prng;
+extern kwipe_prng_t kwipe_aes_ctr_prng;
+
+/* The size of the reads of the statistical tests and of the comparisons of the ways of reading a stream */
+#define NWIPE_CHECK_BLOCK ( 1024 * 1024 )
+
+/* A statistic further than this many standard deviations from its expected value fails */
+#define NWIPE_CHECK_MAX_Z 6.0
+
+/* The CPU capabilities OpenSSL is told about to make it use its AES without AES-NI */
+#define NWIPE_CHECK_NO_AESNI "~0x200000200000000"
+
+typedef struct
+{
+    const char* name;  // The name given to --prng.
+    kwipe_prng_t* prng;
+    size_t word;  // The bytes each value of the generator fills, SIZE_OF_*.
+} kwipe_check_prng_t;
+
+static const kwipe_check_prng_t kwipe_check_prngs[] = {
+    { "twister", &kwipe_twister, SIZE_OF_TWISTER },
+    { "isaac", &kwipe_isaac, SIZE_OF_ISAAC },
+    { "isaac64", &kwipe_isaac64, SIZE_OF_ISAAC64 },
+    { "add_lagg_fibonacci_prng", &kwipe_add_lagg_fibonacci_prng, SIZE_OF_ADD_LAGG_FIBONACCI_PRNG },
+    { "xoroshiro256_prng", &kwipe_xoroshiro256_prng, SIZE_OF_XOROSHIRO256_PRNG },
+    { "aes_ctr_prng", &kwipe_aes_ctr_prng, SIZE_OF_AES_CTR_PRNG } };
+
+#define NWIPE_CHECK_PRNGS ( sizeof( kwipe_check_prngs ) / sizeof( kwipe_check_prngs[0] ) )
+
+/* The seeds of the known answers */
+typedef enum {
+    NWIPE_CHECK_SEED_ZERO = 0,  // Zero bytes, the seed of the reference ISAAC vectors.
+    NWIPE_CHECK_SEED_COUNT,  // The bytes 0, 1, 2, ... 255, 0, 1, ...
+    NWIPE_CHECK_SEED_MT,  // The unsigned longs 0x123, 0x234, 0x345, 0x456 of mt19937ar.out.
+    NWIPE_CHECK_SEED_XOSHIRO  // The words 1, 2, 3, 4.
+} kwipe_check_seed_t;
+
+typedef struct
+{
+    const char* name;  // The name of the generator.
+    kwipe_check_seed_t seed;
+    size_t seed_length;  // The length of the seed in bytes, 0 for that of the kind of seed.
+    size_t offset;  // The offset in the stream of the expected bytes.
+    const char* expected;  // The expected bytes in hex.
+    const char* source;  // Where the expected bytes come from.
+} kwipe_check_vector_t;
+
+/* The 32 and 64 bit values are written low byte first, ISAAC returns each block of results last first. */
+static const kwipe_check_vector_t kwipe_check_vectors[] = {
+    { "twister",
+      NWIPE_CHECK_SEED_MT,
+      0,
+      0,
+      "2336a23f5f93fa3838dc721c5f2fcff45c0f11fc",
+      "mt19937ar.out, the first five outputs of genrand_int32()" },
+    { "twister", NWIPE_CHECK_SEED_MT, 0, 3996, "2ecd3bce", "mt19937ar.out, the thousandth output" },
+    { "isaac",
+      NWIPE_CHECK_SEED_ZERO,
+      1024,
+      2016,
+      "9a4fca46870437d84a15ecedfb1a3f434fd5faf5b42fdb986de948e4c8e450f6",
+      "randvect.txt, the first eight values" },
+    { "isaac64",
+      NWIPE_CHECK_SEED_ZERO,
+      2048,
+      4064,
+      "efb4b1e422e5455b361a0995393b9cb43144f126d50a49d4c21894af16f2a812",
+      "randvect64.txt, the first four values" },
+    { "xoroshiro256_prng",
+      NWIPE_CHECK_SEED_XOSHIRO,
+      0,
+      0,
+      "002d00000000000000000000000000008070005a00000000809d00000000e010"
+      "809d00e11cb6e01000ad43e11c02700889f043e1c2c371e08003a2f70e69a175",
+      "xoshiro256starstar.c, the first eight outputs from the state 1, 2, 3, 4" },
+    { "add_lagg_fibonacci_prng",
+      NWIPE_CHECK_SEED_COUNT,
+      512,
+      0,
+      "898a8c8e90929496989a9c9ea0a2a4a6a8aaacaeb0b2b4b6b8babcbec0c2c4c6",
+      "s[n] = s[n - 55] + s[n - 24] mod 2^64, the first four values" },
+    { "add_lagg_fibonacci_prng",
+      NWIPE_CHECK_SEED_COUNT,
+      512,
+      32736,
+      "852569199873861a825bca7d08a060a903f00baafb9c57ef2b973c172f98c12e",
+      "s[n] = s[n - 55] + s[n - 24] mod 2^64, the values 4092 to 4095" },
+    { "aes_ctr_prng",
+      NWIPE_CHECK_SEED_COUNT,
+      32,
+      0,
+      "a73d5fb0e4041090ca6dc1b820cdaf51d2f09f009cd13a969e109c2745284714"
+      "9a484fe6e260a3f591864bb5d6a8d051b3793286e17bdb7db799b2d8c370cad5",
+      "openssl enc -aes-256-ctr of zeros with the SHA-256 of the seed as key and a zero IV" },
+    { "aes_ctr_prng",
+      NWIPE_CHECK_SEED_COUNT,
+      32,
+      1048544,
+      "58aa77352e80aadf8889a7634cf8fc9783359c84a7d1a34b5bedf10cb651e3b7",
+      "openssl enc -aes-256-ctr, the last 32 bytes of the first MiB" } };
+
+#define NWIPE_CHECK_VECTORS ( sizeof( kwipe_check_vectors ) / sizeof( kwipe_check_vectors[0] ) )
+
+/* The counts the statistical tests are calculated from */
+typedef struct
+{
+    u64 bytes;  // The bytes counted.
+    u64 ones;  // The bits set.
+    u64 transitions;  // The bits that differ from the bit before them, the runs less one.
+    u64 last_bit;  // The last bit of the previous block.
+    u64 byte_count[256];  // How often each byte value occurs.
+    u64* pair_count;  // How often each value of the non-overlapping pairs of bytes occurs, 65536 counts.
+    u64 sum_xy;  // The sum of the products of each byte and the byte after it.
+    u64 sum_x;  // The sum of the bytes.
+    u64 sum_x2;  // The sum of the squares of the bytes.
+    u8 first;  // The first byte, which follows the last one in the serial correlation.
+    u8 last;  // The last byte of the previous block.
+} kwipe_check_stats_t;
+
+static int verbose = 0;
+
+/* The generators use the log of kwipe, only shown with --verbose */
+void kwipe_log( kwipe_log_t level, const char* format, ... )
+{
+    va_list ap;
+
+    if( !verbose && level != NWIPE_LOG_FATAL && level != NWIPE_LOG_SANITY )
+    {
+        return;
+    }
+
+    va_start( ap, format );
+    vfprintf( stderr, format, ap );
+    va_end( ap );
+    fputc( '\n', stderr );
+}
+
+void kwipe_perror( int kwipe_errno, const char* f, const char* s )
+{
+    fprintf( stderr, "%s: %s: %s\n", f, s, strerror( kwipe_errno ) );
+}
+
+static double kwipe_check_seconds( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Prints the result of a test, returns 1 if it failed */
+static int kwipe_check_result( const char* test, int failed, const char* format, ... )
+{
+    va_list ap;
+
+    printf( "  %-15s ", test );
+    va_start( ap, format );
+    vprintf( format, ap );
+    va_end( ap );
+    printf( "%s\n", failed ? "  FAIL" : "" );
+    return failed;
+}
+
+static const kwipe_check_prng_t* kwipe_check_find( const char* name )
+{
+    for( size_t i = 0; i < NWIPE_CHECK_PRNGS; i++ )
+    {
+        if( strcmp( kwipe_check_prngs[i].name, name ) == 0 )
+        {
+            return &kwipe_check_prngs[i];
+        }
+    }
+    return NULL;
+}
+
+/* Makes a seed of the given kind, the caller frees seed->s */
+static void kwipe_check_seed( kwipe_entropy_t* seed, kwipe_check_seed_t kind, size_t length )
+{
+    static const unsigned long mt[4] = { 0x123, 0x234, 0x345, 0x456 };
+    static const uint64_t xoshiro[4] = { 1, 2, 3, 4 };
+
+    switch( kind )
+    {
+        case NWIPE_CHECK_SEED_MT:
+            length = sizeof( mt );
+            break;
+        case NWIPE_CHECK_SEED_XOSHIRO:
+            length = sizeof( xoshiro );
+            break;
+        default:
+            break;
+    }
+
+    seed->length = length;
+    seed->s = calloc( 1, length );
+    if( seed->s == NULL )
+    {
+        fprintf( stderr, "prng-check: out of memory\n" );
+        exit( 2 );
+    }
+
+    switch( kind )
+    {
+        case NWIPE_CHECK_SEED_COUNT:
+            for( size_t i = 0; i < length; i++ )
+            {
+                seed->s[i] = (u8) i;
+            }
+            break;
+        case NWIPE_CHECK_SEED_MT:
+            memcpy( seed->s, mt, length );
+            break;
+        case NWIPE_CHECK_SEED_XOSHIRO:
+            memcpy( seed->s, xoshiro, length );
+            break;
+        default:
+            break;
+    }
+}
+
+/* Initialises a generator with a seed of the given kind, exits if it fails */
+static void* kwipe_check_init( const kwipe_check_prng_t* p, kwipe_check_seed_t kind, size_t length )
+{
+    kwipe_entropy_t seed;
+    void* state = NULL;
+
+    kwipe_check_seed( &seed, kind, length );
+    if( p->prng->init( &state, &seed ) != 0 )
+    {
+        fprintf( stderr, "prng-check: %s failed to initialise\n", p->name );
+        exit( 2 );
+    }
+    free( seed.s );
+    return state;
+}
+
+static void kwipe_check_read( const kwipe_check_prng_t* p, void** state, void* buffer, size_t count )
+{
+    if( p->prng->read( state, buffer, count ) != 0 )
+    {
+        fprintf( stderr, "prng-check: %s failed to generate\n", p->name );
+        exit( 2 );
+    }
+}
+
+/* Compares the stream of a generator with its known answers, returns the number of failures */
+static int kwipe_check_vectors_of( const kwipe_check_prng_t* p )
+{
+    int failures = 0;
+
+    for( size_t i = 0; i < NWIPE_CHECK_VECTORS; i++ )
+    {
+        const kwipe_check_vector_t* v = &kwipe_check_vectors[i];
+        size_t length = strlen( v->expected ) / 2;
+        char hex[sizeof( "00" )];
+
+        if( strcmp( v->name, p->name ) != 0 )
+        {
+            continue;
+        }
+
+        void* state = kwipe_check_init( p, v->seed, v->seed_length );
+        u8* stream = malloc( v->offset + length );
+        kwipe_check_read( p, &state, stream, v->offset + length );
+
+        int match = 1;
+        for( size_t j = 0; j < length; j++ )
+        {
+            snprintf( hex, sizeof( hex ), "%02x", stream[v->offset + j] );
+            if( memcmp( hex, v->expected + j * 2, 2 ) != 0 )
+            {
+                match = 0;
+            }
+        }
+
+        kwipe_check_result( "known answer", !match, "%s, at byte %zu", v->source, v->offset );
+        if( !match )
+        {
+            printf( "    expected %s\n    got      ", v->expected );
+            for( size_t j = 0; j < length; j++ )
+            {
+                printf( "%02x", stream[v->offset + j] );
+            }
+            printf( "\n" );
+            failures++;
+        }
+
+        free( stream );
+        free( state );
+    }
+
+    return failures;
+}
+
+/* Writes NWIPE_CHECK_BLOCK bytes of the stream of a generator from the counting seed to stdout, for
+ * kwipe_check_generic_aes() */
+static int kwipe_check_stream( const kwipe_check_prng_t* p )
+{
+    void* state = kwipe_check_init( p, NWIPE_CHECK_SEED_COUNT, NWIPE_KNOB_PRNG_STATE_LENGTH );
+    u8* buffer = malloc( NWIPE_CHECK_BLOCK );
+
+    kwipe_check_read( p, &state, buffer, NWIPE_CHECK_BLOCK );
+    if( fwrite( buffer, 1, NWIPE_CHECK_BLOCK, stdout ) != NWIPE_CHECK_BLOCK )
+    {
+        return 2;
+    }
+    return 0;
+}
+
+/* Runs this program with OpenSSL told the CPU has no AES instructions, and reads the stream it writes
+ * with --stream, returns 0 on success */
+static int kwipe_check_generic_aes( const kwipe_check_prng_t* p, u8* buffer )
+{
+    int fds[2];
+    size_t got = 0;
+    int status;
+
+    if( pipe( fds ) != 0 )
+    {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if( pid < 0 )
+    {
+        return -1;
+    }
+    if( pid == 0 )
+    {
+        char option[64];
+
+        dup2( fds[1], STDOUT_FILENO );
+        close( fds[0] );
+        close( fds[1] );
+        setenv( "OPENSSL_ia32cap", NWIPE_CHECK_NO_AESNI, 1 );
+        snprintf( option, sizeof( option ), "--stream=%s", p->name );
+        execl( "/proc/self/exe", "prng-check", option, (char*) NULL );
+        _exit( 127 );
+    }
+
+    close( fds[1] );
+    while( got < NWIPE_CHECK_BLOCK )
+    {
+        ssize_t r = read( fds[0], buffer + got, NWIPE_CHECK_BLOCK - got );
+        if( r <= 0 )
+        {
+            break;
+        }
+        got += (size_t) r;
+    }
+    close( fds[0] );
+
+    if( waitpid( pid, &status, 0 ) != pid || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0
+        || got != NWIPE_CHECK_BLOCK )
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/* Checks that the stream of a generator is the same however it is read, returns the number of failures.
+ * Reads that aren't a multiple of the generator's value drop the rest of the last value. */
+static int kwipe_check_equivalence( const kwipe_check_prng_t* p )
+{
+    u8* bulk = malloc( NWIPE_CHECK_BLOCK );
+    u8* other = malloc( NWIPE_CHECK_BLOCK );
+    void* state;
+    int failures = 0;
+
+    /* The whole block in one read, as the passes read it */
+    state = kwipe_check_init( p, NWIPE_CHECK_SEED_COUNT, NWIPE_KNOB_PRNG_STATE_LENGTH );
+    kwipe_check_read( p, &state, bulk, NWIPE_CHECK_BLOCK );
+    free( state );
+
+    /* A value at a time */
+    state = kwipe_check_init( p, NWIPE_CHECK_SEED_COUNT, NWIPE_KNOB_PRNG_STATE_LENGTH );
+    for( size_t offset = 0; offset < NWIPE_CHECK_BLOCK; offset += p->word )
+    {
+        kwipe_check_read( p, &state, other + offset, p->word );
+    }
+    free( state );
+
+    int match = memcmp( bulk, other, NWIPE_CHECK_BLOCK ) == 0;
+    failures += kwipe_check_result(
+        "same stream", !match, "one %d byte read and %zu byte reads", NWIPE_CHECK_BLOCK, p->word );
+
+    /* Five values and three bytes at a time, the three bytes being the start of the sixth value */
+    size_t piece = p->word * 5 + 3;
+    state = kwipe_check_init( p, NWIPE_CHECK_SEED_COUNT, NWIPE_KNOB_PRNG_STATE_LENGTH );
+    match = 1;
+    for( size_t offset = 0; offset + p->word * 6 <= NWIPE_CHECK_BLOCK; offset += p->word * 6 )
+    {
+        kwipe_check_read( p, &state, other, piece );
+        if( memcmp( bulk + offset, other, piece ) != 0 )
+        {
+            match = 0;
+            break;
+        }
+    }
+    free( state );
+    failures += kwipe_check_result(
+        "same stream", !match, "one %d byte read and %zu byte reads", NWIPE_CHECK_BLOCK, piece );
+
+    /* OpenSSL picks the fastest AES it has, the generic C one must give the same bytes */
+    if( p->prng == &kwipe_aes_ctr_prng )
+    {
+        if( kwipe_check_generic_aes( p, other ) != 0 )
+        {
+            failures += kwipe_check_result(
+                "same stream", 1, "couldn't run with OPENSSL_ia32cap=%s", NWIPE_CHECK_NO_AESNI );
+        }
+        else
+        {
+            match = memcmp( bulk, other, NWIPE_CHECK_BLOCK ) == 0;
+            failures += kwipe_check_result( "same stream", !match, "with and without AES-NI" );
+        }
+    }
+
+    free( bulk );
+    free( other );
+    return failures;
+}
+
+/* Adds a block of the stream to the counts of the statistical tests, its length a multiple of 8 */
+static void kwipe_check_count( kwipe_check_stats_t* s, const u8* buffer, size_t length )
+{
+    u64 sum_xy = 0;
+    u64 sum_x = 0;
+    u64 sum_x2 = 0;
+    u8 previous = s->last;
+
+    if( s->bytes == 0 )
+    {
+        s->first = buffer[0];
+    }
+    else
+    {
+        sum_xy += (u64) previous * buffer[0];
+    }
+
+    for( size_t i = 0; i < length; i += 8 )
+    {
+        /* The bits are taken from the least significant of the first byte on */
+        u64 w = 0;
+        for( int j = 7; j >= 0; j-- )
+        {
+            w = ( w << 8 ) | buffer[i + j];
+        }
+        s->ones += (u64) __builtin_popcountll( w );
+        s->transitions += (u64) __builtin_popcountll( ( w ^ ( w >> 1 ) ) & 0x7FFFFFFFFFFFFFFFULL );
+        if( s->bytes + i > 0 )
+        {
+            s->transitions += ( s->last_bit ^ w ) & 1;
+        }
+        s->last_bit = w >> 63;
+
+        for( int j = 0; j < 8; j += 2 )
+        {
+            u8 x = buffer[i + j];
+            u8 y = buffer[i + j + 1];
+
+            s->byte_count[x]++;
+            s->byte_count[y]++;
+            s->pair_count[( x << 8 ) | y]++;
+            sum_x += (u64) x + y;
+            sum_x2 += (u64) x * x + (u64) y * y;
+            sum_xy += (u64) x * y;
+            if( i + j + 2 < length )
+            {
+                sum_xy += (u64) y * buffer[i + j + 2];
+            }
+        }
+    }
+
+    s->last = buffer[length - 1];
+    s->bytes += length;
+    s->sum_xy += sum_xy;
+    s->sum_x += sum_x;
+    s->sum_x2 += sum_x2;
+}
+
+/* The number of standard deviations a chi-square statistic is above its mean, by Wilson and Hilferty */
+static double kwipe_check_chi2_z( double chi2, double dof )
+{
+    double v = 2.0 / ( 9.0 * dof );
+    return ( cbrt( chi2 / dof ) - ( 1.0 - v ) ) / sqrt( v );
+}
+
+static double kwipe_check_chi2( const u64* count, size_t values, u64 total )
+{
+    double expected = (double) total / (double) values;
+    double chi2 = 0;
+
+    for( size_t i = 0; i < values; i++ )
+    {
+        double d = (double) count[i] - expected;
+        chi2 += d * d / expected;
+    }
+    return chi2;
+}
+
+static double kwipe_check_entropy( const u64* count, size_t values, u64 total )
+{
+    double h = 0;
+
+    for( size_t i = 0; i < values; i++ )
+    {
+        if( count[i] > 0 )
+        {
+            double p = (double) count[i] / (double) total;
+            h -= p * log2( p );
+        }
+    }
+    return h;
+}
+
+/* Runs the statistical tests on mib MiB of the stream of a generator, returns the number of failures */
+static int kwipe_check_battery( const kwipe_check_prng_t* p, size_t mib )
+{
+    kwipe_check_stats_t s;
+    u8* buffer = malloc( NWIPE_CHECK_BLOCK );
+    double seconds = 0;
+    int failures = 0;
+
+    memset( &s, 0, sizeof( s ) );
+    s.pair_count = calloc( 65536, sizeof( u64 ) );
+    if( buffer == NULL || s.pair_count == NULL )
+    {
+        fprintf( stderr, "prng-check: out of memory\n" );
+        exit( 2 );
+    }
+
+    void* state = kwipe_check_init( p, NWIPE_CHECK_SEED_COUNT, NWIPE_KNOB_PRNG_STATE_LENGTH );
+    for( size_t i = 0; i < mib; i++ )
+    {
+        double start = kwipe_check_seconds();
+        kwipe_check_read( p, &state, buffer, NWIPE_CHECK_BLOCK );
+        seconds += kwipe_check_seconds() - start;
+        kwipe_check_count( &s, buffer, NWIPE_CHECK_BLOCK );
+    }
+    free( state );
+    free( buffer );
+
+    /* The serial correlation wraps around, the last byte is followed by the first */
+    s.sum_xy += (u64) s.last * s.first;
+
+    double n = (double) s.bytes;
+    double bits = n * 8;
+
+    /* Frequency: the proportion of ones and of each byte value */
+    double z = ( (double) s.ones - bits / 2 ) / sqrt( bits / 4 );
+    failures += kwipe_check_result(
+        "monobit", fabs( z ) > NWIPE_CHECK_MAX_Z, "%.6f of the bits set, z = %+.2f", (double) s.ones / bits, z );
+
+    double chi2 = kwipe_check_chi2( s.byte_count, 256, s.bytes );
+    z = kwipe_check_chi2_z( chi2, 255 );
+    failures += kwipe_check_result( "byte frequency",
+                                    fabs( z ) > NWIPE_CHECK_MAX_Z,
+                                    "chi-square %.1f for 255 degrees of freedom, z = %+.2f",
+                                    chi2,
+                                    z );
+
+    /* Runs: a bit differs from the one before it half the time */
+    double pairs = bits - 1;
+    z = ( (double) s.transitions - pairs / 2 ) / sqrt( pairs / 4 );
+    failures += kwipe_check_result(
+        "runs", fabs( z ) > NWIPE_CHECK_MAX_Z, "%.0f runs of bits, z = %+.2f", (double) s.transitions + 1, z );
+
+    /* Serial correlation of each byte with the next, as ent(1) calculates it */
+    double scc = ( n * (double) s.sum_xy - (double) s.sum_x * (double) s.sum_x )
+        / ( n * (double) s.sum_x2 - (double) s.sum_x * (double) s.sum_x );
+    z = scc * sqrt( n );
+    failures += kwipe_check_result(
+        "serial corr.", fabs( z ) > NWIPE_CHECK_MAX_Z, "coefficient %+.8f, z = %+.2f", scc, z );
+
+    /* Compressibility: what a compressor using the frequencies of the bytes or of the pairs of bytes could
+     * save. Even a perfect generator falls short of 8 bits per byte by chance, by (values - 1) / (2 n ln 2)
+     * bits per symbol, which is what four times is allowed for. */
+    double h1 = kwipe_check_entropy( s.byte_count, 256, s.bytes );
+    double h2 = kwipe_check_entropy( s.pair_count, 65536, s.bytes / 2 ) / 2;
+    double chance = 65535.0 / ( 2 * ( n / 2 ) * log( 2 ) ) / 2;
+    double saving = ( 8 - ( h1 < h2 ? h1 : h2 ) ) / 8 * 100;
+    chi2 = kwipe_check_chi2( s.pair_count, 65536, s.bytes / 2 );
+    z = kwipe_check_chi2_z( chi2, 65535 );
+    failures += kwipe_check_result( "compressible",
+                                    8 - h1 > 4 * 255.0 / ( 2 * n * log( 2 ) ) || 8 - h2 > 4 * chance,
+                                    "%.6f bits per byte, %.6f per byte in pairs, %.5f%% saving",
+                                    h1,
+                                    h2,
+                                    saving );
+    failures += kwipe_check_result( "pair frequency",
+                                    fabs( z ) > NWIPE_CHECK_MAX_Z,
+                                    "chi-square %.1f for 65535 degrees of freedom, z = %+.2f",
+                                    chi2,
+                                    z );
+
+    printf( "  %-15s %.0f MB/s generating %zu MiB\n", "throughput", n / seconds / 1e6, mib );
+
+    free( s.pair_count );
+    return failures;
+}
+
+static void usage( void )
+{
+    printf( "Usage: prng-check [--mib=N] [--prng=NAME] [--verbose]\n" );
+    printf( "  --mib=N      The MiB of each stream the statistical tests read (default PRNG_CHECK_MIB or 512)\n" );
+    printf( "  --prng=NAME  Check only this generator, twister, isaac, isaac64, add_lagg_fibonacci_prng,\n" );
+    printf( "               xoroshiro256_prng or aes_ctr_prng\n" );
+    printf( "  --verbose    Show what the generators log\n" );
+}
+
+int main( int argc, char** argv )
+{
+    const kwipe_check_prng_t* only = NULL;
+    size_t mib = 512;
+    int failures = 0;
+
+    if( getenv( "PRNG_CHECK_MIB" ) != NULL )
+    {
+        mib = strtoul( getenv( "PRNG_CHECK_MIB" ), NULL, 10 );
+    }
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strncmp( argv[i], "--mib=", 6 ) == 0 )
+        {
+            mib = strtoul( argv[i] + 6, NULL, 10 );
+        }
+        else if( strncmp( argv[i], "--prng=", 7 ) == 0 )
+        {
+            only = kwipe_check_find( argv[i] + 7 );
+            if( only == NULL )
+            {
+                fprintf( stderr, "prng-check: unknown generator %s\n", argv[i] + 7 );
+                return 2;
+            }
+        }
+        else if( strncmp( argv[i], "--stream=", 9 ) == 0 && kwipe_check_find( argv[i] + 9 ) != NULL )
+        {
+            return kwipe_check_stream( kwipe_check_find( argv[i] + 9 ) );
+        }
+        else if( strcmp( argv[i], "--verbose" ) == 0 )
+        {
+            verbose = 1;
+        }
+        else
+        {
+            usage();
+            return strcmp( argv[i], "--help" ) == 0 ? 0 : 2;
+        }
+    }
+
+    if( mib == 0 )
+    {
+        fprintf( stderr, "prng-check: --mib must be at least 1\n" );
+        return 2;
+    }
+
+    for( size_t i = 0; i < NWIPE_CHECK_PRNGS; i++ )
+    {
+        const kwipe_check_prng_t* p = &kwipe_check_prngs[i];
+        int f = 0;
+
+        if( only != NULL && only != p )
+        {
+            continue;
+        }
+
+        printf( "%s (%s)\n", p->name, p->prng->label );
+        f += kwipe_check_vectors_of( p );
+        f += kwipe_check_equivalence( p );
+        f += kwipe_check_battery( p, mib );
+        printf( "  %s\n\n", f ? "FAILED" : "passed" );
+        failures += f;
+    }
+
+    return failures ? 1 : 0;
+}
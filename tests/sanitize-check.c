@@ -0,0 +1,447 @@
+/*
+ *  sanitize-check.c: Tests the ATA sanitize method against a simulated drive, run by make check.
+ *
+ *  The commands of sanitize.c are sent through kwipe_sanitize_set_ops() to a drive simulated
+ *  here, which answers MODE SENSE and MODE SELECT of the Control mode page, IDENTIFY DEVICE and
+ *  SANITIZE sent as ATA PASS-THROUGH (16), returning the registers in fixed or descriptor format
+ *  sense data as its D_SENSE bit says, as libata does. Each case checks whether the sanitize
+ *  operation is started and how kwipe_sanitize() ends: a drive sanitized before must not be taken
+ *  for a frozen one, a finished operation must not be polled as running, and the upper byte of
+ *  the count, which fixed format sense data doesn't hold, must never be guessed.
+ *
+ *  sanitize-check [--verbose]
+ *
+ *  This program is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free Software
+ *  Foundation, version 2.
+ *
+ *  This program is distributed in the hope that it will be useful, but WITHOUT
+ *  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along with
+ *  this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include <stdarg.h>
+#include <signal.h>
+#include <time.h>
+
+#include "kwipe.h"
+#include "context.h"
+#include "method.h"
+#include "options.h"
+#include "logging.h"
+#include "io.h"
+#include "sanitize.h"
+
+/* The bits of the SANITIZE STATUS EXT count, in its upper byte */
+#define NWIPE_CHECK_COMPLETED 0x8000
+#define NWIPE_CHECK_IN_PROGRESS 0x4000
+#define NWIPE_CHECK_FROZEN 0x2000
+
+/* A case that hasn't ended by then hangs polling a sanitize that has finished */
+#define NWIPE_CHECK_TIMEOUT_S 60
+
+/* The most SANITIZE STATUS EXT a case may take */
+#define NWIPE_CHECK_MAX_STATUS_READS 16
+
+typedef struct
+{
+    const char* name;
+    int d_sense;  // D_SENSE of the Control mode page when the case starts.
+    int d_sense_settable;  // 0 if MODE SELECT of the Control mode page is refused.
+    int d_sense_ignored;  // 1 if the sense data stays in fixed format whatever D_SENSE says.
+    unsigned int status;  // The sanitize status bits when the case starts.
+    int polls;  // The status reads a started operation takes to complete.
+    int result;  // What kwipe_sanitize() must return.
+    int started;  // The sanitize operations that must have been started.
+} kwipe_check_case_t;
+
+static const kwipe_check_case_t kwipe_check_cases[] = {
+    { "fresh", 0, 1, 0, 0, 2, 0, 1 },
+    { "sanitized", 0, 1, 0, NWIPE_CHECK_COMPLETED, 2, 0, 1 },
+    { "d_sense", 1, 0, 0, NWIPE_CHECK_COMPLETED, 1, 0, 1 },
+    { "frozen", 0, 1, 0, NWIPE_CHECK_FROZEN, 1, -1, 0 },
+    { "fixed", 0, 0, 0, NWIPE_CHECK_COMPLETED, 1, -1, 0 },
+    { "ignored", 0, 1, 1, 0, 2, -1, 1 } };
+
+#define NWIPE_CHECK_CASES ( sizeof( kwipe_check_cases ) / sizeof( kwipe_check_cases[0] ) )
+
+/* The simulated drive */
+typedef struct
+{
+    const kwipe_check_case_t* t;
+    int d_sense;
+    unsigned int status;
+    unsigned int progress;  // The LBA of SANITIZE STATUS EXT, 0 to 65535.
+    int polls;
+    int started;
+    int status_reads;
+} kwipe_check_drive_t;
+
+static kwipe_check_drive_t drive;
+
+static int verbose = 0;
+
+/* sanitize.c uses the log of kwipe, only shown with --verbose */
+void kwipe_log( kwipe_log_t level, const char* format, ... )
+{
+    va_list ap;
+
+    (void) level;
+
+    if( !verbose )
+    {
+        return;
+    }
+
+    va_start( ap, format );
+    vfprintf( stderr, format, ap );
+    va_end( ap );
+    fputc( '\n', stderr );
+}
+
+void kwipe_perror( int kwipe_errno, const char* f, const char* s )
+{
+    fprintf( stderr, "%s: %s: %s\n", f, s, strerror( kwipe_errno ) );
+}
+
+/* What sanitize.c needs of the rest of kwipe */
+kwipe_options_t kwipe_options;
+const kwipe_io_backend_t kwipe_io_device = { .label = "device" };
+
+void* kwipe_sanitize_crypto( void* ptr )
+{
+    return ptr;
+}
+
+void* kwipe_sanitize_block( void* ptr )
+{
+    return ptr;
+}
+
+void* kwipe_sanitize_overwrite( void* ptr )
+{
+    return ptr;
+}
+
+const char* kwipe_method_label( void* method )
+{
+    (void) method;
+    return "Sanitize";
+}
+
+u64 kwipe_time_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (u64) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Fails the command with CHECK CONDITION and fixed format sense data */
+static void kwipe_check_sense( kwipe_scsi_command_t* command, int key, int asc, int ascq )
+{
+    memset( command->sense, 0, sizeof( command->sense ) );
+    command->sense[0] = 0x70;
+    command->sense[2] = key;
+    command->sense[7] = 10;
+    command->sense[12] = asc;
+    command->sense[13] = ascq;
+    command->sense_length = 18;
+    command->status = 0x02;
+}
+
+/* Returns the registers of an ATA command with CK_COND, ATA PASS-THROUGH INFORMATION AVAILABLE */
+static void kwipe_check_registers( kwipe_scsi_command_t* command,
+                                   unsigned char error,
+                                   unsigned char status,
+                                   unsigned int count,
+                                   u64 lba )
+{
+    unsigned char* s = command->sense;
+
+    memset( s, 0, sizeof( command->sense ) );
+    command->status = 0x02;
+
+    if( drive.d_sense && !drive.t->d_sense_ignored )
+    {
+        /* The ATA Status Return descriptor */
+        s[0] = 0x72;
+        s[1] = 0x01;
+        s[3] = 0x1D;
+        s[7] = 14;
+        s[8] = 0x09;
+        s[9] = 0x0C;
+        s[10] = 0x01;
+        s[11] = error;
+        s[12] = ( count >> 8 ) & 0xFF;
+        s[13] = count & 0xFF;
+        s[14] = ( lba >> 24 ) & 0xFF;
+        s[15] = lba & 0xFF;
+        s[16] = ( lba >> 32 ) & 0xFF;
+        s[17] = ( lba >> 8 ) & 0xFF;
+        s[18] = ( lba >> 40 ) & 0xFF;
+        s[19] = ( lba >> 16 ) & 0xFF;
+        s[21] = status;
+        command->sense_length = 22;
+        return;
+    }
+
+    /* Fixed format only holds the low bytes, and flags the upper ones that aren't zero */
+    s[0] = 0x70;
+    s[2] = 0x01;
+    s[3] = error;
+    s[4] = status;
+    s[6] = count & 0xFF;
+    s[7] = 10;
+    s[8] = 0x80 | ( ( count >> 8 ) ? 0x40 : 0 ) | ( ( lba >> 24 ) ? 0x20 : 0 );
+    s[9] = lba & 0xFF;
+    s[10] = ( lba >> 8 ) & 0xFF;
+    s[11] = ( lba >> 16 ) & 0xFF;
+    s[13] = 0x1D;
+    command->sense_length = 18;
+}
+
+static void kwipe_check_ata( kwipe_scsi_command_t* command )
+{
+    unsigned char* data = command->data;
+    unsigned int feature = ( command->cdb[3] << 8 ) | command->cdb[4];
+
+    switch( command->cdb[14] )
+    {
+        case 0xEC:
+            /* IDENTIFY DEVICE, word 59 with every sanitize operation supported */
+            memset( data, 0, command->data_length );
+            data[118] = 0x00;
+            data[119] = 0xF0;
+            command->status = 0;
+            return;
+
+        case 0xB4:
+            if( feature == 0x0000 )
+            {
+                /* SANITIZE STATUS EXT, a running operation moves on with each read */
+                drive.status_reads++;
+                if( ( drive.status & NWIPE_CHECK_IN_PROGRESS ) && --drive.polls <= 0 )
+                {
+                    drive.status = NWIPE_CHECK_COMPLETED;
+                    drive.progress = 0;
+                }
+                else if( drive.status & NWIPE_CHECK_IN_PROGRESS )
+                {
+                    drive.progress += 0x4000;
+                }
+                kwipe_check_registers( command, 0, 0x50, drive.status, drive.progress );
+                return;
+            }
+
+            /* A sanitize operation, refused while frozen */
+            if( drive.status & NWIPE_CHECK_FROZEN )
+            {
+                kwipe_check_registers( command, 0x04, 0x51, 0, 0 );
+                return;
+            }
+            drive.started++;
+            drive.status = NWIPE_CHECK_IN_PROGRESS;
+            drive.progress = 0;
+            drive.polls = drive.t->polls;
+            kwipe_check_registers( command, 0, 0x50, 0, 0 );
+            return;
+    }
+
+    kwipe_check_sense( command, 0x05, 0x20, 0x00 );
+}
+
+static int kwipe_check_scsi_command( int fd, kwipe_scsi_command_t* command )
+{
+    unsigned char* data = command->data;
+    unsigned int length;
+
+    (void) fd;
+
+    command->status = 0;
+    command->sense_length = 0;
+
+    switch( command->cdb[0] )
+    {
+        case 0x5A:
+            /* MODE SENSE (10) of the Control mode page, without block descriptors */
+            length = ( command->cdb[7] << 8 ) | command->cdb[8];
+            if( ( command->cdb[2] & 0x3F ) != 0x0A || length < 20 )
+            {
+                kwipe_check_sense( command, 0x05, 0x24, 0x00 );
+                break;
+            }
+            memset( data, 0, length );
+            data[1] = 18;
+            data[8] = 0x0A;
+            data[9] = 0x0A;
+            data[10] = drive.d_sense ? 0x04 : 0;
+            break;
+
+        case 0x55:
+            /* MODE SELECT (10), only D_SENSE of the Control mode page may change */
+            if( !drive.t->d_sense_settable || data[0] != 0 || data[1] != 0 || data[8] != 0x0A
+                || ( data[10] & ~0x04 ) != 0 )
+            {
+                kwipe_check_sense( command, 0x05, 0x26, 0x00 );
+                break;
+            }
+            drive.d_sense = ( data[10] & 0x04 ) != 0;
+            break;
+
+        case 0x85:
+            kwipe_check_ata( command );
+            break;
+
+        default:
+            kwipe_check_sense( command, 0x05, 0x20, 0x00 );
+            break;
+    }
+
+    return 0;
+}
+
+static int kwipe_check_nvme_admin_command( int fd, kwipe_nvme_command_t* command )
+{
+    (void) fd;
+    (void) command;
+
+    errno = ENOTTY;
+    return -1;
+}
+
+static int kwipe_check_nvme_namespace_id( int fd )
+{
+    (void) fd;
+
+    errno = ENOTTY;
+    return -1;
+}
+
+static const kwipe_sanitize_ops_t kwipe_check_ops = {
+    kwipe_check_scsi_command,
+    kwipe_check_nvme_admin_command,
+    kwipe_check_nvme_namespace_id,
+};
+
+static int kwipe_check_case( const kwipe_check_case_t* t )
+{
+    static char device_name[] = "/dev/sdz";
+    kwipe_context_t* c;
+    int f = 0;
+    int r;
+
+    memset( &drive, 0, sizeof( drive ) );
+    drive.t = t;
+    drive.d_sense = t->d_sense;
+    drive.status = t->status;
+
+    c = calloc( 1, sizeof( kwipe_context_t ) );
+    if( c == NULL )
+    {
+        fprintf( stderr, "sanitize-check: Unable to allocate memory for the context\n" );
+        return 1;
+    }
+    c->device_name = device_name;
+    c->device_type = NWIPE_DEVICE_ATA;
+    c->device_size = 1ULL << 30;
+    c->device_fd = -1;
+    c->io = &kwipe_io_device;
+
+    r = kwipe_sanitize( c, NWIPE_SANITIZE_CRYPTO );
+
+    printf( "  %-10s returned %i, %i started, %i status reads\n", t->name, r, drive.started, drive.status_reads );
+
+    if( r != t->result )
+    {
+        printf( "  %s: kwipe_sanitize() returned %i instead of %i\n", t->name, r, t->result );
+        f++;
+    }
+    if( drive.started != t->started )
+    {
+        printf( "  %s: %i sanitize operations were started instead of %i\n", t->name, drive.started, t->started );
+        f++;
+    }
+    if( drive.status_reads > NWIPE_CHECK_MAX_STATUS_READS )
+    {
+        printf( "  %s: the status was read %i times, a finished operation was polled as running\n",
+                t->name,
+                drive.status_reads );
+        f++;
+    }
+    if( r == 0 && c->progress.pass_done != c->device_size )
+    {
+        printf( "  %s: the progress ended at %llu of %llu bytes\n", t->name, c->progress.pass_done, c->device_size );
+        f++;
+    }
+
+    free( c );
+
+    return f;
+}
+
+static void kwipe_check_timeout( int sig )
+{
+    const char message[] = ": timed out, a finished sanitize operation was polled as running\n  FAILED\n";
+
+    ssize_t r;
+
+    (void) sig;
+
+    /* Only what is safe in a signal handler */
+    r = write( STDOUT_FILENO, "  ", 2 );
+    r = write( STDOUT_FILENO, drive.t->name, strlen( drive.t->name ) );
+    r = write( STDOUT_FILENO, message, sizeof( message ) - 1 );
+    (void) r;
+
+    _exit( 1 );
+}
+
+static void usage( void )
+{
+    printf( "Usage: sanitize-check [--verbose]\n" );
+    printf( "  --verbose  Show the log of the sanitize method\n" );
+}
+
+int main( int argc, char** argv )
+{
+    int failures = 0;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp( argv[i], "--verbose" ) == 0 )
+        {
+            verbose = 1;
+        }
+        else
+        {
+            usage();
+            return strcmp( argv[i], "--help" ) == 0 ? 0 : 2;
+        }
+    }
+
+    /* A case polling forever is stopped and fails the test */
+    setvbuf( stdout, NULL, _IOLBF, 0 );
+    signal( SIGALRM, kwipe_check_timeout );
+    alarm( NWIPE_CHECK_TIMEOUT_S );
+
+    /* One operation and no sampled read back, the drive has no blocks */
+    kwipe_options.verify = NWIPE_VERIFY_NONE;
+    kwipe_options.rounds = 1;
+    kwipe_sanitize_set_ops( &kwipe_check_ops );
+
+    printf( "ATA SANITIZE\n" );
+    for( size_t i = 0; i < NWIPE_CHECK_CASES; i++ )
+    {
+        failures += kwipe_check_case( &kwipe_check_cases[i] );
+    }
+
+    printf( "  %s\n", failures ? "FAILED" : "passed" );
+    return failures ? 1 : 0;
+}